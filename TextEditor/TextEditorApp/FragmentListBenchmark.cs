@@ -0,0 +1,353 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Text;
+
+namespace TextEditor
+{
+    // Benchmark of FragmentList (the line list of StringStorage) against its previous element-at-a-time shifting
+    // implementation, kept here as ShiftingFragmentList, and List<T>. Each is driven with identical random sequences of
+    // inserts and removes at random positions in a large list; final contents are compared as a cross-check.
+    public static class FragmentListBenchmark
+    {
+#if DEBUG
+        private const int InitialCount = 20000;
+        private const int Operations = 500;
+#else
+        private const int InitialCount = 5000000;
+        private const int Operations = 20000;
+#endif
+        private const int RangeLimit = 100;
+
+        private interface ISubject
+        {
+            int Count { get; }
+            string this[int index] { get; }
+            void InsertRange(int index, string[] items, int count);
+            void RemoveRange(int index, int count);
+        }
+
+        private class ListList : ISubject
+        {
+            private readonly List<string> list = new List<string>();
+
+            public int Count { get { return list.Count; } }
+            public string this[int index] { get { return list[index]; } }
+
+            public void InsertRange(int index, string[] items, int count)
+            {
+                list.InsertRange(index, new ArraySegment<string>(items, 0, count));
+            }
+
+            public void RemoveRange(int index, int count)
+            {
+                list.RemoveRange(index, count);
+            }
+        }
+
+        private class ShiftingList : ISubject
+        {
+            private ShiftingFragmentList<string> list;
+
+            public int Count { get { return list.Count; } }
+            public string this[int index] { get { return list[index]; } }
+
+            public void InsertRange(int index, string[] items, int count)
+            {
+                list.InsertRange(index, items, 0, count);
+            }
+
+            public void RemoveRange(int index, int count)
+            {
+                list.RemoveRange(index, count);
+            }
+        }
+
+        private class TieredList : ISubject
+        {
+            private FragmentList<string> list;
+
+            public int Count { get { return list.Count; } }
+            public string this[int index] { get { return list[index]; } }
+
+            public void InsertRange(int index, string[] items, int count)
+            {
+                list.InsertRange(index, items, 0, count);
+            }
+
+            public void RemoveRange(int index, int count)
+            {
+                list.RemoveRange(index, count);
+            }
+        }
+
+        public static string Run(int randomSeed)
+        {
+            KeyValuePair<string, Func<ISubject>>[] lists = new KeyValuePair<string, Func<ISubject>>[]
+            {
+                new KeyValuePair<string, Func<ISubject>>("List<T>", delegate () { return new ListList(); }),
+                new KeyValuePair<string, Func<ISubject>>("Shifting (previous)", delegate () { return new ShiftingList(); }),
+                new KeyValuePair<string, Func<ISubject>>("Tiered", delegate () { return new TieredList(); }),
+            };
+            int[] rangeLimits = new int[] { 1, RangeLimit };
+            string[] scenarioNames = new string[]
+            {
+                String.Format("Single insert/remove ({0:N0} ops on {1:N0} items)", Operations, InitialCount),
+                String.Format("Range insert/remove of 1..{2} ({0:N0} ops on {1:N0} items)", Operations, InitialCount, RangeLimit),
+            };
+
+            StringBuilder report = new StringBuilder();
+            report.AppendLine(String.Format("FragmentList benchmark: random seed = {0}", randomSeed));
+#if DEBUG
+            report.AppendLine("DEBUG build - timings include validation and reduced sizes");
+#endif
+            string[] items = new string[Math.Max(InitialCount, RangeLimit)];
+            for (int i = 0; i < items.Length; i++)
+            {
+                items[i] = i.ToString();
+            }
+
+            for (int i = 0; i < rangeLimits.Length; i++)
+            {
+                report.AppendLine();
+                report.AppendLine(scenarioNames[i]);
+                ISubject reference = null;
+                foreach (KeyValuePair<string, Func<ISubject>> list in lists)
+                {
+                    GC.Collect();
+                    GC.WaitForPendingFinalizers();
+
+                    ISubject subject = list.Value();
+                    subject.InsertRange(0, items, InitialCount);
+
+                    Stopwatch sw = Stopwatch.StartNew();
+                    Random random = new Random(randomSeed);
+                    for (int j = 0; j < Operations; j++)
+                    {
+                        int count = 1 + random.Next(rangeLimits[i]);
+                        if ((j % 2) == 0)
+                        {
+                            subject.InsertRange(random.Next(subject.Count + 1), items, count);
+                        }
+                        else
+                        {
+                            subject.RemoveRange(random.Next(subject.Count - count + 1), count);
+                        }
+                    }
+                    sw.Stop();
+
+                    bool match = true;
+                    if (reference != null)
+                    {
+                        match = reference.Count == subject.Count;
+                        for (int j = 0; match && (j < subject.Count); j++)
+                        {
+                            match = String.Equals(reference[j], subject[j]);
+                        }
+                    }
+                    reference = reference ?? subject;
+                    report.AppendLine(String.Format(
+                        "  {0,-20}{1,10:N0} ms{2}",
+                        list.Key,
+                        sw.ElapsedMilliseconds,
+                        match ? String.Empty : "  MISMATCH"));
+                }
+            }
+            return report.ToString();
+        }
+
+        // FragmentList as it was before becoming a tiered vector: inserts and removes shift each following element
+        // individually through the block address calculation
+        private struct ShiftingFragmentList<T>
+        {
+            private const int BlockSize = 4096; // must be integer power of 2
+
+            private int count;
+            private T[] simpleArray; // exactly one of these is not null
+            private T[][] fragmentArray; // exactly one of these is not null
+
+            public int Count
+            {
+                get
+                {
+                    return count;
+                }
+            }
+
+            public T this[int index]
+            {
+                get
+                {
+                    T[] vector;
+                    int offset;
+                    GetEffectiveAddress(index, out vector, out offset);
+                    return vector[offset];
+                }
+            }
+
+            private void GetEffectiveAddress(int index, out T[] vector, out int offset)
+            {
+                if (unchecked((uint)index) >= unchecked((uint)this.count))
+                {
+                    throw new ArgumentOutOfRangeException();
+                }
+                if (simpleArray != null)
+                {
+                    vector = simpleArray;
+                    offset = index;
+                }
+                else
+                {
+                    vector = fragmentArray[index / BlockSize];
+                    offset = index & (BlockSize - 1);
+                }
+            }
+
+            public void InsertRange(int index, T[] collection, int offset, int count)
+            {
+                if ((unchecked((uint)index) > unchecked((uint)this.count)) || (count < 0))
+                {
+                    throw new ArgumentOutOfRangeException();
+                }
+                if (count == 0)
+                {
+                    return;
+                }
+
+                int after = this.count - index;
+
+                EnsureCapacity(this.count + count);
+                this.count += count;
+
+                for (int i = after - 1; i >= 0; i--)
+                {
+                    T[] vector;
+                    int vectorOffset;
+                    GetEffectiveAddress(i + index, out vector, out vectorOffset);
+                    T t = vector[vectorOffset];
+                    GetEffectiveAddress(i + index + count, out vector, out vectorOffset);
+                    vector[vectorOffset] = t;
+                }
+                for (int i = 0; i < count; i++)
+                {
+                    T[] vector;
+                    int vectorOffset;
+                    GetEffectiveAddress(i + index, out vector, out vectorOffset);
+                    vector[vectorOffset] = collection[i + offset];
+                }
+            }
+
+            public void RemoveRange(int index, int count)
+            {
+                if ((count < 0) || (unchecked((uint)(index + count)) > unchecked((uint)this.count)))
+                {
+                    throw new ArgumentOutOfRangeException();
+                }
+                for (int i = index; i < this.count - count; i++)
+                {
+                    T[] vector;
+                    int vectorOffset;
+                    GetEffectiveAddress(i + count, out vector, out vectorOffset);
+                    T t = vector[vectorOffset];
+                    GetEffectiveAddress(i, out vector, out vectorOffset);
+                    vector[vectorOffset] = t;
+                }
+                for (int i = this.count - count; i < this.count; i++)
+                {
+                    // clear dead slots for garbage collector
+                    T[] vector;
+                    int vectorOffset;
+                    GetEffectiveAddress(i, out vector, out vectorOffset);
+                    vector[vectorOffset] = default(T);
+                }
+                this.count -= count;
+            }
+
+            private int Capacity
+            {
+                get
+                {
+                    if (simpleArray != null)
+                    {
+                        return simpleArray.Length;
+                    }
+                    else if (fragmentArray != null)
+                    {
+                        return fragmentArray.Length * BlockSize;
+                    }
+                    return 0;
+                }
+            }
+
+            private void EnsureCapacity(int capacity)
+            {
+                if (capacity <= Capacity)
+                {
+                    return;
+                }
+                if (capacity <= BlockSize)
+                {
+                    if (simpleArray == null)
+                    {
+                        simpleArray = new T[capacity];
+                    }
+                    if (simpleArray.Length < capacity)
+                    {
+                        int up = capacity;
+                        up |= up >> 1;
+                        up |= up >> 2;
+                        up |= up >> 4;
+                        up |= up >> 8;
+                        up |= up >> 16;
+                        up = up + 1;
+                        Array.Resize(ref simpleArray, Math.Min(up, BlockSize));
+                    }
+                }
+                else
+                {
+                    int oldEnd = fragmentArray != null ? fragmentArray.Length * BlockSize : 0;
+                    int c = (capacity + (BlockSize - 1)) & ~(BlockSize - 1); // round up
+                    if (fragmentArray == null)
+                    {
+                        fragmentArray = new T[c / BlockSize][];
+                        fragmentArray[0] = simpleArray;
+                        simpleArray = null;
+                        Array.Resize(ref fragmentArray[0], BlockSize);
+                    }
+                    else
+                    {
+                        Array.Resize(ref fragmentArray, c / BlockSize);
+                    }
+                    for (int i = oldEnd; i < c; i += BlockSize)
+                    {
+                        if (fragmentArray[i / BlockSize] == null)
+                        {
+                            fragmentArray[i / BlockSize] = new T[BlockSize];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -33,7 +33,7 @@ namespace TextEditor
         public static EditorConfigList Config = new EditorConfigList();
 
         private const string SettingsFileName = "Settings.xml";
-        private const string LocalApplicationDirectoryName = "TextEditor";
+        public const string LocalApplicationDirectoryName = "TextEditor";
         private static string GetSettingsPath(bool create)
         {
             string root = Environment.GetFolderPath(Environment.SpecialFolder.ApplicationData, Environment.SpecialFolderOption.None);
@@ -83,6 +83,37 @@ namespace TextEditor
             return applicationDataPath;
         }
 
+        #if WINDOWS
+        private const string PrivateFontsDirectoryName = "Fonts";
+        private static readonly string[] PrivateFontExtensions = new string[] { ".ttf", ".otf", ".ttc" };
+
+        // Font files in the Fonts folder beside the settings file are made available to the DirectWrite text service
+        // by family name without installing them. Each is mapped read-only rather than read into memory.
+        private static void RegisterPrivateFonts()
+        {
+            string dir = Path.Combine(Path.GetDirectoryName(GetSettingsPath(false/*create*/)), PrivateFontsDirectoryName);
+            if (!Directory.Exists(dir))
+            {
+                return;
+            }
+            foreach (string path in Directory.GetFiles(dir))
+            {
+                if (Array.IndexOf(PrivateFontExtensions, Path.GetExtension(path).ToLowerInvariant()) < 0)
+                {
+                    continue;
+                }
+                try
+                {
+                    DirectWriteTextRenderer.RegisterPrivateFontFile(path);
+                }
+                catch (Exception exception)
+                {
+                    MessageBox.Show(String.Format("Exception loading font file \"{0}\": {1}", path, exception.Message));
+                }
+            }
+        }
+        #endif
+
 		#if WINDOWS
 		#else
 		private class MonoTraceListener : TraceListener
@@ -134,7 +165,12 @@ namespace TextEditor
 			Debug.Listeners.Add(new MonoTraceListener());
 			#endif
 
+			StartupTiming.Mark("Main");
 			LoadSettings();
+			StartupTiming.Mark("Settings loaded");
+			#if WINDOWS
+			RegisterPrivateFonts();
+			#endif
 
             #region Debugger Attach Helper
             {
@@ -171,6 +207,47 @@ namespace TextEditor
             Application.EnableVisualStyles();
             Application.SetCompatibleTextRenderingDefault(false);
 
+            if ((args.Length > 0) && String.Equals(args[0], "-benchmarkstorage"))
+            {
+                // -benchmarkstorage [seed [reportfile]]
+                int randomSeed = args.Length > 1 ? Int32.Parse(args[1]) : Environment.TickCount;
+                string report = StorageBenchmark.Run(randomSeed);
+                ShowBenchmarkReport("Storage Benchmark", report, args.Length > 2 ? args[2] : null);
+                return;
+            }
+
+            if ((args.Length > 0) && String.Equals(args[0], "-benchmarkfragmentlist"))
+            {
+                // -benchmarkfragmentlist [seed [reportfile]]
+                int randomSeed = args.Length > 1 ? Int32.Parse(args[1]) : Environment.TickCount;
+                string report = FragmentListBenchmark.Run(randomSeed);
+                ShowBenchmarkReport("FragmentList Benchmark", report, args.Length > 2 ? args[2] : null);
+                return;
+            }
+
+            if ((args.Length > 0) && String.Equals(args[0], "-benchmarkstochastic"))
+            {
+                // -benchmarkstochastic operations [seed [validateinterval [reportfile]]]
+                int operations = args.Length > 1 ? Int32.Parse(args[1]) : 100000;
+                int randomSeed = args.Length > 2 ? Int32.Parse(args[2]) : Environment.TickCount;
+                int validateInterval = args.Length > 3 ? Int32.Parse(args[3]) : 0;
+                string report = StochasticBenchmark.Run(StorageBenchmark.GetFactories(), randomSeed, operations, validateInterval);
+                ShowBenchmarkReport("Stochastic Benchmark", report, args.Length > 4 ? args[4] : null);
+                return;
+            }
+
+            string perfPath = null;
+            if ((args.Length > 1) && String.Equals(args[0], "-perf"))
+            {
+                // -perf basepath [files...] - counters written to basepath.txt and trace to basepath.json on exit
+                perfPath = args[1];
+                string[] remaining = new string[args.Length - 2];
+                Array.Copy(args, 2, remaining, 0, remaining.Length);
+                args = remaining;
+                PerfCounters.Enabled = true;
+                PerfCounters.Tracing = true;
+            }
+
             if (args.Length != 0)
             {
                 foreach (string arg in args)
@@ -208,9 +285,34 @@ namespace TextEditor
                 defaultEmptyForm = new TextEditorWindow();
                 defaultEmptyForm.Show();
             }
+            StartupTiming.Mark("Windows shown");
 
+            SessionMemory.Start();
             Application.Idle += new EventHandler(Application_Idle);
             Application.Run();
+
+            if (perfPath != null)
+            {
+                File.WriteAllText(perfPath + ".txt", StartupTiming.Report() + Environment.NewLine + PerfCounters.GetSnapshot().ToString());
+                using (TextWriter writer = new StreamWriter(perfPath + ".json"))
+                {
+                    PerfCounters.WriteChromeTrace(writer);
+                }
+            }
+        }
+
+        // report written to file (for unattended regression runs) or else shown
+        private static void ShowBenchmarkReport(string title, string report, string reportPath)
+        {
+            Debugger.Log(0, "TextEditorApp.Benchmark", report);
+            if (reportPath != null)
+            {
+                File.WriteAllText(reportPath, report);
+            }
+            else
+            {
+                MessageBox.Show(report, title);
+            }
         }
 
         private static void Application_Idle(object sender, EventArgs e)
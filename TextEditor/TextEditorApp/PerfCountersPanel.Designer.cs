@@ -0,0 +1,166 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+namespace TextEditor
+{
+    partial class PerfCountersPanel
+    {
+        /// <summary>
+        /// Required designer variable.
+        /// </summary>
+        private System.ComponentModel.IContainer components = null;
+
+        /// <summary>
+        /// Clean up any resources being used.
+        /// </summary>
+        /// <param name="disposing">true if managed resources should be disposed; otherwise, false.</param>
+        protected override void Dispose(bool disposing)
+        {
+            if (disposing && (components != null))
+            {
+                components.Dispose();
+            }
+            base.Dispose(disposing);
+        }
+
+        #region Windows Form Designer generated code
+
+        /// <summary>
+        /// Required method for Designer support - do not modify
+        /// the contents of this method with the code editor.
+        /// </summary>
+        private void InitializeComponent()
+        {
+            this.components = new System.ComponentModel.Container();
+            this.flowLayoutPanel1 = new System.Windows.Forms.FlowLayoutPanel();
+            this.checkBoxEnabled = new System.Windows.Forms.CheckBox();
+            this.checkBoxTracing = new System.Windows.Forms.CheckBox();
+            this.buttonReset = new System.Windows.Forms.Button();
+            this.buttonSaveTrace = new System.Windows.Forms.Button();
+            this.textBoxReport = new System.Windows.Forms.TextBox();
+            this.timerRefresh = new System.Windows.Forms.Timer(this.components);
+            this.flowLayoutPanel1.SuspendLayout();
+            this.SuspendLayout();
+            // 
+            // flowLayoutPanel1
+            // 
+            this.flowLayoutPanel1.AutoSize = true;
+            this.flowLayoutPanel1.Controls.Add(this.checkBoxEnabled);
+            this.flowLayoutPanel1.Controls.Add(this.checkBoxTracing);
+            this.flowLayoutPanel1.Controls.Add(this.buttonReset);
+            this.flowLayoutPanel1.Controls.Add(this.buttonSaveTrace);
+            this.flowLayoutPanel1.Dock = System.Windows.Forms.DockStyle.Top;
+            this.flowLayoutPanel1.Location = new System.Drawing.Point(0, 0);
+            this.flowLayoutPanel1.Name = "flowLayoutPanel1";
+            this.flowLayoutPanel1.Size = new System.Drawing.Size(684, 29);
+            this.flowLayoutPanel1.TabIndex = 0;
+            // 
+            // checkBoxEnabled
+            // 
+            this.checkBoxEnabled.AutoSize = true;
+            this.checkBoxEnabled.Location = new System.Drawing.Point(3, 6);
+            this.checkBoxEnabled.Margin = new System.Windows.Forms.Padding(3, 6, 3, 3);
+            this.checkBoxEnabled.Name = "checkBoxEnabled";
+            this.checkBoxEnabled.Size = new System.Drawing.Size(65, 17);
+            this.checkBoxEnabled.TabIndex = 0;
+            this.checkBoxEnabled.Text = "&Enabled";
+            this.checkBoxEnabled.UseVisualStyleBackColor = true;
+            this.checkBoxEnabled.CheckedChanged += new System.EventHandler(this.checkBoxEnabled_CheckedChanged);
+            // 
+            // checkBoxTracing
+            // 
+            this.checkBoxTracing.AutoSize = true;
+            this.checkBoxTracing.Location = new System.Drawing.Point(74, 6);
+            this.checkBoxTracing.Margin = new System.Windows.Forms.Padding(3, 6, 3, 3);
+            this.checkBoxTracing.Name = "checkBoxTracing";
+            this.checkBoxTracing.Size = new System.Drawing.Size(62, 17);
+            this.checkBoxTracing.TabIndex = 1;
+            this.checkBoxTracing.Text = "&Tracing";
+            this.checkBoxTracing.UseVisualStyleBackColor = true;
+            this.checkBoxTracing.CheckedChanged += new System.EventHandler(this.checkBoxTracing_CheckedChanged);
+            // 
+            // buttonReset
+            // 
+            this.buttonReset.Location = new System.Drawing.Point(142, 3);
+            this.buttonReset.Name = "buttonReset";
+            this.buttonReset.Size = new System.Drawing.Size(75, 23);
+            this.buttonReset.TabIndex = 2;
+            this.buttonReset.Text = "&Reset";
+            this.buttonReset.UseVisualStyleBackColor = true;
+            this.buttonReset.Click += new System.EventHandler(this.buttonReset_Click);
+            // 
+            // buttonSaveTrace
+            // 
+            this.buttonSaveTrace.AutoSize = true;
+            this.buttonSaveTrace.Location = new System.Drawing.Point(223, 3);
+            this.buttonSaveTrace.Name = "buttonSaveTrace";
+            this.buttonSaveTrace.Size = new System.Drawing.Size(85, 23);
+            this.buttonSaveTrace.TabIndex = 3;
+            this.buttonSaveTrace.Text = "&Save Trace...";
+            this.buttonSaveTrace.UseVisualStyleBackColor = true;
+            this.buttonSaveTrace.Click += new System.EventHandler(this.buttonSaveTrace_Click);
+            // 
+            // textBoxReport
+            // 
+            this.textBoxReport.Dock = System.Windows.Forms.DockStyle.Fill;
+            this.textBoxReport.Font = new System.Drawing.Font("Consolas", 9F, System.Drawing.FontStyle.Regular, System.Drawing.GraphicsUnit.Point, ((byte)(0)));
+            this.textBoxReport.Location = new System.Drawing.Point(0, 29);
+            this.textBoxReport.Multiline = true;
+            this.textBoxReport.Name = "textBoxReport";
+            this.textBoxReport.ReadOnly = true;
+            this.textBoxReport.ScrollBars = System.Windows.Forms.ScrollBars.Both;
+            this.textBoxReport.Size = new System.Drawing.Size(684, 332);
+            this.textBoxReport.TabIndex = 4;
+            this.textBoxReport.WordWrap = false;
+            // 
+            // timerRefresh
+            // 
+            this.timerRefresh.Enabled = true;
+            this.timerRefresh.Interval = 1000;
+            this.timerRefresh.Tick += new System.EventHandler(this.timerRefresh_Tick);
+            // 
+            // PerfCountersPanel
+            // 
+            this.AutoScaleDimensions = new System.Drawing.SizeF(6F, 13F);
+            this.AutoScaleMode = System.Windows.Forms.AutoScaleMode.Font;
+            this.ClientSize = new System.Drawing.Size(684, 361);
+            this.Controls.Add(this.textBoxReport);
+            this.Controls.Add(this.flowLayoutPanel1);
+            this.Name = "PerfCountersPanel";
+            this.Text = "Performance Counters";
+            this.flowLayoutPanel1.ResumeLayout(false);
+            this.flowLayoutPanel1.PerformLayout();
+            this.ResumeLayout(false);
+            this.PerformLayout();
+
+        }
+
+        #endregion
+
+        private System.Windows.Forms.FlowLayoutPanel flowLayoutPanel1;
+        private System.Windows.Forms.CheckBox checkBoxEnabled;
+        private System.Windows.Forms.CheckBox checkBoxTracing;
+        private System.Windows.Forms.Button buttonReset;
+        private System.Windows.Forms.Button buttonSaveTrace;
+        private System.Windows.Forms.TextBox textBoxReport;
+        private System.Windows.Forms.Timer timerRefresh;
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Windows.Forms;
+
+namespace TextEditor
+{
+    public partial class PerfCountersPanel : Form
+    {
+        private const int WindowSeconds = 10;
+
+        // snapshots taken at each refresh - the rolling histogram is the difference between the newest and oldest
+        private readonly Queue<PerfSnapshot> window = new Queue<PerfSnapshot>();
+
+        public PerfCountersPanel()
+        {
+            InitializeComponent();
+            this.Icon = TextEditorApp.Properties.Resources.Icon2;
+
+            checkBoxEnabled.Checked = PerfCounters.Enabled;
+            checkBoxTracing.Checked = PerfCounters.Tracing;
+            UpdateReport();
+        }
+
+        private void UpdateReport()
+        {
+            PerfSnapshot snapshot = PerfCounters.GetSnapshot();
+            window.Enqueue(snapshot);
+            while (window.Count > WindowSeconds * 1000 / timerRefresh.Interval + 1)
+            {
+                window.Dequeue();
+            }
+            PerfSnapshot rolling = snapshot.Subtract(window.Peek());
+
+            textBoxReport.Text = String.Format(
+                "Last {0:N1} seconds{1}{1}{2}",
+                (double)rolling.timestamp / Stopwatch.Frequency,
+                Environment.NewLine,
+                rolling);
+        }
+
+        private void timerRefresh_Tick(object sender, EventArgs e)
+        {
+            UpdateReport();
+        }
+
+        private void checkBoxEnabled_CheckedChanged(object sender, EventArgs e)
+        {
+            PerfCounters.Enabled = checkBoxEnabled.Checked;
+        }
+
+        private void checkBoxTracing_CheckedChanged(object sender, EventArgs e)
+        {
+            PerfCounters.Tracing = checkBoxTracing.Checked;
+        }
+
+        private void buttonReset_Click(object sender, EventArgs e)
+        {
+            PerfCounters.Reset();
+            window.Clear();
+            UpdateReport();
+        }
+
+        private void buttonSaveTrace_Click(object sender, EventArgs e)
+        {
+            using (SaveFileDialog dialog = new SaveFileDialog())
+            {
+                dialog.Filter = "Chrome Trace (*.json)|*.json|All Files (*.*)|*.*";
+                dialog.FileName = "trace.json";
+                if (dialog.ShowDialog() != DialogResult.OK)
+                {
+                    return;
+                }
+                using (TextWriter writer = new StreamWriter(dialog.FileName))
+                {
+                    PerfCounters.WriteChromeTrace(writer);
+                }
+            }
+        }
+    }
+}
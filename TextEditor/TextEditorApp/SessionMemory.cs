@@ -0,0 +1,115 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Windows.Forms;
+
+namespace TextEditor
+{
+    // Keeps the memory held by all open documents within the configured budget. When over budget, windows that have
+    // not been used recently are visited least recently used first: their layout caches are discarded, then unmodified
+    // documents backed by a file are hibernated (text released, and reread through a mapped view of the file when the
+    // window is next activated), and finally undo history is trimmed. Footprints are estimates.
+    public static class SessionMemory
+    {
+#if DEBUG
+        private const int CheckIntervalMilliseconds = 1000;
+        private const int IdleSeconds = 5;
+#else
+        private const int CheckIntervalMilliseconds = 5000;
+        private const int IdleSeconds = 60;
+#endif
+        private const long BytesPerMegabyte = 1024 * 1024;
+
+        private static Timer timer;
+
+        public static void Start()
+        {
+            if (timer == null)
+            {
+                timer = new Timer();
+                timer.Interval = CheckIntervalMilliseconds;
+                timer.Tick += new EventHandler(timer_Tick);
+                timer.Start();
+            }
+        }
+
+        private static void timer_Tick(object sender, EventArgs e)
+        {
+            long budget = MainClass.Config.MemoryBudget * BytesPerMegabyte;
+            if (budget <= 0)
+            {
+                return;
+            }
+
+            List<TextEditorWindow> windows = new List<TextEditorWindow>();
+            long total = 0;
+            foreach (Form form in Application.OpenForms)
+            {
+                TextEditorWindow window = form as TextEditorWindow;
+                if (window != null)
+                {
+                    windows.Add(window);
+                    total += window.MemoryFootprint;
+                }
+            }
+            if (total <= budget)
+            {
+                return;
+            }
+
+            Form active = Form.ActiveForm;
+            DateTime idleBefore = DateTime.UtcNow - TimeSpan.FromSeconds(IdleSeconds);
+            windows.RemoveAll(delegate (TextEditorWindow window) { return (window == active) || (window.LastActive > idleBefore); });
+            windows.Sort(delegate (TextEditorWindow l, TextEditorWindow r) { return l.LastActive.CompareTo(r.LastActive); });
+
+            // cheapest to recover from first
+            foreach (TextEditorWindow window in windows)
+            {
+                if (total <= budget)
+                {
+                    return;
+                }
+                total -= window.TrimCaches();
+            }
+            foreach (TextEditorWindow window in windows)
+            {
+                if (total <= budget)
+                {
+                    return;
+                }
+                if (window.CanHibernate)
+                {
+                    total -= window.Hibernate();
+                }
+            }
+            foreach (TextEditorWindow window in windows)
+            {
+                if (total <= budget)
+                {
+                    return;
+                }
+                total -= window.TrimUndoRedo(total - budget);
+            }
+        }
+    }
+}
@@ -33,6 +33,7 @@ namespace TextEditor
     {
         String,
         Utf8SplayGapBuffer,
+        PieceTree,
     }
 
     public struct EditorConfig
@@ -78,6 +79,8 @@ namespace TextEditor
         private int height;
         private BackingStore backingStore = BackingStore.String;
         private TextService textService = TextService.Simple;
+        private int memoryBudget; // megabytes for all open documents, 0 for unlimited
+        private bool snapshotCache;
         private SearchCombos searchPaths = new SearchCombos();
         private SearchCombos searchExtensions = new SearchCombos();
 
@@ -99,6 +102,8 @@ namespace TextEditor
             this.height = original.height;
             this.backingStore = original.backingStore;
             this.textService = original.textService;
+            this.memoryBudget = original.memoryBudget;
+            this.snapshotCache = original.snapshotCache;
             this.searchPaths = new SearchCombos(original.searchPaths);
             this.searchExtensions = new SearchCombos(original.searchExtensions);
 
@@ -157,6 +162,30 @@ namespace TextEditor
             }
         }
 
+        public int MemoryBudget
+        {
+            get
+            {
+                return memoryBudget;
+            }
+            set
+            {
+                memoryBudget = value;
+            }
+        }
+
+        public bool SnapshotCache
+        {
+            get
+            {
+                return snapshotCache;
+            }
+            set
+            {
+                snapshotCache = value;
+            }
+        }
+
         public SearchCombos SearchPaths
         {
             get
@@ -257,6 +286,20 @@ namespace TextEditor
             catch (NullReferenceException)
             {
             }
+            try
+            {
+                memoryBudget = xml.CreateNavigator().SelectSingleNode("/settings/memoryBudget").ValueAsInt;
+            }
+            catch (NullReferenceException)
+            {
+            }
+            try
+            {
+                snapshotCache = xml.CreateNavigator().SelectSingleNode("/settings/snapshotCache").ValueAsBoolean;
+            }
+            catch (NullReferenceException)
+            {
+            }
             {
                 List<string> searchPathStrings = new List<string>();
                 string searchPathLast = null;
@@ -336,6 +379,14 @@ namespace TextEditor
                     writer.WriteValue(textService.ToString());
                     writer.WriteEndElement();
 
+                    writer.WriteStartElement("memoryBudget");
+                    writer.WriteValue(memoryBudget);
+                    writer.WriteEndElement();
+
+                    writer.WriteStartElement("snapshotCache");
+                    writer.WriteValue(snapshotCache);
+                    writer.WriteEndElement();
+
                     writer.WriteStartElement("searchPaths");
                     foreach (string searchPath in searchPaths.items)
                     {
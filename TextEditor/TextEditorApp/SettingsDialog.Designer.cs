@@ -45,6 +45,10 @@ namespace TextEditor
             this.label3 = new System.Windows.Forms.Label();
             this.label4 = new System.Windows.Forms.Label();
             this.comboBoxTextService = new System.Windows.Forms.ComboBox();
+            this.label5 = new System.Windows.Forms.Label();
+            this.numericUpDownMemoryBudget = new System.Windows.Forms.NumericUpDown();
+            this.label6 = new System.Windows.Forms.Label();
+            this.checkBoxSnapshotCache = new System.Windows.Forms.CheckBox();
             this.dpiChangeHelper = new TextEditor.DpiChangeHelper(this.components);
             this.tableLayoutPanel1.SuspendLayout();
             this.tabControlSettings.SuspendLayout();
@@ -52,6 +56,7 @@ namespace TextEditor
             this.tableLayoutPanel2.SuspendLayout();
             this.flowLayoutPanel1.SuspendLayout();
             this.tableLayoutPanel3.SuspendLayout();
+            ((System.ComponentModel.ISupportInitialize)(this.numericUpDownMemoryBudget)).BeginInit();
             this.SuspendLayout();
             // 
             // tableLayoutPanel1
@@ -194,13 +199,19 @@ namespace TextEditor
             this.tableLayoutPanel3.Controls.Add(this.label3, 0, 0);
             this.tableLayoutPanel3.Controls.Add(this.label4, 0, 1);
             this.tableLayoutPanel3.Controls.Add(this.comboBoxTextService, 1, 1);
+            this.tableLayoutPanel3.Controls.Add(this.label5, 0, 2);
+            this.tableLayoutPanel3.Controls.Add(this.numericUpDownMemoryBudget, 1, 2);
+            this.tableLayoutPanel3.Controls.Add(this.label6, 0, 3);
+            this.tableLayoutPanel3.Controls.Add(this.checkBoxSnapshotCache, 1, 3);
             this.tableLayoutPanel3.Dock = System.Windows.Forms.DockStyle.Top;
             this.tableLayoutPanel3.Location = new System.Drawing.Point(3, 3);
             this.tableLayoutPanel3.Name = "tableLayoutPanel3";
-            this.tableLayoutPanel3.RowCount = 2;
+            this.tableLayoutPanel3.RowCount = 4;
             this.tableLayoutPanel3.RowStyles.Add(new System.Windows.Forms.RowStyle());
             this.tableLayoutPanel3.RowStyles.Add(new System.Windows.Forms.RowStyle());
-            this.tableLayoutPanel3.Size = new System.Drawing.Size(640, 54);
+            this.tableLayoutPanel3.RowStyles.Add(new System.Windows.Forms.RowStyle());
+            this.tableLayoutPanel3.RowStyles.Add(new System.Windows.Forms.RowStyle());
+            this.tableLayoutPanel3.Size = new System.Drawing.Size(640, 103);
             this.tableLayoutPanel3.TabIndex = 5;
             // 
             // comboBoxBackingStore
@@ -210,7 +221,8 @@ namespace TextEditor
             this.comboBoxBackingStore.FormattingEnabled = true;
             this.comboBoxBackingStore.Items.AddRange(new object[] {
             "String",
-            "Utf8SplayGapBuffer"});
+            "Utf8SplayGapBuffer",
+            "PieceTree"});
             this.comboBoxBackingStore.Location = new System.Drawing.Point(323, 3);
             this.comboBoxBackingStore.Name = "comboBoxBackingStore";
             this.comboBoxBackingStore.Size = new System.Drawing.Size(125, 21);
@@ -250,6 +262,54 @@ namespace TextEditor
             this.comboBoxTextService.Size = new System.Drawing.Size(125, 21);
             this.comboBoxTextService.TabIndex = 3;
             // 
+            // label5
+            // 
+            this.label5.Anchor = ((System.Windows.Forms.AnchorStyles)((System.Windows.Forms.AnchorStyles.Left | System.Windows.Forms.AnchorStyles.Right)));
+            this.label5.AutoSize = true;
+            this.label5.Location = new System.Drawing.Point(3, 60);
+            this.label5.Name = "label5";
+            this.label5.Size = new System.Drawing.Size(314, 13);
+            this.label5.TabIndex = 4;
+            this.label5.Text = "Session Memory Budget (MB, 0 = unlimited):";
+            // 
+            // numericUpDownMemoryBudget
+            // 
+            this.numericUpDownMemoryBudget.Anchor = System.Windows.Forms.AnchorStyles.Left;
+            this.numericUpDownMemoryBudget.Increment = new decimal(new int[] {
+            256,
+            0,
+            0,
+            0});
+            this.numericUpDownMemoryBudget.Location = new System.Drawing.Point(323, 57);
+            this.numericUpDownMemoryBudget.Maximum = new decimal(new int[] {
+            1048576,
+            0,
+            0,
+            0});
+            this.numericUpDownMemoryBudget.Name = "numericUpDownMemoryBudget";
+            this.numericUpDownMemoryBudget.Size = new System.Drawing.Size(125, 20);
+            this.numericUpDownMemoryBudget.TabIndex = 5;
+            // 
+            // label6
+            // 
+            this.label6.Anchor = ((System.Windows.Forms.AnchorStyles)((System.Windows.Forms.AnchorStyles.Left | System.Windows.Forms.AnchorStyles.Right)));
+            this.label6.AutoSize = true;
+            this.label6.Location = new System.Drawing.Point(3, 85);
+            this.label6.Name = "label6";
+            this.label6.Size = new System.Drawing.Size(314, 13);
+            this.label6.TabIndex = 6;
+            this.label6.Text = "Cache Line Index of Large Files:";
+            // 
+            // checkBoxSnapshotCache
+            // 
+            this.checkBoxSnapshotCache.Anchor = System.Windows.Forms.AnchorStyles.Left;
+            this.checkBoxSnapshotCache.AutoSize = true;
+            this.checkBoxSnapshotCache.Location = new System.Drawing.Point(323, 85);
+            this.checkBoxSnapshotCache.Name = "checkBoxSnapshotCache";
+            this.checkBoxSnapshotCache.Size = new System.Drawing.Size(15, 14);
+            this.checkBoxSnapshotCache.TabIndex = 7;
+            this.checkBoxSnapshotCache.UseVisualStyleBackColor = true;
+            // 
             // dpiChangeHelper
             // 
             this.dpiChangeHelper.Form = this;
@@ -261,7 +321,7 @@ namespace TextEditor
             this.AutoScaleMode = System.Windows.Forms.AutoScaleMode.Font;
             this.AutoSize = true;
             this.CancelButton = this.buttonCancel;
-            this.ClientSize = new System.Drawing.Size(646, 407);
+            this.ClientSize = new System.Drawing.Size(646, 456);
             this.Controls.Add(this.tableLayoutPanel1);
             this.MaximizeBox = false;
             this.MinimizeBox = false;
@@ -278,6 +338,7 @@ namespace TextEditor
             this.flowLayoutPanel1.ResumeLayout(false);
             this.tableLayoutPanel3.ResumeLayout(false);
             this.tableLayoutPanel3.PerformLayout();
+            ((System.ComponentModel.ISupportInitialize)(this.numericUpDownMemoryBudget)).EndInit();
             this.ResumeLayout(false);
 
         }
@@ -300,6 +361,10 @@ namespace TextEditor
         private System.Windows.Forms.TableLayoutPanel tableLayoutPanel3;
         private System.Windows.Forms.Label label4;
         private System.Windows.Forms.ComboBox comboBoxTextService;
+        private System.Windows.Forms.Label label5;
+        private System.Windows.Forms.NumericUpDown numericUpDownMemoryBudget;
+        private System.Windows.Forms.Label label6;
+        private System.Windows.Forms.CheckBox checkBoxSnapshotCache;
         private DpiChangeHelper dpiChangeHelper;
     }
 }
@@ -53,6 +53,9 @@ namespace TextEditor
                 case BackingStore.Utf8SplayGapBuffer:
                     comboBoxBackingStore.SelectedItem = "Utf8SplayGapBuffer";
                     break;
+                case BackingStore.PieceTree:
+                    comboBoxBackingStore.SelectedItem = "PieceTree";
+                    break;
             }
 
             switch (config.TextService)
@@ -71,6 +74,9 @@ namespace TextEditor
                     break;
             }
 
+            numericUpDownMemoryBudget.Value = Math.Min(Math.Max(config.MemoryBudget, 0), (int)numericUpDownMemoryBudget.Maximum);
+            checkBoxSnapshotCache.Checked = config.SnapshotCache;
+
             ((SettingsPanel)((TabPage)tabControlSettings.Controls[0]).Controls[0]).All = this.config[0];
             for (int i = 1; i < this.config.Count; i++)
             {
@@ -115,6 +121,9 @@ namespace TextEditor
                     case "Utf8SplayGapBuffer":
                         config.BackingStore = BackingStore.Utf8SplayGapBuffer;
                         break;
+                    case "PieceTree":
+                        config.BackingStore = BackingStore.PieceTree;
+                        break;
                 }
 
                 switch ((string)comboBoxTextService.SelectedItem)
@@ -133,6 +142,9 @@ namespace TextEditor
                         break;
                 }
 
+                config.MemoryBudget = (int)numericUpDownMemoryBudget.Value;
+                config.SnapshotCache = checkBoxSnapshotCache.Checked;
+
                 return config;
             }
         }
@@ -0,0 +1,228 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+
+namespace TextEditor
+{
+    // Optional on-disk cache of the line index of large files (see LineIndex), so that reopening one skips encoding
+    // detection and the scan for line breaks. Entries are kept per user and machine, one per file path, and are
+    // validated against the file's length, last write time and a hash of blocks sampled through the file. A stale or
+    // unreadable entry is ignored, and replaced when the file has been loaded again. Entries not used for MaxAge are
+    // deleted, as are the least recently used ones beyond MaxTotalBytes, whenever an entry is saved.
+    public static class SnapshotCache
+    {
+#if DEBUG
+        private const long MinimumFileLength = 4096;
+        private const int SampleSize = 256;
+#else
+        private const long MinimumFileLength = 16 * 1024 * 1024;
+        private const int SampleSize = 4096;
+#endif
+        private const int SampleCount = 8;
+#if DEBUG
+        private const long MaxTotalBytes = 64 * 1024;
+#else
+        private const long MaxTotalBytes = 256 * 1024 * 1024;
+#endif
+        private static readonly TimeSpan MaxAge = TimeSpan.FromDays(30);
+        private const int Signature = 0x50414E53; // "SNAP"
+        private const string DirectoryName = "Snapshots";
+        private const string Extension = ".snapshot";
+
+        // returns null if there is no current entry for the file
+        public static LineIndex TryLoad(string path, out Utf8Transcoding.Form form, out int bomLength)
+        {
+            form = Utf8Transcoding.Form.Other;
+            bomLength = 0;
+
+            try
+            {
+                FileInfo info = new FileInfo(path);
+                if (!info.Exists || (info.Length < MinimumFileLength))
+                {
+                    return null;
+                }
+                string entryPath = GetEntryPath(info.FullName, false/*create*/);
+                if (!File.Exists(entryPath))
+                {
+                    return null;
+                }
+
+                LineIndex index;
+                using (Stream stream = new FileStream(entryPath, FileMode.Open, FileAccess.Read, FileShare.Read))
+                {
+                    using (BinaryReader reader = new BinaryReader(stream, Encoding.UTF8))
+                    {
+                        if ((reader.ReadInt32() != Signature)
+                            || !String.Equals(reader.ReadString(), info.FullName, StringComparison.OrdinalIgnoreCase)
+                            || (reader.ReadInt64() != info.Length)
+                            || (reader.ReadInt64() != info.LastWriteTimeUtc.Ticks))
+                        {
+                            return null;
+                        }
+                        long sampleHash = reader.ReadInt64();
+                        form = (Utf8Transcoding.Form)reader.ReadInt32();
+                        bomLength = reader.ReadInt32();
+                        index = LineIndex.Read(reader);
+                        if ((index == null)
+                            || (form < Utf8Transcoding.Form.Utf8)
+                            || (form > Utf8Transcoding.Form.Utf16BigEndian)
+                            || (sampleHash != HashSamples(info.FullName)))
+                        {
+                            return null;
+                        }
+                    }
+                }
+                File.SetLastWriteTimeUtc(entryPath, DateTime.UtcNow); // mark as recently used (see Trim())
+                return index;
+            }
+            catch (IOException)
+            {
+                return null; // includes truncated entry
+            }
+            catch (UnauthorizedAccessException)
+            {
+                return null;
+            }
+        }
+
+        // record the index of the file as just loaded (ignored for small files, or if the entry can't be written)
+        public static void Save(string path, Utf8Transcoding.Form form, int bomLength, LineIndex index)
+        {
+            try
+            {
+                FileInfo info = new FileInfo(path);
+                if (!info.Exists || (info.Length < MinimumFileLength))
+                {
+                    return;
+                }
+                using (Stream stream = new FileStream(GetEntryPath(info.FullName, true/*create*/), FileMode.Create, FileAccess.Write, FileShare.None))
+                {
+                    using (BinaryWriter writer = new BinaryWriter(stream, Encoding.UTF8))
+                    {
+                        writer.Write(Signature);
+                        writer.Write(info.FullName);
+                        writer.Write(info.Length);
+                        writer.Write(info.LastWriteTimeUtc.Ticks);
+                        writer.Write(HashSamples(info.FullName));
+                        writer.Write((int)form);
+                        writer.Write(bomLength);
+                        index.Write(writer);
+                    }
+                }
+
+                Trim();
+            }
+            catch (IOException)
+            {
+            }
+            catch (UnauthorizedAccessException)
+            {
+            }
+        }
+
+        // delete entries unused for MaxAge, then least recently used (by last write, refreshed on load) until the rest
+        // fit in MaxTotalBytes
+        private static void Trim()
+        {
+            DirectoryInfo dir = new DirectoryInfo(GetDirectory());
+            List<FileInfo> entries = new List<FileInfo>(dir.GetFiles("*" + Extension));
+            entries.Sort(delegate (FileInfo l, FileInfo r) { return r.LastWriteTimeUtc.CompareTo(l.LastWriteTimeUtc); });
+
+            DateTime cutoff = DateTime.UtcNow - MaxAge;
+            long total = 0;
+            foreach (FileInfo entry in entries)
+            {
+                total += entry.Length;
+                if ((entry.LastWriteTimeUtc < cutoff) || (total > MaxTotalBytes))
+                {
+                    try
+                    {
+                        entry.Delete();
+                    }
+                    catch (IOException)
+                    {
+                        // in use by another instance
+                    }
+                }
+            }
+        }
+
+        private static string GetDirectory()
+        {
+            string root = Environment.GetFolderPath(Environment.SpecialFolder.LocalApplicationData, Environment.SpecialFolderOption.None);
+            return Path.Combine(Path.Combine(root, MainClass.LocalApplicationDirectoryName), DirectoryName);
+        }
+
+        private static string GetEntryPath(string fullPath, bool create)
+        {
+            string dir = GetDirectory();
+            if (create)
+            {
+                Directory.CreateDirectory(dir);
+            }
+            return Path.Combine(dir, Hash(Encoding.UTF8.GetBytes(fullPath.ToUpperInvariant())).ToString("x16") + Extension);
+        }
+
+        // blocks at evenly spaced offsets from the start to the end of the file
+        private static long HashSamples(string path)
+        {
+            using (Stream stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite))
+            {
+                long length = stream.Length;
+                byte[] buffer = new byte[SampleSize * SampleCount];
+                int count = 0;
+                for (int i = 0; i < SampleCount; i++)
+                {
+                    stream.Seek((length - SampleSize) * i / (SampleCount - 1), SeekOrigin.Begin);
+                    int c = 0;
+                    int read;
+                    while ((c < SampleSize) && ((read = stream.Read(buffer, count + c, SampleSize - c)) > 0))
+                    {
+                        c += read;
+                    }
+                    count += c;
+                }
+                return Hash(buffer, count);
+            }
+        }
+
+        private static long Hash(byte[] bytes)
+        {
+            return Hash(bytes, bytes.Length);
+        }
+
+        // 64-bit FNV-1a
+        private static long Hash(byte[] bytes, int count)
+        {
+            ulong hash = 14695981039346656037UL;
+            for (int i = 0; i < count; i++)
+            {
+                hash = unchecked((hash ^ bytes[i]) * 1099511628211UL);
+            }
+            return unchecked((long)hash);
+        }
+    }
+}
@@ -0,0 +1,281 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Text;
+
+namespace TextEditor
+{
+    // Headless driver for the stochastic test: runs the StochasticEngine operation mix directly against a storage
+    // backend (no control or rendering), validating as it goes, and measures throughput, per-operation latency and
+    // allocation. Suitable as a regression benchmark since a given random seed reproduces the same operations.
+    public static class StochasticBenchmark
+    {
+        public class Result
+        {
+            public int operations;
+            public long elapsedTicks; // Stopwatch ticks spent in the backend
+            public long[] latencyTicks; // per operation, sorted
+            public long allocatedBytes; // approximate, by backend
+            public int gen0Collections;
+            public int gen1Collections;
+            public int gen2Collections;
+            public int fullValidations;
+            public int finalLineCount;
+
+            public double OperationsPerSecond
+            {
+                get { return elapsedTicks != 0 ? operations * (double)Stopwatch.Frequency / elapsedTicks : 0; }
+            }
+
+            // latency at percentile (0..100) in microseconds
+            public double Percentile(double percentile)
+            {
+                if (latencyTicks.Length == 0)
+                {
+                    return 0;
+                }
+                int index = Math.Min((int)(percentile / 100 * latencyTicks.Length), latencyTicks.Length - 1);
+                return latencyTicks[index] * 1000000d / Stopwatch.Frequency;
+            }
+
+            public override string ToString()
+            {
+                return String.Format(
+                    "{0,12:N0} ops/s  p50 {1,8:N1} us  p99 {2,9:N1} us  max {3,10:N1} us  {4,12:N0} KB alloc  GC {5}/{6}/{7}",
+                    OperationsPerSecond,
+                    Percentile(50),
+                    Percentile(99),
+                    Percentile(100),
+                    allocatedBytes / 1024,
+                    gen0Collections,
+                    gen1Collections,
+                    gen2Collections);
+            }
+        }
+
+        // Run at least the given number of operations (always completing the last task). The lines touched by each
+        // edit are checked after every task; the whole document is checked every validateInterval operations (zero
+        // meaning only at the end).
+        public static Result Run(ITextStorageFactory factory, int randomSeed, int operations, int validateInterval)
+        {
+            AppDomain.MonitoringIsEnabled = true;
+
+            StorageTarget target = new StorageTarget(factory);
+            StochasticEngine engine = new StochasticEngine(randomSeed, target);
+            List<StochasticEngine.Operation> task = new List<StochasticEngine.Operation>();
+            List<long> latencies = new List<long>(operations);
+            Result result = new Result();
+
+            int gen0 = GC.CollectionCount(0);
+            int gen1 = GC.CollectionCount(1);
+            int gen2 = GC.CollectionCount(2);
+            int nextValidation = validateInterval;
+            while (result.operations < operations)
+            {
+                task.Clear();
+                engine.Generate(task);
+                foreach (StochasticEngine.Operation operation in task)
+                {
+                    // generated text is marshalled to the backend's form outside of the timed region, as the
+                    // control's caller would
+                    ITextStorage text = operation.kind == StochasticEngine.OperationKind.Replace
+                        ? target.Prepare(operation)
+                        : null;
+                    engine.Apply(operation);
+
+                    long allocated = AppDomain.CurrentDomain.MonitoringTotalAllocatedMemorySize;
+                    long start = Stopwatch.GetTimestamp();
+                    target.Do(operation, text);
+                    long elapsed = Stopwatch.GetTimestamp() - start;
+                    result.allocatedBytes += AppDomain.CurrentDomain.MonitoringTotalAllocatedMemorySize - allocated;
+
+                    result.elapsedTicks += elapsed;
+                    latencies.Add(elapsed);
+                    result.operations++;
+                }
+
+                engine.ValidateOperation(target, task[task.Count - 1]);
+                if ((validateInterval > 0) && (result.operations >= nextValidation))
+                {
+                    engine.Validate(target);
+                    result.fullValidations++;
+                    nextValidation = result.operations + validateInterval;
+                }
+            }
+            engine.Validate(target);
+            result.fullValidations++;
+
+            result.gen0Collections = GC.CollectionCount(0) - gen0;
+            result.gen1Collections = GC.CollectionCount(1) - gen1;
+            result.gen2Collections = GC.CollectionCount(2) - gen2;
+            result.latencyTicks = latencies.ToArray();
+            Array.Sort(result.latencyTicks);
+            result.finalLineCount = target.Count;
+            return result;
+        }
+
+        public static string Run(
+            KeyValuePair<string, ITextStorageFactory>[] factories,
+            int randomSeed,
+            int operations,
+            int validateInterval)
+        {
+            StringBuilder report = new StringBuilder();
+            report.AppendLine(String.Format(
+                "Stochastic ({0:N0} ops, seed {1}, full validation every {2:N0} ops)",
+                operations,
+                randomSeed,
+                validateInterval));
+            foreach (KeyValuePair<string, ITextStorageFactory> factory in factories)
+            {
+                GC.Collect();
+                GC.WaitForPendingFinalizers();
+
+                Result result = Run(factory.Value, randomSeed, operations, validateInterval);
+                report.AppendLine(String.Format("  {0,-20}{1}", factory.Key, result));
+            }
+            return report.ToString();
+        }
+
+        // Storage with undo/redo modeled by swapping saved sections
+        private class StorageTarget : IStochasticTarget
+        {
+            private readonly ITextStorageFactory factory;
+            private readonly ITextStorage storage;
+            private readonly List<Edit> undo = new List<Edit>();
+            private readonly List<Edit> redo = new List<Edit>();
+
+            // swapping an edit exchanges the text between start and end with saved, and leaves the edit describing the
+            // inverse swap
+            private class Edit
+            {
+                public int startLine;
+                public int startChar;
+                public int endLine;
+                public int endCharPlusOne;
+                public ITextStorage saved;
+            }
+
+            public StorageTarget(ITextStorageFactory factory)
+            {
+                this.factory = factory;
+                this.storage = factory.New();
+            }
+
+            public int Count { get { return storage.Count; } }
+
+            public int CopyLine(int index, ref char[] buffer)
+            {
+                return storage.CopyLine(index, ref buffer);
+            }
+
+            public ITextStorage Prepare(StochasticEngine.Operation operation)
+            {
+                string text = operation.Text;
+                return factory.FromUtf16Buffer(text, 0, text.Length, Environment.NewLine);
+            }
+
+            public void Do(StochasticEngine.Operation operation, ITextStorage text)
+            {
+                switch (operation.kind)
+                {
+                    default:
+                        Debug.Assert(false);
+                        throw new ArgumentException();
+                    case StochasticEngine.OperationKind.Replace:
+                        Replace(operation.startLine, operation.startChar, operation.endLine, operation.endCharPlusOne, text);
+                        break;
+                    case StochasticEngine.OperationKind.Undo:
+                        Undo();
+                        break;
+                    case StochasticEngine.OperationKind.Redo:
+                        Redo();
+                        break;
+                    case StochasticEngine.OperationKind.ClearUndoRedo:
+                        ClearUndoRedo();
+                        break;
+                }
+            }
+
+            public void Replace(int startLine, int startChar, int endLine, int endCharPlusOne, string text)
+            {
+                Replace(startLine, startChar, endLine, endCharPlusOne, factory.FromUtf16Buffer(text, 0, text.Length, Environment.NewLine));
+            }
+
+            private void Replace(int startLine, int startChar, int endLine, int endCharPlusOne, ITextStorage text)
+            {
+                Edit edit = new Edit();
+                edit.startLine = startLine;
+                edit.startChar = startChar;
+                edit.endLine = endLine;
+                edit.endCharPlusOne = endCharPlusOne;
+                edit.saved = text;
+                Swap(edit);
+                undo.Add(edit);
+                redo.Clear();
+            }
+
+            public void Undo()
+            {
+                if (undo.Count != 0)
+                {
+                    Edit edit = undo[undo.Count - 1];
+                    undo.RemoveAt(undo.Count - 1);
+                    Swap(edit);
+                    redo.Add(edit);
+                }
+            }
+
+            public void Redo()
+            {
+                if (redo.Count != 0)
+                {
+                    Edit edit = redo[redo.Count - 1];
+                    redo.RemoveAt(redo.Count - 1);
+                    Swap(edit);
+                    undo.Add(edit);
+                }
+            }
+
+            public void ClearUndoRedo()
+            {
+                undo.Clear();
+                redo.Clear();
+            }
+
+            private void Swap(Edit edit)
+            {
+                ITextStorage current = storage.CloneSection(edit.startLine, edit.startChar, edit.endLine, edit.endCharPlusOne);
+                storage.DeleteSection(edit.startLine, edit.startChar, edit.endLine, edit.endCharPlusOne);
+                storage.InsertSection(edit.startLine, edit.startChar, edit.saved);
+
+                int lines = edit.saved.Count;
+                int lastLength = edit.saved[lines - 1].Length;
+                edit.endLine = edit.startLine + lines - 1;
+                edit.endCharPlusOne = (lines == 1 ? edit.startChar : 0) + lastLength;
+                edit.saved = current;
+            }
+        }
+    }
+}
@@ -0,0 +1,426 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Text;
+
+namespace TextEditor
+{
+    // Target of stochastic editing - the edit control (StochasticTest) or a bare storage (StochasticBenchmark)
+    public interface IStochasticTarget
+    {
+        int Count { get; }
+        int CopyLine(int index, ref char[] buffer);
+        void Replace(int startLine, int startChar, int endLine, int endCharPlusOne, string text);
+        void Undo();
+        void Redo();
+        void ClearUndoRedo();
+    }
+
+    public class StochasticValidateException : ApplicationException
+    {
+        private readonly int line;
+        private readonly string reference;
+        private readonly string actual;
+
+        public StochasticValidateException(string message, int line, string reference, string actual)
+            : base(String.Format("{0} (line {1})", message, line))
+        {
+            this.line = line;
+            this.reference = reference;
+            this.actual = actual;
+        }
+
+        public int Line { get { return line; } }
+        public string Reference { get { return reference; } }
+        public string Actual { get { return actual; } }
+    }
+
+    // Random edit generator shared by the interactive stochastic test and the headless benchmark. Operations are
+    // generated against a reference model of the expected text, kept as lines along with a rolling hash of each line,
+    // so that a target can be checked cheaply after each edit (line count and the lines the edit produced) and in full
+    // at intervals (comparing line hashes) without materializing the target's text.
+    public class StochasticEngine
+    {
+        public class Tuning
+        {
+            public static readonly Tuning Grow = new Tuning(
+                Label: "Grow",
+                WordsPerLineLimit: 10,
+                WordLengthLimit: 10,
+                LineLimit: 10000,
+                Exponent: 1.1,
+                ReplaceRangeAffinity: 1000);
+
+            public static readonly Tuning Shrink = new Tuning(
+                Label: "Shrink",
+                WordsPerLineLimit: 10,
+                WordLengthLimit: 10,
+                LineLimit: 10000,
+                Exponent: .6,
+                ReplaceRangeAffinity: 500);
+
+            public readonly string Label;
+            public readonly int WordsPerLineLimit;
+            public readonly int WordLengthLimit;
+            public readonly int LineLimit;
+            public readonly double Exponent;
+            public readonly int ReplaceRangeAffinity;
+
+            public Tuning(
+                string Label,
+                int WordsPerLineLimit,
+                int WordLengthLimit,
+                int LineLimit,
+                double Exponent,
+                int ReplaceRangeAffinity)
+            {
+                this.Label = Label;
+                this.WordsPerLineLimit = WordsPerLineLimit;
+                this.WordLengthLimit = WordLengthLimit;
+                this.LineLimit = LineLimit;
+                this.Exponent = Exponent;
+                this.ReplaceRangeAffinity = ReplaceRangeAffinity;
+            }
+        }
+
+        public enum OperationKind
+        {
+            Replace,
+            Undo,
+            Redo,
+            ClearUndoRedo,
+        }
+
+        public struct Operation
+        {
+            public readonly OperationKind kind;
+            public readonly int startLine;
+            public readonly int startChar;
+            public readonly int endLine;
+            public readonly int endCharPlusOne;
+            public readonly string[] lines; // replacement text, for Replace
+
+            public Operation(OperationKind kind)
+            {
+                Debug.Assert(kind != OperationKind.Replace);
+                this.kind = kind;
+                this.startLine = 0;
+                this.startChar = 0;
+                this.endLine = 0;
+                this.endCharPlusOne = 0;
+                this.lines = null;
+            }
+
+            public Operation(int startLine, int startChar, int endLine, int endCharPlusOne, string[] lines)
+            {
+                this.kind = OperationKind.Replace;
+                this.startLine = startLine;
+                this.startChar = startChar;
+                this.endLine = endLine;
+                this.endCharPlusOne = endCharPlusOne;
+                this.lines = lines;
+            }
+
+            public string Text { get { return String.Join(Environment.NewLine, lines); } }
+
+            public override string ToString()
+            {
+                return kind == OperationKind.Replace
+                    ? String.Format("Replace [{0}.{1}-{2}.{3}] with {4} lines", startLine, startChar, endLine, endCharPlusOne, lines.Length)
+                    : kind.ToString();
+            }
+        }
+
+        private const string Domain = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+        private const int DeclusteringLikelihood = 10;
+        private const int ClusteringAffinity = 25;
+        private const int UndoRedoLikelihood = 10;
+        private const int UndoRedoMaxDepth = 20;
+        private const double UndoRedoBias = 2;
+        private const int ClearUndoRedoLikelihood = 1000;
+
+        private readonly Random random;
+        private readonly List<string> lines = new List<string>();
+        private readonly List<ulong> hashes = new List<ulong>();
+        private long charCount; // excluding line breaks
+        private Tuning tuning = Tuning.Grow;
+        private int lastLine;
+        private char[] buffer;
+
+        public StochasticEngine(int randomSeed, IStochasticTarget initial)
+        {
+            this.random = new Random(randomSeed);
+
+            for (int i = 0; i < initial.Count; i++)
+            {
+                int length = initial.CopyLine(i, ref buffer);
+                string line = new String(buffer, 0, length);
+                lines.Add(line);
+                hashes.Add(Hash(line));
+                charCount += length;
+            }
+        }
+
+        public Tuning CurrentTuning { get { return tuning; } }
+
+        public int Count { get { return lines.Count; } }
+
+        public long Length { get { return charCount + (long)(lines.Count - 1) * Environment.NewLine.Length; } }
+
+        // Polynomial rolling hash of a line - cheap to compute while copying and sensitive to order and position.
+        public static ulong Hash(char[] chars, int start, int length)
+        {
+            unchecked
+            {
+                ulong hash = (ulong)length;
+                for (int i = start; i < start + length; i++)
+                {
+                    hash = (hash + chars[i]) * 0x100000001B3UL;
+                }
+                return hash;
+            }
+        }
+
+        public static ulong Hash(string line)
+        {
+            unchecked
+            {
+                ulong hash = (ulong)line.Length;
+                for (int i = 0; i < line.Length; i++)
+                {
+                    hash = (hash + line[i]) * 0x100000001B3UL;
+                }
+                return hash;
+            }
+        }
+
+        // Append the operations of one randomly chosen task. Undo and redo are always generated in equal numbers within
+        // a task, so the reference (and the target) are back in the same state once the task completes.
+        public void Generate(List<Operation> operations)
+        {
+            if (lines.Count > tuning.LineLimit)
+            {
+                tuning = Tuning.Shrink;
+            }
+            else if (lines.Count < 500)
+            {
+                tuning = Tuning.Grow;
+            }
+
+        Retry:
+            lastLine = Math.Min(lastLine, lines.Count - 1); // ensure valid given deletion may have occurred
+            int operation = random.Next(4);
+            switch (operation)
+            {
+                default:
+                    Debug.Assert(false);
+                    break;
+
+                case 0: // insert
+                case 1: // replace
+                    {
+                        int startLine, startChar, endLine, endCharPlusOne;
+                        GetRandomPosition(
+                            lastLine,
+                            random.Next(DeclusteringLikelihood) != 0 ? ClusteringAffinity : 0,
+                            out startLine,
+                            out startChar);
+                        endLine = startLine;
+                        endCharPlusOne = startChar;
+                        if (operation == 1)
+                        {
+                            GetRandomPosition(startLine, tuning.ReplaceRangeAffinity, out endLine, out endCharPlusOne);
+                            if ((endLine < startLine) || ((endLine == startLine) && (endCharPlusOne < startChar)))
+                            {
+                                int t = startLine;
+                                startLine = endLine;
+                                endLine = t;
+                                t = startChar;
+                                startChar = endCharPlusOne;
+                                endCharPlusOne = t;
+                            }
+                        }
+
+                        operations.Add(new Operation(startLine, startChar, endLine, endCharPlusOne, MakeLines()));
+                        lastLine = (startLine + endLine) / 2;
+                    }
+                    break;
+
+                case 2: // undo/redo
+                    if (random.Next(UndoRedoLikelihood) != 0)
+                    {
+                        goto Retry;
+                    }
+                    {
+                        int depth = TruncatedHyperbolicDistribution(UndoRedoMaxDepth, UndoRedoBias);
+                        for (int i = 0; i < depth; i++)
+                        {
+                            operations.Add(new Operation(OperationKind.Undo));
+                        }
+                        for (int i = 0; i < depth; i++)
+                        {
+                            operations.Add(new Operation(OperationKind.Redo));
+                        }
+                    }
+                    break;
+
+                case 3: // periodically clear undo/redo to reign in memory usage
+                    if (random.Next(ClearUndoRedoLikelihood) != 0)
+                    {
+                        goto Retry;
+                    }
+                    operations.Add(new Operation(OperationKind.ClearUndoRedo));
+                    break;
+            }
+        }
+
+        // Update the reference to reflect an operation that has been (or is about to be) applied to the target.
+        public void Apply(Operation operation)
+        {
+            if (operation.kind != OperationKind.Replace)
+            {
+                return;
+            }
+
+            string prefix = lines[operation.startLine].Substring(0, operation.startChar);
+            string suffix = lines[operation.endLine].Substring(operation.endCharPlusOne);
+            for (int i = operation.startLine; i <= operation.endLine; i++)
+            {
+                charCount -= lines[i].Length;
+            }
+            lines.RemoveRange(operation.startLine, operation.endLine - operation.startLine + 1);
+            hashes.RemoveRange(operation.startLine, operation.endLine - operation.startLine + 1);
+
+            string[] inserted = (string[])operation.lines.Clone();
+            inserted[0] = String.Concat(prefix, inserted[0]);
+            inserted[inserted.Length - 1] = String.Concat(inserted[inserted.Length - 1], suffix);
+            lines.InsertRange(operation.startLine, inserted);
+            ulong[] insertedHashes = new ulong[inserted.Length];
+            for (int i = 0; i < inserted.Length; i++)
+            {
+                insertedHashes[i] = Hash(inserted[i]);
+                charCount += inserted[i].Length;
+            }
+            hashes.InsertRange(operation.startLine, insertedHashes);
+        }
+
+        // Incremental check after applying an operation: line count, plus the lines produced by a replace.
+        public void ValidateOperation(IStochasticTarget target, Operation operation)
+        {
+            ValidateCount(target);
+            if (operation.kind == OperationKind.Replace)
+            {
+                ValidateLines(target, operation.startLine, operation.lines.Length);
+            }
+        }
+
+        // Full check comparing the hash of every line.
+        public void Validate(IStochasticTarget target)
+        {
+            ValidateCount(target);
+            ValidateLines(target, 0, lines.Count);
+        }
+
+        private void ValidateCount(IStochasticTarget target)
+        {
+            if (target.Count != lines.Count)
+            {
+                throw new StochasticValidateException(
+                    "Reference line count does not match target's line count",
+                    Math.Min(target.Count, lines.Count),
+                    lines.Count.ToString(),
+                    target.Count.ToString());
+            }
+        }
+
+        private void ValidateLines(IStochasticTarget target, int startLine, int count)
+        {
+            for (int i = startLine; i < startLine + count; i++)
+            {
+                int length = target.CopyLine(i, ref buffer);
+                if ((length != lines[i].Length) || (Hash(buffer, 0, length) != hashes[i]))
+                {
+                    throw new StochasticValidateException(
+                        "Reference text state does not match target's text state",
+                        i,
+                        lines[i],
+                        new String(buffer, 0, length));
+                }
+            }
+        }
+
+        private string[] MakeLines()
+        {
+            StringBuilder sb = new StringBuilder();
+            string[] result = new string[TruncatedHyperbolicDistribution(tuning.LineLimit, tuning.Exponent)];
+            for (int i = 0; i < result.Length; i++)
+            {
+                sb.Length = 0;
+                for (int j = random.Next(tuning.WordsPerLineLimit); j >= 0; j--)
+                {
+                    for (int k = random.Next(tuning.WordLengthLimit); k >= 0; k--)
+                    {
+                        sb.Append(Domain[random.Next(Domain.Length)]);
+                    }
+                    if (j > 0)
+                    {
+                        sb.Append(" ");
+                    }
+                }
+                result[i] = sb.ToString();
+            }
+            return result;
+        }
+
+        private int TruncatedHyperbolicDistribution(int limit, double exponent)
+        {
+            double r = Math.Pow(random.NextDouble(), exponent);
+            double b = 1d / limit;
+            int i = (int)(1 / (r * (1 - b) + b));
+            return Math.Max(Math.Min(i, limit - 1), 1);
+        }
+
+        // position near the pivot line (distance distributed hyperbolically, as a fraction of the document), or anywhere
+        // in the document if range is zero
+        private void GetRandomPosition(int pivotLine, int range, out int line, out int charIndex)
+        {
+            if (range == 0)
+            {
+                line = random.Next(lines.Count);
+            }
+            else
+            {
+                int adjust = (int)((long)(TruncatedHyperbolicDistribution(range + 1, 1) - 1) * lines.Count / range);
+                line = pivotLine + (random.Next(2) > 0 ? adjust : -adjust);
+                if ((line < 0) || (line >= lines.Count))
+                {
+                    line = pivotLine - (line - pivotLine);
+                }
+                line = Math.Min(Math.Max(line, 0), lines.Count - 1);
+            }
+            charIndex = random.Next(lines[line].Length + 1);
+        }
+    }
+}
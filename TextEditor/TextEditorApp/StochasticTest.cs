@@ -22,7 +22,6 @@
 using System;
 using System.Collections.Generic;
 using System.Diagnostics;
-using System.Text;
 using System.Timers;
 using System.Windows.Forms;
 
@@ -34,10 +33,10 @@ namespace TextEditor
         private readonly DateTime started;
         private readonly Queue<Action> queue = new Queue<Action>();
         private readonly int randomSeed;
-        private readonly Random random;
+        private readonly ControlTarget target;
+        private readonly StochasticEngine engine;
 
         private int operationCount;
-        private string state = String.Empty;
 
         public StochasticTest(TextEditControl textEditControl)
             : this(textEditControl, Environment.TickCount)
@@ -48,7 +47,8 @@ namespace TextEditor
         {
             this.textEditControl = textEditControl;
             this.randomSeed = randomSeed;
-            this.random = new Random(randomSeed);
+            this.target = new ControlTarget(textEditControl);
+            this.engine = new StochasticEngine(randomSeed, target);
             Debugger.Log(0, "TextEditorApp.StochasticTest", String.Format("StochasticTest: random seed = {0}" + Environment.NewLine, randomSeed));
 
             InitializeComponent();
@@ -57,8 +57,6 @@ namespace TextEditor
             this.started = DateTime.Now;
             UpdateStatus();
 
-            state = textEditControl.Text;
-
             Disposed += StochasticTest_Disposed;
         }
 
@@ -74,8 +72,8 @@ namespace TextEditor
             this.labelElapsedTime.Text = elapsed.ToString("g");
             this.labelOperationCount.Text = operationCount.ToString("N0");
             this.labelLines.Text = textEditControl.Count.ToString("N0");
-            this.labelCharacters.Text = state.Length.ToString("N0");
-            this.labelMode.Text = tuning.Label;
+            this.labelCharacters.Text = engine.Length.ToString("N0");
+            this.labelMode.Text = engine.CurrentTuning.Label;
             this.labelRandomSeed.Text = randomSeed.ToString();
         }
 
@@ -123,241 +121,17 @@ namespace TextEditor
             }
         }
 
-        private class Tuning
-        {
-            public static readonly Tuning Grow = new Tuning(
-                Label: "Grow",
-                WordsPerLineLimit: 10,
-                WordLengthLimit: 10,
-                LineLimit: 10000,
-                Exponent: 1.1,
-                ReplaceRangeAffinity: 1000);
-
-            public static readonly Tuning Shrink = new Tuning(
-                Label: "Shrink",
-                WordsPerLineLimit: 10,
-                WordLengthLimit: 10,
-                LineLimit: 10000,
-                Exponent: .6,
-                ReplaceRangeAffinity: 500);
-
-            public readonly string Label;
-            public readonly int WordsPerLineLimit;
-            public readonly int WordLengthLimit;
-            public readonly int LineLimit;
-            public readonly double Exponent;
-            public readonly int ReplaceRangeAffinity;
-
-            public Tuning(
-                string Label,
-                int WordsPerLineLimit,
-                int WordLengthLimit,
-                int LineLimit,
-                double Exponent,
-                int ReplaceRangeAffinity)
-            {
-                this.Label = Label;
-                this.WordsPerLineLimit = WordsPerLineLimit;
-                this.WordLengthLimit = WordLengthLimit;
-                this.LineLimit = LineLimit;
-                this.Exponent = Exponent;
-                this.ReplaceRangeAffinity = ReplaceRangeAffinity;
-            }
-        }
-
-        private Tuning tuning = Tuning.Grow;
-
-        private int lastOffset;
         private void GenerateTask()
         {
-            bool oversized = false;
-
-            if (textEditControl.Count > 10000)
-            {
-                tuning = Tuning.Shrink;
-            }
-            else if (textEditControl.Count < 500)
-            {
-                tuning = Tuning.Grow;
-            }
-
-        Retry:
-            lastOffset = Math.Min(Math.Max(lastOffset, 0), state.Length); // ensure valid given deletion may have occurred
-            const int DeclusteringLikelihood = 10;
-            const int ClusteringAffinity = 25;
-            const int UndoRedoLikelihood = 10;
-            const int UndoRedoMaxDepth = 20;
-            const double UndoRedoBias = 2;
-            switch (random.Next(4))
+            List<StochasticEngine.Operation> operations = new List<StochasticEngine.Operation>();
+            engine.Generate(operations);
+            foreach (StochasticEngine.Operation operation in operations)
             {
-                default:
-                    Debug.Assert(false);
-                    break;
-
-                case 0: // insert
-                    {
-                        Position insertionPoint = random.Next(DeclusteringLikelihood) != 0
-                            ? GetNearbyPosition(OffsetToValidPosition(lastOffset), ClusteringAffinity)
-                            : GetRandomValidPosition();
-                        queue.Enqueue(new ActionSelect(this, insertionPoint, insertionPoint));
-                        queue.Enqueue(new ActionReplace(this, insertionPoint, insertionPoint));
-                        lastOffset = insertionPoint.offset;
-                    }
-                    break;
-
-                case 1: // replace
-                    {
-                        Position start = random.Next(DeclusteringLikelihood) != 0
-                            ? GetNearbyPosition(OffsetToValidPosition(lastOffset), ClusteringAffinity)
-                            : GetRandomValidPosition();
-                        Position end = !oversized ? GetNearbyPosition(start, tuning.ReplaceRangeAffinity) : GetRandomValidPosition();
-                        EnsurePositionOrdering(ref start, ref end);
-                        queue.Enqueue(new ActionSelect(this, start, end));
-                        queue.Enqueue(new ActionReplace(this, start, end));
-                        lastOffset = (start.offset + end.offset) / 2;
-                    }
-                    break;
-
-                case 2: // undo/redo
-                    if (random.Next(UndoRedoLikelihood) != 0)
-                    {
-                        goto Retry;
-                    }
-                    {
-                        int depth = TruncatedHyperbolicDistribution(UndoRedoMaxDepth, UndoRedoBias);
-                        for (int i = 0; i < depth; i++)
-                        {
-                            queue.Enqueue(new ActionUndo(this));
-                        }
-                        for (int i = 0; i < depth; i++)
-                        {
-                            queue.Enqueue(new ActionRedo(this));
-                        }
-                    }
-                    break;
-
-                case 3: // periodically clear undo/redo to reign in memory usage
-                    if (random.Next(1000) != 0)
-                    {
-                        goto Retry;
-                    }
-                    textEditControl.ClearUndoRedo();
-                    break;
+                queue.Enqueue(new ActionOperation(this, operation));
             }
-
             queue.Enqueue(new ActionValidate(this));
         }
 
-        private double TruncatedHyperbolicDistribution(double limit, double exponent)
-        {
-            double r = Math.Pow(random.NextDouble(), exponent);
-            double b = 1d / limit;
-            double i = 1 / (r * (1 - b) + b);
-            if (Double.IsNaN(i) || Double.IsInfinity(i))
-            {
-                i = Double.MaxValue;
-            }
-            return Math.Max(Math.Min(i, limit - 1), 1);
-        }
-
-        private int TruncatedHyperbolicDistribution(int limit, double exponent)
-        {
-            double r = Math.Pow(random.NextDouble(), exponent);
-            double b = 1d / limit;
-            int i = (int)(1 / (r * (1 - b) + b));
-            return Math.Max(Math.Min(i, limit - 1), 1);
-        }
-
-        private void EnsurePositionOrdering(ref Position start, ref Position end)
-        {
-            if (start.offset > end.offset)
-            {
-                Position temp = start;
-                start = end;
-                end = temp;
-            }
-        }
-
-        private Position GetRandomValidPosition()
-        {
-            return OffsetToValidPosition(random.Next(state.Length));
-        }
-
-        private Position GetNearbyPosition(Position pivot, int range)
-        {
-            double frac = (TruncatedHyperbolicDistribution((double)range + 1.0, 1) - 1) / range;
-            int adjust = ((int)(frac * state.Length) + 1) * (random.Next(2) > 0 ? 1 : -1);
-            if ((pivot.offset + adjust < 0) || (pivot.offset + adjust > state.Length))
-            {
-                adjust = -adjust;
-            }
-            int offset = pivot.offset + adjust;
-            offset = Math.Min(Math.Max(offset, 0), state.Length);
-            return OffsetToValidPosition(offset);
-        }
-
-        private static readonly char NewLineFirstChar = Environment.NewLine[0];
-        private Position OffsetToValidPosition(int offset)
-        {
-            Debug.Assert((offset >= 0) && (offset <= state.Length));
-
-            if (offset < state.Length)
-            {
-                int nl = Environment.NewLine.IndexOf(state[offset]);
-                if (nl > 0)
-                {
-                    offset = offset + (random.Next(2) > 0 ? Environment.NewLine.Length - nl : -nl);
-                }
-            }
-            Debug.Assert((offset == state.Length) || (Environment.NewLine.IndexOf(state[offset]) <= 0));
-
-            int l = 0;
-            int c = 0;
-            for (int i = 0; i < offset; i++)
-            {
-                if (state[i] == NewLineFirstChar)
-                {
-                    c = i + Environment.NewLine.Length;
-                    l++;
-                }
-            }
-            c = offset - c;
-
-            int count = 0;
-            for (int i = 0; i < l; i++)
-            {
-                count += textEditControl[i].Length + Environment.NewLine.Length;
-            }
-            count += c;
-            Debug.Assert(count == offset);
-
-            Debug.Assert((l >= 0) && (c >= 0));
-            Debug.Assert(l < textEditControl.Count);
-            Debug.Assert(c <= textEditControl[l].Length);
-
-            return new Position(offset, l, c);
-        }
-
-        private struct Position
-        {
-            public int offset;
-            public int l;
-            public int c;
-
-            public Position(int offset, int l, int c)
-            {
-                Debug.Assert((offset >= 0) && (l >= 0) && (c >= 0));
-                this.offset = offset;
-                this.l = l;
-                this.c = c;
-            }
-
-            public override string ToString()
-            {
-                return String.Format("[{0}: {1}.{2}]", offset, l, c);
-            }
-        }
-
         private abstract class Action
         {
             protected readonly StochasticTest context;
@@ -379,126 +153,89 @@ namespace TextEditor
 
             public override void Do()
             {
-                string actual = context.textEditControl.Text;
-                if (!String.Equals(context.state, actual, StringComparison.Ordinal))
-                {
-                    throw new ValidateException(
-                        "Reference text state does not match control's text state",
-                        context.state,
-                        actual);
-                }
-            }
-
-            private class ValidateException : ApplicationException
-            {
-                private readonly string reference;
-                private readonly string actual;
-
-                public ValidateException(string message, string reference, string actual)
-                    : base(message)
-                {
-                    this.reference = reference;
-                    this.actual = actual;
-                }
-
-                public string Reference { get { return reference; } }
-                public string Actual { get { return actual; } }
+                context.engine.Validate(context.target);
             }
         }
 
-        private class ActionSelect : Action
+        private class ActionOperation : Action
         {
-            private readonly Position start;
-            private readonly Position end;
+            private readonly StochasticEngine.Operation operation;
 
-            public ActionSelect(StochasticTest context, Position start, Position end)
+            public ActionOperation(StochasticTest context, StochasticEngine.Operation operation)
                 : base(context)
             {
-                Debug.Assert(start.offset <= end.offset);
-                this.start = start;
-                this.end = end;
+                this.operation = operation;
             }
 
             public override void Do()
             {
-                context.textEditControl.SetSelection(start.l, start.c, end.l, end.c);
-                context.textEditControl.ScrollToSelection();
+                switch (operation.kind)
+                {
+                    default:
+                        Debug.Assert(false);
+                        throw new ArgumentException();
+                    case StochasticEngine.OperationKind.Replace:
+                        context.engine.Apply(operation);
+                        context.target.Replace(
+                            operation.startLine,
+                            operation.startChar,
+                            operation.endLine,
+                            operation.endCharPlusOne,
+                            operation.Text);
+                        context.engine.ValidateOperation(context.target, operation);
+                        break;
+                    case StochasticEngine.OperationKind.Undo:
+                        context.target.Undo();
+                        break;
+                    case StochasticEngine.OperationKind.Redo:
+                        context.target.Redo();
+                        break;
+                    case StochasticEngine.OperationKind.ClearUndoRedo:
+                        context.target.ClearUndoRedo();
+                        break;
+                }
             }
         }
 
-        private class ActionReplace : Action
+        private class ControlTarget : IStochasticTarget
         {
-            private readonly Position start;
-            private readonly Position end;
+            private readonly TextEditControl textEditControl;
 
-            public ActionReplace(StochasticTest context, Position start, Position end)
-                : base(context)
+            public ControlTarget(TextEditControl textEditControl)
             {
-                this.start = start;
-                this.end = end;
+                this.textEditControl = textEditControl;
             }
 
-            private const string Domain = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-            public override void Do()
+            public int Count { get { return textEditControl.Count; } }
+
+            public int CopyLine(int index, ref char[] buffer)
             {
-                StringBuilder sb = new StringBuilder();
-                int lines = context.TruncatedHyperbolicDistribution(context.tuning.LineLimit, context.tuning.Exponent) - 1;
-                for (int i = 0; i <= lines; i++)
-                {
-                    for (int j = context.random.Next(context.tuning.WordsPerLineLimit); j >= 0; j--)
-                    {
-                        for (int k = context.random.Next(context.tuning.WordLengthLimit); k >= 0; k--)
-                        {
-                            sb.Append(Domain[context.random.Next(Domain.Length)]);
-                        }
-                        if (j > 0)
-                        {
-                            sb.Append(" ");
-                        }
-                    }
-                    if (i < lines)
-                    {
-                        sb.Append(Environment.NewLine);
-                    }
-                }
-                string s = sb.ToString();
-
-                Debug.Assert((context.textEditControl.SelectionStartLine == start.l)
-                    || (context.textEditControl.SelectionEndLine == end.l)
-                    || (context.textEditControl.SelectionStartChar == start.c)
-                    || (context.textEditControl.SelectionEndCharPlusOne == end.c));
-
-                context.state = String.Concat(
-                    context.state.Substring(0, start.offset),
-                    s,
-                    context.state.Substring(end.offset, context.state.Length - end.offset));
-                context.textEditControl.SelectedText = s;
+                string line = textEditControl.GetLine(index).Decode_MustDispose().Value;
+                TextStorage.EnsureCapacity(ref buffer, line.Length);
+                line.CopyTo(0, buffer, 0, line.Length);
+                return line.Length;
             }
-        }
 
-        private class ActionUndo : Action
-        {
-            public ActionUndo(StochasticTest context)
-                : base(context)
+            public void Replace(int startLine, int startChar, int endLine, int endCharPlusOne, string text)
             {
+                textEditControl.SetSelection(startLine, startChar, endLine, endCharPlusOne);
+                textEditControl.ScrollToSelection();
+                textEditControl.SelectedText = text;
             }
 
-            public override void Do()
+            public void Undo()
             {
-                context.textEditControl.Undo();
+                textEditControl.Undo();
             }
-        }
 
-        private class ActionRedo : Action
-        {
-            public ActionRedo(StochasticTest context)
-                : base(context)
+            public void Redo()
             {
+                textEditControl.Redo();
             }
 
-            public override void Do()
+            public void ClearUndoRedo()
             {
-                context.textEditControl.Redo();
+                textEditControl.ClearUndoRedo();
             }
         }
     }
@@ -0,0 +1,200 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Text;
+
+namespace TextEditor
+{
+    // Comparative benchmark of the text storage backends. Each factory is driven directly (no control or rendering) with
+    // identical random sequences: the StochasticTest operation mix (see StochasticBenchmark), a Replace All pattern of
+    // edits spread across a large document, alternating edits at both ends of a large document, and random line reads
+    // from a document of long lines. Only the scenario itself is timed, not construction of the initial document. Final
+    // texts of the latter (a checksum, for the read-only scenario) are compared across backends as a cross-check.
+    public static class StorageBenchmark
+    {
+        private const string Domain = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+        private const int LongLineWordsPerLineLimit = 3000; // about 10KB per line on average
+
+#if DEBUG
+        private const int StochasticOperations = 2000;
+        private const int StochasticValidateInterval = 100;
+        private const int LargeDocumentLines = 5000;
+        private const int ManyLocationEdits = 500;
+        private const int LongLineDocumentLines = 200;
+        private const int RandomLineReads = 1000;
+#else
+        private const int StochasticOperations = 100000;
+        private const int StochasticValidateInterval = 10000;
+        private const int LargeDocumentLines = 1000000;
+        private const int ManyLocationEdits = 20000;
+        private const int LongLineDocumentLines = 5000;
+        private const int RandomLineReads = 100000;
+#endif
+
+        public static KeyValuePair<string, ITextStorageFactory>[] GetFactories()
+        {
+            return new KeyValuePair<string, ITextStorageFactory>[]
+            {
+                new KeyValuePair<string, ITextStorageFactory>(BackingStore.String.ToString(), new StringStorageFactory()),
+                new KeyValuePair<string, ITextStorageFactory>(BackingStore.Utf8SplayGapBuffer.ToString(), new Utf8SplayGapStorageFactory()),
+                new KeyValuePair<string, ITextStorageFactory>(BackingStore.PieceTree.ToString(), new PieceTreeStorageFactory()),
+            };
+        }
+
+        public static string Run(int randomSeed)
+        {
+            KeyValuePair<string, ITextStorageFactory>[] factories = GetFactories();
+            Func<ITextStorageFactory, Stopwatch, ITextStorage>[] scenarios = new Func<ITextStorageFactory, Stopwatch, ITextStorage>[]
+            {
+                delegate (ITextStorageFactory factory, Stopwatch sw) { return ReplaceAll(factory, randomSeed, sw); },
+                delegate (ITextStorageFactory factory, Stopwatch sw) { return BothEnds(factory, randomSeed, sw); },
+                delegate (ITextStorageFactory factory, Stopwatch sw) { return RandomLineAccess(factory, randomSeed, sw); },
+            };
+            string[] scenarioNames = new string[]
+            {
+                String.Format("Replace All ({0:N0} of {1:N0} lines)", ManyLocationEdits, LargeDocumentLines),
+                String.Format("Both ends ({0:N0} of {1:N0} lines)", ManyLocationEdits, LargeDocumentLines),
+                String.Format("Random line reads ({0:N0} of {1:N0} lines, ~10KB each)", RandomLineReads, LongLineDocumentLines),
+            };
+
+            StringBuilder report = new StringBuilder();
+            report.AppendLine(String.Format("Storage benchmark: random seed = {0}", randomSeed));
+#if DEBUG
+            report.AppendLine("DEBUG build - timings include validation and reduced sizes");
+#endif
+            report.AppendLine();
+            report.Append(StochasticBenchmark.Run(factories, randomSeed, StochasticOperations, StochasticValidateInterval));
+            for (int i = 0; i < scenarios.Length; i++)
+            {
+                report.AppendLine();
+                report.AppendLine(scenarioNames[i]);
+                string reference = null;
+                foreach (KeyValuePair<string, ITextStorageFactory> factory in factories)
+                {
+                    GC.Collect();
+                    GC.WaitForPendingFinalizers();
+
+                    Stopwatch sw = new Stopwatch();
+                    ITextStorage result = scenarios[i](factory.Value, sw);
+                    sw.Stop();
+
+                    string text = result.GetText("\n");
+                    bool match = (reference == null) || String.Equals(reference, text, StringComparison.Ordinal);
+                    reference = reference ?? text;
+                    report.AppendLine(String.Format(
+                        "  {0,-20}{1,10:N0} ms{2}",
+                        factory.Key,
+                        sw.ElapsedMilliseconds,
+                        match ? String.Empty : "  MISMATCH"));
+                }
+            }
+            return report.ToString();
+        }
+
+        private static string MakeText(Random random, int lines, int wordsPerLineLimit, int wordLengthLimit)
+        {
+            StringBuilder sb = new StringBuilder();
+            for (int i = 0; i <= lines; i++)
+            {
+                for (int j = random.Next(wordsPerLineLimit); j >= 0; j--)
+                {
+                    for (int k = random.Next(wordLengthLimit); k >= 0; k--)
+                    {
+                        sb.Append(Domain[random.Next(Domain.Length)]);
+                    }
+                    if (j > 0)
+                    {
+                        sb.Append(" ");
+                    }
+                }
+                if (i < lines)
+                {
+                    sb.Append(Environment.NewLine);
+                }
+            }
+            return sb.ToString();
+        }
+
+        private static ITextStorage MakeLargeDocument(ITextStorageFactory factory, int randomSeed)
+        {
+            string text = MakeText(new Random(randomSeed), LargeDocumentLines - 1, 10, 10);
+            return factory.FromUtf16Buffer(text, 0, text.Length, Environment.NewLine);
+        }
+
+        private static void Replace(ITextStorage storage, int line, int startChar, int endCharPlusOne, ITextStorage replacement)
+        {
+            storage.DeleteSection(line, startChar, line, endCharPlusOne);
+            storage.InsertSection(line, startChar, replacement);
+        }
+
+        // edits spread evenly through the document, back to front as Replace All does
+        private static ITextStorage ReplaceAll(ITextStorageFactory factory, int randomSeed, Stopwatch sw)
+        {
+            ITextStorage storage = MakeLargeDocument(factory, randomSeed);
+            ITextStorage replacement = factory.FromUtf16Buffer("[replaced]", 0, 10, Environment.NewLine);
+            sw.Start();
+            int stride = Math.Max(storage.Count / ManyLocationEdits, 1);
+            for (int line = (ManyLocationEdits - 1) * stride; line >= 0; line -= stride)
+            {
+                int length = storage[line].Length;
+                Replace(storage, line, length / 2, Math.Min(length / 2 + 3, length), replacement);
+            }
+            return storage;
+        }
+
+        // alternating edits at the start and end of the document
+        private static ITextStorage BothEnds(ITextStorageFactory factory, int randomSeed, Stopwatch sw)
+        {
+            ITextStorage storage = MakeLargeDocument(factory, randomSeed);
+            ITextStorage typed = factory.FromUtf16Buffer("x", 0, 1, Environment.NewLine);
+            sw.Start();
+            for (int i = 0; i < ManyLocationEdits; i++)
+            {
+                int line = (i % 2) == 0 ? 0 : storage.Count - 1;
+                storage.InsertSection(line, storage[line].Length, typed);
+            }
+            return storage;
+        }
+
+        // random reads from a document of long lines, where locating a line means skipping many bytes
+        private static ITextStorage RandomLineAccess(ITextStorageFactory factory, int randomSeed, Stopwatch sw)
+        {
+            string text = MakeText(new Random(randomSeed), LongLineDocumentLines - 1, LongLineWordsPerLineLimit, 10);
+            ITextStorage storage = factory.FromUtf16Buffer(text, 0, text.Length, Environment.NewLine);
+            Random random = new Random(randomSeed);
+            char[] buffer = null;
+            long checksum = 0;
+            sw.Start();
+            for (int i = 0; i < RandomLineReads; i++)
+            {
+                int line = random.Next(storage.Count);
+                int length = storage.CopyLine(line, ref buffer);
+                checksum = unchecked(checksum * 31 + length + buffer[length / 2]);
+            }
+            sw.Stop();
+            string result = checksum.ToString();
+            return factory.FromUtf16Buffer(result, 0, result.Length, Environment.NewLine);
+        }
+    }
+}
@@ -24,6 +24,7 @@ using System.Collections.Generic;
 using System.Diagnostics;
 using System.Drawing;
 using System.IO;
+using System.IO.MemoryMappedFiles;
 using System.Reflection;
 using System.Runtime.InteropServices;
 using System.Text;
@@ -49,6 +50,27 @@ namespace TextEditor
 
         private string path;
 
+        // follow mode: bytes of the file consumed so far (including any BOM) - data beyond is appended as the file grows
+        private long followLength;
+        private LineEndingInfo followLineEndingInfo;
+#if DEBUG
+        private const int FollowChunkSize = 4096;
+#else
+        private const int FollowChunkSize = 16 * 1024 * 1024; // per update, so catching up on a large backlog doesn't block
+#endif
+
+        // session memory (see SessionMemory): the file as last loaded or saved, from which a hibernated document is restored
+        private DateTime lastActive = DateTime.UtcNow;
+        private long storageFootprint = -1; // cached since measuring is not free for all storages; -1 when stale
+        private long fileLength;
+        private DateTime fileLastWriteTimeUtc;
+        private Encoding fileEncoding;
+        private int fileBomLength;
+        private bool hibernated;
+        private int hibernatedStartLine, hibernatedStartChar, hibernatedEndLine, hibernatedEndCharPlusOne;
+        private bool hibernatedStartIsActive;
+        private Point hibernatedScrollPosition;
+
         private bool startedEmpty = true;
 
         private BackingStore effectiveBackingStore = MainClass.Config.BackingStore;
@@ -66,28 +88,35 @@ namespace TextEditor
                 textEditControl.Reload(backingStore, backingStore.New());
             }
 
+            // font and size first, since the deferred text service is prepared for them
+            textEditControl.Font = config.Font;
+            if ((MainClass.Config.Width != 0) && (MainClass.Config.Height != 0))
+            {
+                Size = new Size(MainClass.Config.Width, MainClass.Config.Height); // position is set in OnShown
+            }
+
             try
             {
-                textEditControl.TextService = MainClass.Config.TextService;
+                // window and text are shown with the simple text service while the configured one is prepared
+                textEditControl.SetTextServiceDeferred(
+                    MainClass.Config.TextService,
+                    delegate (Exception exception)
+                    {
+                        if (exception is FileNotFoundException)
+                        {
+                            ShowComponentLoadFailure((FileNotFoundException)exception);
+                        }
+                        else
+                        {
+                            MessageBox.Show(exception.ToString(), "Error", MessageBoxButtons.OK, MessageBoxIcon.Error);
+                        }
+                    });
             }
             catch (FileNotFoundException exception)
             {
-                string platform = String.Empty;
-                switch (Assembly.GetExecutingAssembly().GetName().ProcessorArchitecture)
-                {
-                    default:
-                        break;
-                    case ProcessorArchitecture.X86:
-                        platform = " (x86)";
-                        break;
-                    case ProcessorArchitecture.Amd64:
-                        platform = " (x64)";
-                        break;
-                }
-                MessageBox.Show(String.Format("Unable to load program component. To solve this problem, make sure the Visual Studio 2015 Redistributable{1} is installed on the computer. (Internal exception: {0})", exception.Message, platform));
+                ShowComponentLoadFailure(exception);
                 throw;
             }
-            textEditControl.Font = config.Font;
             textEditControl.TabSize = config.TabSize;
             textEditControl.AutoIndent = config.AutoIndent;
             textEditControl.InsertTabAsSpaces = config.InsertTabAsSpaces;
@@ -101,6 +130,25 @@ namespace TextEditor
             toolStripTextBoxColumn.Validated += new EventHandler(UserEditedColumnHandler);
 
             menuStrip.MenuActivate += new EventHandler(menuStrip1_MenuActivate);
+
+            textEditControl.TextChanged += new EventHandler(textEditControl_TextChanged);
+        }
+
+        private static void ShowComponentLoadFailure(FileNotFoundException exception)
+        {
+            string platform = String.Empty;
+            switch (Assembly.GetExecutingAssembly().GetName().ProcessorArchitecture)
+            {
+                default:
+                    break;
+                case ProcessorArchitecture.X86:
+                    platform = " (x86)";
+                    break;
+                case ProcessorArchitecture.Amd64:
+                    platform = " (x64)";
+                    break;
+            }
+            MessageBox.Show(String.Format("Unable to load program component. To solve this problem, make sure the Visual Studio 2015 Redistributable{1} is installed on the computer. (Internal exception: {0})", exception.Message, platform));
         }
 
         public TextEditorWindow()
@@ -113,6 +161,7 @@ namespace TextEditor
             : this(false/*setSpecificBackingStore*/)
         {
             LoadFile(path);
+            StartupTiming.Mark("File loaded");
             UserEditedLineCharHandler(null, null);
         }
 
@@ -132,49 +181,21 @@ namespace TextEditor
                     effectiveBackingStore = BackingStore.Utf8SplayGapBuffer;
                     factory = this.utf8SplayGapBufferFactory;
                     break;
+                case BackingStore.PieceTree:
+                    effectiveBackingStore = BackingStore.PieceTree;
+                    factory = this.pieceTreeStorageFactory;
+                    break;
             }
             return factory;
         }
 
-#if WINDOWS
-        [DllImport("advapi32.dll")]
-        [return: MarshalAs(UnmanagedType.Bool)]
-        private extern static bool IsTextUnicode(IntPtr buffer, int byteCount, ref IsTextUnicodeFlags flags);
-#else
-        private static bool IsTextUnicode(IntPtr buffer, int byteCount, ref IsTextUnicodeFlags flags)
-        {
-            flags = (IsTextUnicodeFlags)0;
-            return false;
-        }
-#endif
-
-        [Flags]
-        private enum IsTextUnicodeFlags : int
+        public void LoadFile(string path, EncodingInfo encodingInfo)
         {
-            IS_TEXT_UNICODE_ASCII16 = 0x0001,
-            IS_TEXT_UNICODE_REVERSE_ASCII16 = 0x0010,
-
-            IS_TEXT_UNICODE_STATISTICS = 0x0002,
-            IS_TEXT_UNICODE_REVERSE_STATISTICS = 0x0020,
-
-            IS_TEXT_UNICODE_CONTROLS = 0x0004,
-            IS_TEXT_UNICODE_REVERSE_CONTROLS = 0x0040,
-
-            IS_TEXT_UNICODE_SIGNATURE = 0x0008,
-            IS_TEXT_UNICODE_REVERSE_SIGNATURE = 0x0080,
-
-            IS_TEXT_UNICODE_ILLEGAL_CHARS = 0x0100,
-            IS_TEXT_UNICODE_ODD_LENGTH = 0x0200,
-            IS_TEXT_UNICODE_DBCS_LEADBYTE = 0x0400,
-            IS_TEXT_UNICODE_NULL_BYTES = 0x1000,
-
-            IS_TEXT_UNICODE_UNICODE_MASK = 0x000F,
-            IS_TEXT_UNICODE_REVERSE_MASK = 0x00F0,
-            IS_TEXT_UNICODE_NOT_UNICODE_MASK = 0x0F00,
-            IS_TEXT_UNICODE_NOT_ASCII_MASK = 0xF000
+            LoadFile(path, encodingInfo, null/*snapshot*/);
         }
 
-        public void LoadFile(string path, EncodingInfo encodingInfo)
+        // snapshot: line index saved from an earlier load of the unchanged file (see SnapshotCache), or null
+        private void LoadFile(string path, EncodingInfo encodingInfo, LineIndex snapshot)
         {
             if (textEditControl.Modified || (textEditControl.Count != 1) || (textEditControl.GetLine(0).Length != 0))
             {
@@ -196,19 +217,81 @@ namespace TextEditor
             this.encoding = encodingInfo.Encoding;
             this.includeBom = encodingInfo.BomLength != 0;
 
-            using (Stream stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite))
+            using (FileStream stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite))
             {
                 long length = stream.Length;
 
-                stream.Seek(encodingInfo.BomLength, SeekOrigin.Begin);
+                // sample the content first so that problems are reported before paying for a full load (unless the file
+                // has been loaded before)
+                SniffResult sniff = snapshot == null
+                    ? EncodingSniffer.Sniff(stream, Utf8Transcoding.GetForm(encoding), encodingInfo.BomLength)
+                    : new SniffResult();
+                if (sniff.binary)
+                {
+                    DialogResult result = MessageBox.Show(
+                        "The file appears to contain binary data. Continue trying to open?",
+                        "Encoding",
+                        MessageBoxButtons.OKCancel,
+                        MessageBoxIcon.Warning);
+                    if (result != DialogResult.OK)
+                    {
+                        throw new ApplicationException();
+                    }
+                }
+                else if ((snapshot == null) && (length >= 4096) && (length / sniff.estimatedLineCount >= 5000))
+                {
+                    DialogResult result = MessageBox.Show(
+                        "The file data contains a small number of very long lines, indicating the encoding used to open it may be incorrect. Continue trying to open? (It may take a long time.)",
+                        "Encoding",
+                        MessageBoxButtons.OKCancel,
+                        MessageBoxIcon.Warning);
+                    if (result != DialogResult.OK)
+                    {
+                        throw new ApplicationException();
+                    }
+                }
 
                 // must use our own reader rather than TextReader since we want to also determine
                 // which kind of line ending the file used.
-                LineEndingInfo lineEndingInfo;
-                ITextStorage text = textEditControl.TextStorageFactory.FromStream(
-                    stream,
-                    encoding,
-                    out lineEndingInfo);
+                LineEndingInfo lineEndingInfo = new LineEndingInfo();
+                long perf = PerfCounters.Begin();
+                Utf8SplayGapStorageFactory indexingFactory = MainClass.Config.SnapshotCache
+                    ? textEditControl.TextStorageFactory as Utf8SplayGapStorageFactory
+                    : null;
+                ITextStorage text = null;
+                LineIndex index = null;
+                if ((snapshot != null) && (indexingFactory != null))
+                {
+                    text = ReadMapped(
+                        stream,
+                        encodingInfo.BomLength,
+                        delegate (Stream view) { return indexingFactory.FromStream(view, encoding, snapshot); });
+                    if (text != null)
+                    {
+                        index = snapshot;
+                        lineEndingInfo = snapshot.lineEndingInfo;
+                        followLength = length;
+                    }
+                }
+                if (text == null)
+                {
+                    stream.Seek(encodingInfo.BomLength, SeekOrigin.Begin);
+                    if (indexingFactory != null)
+                    {
+                        text = indexingFactory.FromStream(stream, encoding, out lineEndingInfo, out index);
+                        SnapshotCache.Save(path, Utf8Transcoding.GetForm(encoding), encodingInfo.BomLength, index);
+                    }
+                    else
+                    {
+                        text = textEditControl.TextStorageFactory.FromStream(
+                            stream,
+                            encoding,
+                            out lineEndingInfo);
+                    }
+                    followLength = stream.Position;
+                }
+                PerfCounters.End(PerfCounter.Load, perf);
+                followLineEndingInfo = lineEndingInfo;
                 linefeed = Environment.NewLine;
                 string lineFeedName = "Windows";
                 if (lineEndingInfo.unixLFCount > 2 * (lineEndingInfo.windowsLFCount + lineEndingInfo.macintoshLFCount))
@@ -238,28 +321,21 @@ namespace TextEditor
                     }
                 }
 
-                if ((length >= 4096) && (length / text.Count >= 5000))
-                {
-                    DialogResult result = MessageBox.Show(
-                        "The file data contains a small number of very long lines, indicating the encoding used to open it may be incorrect. Continue trying to open? (It may take a long time.)",
-                        "Encoding",
-                        MessageBoxButtons.OKCancel,
-                        MessageBoxIcon.Warning);
-                    if (result != DialogResult.OK)
-                    {
-                        throw new ApplicationException();
-                    }
-                }
-
                 textEditControl.Reload(
                     textEditControl.TextStorageFactory,
                     text);
+                if (index != null)
+                {
+                    textEditControl.LongestLineHint = index.longestLine;
+                }
             }
 
             textEditControl.ClearUndoRedo();
             textEditControl.SetInsertionPoint(0, 0);
             textEditControl.Modified = false;
 
+            RecordFile(encoding, encodingInfo.BomLength);
+
             startedEmpty = false;
         }
 
@@ -293,7 +369,7 @@ namespace TextEditor
                 }
                 catch (ArgumentException)
                 {
-                    throw new Exception(String.Format("Buffer qualifier '{0}' is not recognized - should be one of '{1}' or '{2}'", qualifier, BackingStore.String, BackingStore.Utf8SplayGapBuffer));
+                    throw new Exception(String.Format("Buffer qualifier '{0}' is not recognized - should be one of '{1}', '{2}' or '{3}'", qualifier, BackingStore.String, BackingStore.Utf8SplayGapBuffer, BackingStore.PieceTree));
                 }
                 factory = GetBackingStore(effectiveBackingStore);
             }
@@ -308,7 +384,12 @@ namespace TextEditor
 
             if (String.IsNullOrEmpty(qualifier))
             {
-                EncodingInfo encodingInfo = GuessEncoding(path);
+                EncodingInfo encodingInfo;
+                LineIndex snapshot = FindSnapshot(path, out encodingInfo);
+                if (snapshot == null)
+                {
+                    encodingInfo = GuessEncoding(path);
+                }
                 Type[] permittedEncodings = null;
                 if (this.textEditControl.TextStorageFactory != null)
                 {
@@ -327,7 +408,7 @@ namespace TextEditor
                         throw new ApplicationException(); // cancel the old window
                     }
                 }
-                LoadFile(path, encodingInfo);
+                LoadFile(path, encodingInfo, snapshot);
             }
             else
             {
@@ -367,55 +448,66 @@ namespace TextEditor
         {
             using (Stream stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite))
             {
-                Encoding encoding;
-                int bomLength = 0;
+                SniffResult sniff = EncodingSniffer.Sniff(stream);
+                return new EncodingInfo(GetEncoding(sniff.form), sniff.bomLength);
+            }
+        }
 
-                byte[] bom = new byte[3];
-                stream.Read(bom, 0, 3);
+        private static Encoding GetEncoding(Utf8Transcoding.Form form)
+        {
+            switch (form)
+            {
+                default:
+                    Debug.Assert(false);
+                    throw new InvalidOperationException();
+                case Utf8Transcoding.Form.Ansi:
+                    return Encoding_ANSI;
+                case Utf8Transcoding.Form.Utf8:
+                    return Encoding_UTF8;
+                case Utf8Transcoding.Form.Utf16LittleEndian:
+                    return Encoding_UTF16;
+                case Utf8Transcoding.Form.Utf16BigEndian:
+                    return Encoding_UTF16BigEndian;
+            }
+        }
 
-                if ((bom[0] == 0xFF) && (bom[1] == 0xFE))
-                {
-                    encoding = Encoding_UTF16;
-                    bomLength = 2;
-                }
-                else if ((bom[0] == 0xFE) && (bom[1] == 0xFF))
-                {
-                    encoding = Encoding_UTF16BigEndian;
-                    bomLength = 2;
-                }
-                else if ((bom[0] == 0xEF) && (bom[1] == 0xBB) && (bom[2] == 0xBF))
-                {
-                    encoding = Encoding_UTF8;
-                    bomLength = 3;
-                }
-                else
-                {
-                    stream.Seek(0, SeekOrigin.Begin);
-                    using (Pin<byte[]> pinBuffer = new Pin<byte[]>(new byte[4096]))
-                    {
-                        int c = stream.Read(pinBuffer.Ref, 0, pinBuffer.Ref.Length);
+        // line index and encoding from an earlier load of the file, if enabled and the file is unchanged since
+        private LineIndex FindSnapshot(string path, out EncodingInfo encodingInfo)
+        {
+            encodingInfo = new EncodingInfo();
+            if (!MainClass.Config.SnapshotCache || !(textEditControl.TextStorageFactory is Utf8SplayGapStorageFactory))
+            {
+                return null;
+            }
+            Utf8Transcoding.Form form;
+            int bomLength;
+            LineIndex snapshot = SnapshotCache.TryLoad(path, out form, out bomLength);
+            if (snapshot != null)
+            {
+                encodingInfo = new EncodingInfo(GetEncoding(form), bomLength);
+            }
+            return snapshot;
+        }
 
-                        IsTextUnicodeFlags flags = unchecked((IsTextUnicodeFlags)0xffffffff);
-                        bool unicode = IsTextUnicode(pinBuffer.AddrOfPinnedObject(), c, ref flags);
-                        if (unicode)
-                        {
-                            if ((flags & IsTextUnicodeFlags.IS_TEXT_UNICODE_UNICODE_MASK) != 0)
-                            {
-                                encoding = Encoding_UTF16;
-                            }
-                            else
-                            {
-                                encoding = Encoding_UTF16BigEndian;
-                            }
-                        }
-                        else
-                        {
-                            encoding = Encoding_ANSI;
-                        }
-                    }
+        // Read the file through a read-only mapped view, which is released afterwards. The view is given an explicit
+        // length since a view of the whole file is rounded up to the page size.
+        private delegate ITextStorage ReadStreamMethod(Stream stream);
+        private static ITextStorage ReadMapped(FileStream file, int bomLength, ReadStreamMethod read)
+        {
+            long length = file.Length;
+            if (length <= bomLength)
+            {
+                // empty files can't be mapped
+                file.Seek(Math.Min(bomLength, length), SeekOrigin.Begin);
+                return read(file);
+            }
+            using (MemoryMappedFile mapping = MemoryMappedFile.CreateFromFile(file, null, 0, MemoryMappedFileAccess.Read, null, HandleInheritability.None, true/*leaveOpen*/))
+            {
+                using (Stream view = mapping.CreateViewStream(0, length, MemoryMappedFileAccess.Read))
+                {
+                    view.Seek(bomLength, SeekOrigin.Begin);
+                    return read(view);
                 }
-
-                return new EncodingInfo(encoding, bomLength);
             }
         }
 
@@ -519,6 +611,232 @@ namespace TextEditor
             base.OnFormClosed(e);
         }
 
+        protected override void OnActivated(EventArgs e)
+        {
+            lastActive = DateTime.UtcNow;
+            EnsureRestored();
+            base.OnActivated(e);
+        }
+
+        protected override void OnDeactivate(EventArgs e)
+        {
+            lastActive = DateTime.UtcNow;
+            base.OnDeactivate(e);
+        }
+
+        // a hibernated window can come back into view without being activated (e.g. restoring all windows from the
+        // taskbar), so restore on becoming visible as well
+        protected override void OnVisibleChanged(EventArgs e)
+        {
+            if (Visible && (WindowState != FormWindowState.Minimized))
+            {
+                EnsureRestored();
+            }
+            base.OnVisibleChanged(e);
+        }
+
+        protected override void OnResize(EventArgs e)
+        {
+            if (Visible && (WindowState != FormWindowState.Minimized))
+            {
+                EnsureRestored();
+            }
+            base.OnResize(e);
+        }
+
+
+        // session memory
+
+        public DateTime LastActive { get { return lastActive; } }
+
+        public long MemoryFootprint
+        {
+            get
+            {
+                if (storageFootprint < 0)
+                {
+                    storageFootprint = textEditControl.StorageFootprint;
+                }
+                return storageFootprint + textEditControl.UndoRedoFootprint + textEditControl.CacheFootprint;
+            }
+        }
+
+        private void textEditControl_TextChanged(object sender, EventArgs e)
+        {
+            storageFootprint = -1;
+        }
+
+        private void RecordFile(Encoding encoding, int bomLength)
+        {
+            FileInfo info = new FileInfo(path);
+            fileLength = info.Length;
+            fileLastWriteTimeUtc = info.LastWriteTimeUtc;
+            fileEncoding = encoding;
+            fileBomLength = bomLength;
+        }
+
+        private bool FileUnchanged()
+        {
+            FileInfo info = new FileInfo(path);
+            return info.Exists && (info.Length == fileLength) && (info.LastWriteTimeUtc == fileLastWriteTimeUtc);
+        }
+
+        // each returns the (estimated) number of bytes released
+
+        public long TrimCaches()
+        {
+            long before = textEditControl.CacheFootprint;
+            textEditControl.TrimCaches();
+            return before - textEditControl.CacheFootprint;
+        }
+
+        public long TrimUndoRedo(long excess)
+        {
+            long before = textEditControl.UndoRedoFootprint;
+            textEditControl.TrimUndoRedo(Math.Max(before - excess, 0));
+            return before - textEditControl.UndoRedoFootprint;
+        }
+
+        // Only an unmodified document whose file still holds exactly its text can be released - following appends text
+        // the recorded file state doesn't cover. A window that may be in view (e.g. a reference document beside the one
+        // being edited) is kept however long it has been inactive.
+        public bool CanHibernate
+        {
+            get
+            {
+                return !hibernated
+                    && (!Visible || (WindowState == FormWindowState.Minimized))
+                    && !textEditControl.Modified
+                    && (path != null)
+                    && (fileEncoding != null)
+                    && !followTimer.Enabled
+                    && FileUnchanged();
+            }
+        }
+
+        // Release the text (and its undo history, which can't outlive it), keeping the selection and scroll position.
+        public long Hibernate()
+        {
+            Debug.Assert(CanHibernate);
+            long before = MemoryFootprint;
+
+            textEditControl.GetSelectionExtent(
+                out hibernatedStartLine,
+                out hibernatedStartChar,
+                out hibernatedEndLine,
+                out hibernatedEndCharPlusOne,
+                out hibernatedStartIsActive);
+            hibernatedScrollPosition = textEditControl.AutoScrollPosition;
+
+            textEditControl.ClearUndoRedo();
+            textEditControl.Reload(textEditControl.TextStorageFactory, textEditControl.TextStorageFactory.New());
+            textEditControl.TrimCaches();
+            textEditControl.Modified = false;
+            storageFootprint = -1;
+            hibernated = true;
+
+            return before - MemoryFootprint;
+        }
+
+        // Reload a hibernated document from a read-only mapped view of its file. The mapping is held only while reading,
+        // so the file isn't locked while the window is in the background.
+        private void EnsureRestored()
+        {
+            if (!hibernated)
+            {
+                return;
+            }
+            hibernated = false;
+
+            EncodingInfo encodingInfo = new EncodingInfo(fileEncoding, fileBomLength);
+            bool changed = !FileUnchanged();
+            if (changed)
+            {
+                MessageBox.Show(
+                    String.Format("The file \"{0}\" was changed outside of the editor while its window was inactive. The current contents of the file have been loaded.", Path.GetFileName(path)),
+                    "Text Editor",
+                    MessageBoxButtons.OK,
+                    MessageBoxIcon.Information);
+            }
+
+            ITextStorage text;
+            LineEndingInfo lineEndingInfo = new LineEndingInfo();
+            long length;
+            try
+            {
+                if (changed)
+                {
+                    // the encoding or byte order mark may have changed along with the contents - the guess is used only
+                    // if this window's backing store can hold it
+                    EncodingInfo guessed = GuessEncoding(path);
+                    Type[] permittedEncodings = textEditControl.TextStorageFactory.PermittedEncodings;
+                    if ((permittedEncodings == null)
+                        || (Array.FindIndex(permittedEncodings, delegate (Type candidate) { return candidate.IsInstanceOfType(guessed.Encoding); }) >= 0))
+                    {
+                        encodingInfo = guessed;
+                    }
+                }
+
+                using (FileStream file = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite))
+                {
+                    length = file.Length;
+                    long perf = PerfCounters.Begin();
+                    text = ReadMapped(
+                        file,
+                        encodingInfo.BomLength,
+                        delegate (Stream view) { return textEditControl.TextStorageFactory.FromStream(view, encodingInfo.Encoding, out lineEndingInfo); });
+                    PerfCounters.End(PerfCounter.Load, perf);
+                }
+            }
+            catch (IOException exception)
+            {
+                RestoreFailed(exception);
+                return;
+            }
+            catch (UnauthorizedAccessException exception)
+            {
+                RestoreFailed(exception);
+                return;
+            }
+
+            textEditControl.Reload(textEditControl.TextStorageFactory, text);
+            textEditControl.Modified = false;
+            if (changed)
+            {
+                // saving keeps the form the file now has
+                this.encoding = encodingInfo.Encoding;
+                this.includeBom = encodingInfo.BomLength != 0;
+            }
+            RecordFile(encodingInfo.Encoding, encodingInfo.BomLength);
+            followLength = length;
+            followLineEndingInfo = lineEndingInfo;
+            storageFootprint = -1;
+
+            SelPoint end = textEditControl.End;
+            if ((hibernatedEndLine < end.Line) || ((hibernatedEndLine == end.Line) && (hibernatedEndCharPlusOne <= end.Column)))
+            {
+                textEditControl.SetSelection(
+                    hibernatedStartLine,
+                    hibernatedStartChar,
+                    hibernatedEndLine,
+                    hibernatedEndCharPlusOne,
+                    hibernatedStartIsActive);
+                textEditControl.AutoScrollPosition = new Point(-hibernatedScrollPosition.X, -hibernatedScrollPosition.Y);
+            }
+        }
+
+        // the window is left empty and detached from the file, so that saving can't overwrite the file with nothing
+        private void RestoreFailed(Exception exception)
+        {
+            MessageBox.Show(
+                String.Format("The file \"{0}\" could not be reloaded: {1}", Path.GetFileName(path), exception.Message),
+                "Text Editor",
+                MessageBoxButtons.OK,
+                MessageBoxIcon.Error);
+            path = null;
+            this.Text = "Untitled";
+        }
+
         private void textEditControl_SelectionChanged(object sender, EventArgs e)
         {
             toolStripTextBoxLine.Validated -= new EventHandler(UserEditedLineCharHandler);
@@ -615,6 +933,8 @@ namespace TextEditor
             tabSizeToolStripMenuItem.Text = String.Format("&Tab Size ({0})...", textEditControl.TabSize);
             insertTabAsSpacesToolStripMenuItem.Checked = textEditControl.InsertTabAsSpaces;
             simpleNavigationToolStripMenuItem.Checked = textEditControl.SimpleNavigation;
+            wordWrapToolStripMenuItem.Checked = textEditControl.WordWrap;
+            syntaxHighlightingToolStripMenuItem.Checked = textEditControl.SyntaxTokenizer != null;
             fontToolStripMenuItem.Text = String.Format("&Font ({0}, {1}{2})...", textEditControl.Font.FontFamily.Name, textEditControl.Font.Style != FontStyle.Regular ? textEditControl.Font.Style.ToString().ToLower() + " ," : null, textEditControl.Font.SizeInPoints);
             macintoshLinebreaksToolStripMenuItem.Checked = String.Equals(linefeed, "\r");
             uNIXLinebreaksToolStripMenuItem.Checked = String.Equals(linefeed, "\n");
@@ -625,6 +945,8 @@ namespace TextEditor
             uTF16BigEndianToolStripMenuItem.Checked = (encoding == Encoding_UTF16BigEndian);
             includeByteOrderMarkToolStripMenuItem.Checked = includeBom && !(encoding == Encoding_ANSI);
             includeByteOrderMarkToolStripMenuItem.Enabled = !(encoding == Encoding_ANSI);
+            followToolStripMenuItem.Checked = followTimer.Enabled;
+            followToolStripMenuItem.Enabled = !String.IsNullOrEmpty(path);
         }
 
         private void windowsLineBreaksToolStripMenuItem_Click(object sender, EventArgs e)
@@ -680,6 +1002,16 @@ namespace TextEditor
             textEditControl.SimpleNavigation = !textEditControl.SimpleNavigation;
         }
 
+        private void wordWrapToolStripMenuItem_Click(object sender, EventArgs e)
+        {
+            textEditControl.WordWrap = !textEditControl.WordWrap;
+        }
+
+        private void syntaxHighlightingToolStripMenuItem_Click(object sender, EventArgs e)
+        {
+            textEditControl.SyntaxTokenizer = textEditControl.SyntaxTokenizer == null ? new CLikeSyntaxTokenizer() : null;
+        }
+
         private void raw8bitToolStripMenuItem_Click(object sender, EventArgs e)
         {
             encoding = Encoding_ANSI;
@@ -955,6 +1287,7 @@ namespace TextEditor
                 }
             }
 
+            int bomLength = 0;
             using (Stream stream = tempStream)
             {
                 if (includeBom)
@@ -963,23 +1296,35 @@ namespace TextEditor
                     if (encoding == Encoding_UTF16)
                     {
                         stream.Write(new byte[2] { 0xFF, 0xFE }, 0, 2);
+                        bomLength = 2;
                     }
                     else if (encoding == Encoding_UTF16BigEndian)
                     {
                         stream.Write(new byte[2] { 0xFE, 0xFF }, 0, 2);
+                        bomLength = 2;
                     }
                     else if (encoding == Encoding_UTF8)
                     {
                         stream.Write(new byte[3] { 0xEF, 0xBB, 0xBF }, 0, 3);
+                        bomLength = 3;
                     }
                 }
 
+                long perf = PerfCounters.Begin();
                 text.ToStream(stream, encoding, linefeed);
+                PerfCounters.End(PerfCounter.Save, perf);
             }
 
             File.Delete(path);
             File.Move(temp, path);
 
+            if (String.Equals(path, this.path, StringComparison.OrdinalIgnoreCase))
+            {
+                // file now holds exactly the current text
+                followLength = new FileInfo(path).Length;
+                RecordFile(encoding, bomLength);
+            }
+
             textEditControl.Modified = false;
         }
 
@@ -1038,6 +1383,115 @@ namespace TextEditor
             SaveHelper(copyPath);
         }
 
+        private void followToolStripMenuItem_Click(object sender, EventArgs e)
+        {
+            if (followTimer.Enabled)
+            {
+                followTimer.Stop();
+                return;
+            }
+
+            textEditControl.SetInsertionPoint(textEditControl.End);
+            textEditControl.ScrollToSelection();
+            followTimer.Start();
+            followTimer_Tick(null, null);
+        }
+
+        // Only the bytes written since the last update are read and appended to the storage, which extends its line
+        // index incrementally - nothing already loaded is re-read or re-measured.
+        private void followTimer_Tick(object sender, EventArgs e)
+        {
+            byte[] bytes;
+            int count = 0;
+            try
+            {
+                using (Stream stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite | FileShare.Delete))
+                {
+                    long length = stream.Length;
+                    if (length < followLength)
+                    {
+                        followTimer.Stop();
+                        MessageBox.Show("The file has been truncated or replaced. Following has stopped - reopen the file to see its current contents.", "Text Editor", MessageBoxButtons.OK, MessageBoxIcon.Information);
+                        return;
+                    }
+                    if (length == followLength)
+                    {
+                        return;
+                    }
+
+                    bytes = new byte[(int)Math.Min(length - followLength, FollowChunkSize)];
+                    stream.Seek(followLength, SeekOrigin.Begin);
+                    int read;
+                    while ((count < bytes.Length) && ((read = stream.Read(bytes, count, bytes.Length - count)) > 0))
+                    {
+                        count += read;
+                    }
+                }
+            }
+            catch (IOException)
+            {
+                return; // file temporarily inaccessible - try again at next update
+            }
+            catch (UnauthorizedAccessException)
+            {
+                return;
+            }
+
+            count = GetCompleteLength(bytes, count, Utf8Transcoding.GetForm(encoding));
+            if (count == 0)
+            {
+                return;
+            }
+
+            textEditControl.AppendFromStream(new MemoryStream(bytes, 0, count), encoding, ref followLineEndingInfo);
+            followLength += count;
+        }
+
+        // Length of the data that can be appended now. A writer may be partway through a line: an incomplete character,
+        // or a CR whose LF has yet to arrive, is left for the next update.
+        private static int GetCompleteLength(byte[] bytes, int count, Utf8Transcoding.Form form)
+        {
+            if ((form == Utf8Transcoding.Form.Utf16LittleEndian) || (form == Utf8Transcoding.Form.Utf16BigEndian))
+            {
+                count &= ~1;
+                if (count >= 2)
+                {
+                    char unit = form == Utf8Transcoding.Form.Utf16BigEndian
+                        ? (char)((bytes[count - 2] << 8) | bytes[count - 1])
+                        : (char)(bytes[count - 2] | (bytes[count - 1] << 8));
+                    if (Char.IsHighSurrogate(unit) || (unit == '\r'))
+                    {
+                        count -= 2;
+                    }
+                }
+                return count;
+            }
+
+            if (form == Utf8Transcoding.Form.Utf8)
+            {
+                // back up over continuation bytes to the lead byte of the last sequence
+                int lead = count;
+                while ((lead > 0) && (count - lead < 3) && ((bytes[lead - 1] & 0xC0) == 0x80))
+                {
+                    lead--;
+                }
+                if ((lead > 0) && (bytes[lead - 1] >= 0xC0))
+                {
+                    lead--;
+                    int sequenceLength = bytes[lead] >= 0xF0 ? 4 : (bytes[lead] >= 0xE0 ? 3 : 2);
+                    if (count - lead < sequenceLength)
+                    {
+                        count = lead;
+                    }
+                }
+            }
+            if ((count > 0) && (bytes[count - 1] == (byte)'\r'))
+            {
+                count--;
+            }
+            return count;
+        }
+
         private void closeToolStripMenuItem_Click(object sender, EventArgs e)
         {
             Close();
@@ -1127,6 +1581,7 @@ namespace TextEditor
 
         public void SetSelection(int startLine, int startChar, int endLine, int endCharP1)
         {
+            EnsureRestored();
             textEditControl.SetSelection(startLine, startChar, endLine, endCharP1);
             textEditControl.ScrollToSelection();
         }
@@ -1148,5 +1603,10 @@ namespace TextEditor
                 dialog.ShowDialog();
             }
         }
+
+        private void perfCountersToolStripMenuItem_Click(object sender, EventArgs e)
+        {
+            new PerfCountersPanel().Show();
+        }
     }
 }
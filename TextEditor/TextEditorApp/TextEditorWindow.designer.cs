@@ -42,6 +42,8 @@ namespace TextEditor
             this.saveToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.saveAsToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.saveACopyAsToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
+            this.toolStripMenuItem16 = new System.Windows.Forms.ToolStripSeparator();
+            this.followToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.toolStripMenuItem11 = new System.Windows.Forms.ToolStripSeparator();
             this.closeToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.exitToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
@@ -84,6 +86,8 @@ namespace TextEditor
             this.insertTabAsSpacesToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.toolStripMenuItem14 = new System.Windows.Forms.ToolStripSeparator();
             this.simpleNavigationToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
+            this.wordWrapToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
+            this.syntaxHighlightingToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.toolStripMenuItem7 = new System.Windows.Forms.ToolStripSeparator();
             this.fontToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.toolStripMenuItem6 = new System.Windows.Forms.ToolStripSeparator();
@@ -91,6 +95,7 @@ namespace TextEditor
             this.toolsToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.testInlineModeToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.stochasticTestToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
+            this.perfCountersToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.toolStripMenuItem15 = new System.Windows.Forms.ToolStripSeparator();
             this.previousUTF16SurrogatePairToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
             this.nextUTF16SurrogatePairToolStripMenuItem = new System.Windows.Forms.ToolStripMenuItem();
@@ -111,7 +116,9 @@ namespace TextEditor
             this.stringStorageFactory = new TextEditor.StringStorageFactory();
             this.helper = new TextEditor.TextEditorWindowHelper(this.components);
             this.utf8SplayGapBufferFactory = new TextEditor.Utf8SplayGapStorageFactory();
+            this.pieceTreeStorageFactory = new TextEditor.PieceTreeStorageFactory();
             this.dpiChangeHelper = new TextEditor.DpiChangeHelper(this.components);
+            this.followTimer = new System.Windows.Forms.Timer(this.components);
             this.menuStrip.SuspendLayout();
             this.tableLayoutPanel1.SuspendLayout();
             this.toolStrip.SuspendLayout();
@@ -142,6 +149,8 @@ namespace TextEditor
             this.saveToolStripMenuItem,
             this.saveAsToolStripMenuItem,
             this.saveACopyAsToolStripMenuItem,
+            this.toolStripMenuItem16,
+            this.followToolStripMenuItem,
             this.toolStripMenuItem11,
             this.closeToolStripMenuItem,
             this.exitToolStripMenuItem});
@@ -231,6 +240,18 @@ namespace TextEditor
             this.saveACopyAsToolStripMenuItem.Text = "Sa&ve a Copy As...";
             this.saveACopyAsToolStripMenuItem.Click += new System.EventHandler(this.saveACopyAsToolStripMenuItem_Click);
             // 
+            // toolStripMenuItem16
+            // 
+            this.toolStripMenuItem16.Name = "toolStripMenuItem16";
+            this.toolStripMenuItem16.Size = new System.Drawing.Size(179, 6);
+            // 
+            // followToolStripMenuItem
+            // 
+            this.followToolStripMenuItem.Name = "followToolStripMenuItem";
+            this.followToolStripMenuItem.Size = new System.Drawing.Size(182, 22);
+            this.followToolStripMenuItem.Text = "Fo&llow File Changes";
+            this.followToolStripMenuItem.Click += new System.EventHandler(this.followToolStripMenuItem_Click);
+            // 
             // toolStripMenuItem11
             // 
             this.toolStripMenuItem11.Name = "toolStripMenuItem11";
@@ -439,6 +460,8 @@ namespace TextEditor
             this.insertTabAsSpacesToolStripMenuItem,
             this.toolStripMenuItem14,
             this.simpleNavigationToolStripMenuItem,
+            this.wordWrapToolStripMenuItem,
+            this.syntaxHighlightingToolStripMenuItem,
             this.toolStripMenuItem7,
             this.fontToolStripMenuItem,
             this.toolStripMenuItem6,
@@ -547,6 +570,20 @@ namespace TextEditor
             this.simpleNavigationToolStripMenuItem.Text = "&Simple Navigation";
             this.simpleNavigationToolStripMenuItem.Click += new System.EventHandler(this.simpleNavigationToolStripMenuItem_Click);
             // 
+            // wordWrapToolStripMenuItem
+            // 
+            this.wordWrapToolStripMenuItem.Name = "wordWrapToolStripMenuItem";
+            this.wordWrapToolStripMenuItem.Size = new System.Drawing.Size(202, 22);
+            this.wordWrapToolStripMenuItem.Text = "&Word Wrap";
+            this.wordWrapToolStripMenuItem.Click += new System.EventHandler(this.wordWrapToolStripMenuItem_Click);
+            // 
+            // syntaxHighlightingToolStripMenuItem
+            // 
+            this.syntaxHighlightingToolStripMenuItem.Name = "syntaxHighlightingToolStripMenuItem";
+            this.syntaxHighlightingToolStripMenuItem.Size = new System.Drawing.Size(202, 22);
+            this.syntaxHighlightingToolStripMenuItem.Text = "S&yntax Highlighting";
+            this.syntaxHighlightingToolStripMenuItem.Click += new System.EventHandler(this.syntaxHighlightingToolStripMenuItem_Click);
+            // 
             // toolStripMenuItem7
             // 
             this.toolStripMenuItem7.Name = "toolStripMenuItem7";
@@ -576,6 +613,7 @@ namespace TextEditor
             this.toolsToolStripMenuItem.DropDownItems.AddRange(new System.Windows.Forms.ToolStripItem[] {
             this.testInlineModeToolStripMenuItem,
             this.stochasticTestToolStripMenuItem,
+            this.perfCountersToolStripMenuItem,
             this.toolStripMenuItem15,
             this.previousUTF16SurrogatePairToolStripMenuItem,
             this.nextUTF16SurrogatePairToolStripMenuItem,
@@ -601,6 +639,13 @@ namespace TextEditor
             this.stochasticTestToolStripMenuItem.Text = "Stochastic Test";
             this.stochasticTestToolStripMenuItem.Click += new System.EventHandler(this.stochasticTestToolStripMenuItem_Click);
             // 
+            // perfCountersToolStripMenuItem
+            // 
+            this.perfCountersToolStripMenuItem.Name = "perfCountersToolStripMenuItem";
+            this.perfCountersToolStripMenuItem.Size = new System.Drawing.Size(256, 22);
+            this.perfCountersToolStripMenuItem.Text = "Performance Counters...";
+            this.perfCountersToolStripMenuItem.Click += new System.EventHandler(this.perfCountersToolStripMenuItem_Click);
+            // 
             // toolStripMenuItem15
             // 
             this.toolStripMenuItem15.Name = "toolStripMenuItem15";
@@ -763,6 +808,11 @@ namespace TextEditor
             // 
             this.dpiChangeHelper.Form = this;
             // 
+            // followTimer
+            // 
+            this.followTimer.Interval = 500;
+            this.followTimer.Tick += new System.EventHandler(this.followTimer_Tick);
+            // 
             // TextEditorWindow
             // 
             this.AllowDrop = true;
@@ -853,6 +903,7 @@ namespace TextEditor
         private StringStorageFactory stringStorageFactory;
         private System.Windows.Forms.ToolStripLabel toolStripLabelBackingStore;
         private Utf8SplayGapStorageFactory utf8SplayGapBufferFactory;
+        private PieceTreeStorageFactory pieceTreeStorageFactory;
         private System.Windows.Forms.ToolStripMenuItem toolsToolStripMenuItem;
         private System.Windows.Forms.ToolStripMenuItem previousUTF16SurrogatePairToolStripMenuItem;
         private System.Windows.Forms.ToolStripMenuItem nextUTF16SurrogatePairToolStripMenuItem;
@@ -863,9 +914,15 @@ namespace TextEditor
         private System.Windows.Forms.ToolStripMenuItem findInFilesToolStripMenuItem;
         private System.Windows.Forms.ToolStripSeparator toolStripMenuItem14;
         private System.Windows.Forms.ToolStripMenuItem simpleNavigationToolStripMenuItem;
+        private System.Windows.Forms.ToolStripMenuItem wordWrapToolStripMenuItem;
+        private System.Windows.Forms.ToolStripMenuItem syntaxHighlightingToolStripMenuItem;
         private System.Windows.Forms.ToolStripMenuItem testInlineModeToolStripMenuItem;
         private System.Windows.Forms.ToolStripSeparator toolStripMenuItem15;
         private DpiChangeHelper dpiChangeHelper;
         private System.Windows.Forms.ToolStripMenuItem stochasticTestToolStripMenuItem;
+        private System.Windows.Forms.ToolStripMenuItem perfCountersToolStripMenuItem;
+        private System.Windows.Forms.ToolStripSeparator toolStripMenuItem16;
+        private System.Windows.Forms.ToolStripMenuItem followToolStripMenuItem;
+        private System.Windows.Forms.Timer followTimer;
     }
 }
@@ -24,6 +24,8 @@
 
 #include "TextEditorDirectWrite.h"
 
+#include "../TextEditorLayout/TextLayoutDirectWrite.h"
+
 namespace TextEditor
 {
 	//
@@ -55,6 +57,9 @@ namespace TextEditor
 		customFontCollectionLoader = NULL;
 		customFontFileLoader = NULL;
 		factory = NULL;
+		customFontCollection = NULL;
+		gdiInterop = NULL;
+		renderingParams = NULL;
 	}
 
 	TextServiceDirectWriteGlobals::~TextServiceDirectWriteGlobals()
@@ -64,6 +69,17 @@ namespace TextEditor
 
 	void TextServiceDirectWriteGlobals::_Dispose()
 	{
+		ClearTextFormats();
+		SafeRelease(&customFontCollection);
+		SafeRelease(&gdiInterop);
+		SafeRelease(&renderingParams);
+
+		for (int i = 0; i < fontFiles.GetSize(); i++)
+		{
+			SafeRelease(&fontFiles[i]);
+		}
+		fontFiles.RemoveAll();
+
 		if (customFontCollectionLoader != NULL)
 		{
 			factory->UnregisterFontCollectionLoader(customFontCollectionLoader);
@@ -75,14 +91,311 @@ namespace TextEditor
 		SafeRelease(&customFontCollectionLoader);
 		SafeRelease(&customFontFileLoader);
 		SafeRelease(&factory);
+
+		for (int i = 0; i < fonts.GetSize(); i++)
+		{
+			TextServiceFontData* font = fonts[i];
+			if (font->file != INVALID_HANDLE_VALUE)
+			{
+				UnmapViewOfFile(font->data);
+				CloseHandle(font->mapping);
+				CloseHandle(font->file);
+			}
+			delete font;
+		}
+		fonts.RemoveAll();
 	}
 
-	void TextServiceDirectWriteGlobals::AddFont(BYTE* data, int length)
+	void TextServiceDirectWriteGlobals::AddFont(const BYTE* data, int length)
 	{
-		BYTE* copy = new BYTE[length];
-		memcpy(copy, data, length);
-		fonts.Add(copy);
-		lengths.Add(length);
+		TextServiceFontData* font = new TextServiceFontData();
+		font->data = data;
+		font->length = length;
+		font->lastWriteTime = 0;
+		font->file = INVALID_HANDLE_VALUE;
+		font->mapping = NULL;
+		fonts.Add(font);
+
+		// collection (and formats that may have fallen back to GDI) must be rebuilt to include the new font
+		SafeRelease(&customFontCollection);
+		ClearTextFormats();
+	}
+
+	HRESULT TextServiceDirectWriteGlobals::AddFontFile(const wchar_t* path)
+	{
+		HANDLE file = CreateFileW(
+			path,
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			NULL,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		HANDLE mapping = NULL;
+		const BYTE* data = NULL;
+		LARGE_INTEGER size;
+		FILETIME lastWriteTime;
+		if (!GetFileSizeEx(file, &size) || !GetFileTime(file, NULL, NULL, &lastWriteTime))
+		{
+			goto Error;
+		}
+		if (size.QuadPart == 0)
+		{
+			SetLastError(ERROR_INVALID_DATA);
+			goto Error;
+		}
+
+		mapping = CreateFileMappingW(
+			file,
+			NULL,
+			PAGE_READONLY,
+			0,
+			0,
+			NULL);
+		if (mapping == NULL)
+		{
+			goto Error;
+		}
+		data = (const BYTE*)MapViewOfFile(
+			mapping,
+			FILE_MAP_READ,
+			0,
+			0,
+			0);
+		if (data == NULL)
+		{
+			goto Error;
+		}
+
+		{
+			TextServiceFontData* font = new TextServiceFontData();
+			font->data = data;
+			font->length = size.QuadPart;
+			font->lastWriteTime = ((UINT64)lastWriteTime.dwHighDateTime << 32) | lastWriteTime.dwLowDateTime;
+			font->file = file;
+			font->mapping = mapping;
+			fonts.Add(font);
+		}
+
+		SafeRelease(&customFontCollection);
+		ClearTextFormats();
+
+		return S_OK;
+
+
+	Error:
+
+		HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+		if (mapping != NULL)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return hr;
+	}
+
+	HRESULT TextServiceDirectWriteGlobals::GetFontFile(int index, IDWriteFontFile** fontFileOut)
+	{
+		while (fontFiles.GetSize() <= index)
+		{
+			fontFiles.Add(NULL);
+		}
+
+		if (fontFiles[index] == NULL)
+		{
+			DWORD key = index;
+			HRESULT hr = factory->CreateCustomFontFileReference(
+				&key,
+				sizeof(DWORD),
+				customFontFileLoader,
+				&fontFiles[index]);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+		}
+
+		fontFiles[index]->AddRef();
+		*fontFileOut = fontFiles[index];
+		return S_OK;
+	}
+
+	HRESULT TextServiceDirectWriteGlobals::EnsureShared()
+	{
+		int hr;
+
+		if (factory == NULL)
+		{
+			IDWriteFactory* factory;
+			hr = DWriteCreateFactory(
+				DWRITE_FACTORY_TYPE_ISOLATED,
+				__uuidof(IDWriteFactory),
+				reinterpret_cast<IUnknown**>(&factory));
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+			this->factory = factory;
+		}
+
+		if (fonts.GetSize() != 0)
+		{
+			// For some reason I don't understand, DWrite is losing track of the registered loader sometimes, but not
+			// always, so for now, always try to register and ignore the "already registered" error.
+			if (customFontCollectionLoader == NULL)
+			{
+				customFontCollectionLoader = new TextServiceFontCollectionLoader(this);
+			}
+			hr = factory->RegisterFontCollectionLoader(
+				customFontCollectionLoader);
+			if (FAILED(hr) && (hr != DWRITE_E_ALREADYREGISTERED))
+			{
+				return hr;
+			}
+			if (customFontFileLoader == NULL)
+			{
+				customFontFileLoader = new TextServiceFontLoader(this);
+			}
+			hr = factory->RegisterFontFileLoader(
+				customFontFileLoader);
+			if (FAILED(hr) && (hr != DWRITE_E_ALREADYREGISTERED))
+			{
+				return hr;
+			}
+		}
+
+		if (gdiInterop == NULL)
+		{
+			hr = factory->GetGdiInterop(&gdiInterop);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+		}
+
+		if (renderingParams == NULL)
+		{
+			hr = factory->CreateRenderingParams(
+				&renderingParams); // "default settings for the primary monitor"
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+		}
+
+		return S_OK;
+	}
+
+	HRESULT TextServiceDirectWriteGlobals::GetCustomFontCollection(IDWriteFontCollection** collectionOut)
+	{
+		*collectionOut = NULL;
+		if (fonts.GetSize() == 0)
+		{
+			return S_OK;
+		}
+
+		if (customFontCollection == NULL)
+		{
+			DWORD key = 0; // const key: we only ever have one custom font collection
+			int hr = factory->CreateCustomFontCollection(
+				customFontCollectionLoader,
+				&key,
+				sizeof(DWORD),
+				&customFontCollection);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+		}
+
+		customFontCollection->AddRef();
+		*collectionOut = customFontCollection;
+		return S_OK;
+	}
+
+	IDWriteTextFormat* TextServiceDirectWriteGlobals::FindTextFormat(
+		const LOGFONTW* logFont,
+		float fontSize,
+		float rdpiY,
+		const wchar_t* locale,
+		float* baselineOut)
+	{
+		for (int i = 0; i < textFormats.GetSize(); i++)
+		{
+			TextServiceTextFormatCacheEntry* entry = textFormats[i];
+			if ((entry->fontSize == fontSize)
+				&& (entry->rdpiY == rdpiY)
+				&& (memcmp(&entry->logFont, logFont, sizeof(LOGFONTW)) == 0)
+				&& (wcscmp(entry->locale, locale) == 0))
+			{
+				if (i != 0)
+				{
+					// move to front
+					textFormats.RemoveAt(i);
+					textFormats.Add(NULL);
+					for (int j = textFormats.GetSize() - 1; j > 0; j--)
+					{
+						textFormats[j] = textFormats[j - 1];
+					}
+					textFormats[0] = entry;
+				}
+
+				*baselineOut = entry->baseline;
+				entry->textFormat->AddRef();
+				return entry->textFormat;
+			}
+		}
+		return NULL;
+	}
+
+	void TextServiceDirectWriteGlobals::AddTextFormat(
+		const LOGFONTW* logFont,
+		float fontSize,
+		float rdpiY,
+		const wchar_t* locale,
+		IDWriteTextFormat* textFormat,
+		float baseline)
+	{
+		// evict least recently used - interops still holding the format keep it alive
+		while (textFormats.GetSize() >= MaxCachedTextFormats)
+		{
+			TextServiceTextFormatCacheEntry* evicted = textFormats[textFormats.GetSize() - 1];
+			textFormats.RemoveAt(textFormats.GetSize() - 1);
+			SafeRelease(&evicted->textFormat);
+			delete evicted;
+		}
+
+		TextServiceTextFormatCacheEntry* entry = new TextServiceTextFormatCacheEntry();
+		entry->logFont = *logFont;
+		entry->fontSize = fontSize;
+		entry->rdpiY = rdpiY;
+		wcsncpy_s(entry->locale, LOCALE_NAME_MAX_LENGTH, locale, _TRUNCATE);
+		textFormat->AddRef();
+		entry->textFormat = textFormat;
+		entry->baseline = baseline;
+
+		textFormats.Add(NULL);
+		for (int j = textFormats.GetSize() - 1; j > 0; j--)
+		{
+			textFormats[j] = textFormats[j - 1];
+		}
+		textFormats[0] = entry;
+	}
+
+	void TextServiceDirectWriteGlobals::ClearTextFormats()
+	{
+		for (int i = 0; i < textFormats.GetSize(); i++)
+		{
+			TextServiceTextFormatCacheEntry* entry = textFormats[i];
+			SafeRelease(&entry->textFormat);
+			delete entry;
+		}
+		textFormats.RemoveAll();
 	}
 
 
@@ -93,7 +406,13 @@ namespace TextEditor
 
 	void TextServiceDirectWriteGlobalsHandle::AddFont(INT64 data, int length)
 	{
-		globals->AddFont((BYTE*)data, length);
+		globals->AddFont((const BYTE*)data, length);
+	}
+
+	HRESULT TextServiceDirectWriteGlobalsHandle::AddFontFile(String^ path)
+	{
+		pin_ptr<const wchar_t> wzPath = PtrToStringChars(path);
+		return globals->AddFontFile(wzPath);
 	}
 
 	void TextServiceDirectWriteGlobalsHandle::_Dispose()
@@ -124,84 +443,24 @@ namespace TextEditor
 		Font^ font,
 		int visibleWidth)
 	{
-		ClearCaches();
-
 		int hr;
 
 		this->globals = globalsHandle->globals;
 
-		if (globals->factory == NULL)
+		hr = globals->EnsureShared();
+		if (FAILED(hr))
 		{
-			IDWriteFactory* factory;
-			hr = DWriteCreateFactory(
-				DWRITE_FACTORY_TYPE_ISOLATED,
-				__uuidof(IDWriteFactory),
-				reinterpret_cast<IUnknown**>(&factory));
-			if (FAILED(hr))
-			{
-				return hr;
-			}
-			globals->factory = factory;
+			return hr;
 		}
 
 
-		IDWriteFontCollection* fontCollection = NULL;
 		IDWriteFontCollection* fontCollection2 = NULL;
-		IDWriteGdiInterop* gdiInterop = NULL;
 		IDWriteFont* fontD = NULL;
 		IDWriteFontFamily* family = NULL;
 		IDWriteLocalizedStrings* familyNames = NULL;
-		IDWriteRenderingParams* renderingParams = NULL;
 		IDWriteBitmapRenderTarget* renderTarget = NULL;
 		IDWriteTextFormat* textFormat = NULL;
 
-		if (globals->fonts.GetSize() != 0)
-		{
-			// For some reason I don't understand, DWrite is losing track of the registered loader sometimes, but not
-			// always, so for now, always try to register and ignore the "already registered" error.
-			if (globals->customFontCollectionLoader == NULL)
-			{
-				globals->customFontCollectionLoader = new TextServiceFontCollectionLoader(globals);
-			}
-			hr = globals->factory->RegisterFontCollectionLoader(
-				globals->customFontCollectionLoader);
-			if (FAILED(hr) && (hr != DWRITE_E_ALREADYREGISTERED))
-			{
-				goto Error;
-			}
-			if (globals->customFontFileLoader == NULL)
-			{
-				globals->customFontFileLoader = new TextServiceFontLoader(globals);
-			}
-			hr = globals->factory->RegisterFontFileLoader(
-				globals->customFontFileLoader);
-			if (FAILED(hr) && (hr != DWRITE_E_ALREADYREGISTERED))
-			{
-				goto Error;
-			}
-		}
-
-		hr = globals->factory->GetSystemFontCollection(
-			&fontCollection,
-			false/*checkForUpdates*/);
-		if (FAILED(hr))
-		{
-			goto Error;
-		}
-
-		hr = globals->factory->GetGdiInterop(&gdiInterop);
-		if (FAILED(hr))
-		{
-			goto Error;
-		}
-
-		hr = globals->factory->CreateRenderingParams(
-			&renderingParams); // "default settings for the primary monitor"
-		if (FAILED(hr))
-		{
-			goto Error;
-		}
-
 
 		//lineHeight = font.Height;
 		this->visibleWidth = visibleWidth;
@@ -213,41 +472,64 @@ namespace TextEditor
 		}
 		_ASSERT(visibleWidth > 0);
 		_ASSERT(lineHeight > 0);
-		Image^ offscreenStrip = gcnew Bitmap(visibleWidth, lineHeight, System::Drawing::Imaging::PixelFormat::Format32bppArgb);
-		try
+		if (this->renderTarget != NULL)
+		{
+			// existing strip (e.g. width changed or font changed): resize in place rather than recreating
+			SIZE size;
+			hr = this->renderTarget->GetSize(&size);
+			if (FAILED(hr))
+			{
+				goto Error;
+			}
+			if ((size.cx != visibleWidth) || (size.cy != lineHeight))
+			{
+				hr = this->renderTarget->Resize(visibleWidth, lineHeight);
+				if (FAILED(hr))
+				{
+					goto Error;
+				}
+			}
+			renderTarget = this->renderTarget;
+			this->renderTarget = NULL;
+		}
+		else
 		{
-			Graphics^ offscreenGraphics = Graphics::FromImage(offscreenStrip);
+			Image^ offscreenStrip = gcnew Bitmap(visibleWidth, lineHeight, System::Drawing::Imaging::PixelFormat::Format32bppArgb);
 			try
 			{
-				IntPtr hdc = offscreenGraphics->GetHdc();
+				Graphics^ offscreenGraphics = Graphics::FromImage(offscreenStrip);
 				try
 				{
-					// GDI interop: https://msdn.microsoft.com/en-us/library/windows/desktop/dd742734(v=vs.85).aspx
-					// Render to a GDI surface: https://msdn.microsoft.com/en-us/library/windows/desktop/ff485856(v=vs.85).aspx
-					hr = gdiInterop->CreateBitmapRenderTarget(
-						(HDC)hdc.ToInt64(),
-						visibleWidth,
-						lineHeight,
-						&renderTarget);
-					if (FAILED(hr))
+					IntPtr hdc = offscreenGraphics->GetHdc();
+					try
 					{
-						goto Error;
+						// GDI interop: https://msdn.microsoft.com/en-us/library/windows/desktop/dd742734(v=vs.85).aspx
+						// Render to a GDI surface: https://msdn.microsoft.com/en-us/library/windows/desktop/ff485856(v=vs.85).aspx
+						hr = globals->gdiInterop->CreateBitmapRenderTarget(
+							(HDC)hdc.ToInt64(),
+							visibleWidth,
+							lineHeight,
+							&renderTarget);
+						if (FAILED(hr))
+						{
+							goto Error;
+						}
+					}
+					finally
+					{
+						offscreenGraphics->ReleaseHdc();
 					}
 				}
 				finally
 				{
-					offscreenGraphics->ReleaseHdc();
+					delete offscreenGraphics; // Dispose()
 				}
 			}
 			finally
 			{
-				delete offscreenGraphics; // Dispose()
+				delete offscreenStrip; // Dispose()
 			}
 		}
-		finally
-		{
-			delete offscreenStrip; // Dispose()
-		}
 
 #if 0
 		// TODO: this will do the wrong thing since line heights are determined from font size in the winforms
@@ -256,6 +538,7 @@ namespace TextEditor
 		HDC hdcScreen = GetDC(NULL);
 		int dpiX = GetDeviceCaps(hdcScreen, LOGPIXELSX);
 		int dpiY = GetDeviceCaps(hdcScreen, LOGPIXELSY);
+		ReleaseDC(NULL, hdcScreen);
 		rdpiX = dpiX / (float)96; // TODO: figure out correct thing to put here
 		rdpiY = dpiY / (float)96; // TODO: figure out correct thing to put here
 		hr = renderTarget->SetPixelsPerDip(rdpiY);
@@ -279,20 +562,28 @@ namespace TextEditor
 		const float Scaling = (float)96 / 72;
 		float fontSize = Math::Abs(font->Size * Scaling);
 
+		wchar_t locale[256];
+		{
+			pin_ptr<const wchar_t> name = PtrToStringChars(CultureInfo::CurrentCulture->Name);
+			wcsncpy_s(locale, 256, name, CultureInfo::CurrentCulture->Name->Length);
+		}
+
+		// shared format for this font, if some interop has already built one
+		textFormat = globals->FindTextFormat(&logFontStack, fontSize, rdpiY, locale, &baseline);
+		if (textFormat != NULL)
+		{
+			goto Success;
+		}
+
 		// first, try the custom font collection
 		IDWriteFontCollection* fontCollectionActual = NULL; // weak ref; NULL means system collection
-		if (globals->fonts.GetSize() != 0)
+		hr = globals->GetCustomFontCollection(&fontCollection2);
+		if (FAILED(hr))
+		{
+			goto Error;
+		}
+		if (fontCollection2 != NULL)
 		{
-			DWORD key = 0; // const key: we only ever have one custom font collection
-			hr = globals->factory->CreateCustomFontCollection(
-				globals->customFontCollectionLoader,
-				&key,
-				sizeof(DWORD),
-				&fontCollection2);
-			if (FAILED(hr))
-			{
-				goto Error;
-			}
 			UINT32 index;
 			BOOL exists;
 			hr = fontCollection2->FindFamilyName(
@@ -322,13 +613,14 @@ namespace TextEditor
 					goto Error;
 				}
 				fontCollectionActual = fontCollection2;
+				SafeRelease(&family);
 			}
 		}
 		// if font wasn't found in custom collection, try asking GDI
 		if (fontCollectionActual == NULL)
 		{
 			_ASSERT(fontD == NULL);
-			hr = gdiInterop->CreateFontFromLOGFONT(
+			hr = globals->gdiInterop->CreateFontFromLOGFONT(
 				&logFontStack,
 				&fontD);
 			if (FAILED(hr))
@@ -361,13 +653,6 @@ namespace TextEditor
 			goto Error;
 		}
 
-		wchar_t locale[256];
-		{
-			pin_ptr<const wchar_t> name = PtrToStringChars(CultureInfo::CurrentCulture->Name);
-			wcsncpy_s(locale, 256, name, CultureInfo::CurrentCulture->Name->Length);
-		}
-
-		SafeRelease(&textFormat);
 		hr = globals->factory->CreateTextFormat(
 			familyName,
 			fontCollectionActual, // NULL: system font collection
@@ -407,15 +692,20 @@ namespace TextEditor
 		}
 #endif
 
+		globals->AddTextFormat(&logFontStack, fontSize, rdpiY, locale, textFormat, baseline);
+
 
 		// Success
+	Success:
 
-		this->renderingParams = renderingParams;
-		renderingParams = NULL;
+		SafeRelease(&this->renderingParams);
+		this->renderingParams = globals->renderingParams;
+		this->renderingParams->AddRef();
 
 		this->renderTarget = renderTarget;
 		renderTarget = NULL;
 
+		SafeRelease(&this->textFormat);
 		this->textFormat = textFormat;
 		textFormat = NULL;
 
@@ -424,13 +714,10 @@ namespace TextEditor
 
 		SafeRelease(&textFormat);
 		SafeRelease(&renderTarget);
-		SafeRelease(&renderingParams);
 		SafeRelease(&familyNames);
 		SafeRelease(&family);
 		SafeRelease(&fontD);
-		SafeRelease(&fontCollection);
 		SafeRelease(&fontCollection2);
-		SafeRelease(&gdiInterop);
 
 		return hr;
 	}
@@ -750,63 +1037,33 @@ namespace TextEditor
 
 		regionOut = nullptr;
 
-		unsigned int cMaxMetrics = 8;
-		DWRITE_HIT_TEST_METRICS* metrics = NULL;
-		unsigned int cMetrics;
-		while (true)
+		// hit-testing and rounding rules are shared with other layout implementations - see TextLayout.h
+		LayoutCore::DirectWriteTextLayout layout(textLayout, totalChars);
+		std::vector<LayoutCore::PixelSpan> spans;
+		hr = LayoutCore::LineMetrics::BuildRegion(
+			layout,
+			this->service->rdpiY,
+			(float)position.X,
+			startPos,
+			endPosPlusOne,
+			spans);
+		if (FAILED(hr))
 		{
-			if (metrics != NULL)
-			{
-				delete metrics;
-			}
-			metrics = new DWRITE_HIT_TEST_METRICS[cMaxMetrics];
-			int hr = textLayout->HitTestTextRange(
-				startPos,
-				(endPosPlusOne - startPos),
-				(float)position.X,
-				(float)position.Y /*+ service.baseline*/,
-				metrics,
-				cMaxMetrics,
-				&cMetrics);
-			if (hr == E_NOT_SUFFICIENT_BUFFER)
-			{
-				cMaxMetrics *= 2;
-				continue;
-			}
-			if (FAILED(hr))
-			{
-				goto Error;
-			}
-			break;
+			goto Error;
 		}
 
 		Region^ region = gcnew Region(System::Drawing::Rectangle());
-		for (unsigned int i = 0; i < cMetrics; i++)
-		{
-			RectangleF rectF(
-				metrics[i].left,
-				metrics[i].top,
-				metrics[i].width,
-				metrics[i].height);
-			//rectF.Y -= service.baseline;
-			int X = (int)Math::Round(rectF.Left * this->service->rdpiY); // rounding must match CharPosToX()
-			//int Y = (int)Math::Floor(rectF.Top);
+		for (size_t i = 0; i < spans.size(); i++)
+		{
 			int Y = 0;
-			int Width = (int)Math::Round((rectF.Width + rectF.Left) * this->service->rdpiY - X); // rounding must match CharPosToX()
-			//int Height = (int)Math::Ceiling(rectF.Height + rectF.Top - Y);
 			int Height = service->lineHeight;
-			region->Union(System::Drawing::Rectangle(X, Y, Width, Height));
+			region->Union(System::Drawing::Rectangle(spans[i].x, Y, spans[i].width, Height));
 		}
 
 		regionOut = region;
 
 	Error:
 
-		if (metrics != NULL)
-		{
-			delete metrics;
-		}
-
 		return hr;
 	}
 
@@ -816,15 +1073,13 @@ namespace TextEditor
 	{
 		int hr = S_OK;
 
-		DWRITE_TEXT_METRICS metrics;
-		hr = textLayout->GetMetrics(&metrics);
+		LayoutCore::DirectWriteTextLayout layout(textLayout, totalChars);
+		int width;
+		hr = LayoutCore::LineMetrics::GetExtent(layout, this->service->rdpiY, &width);
 		if (FAILED(hr))
 		{
 			goto Error;
 		}
-		_ASSERT(metrics.lineCount <= 1);
-
-		int width = (int)Math::Round(metrics.widthIncludingTrailingWhitespace * this->service->rdpiY); // rounding must match CharPosToX(), BuildRegion()
 
 		// Note: height can increase when non-western scripts are introduced (e.g. Arabic and or Devanagari)
 		// and font substitution decides it needs more space to comfortably display the text,
@@ -848,20 +1103,15 @@ namespace TextEditor
 	{
 		int hr = S_OK;
 
-		float x1, y1;
-		DWRITE_HIT_TEST_METRICS metrics;
-		hr = textLayout->HitTestTextPosition(
-			offset,
-			trailing,
-			&x1,
-			&y1,
-			&metrics);
+		LayoutCore::DirectWriteTextLayout layout(textLayout, totalChars);
+		int x1;
+		hr = LayoutCore::LineMetrics::CharPosToX(layout, this->service->rdpiY, offset, trailing, &x1);
 		if (FAILED(hr))
 		{
 			goto Error;
 		}
 
-		x = (int)Math::Round(x1 * this->service->rdpiY); // rounding must match BuildRegion()
+		x = x1;
 
 	Error:
 		return hr;
@@ -875,30 +1125,85 @@ namespace TextEditor
 	{
 		int hr = S_OK;
 
-		BOOL inside, trailing1;
-		DWRITE_HIT_TEST_METRICS metric;
-		hr = textLayout->HitTestPoint(
-			(float)(x / this->service->rdpiY),
-			(float)0,
-			&trailing1,
-			&inside,
-			&metric);
+		LayoutCore::DirectWriteTextLayout layout(textLayout, totalChars);
+		int offset1;
+		bool trailing1;
+		hr = LayoutCore::LineMetrics::XToCharPos(layout, this->service->rdpiY, x, &offset1, &trailing1);
 		if (FAILED(hr))
 		{
 			goto Error;
 		}
 
-		trailing = trailing1 != 0;
-		offset = (int)metric.textPosition;
-		if (trailing)
-		{
-			offset += metric.length;
-		}
+		offset = offset1;
+		trailing = trailing1;
 
 	Error:
 		return hr;
 	}
 
+	HRESULT TextServiceLineDirectWriteInterop::SetColor(
+		int start,
+		int length,
+		Color color)
+	{
+		TextServiceColorEffect* effect = new TextServiceColorEffect((unsigned int)(
+			(unsigned int)color.R
+			| ((unsigned int)color.G << 8)
+			| ((unsigned int)color.B << 16)));
+		DWRITE_TEXT_RANGE range = { (UINT32)start, (UINT32)length };
+		int hr = textLayout->SetDrawingEffect(
+			effect,
+			range); // layout takes its own reference
+		effect->Release();
+		return hr;
+	}
+
+
+	//
+
+	TextServiceColorEffect::TextServiceColorEffect(
+		COLORREF color)
+	{
+		this->refCount = 1;
+		this->color = color;
+	}
+
+	unsigned long STDMETHODCALLTYPE TextServiceColorEffect::AddRef()
+	{
+		return InterlockedIncrement(&refCount);
+	}
+
+	unsigned long STDMETHODCALLTYPE TextServiceColorEffect::Release()
+	{
+		if (InterlockedDecrement(&refCount) == 0)
+		{
+			delete this;
+			return 0;
+		}
+		return refCount;
+	}
+
+	HRESULT TextServiceColorEffect::QueryInterface(
+		IID const& riid,
+		void** ppvObject)
+	{
+		if (__uuidof(IUnknown) == riid)
+		{
+			*ppvObject = static_cast<IUnknown*>(this);
+		}
+		else if (__uuidof(TextServiceColorEffect) == riid)
+		{
+			*ppvObject = this;
+		}
+		else
+		{
+			*ppvObject = NULL;
+			return E_NOINTERFACE;
+		}
+		InterlockedIncrement(&refCount);
+		return S_OK;
+	}
+
 
 	//
 
@@ -1000,13 +1305,22 @@ namespace TextEditor
 	{
 		RECT bb;
 
+		COLORREF color = foreColor;
+		TextServiceColorEffect* effect;
+		if ((clientDrawingEffect != NULL)
+			&& SUCCEEDED(clientDrawingEffect->QueryInterface(__uuidof(TextServiceColorEffect), (void**)&effect)))
+		{
+			color = effect->color;
+			effect->Release();
+		}
+
 		int hr = renderTarget->DrawGlyphRun(
 			baselineOriginX,
 			baselineOriginY,
 			measuringMode,
 			glyphRun,
 			renderingParams,
-			foreColor,
+			color,
 			&bb);
 
 		return hr;
@@ -1162,21 +1476,8 @@ namespace TextEditor
 	HRESULT TextServiceFontEnumerator::GetCurrentFontFile(
 		IDWriteFontFile** fontFile)
 	{
-		HRESULT hr;
-
-		DWORD key = index;
-		hr = factory->CreateCustomFontFileReference(
-			&key,
-			sizeof(DWORD),
-			globals->customFontFileLoader,
-			fontFile);
-		if (FAILED(hr))
-		{
-			goto Error;
-		}
-
-	Error:
-		return hr;
+		// references are created once and shared by every collection build
+		return globals->GetFontFile(index, fontFile);
 	}
 
 	HRESULT TextServiceFontEnumerator::MoveNext(
@@ -1246,8 +1547,7 @@ namespace TextEditor
 		int index = *(DWORD*)fontFileReferenceKey;
 
 		*fontFileStream = new TextServiceFontFileStream(
-			globals->fonts[index],
-			globals->lengths[index]);
+			globals->fonts[index]);
 
 		return S_OK;
 	}
@@ -1256,12 +1556,10 @@ namespace TextEditor
 	//
 
 	TextServiceFontFileStream::TextServiceFontFileStream(
-		BYTE* data,
-		long length)
+		const TextServiceFontData* font)
 	{
 		this->refCount = 1;
-		this->data = data;
-		this->length = length;
+		this->font = font;
 	}
 
 	unsigned long STDMETHODCALLTYPE TextServiceFontFileStream::AddRef()
@@ -1303,14 +1601,14 @@ namespace TextEditor
 	HRESULT TextServiceFontFileStream::GetFileSize(
 		UINT64* fileSize)
 	{
-		*fileSize = length;
+		*fileSize = font->length;
 		return S_OK;
 	}
 
 	HRESULT TextServiceFontFileStream::GetLastWriteTime(
 		UINT64* lastWriteTime)
 	{
-		*lastWriteTime = 0;
+		*lastWriteTime = font->lastWriteTime;
 		return S_OK;
 	}
 
@@ -1320,11 +1618,16 @@ namespace TextEditor
 		UINT64 fragmentSize,
 		void** fragmentContext)
 	{
-		BYTE* target = new BYTE[fragmentSize];
-		*fragmentContext = target;
-		*fragmentStart = target;
+		if ((fileOffset > font->length) || (fragmentSize > font->length - fileOffset))
+		{
+			*fragmentStart = NULL;
+			*fragmentContext = NULL;
+			return E_INVALIDARG;
+		}
 
-		memcpy(target, (BYTE*)data + fileOffset, fragmentSize);
+		// data stays resident (mapped or heap) for the life of the globals, so hand out a direct pointer
+		*fragmentContext = NULL;
+		*fragmentStart = font->data + fileOffset;
 
 		return S_OK;
 	}
@@ -1332,6 +1635,5 @@ namespace TextEditor
 	void TextServiceFontFileStream::ReleaseFileFragment(
 		void* fragmentContext)
 	{
-		delete (BYTE*)fragmentContext;
 	}
 }
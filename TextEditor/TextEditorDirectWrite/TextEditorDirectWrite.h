@@ -32,14 +32,46 @@ namespace TextEditor
 {
 	//
 
+	// Text formats are shared by all interops (across windows) that use the same font at the same DPI. The cache holds
+	// one COM reference; each interop using the format holds another, so evicting an entry never invalidates a user.
+	struct TextServiceTextFormatCacheEntry
+	{
+		LOGFONTW logFont;
+		float fontSize;
+		float rdpiY;
+		wchar_t locale[LOCALE_NAME_MAX_LENGTH];
+		IDWriteTextFormat* textFormat;
+		float baseline;
+	};
+
+	// Font file contents are served directly to DirectWrite without copying: fonts registered by path are read-only
+	// file mappings (pages shared with any other process mapping the same file), and fonts registered from memory are
+	// used in place - the caller keeps that memory alive and unmoved for the life of the globals.
+	struct TextServiceFontData
+	{
+		const BYTE* data;
+		UINT64 length;
+		UINT64 lastWriteTime;
+		HANDLE file; // INVALID_HANDLE_VALUE if data is the caller's memory
+		HANDLE mapping;
+	};
+
 	public class TextServiceDirectWriteGlobals
 	{
 	public:
 		IDWriteFactory* factory;
 		IDWriteFontCollectionLoader* customFontCollectionLoader;
 		IDWriteFontFileLoader* customFontFileLoader;
-		CSimpleArray<BYTE*> fonts;
-		CSimpleArray<long> lengths;
+		CSimpleArray<TextServiceFontData*> fonts;
+		CSimpleArray<IDWriteFontFile*> fontFiles; // references built on first enumeration, parallel to fonts
+
+		// process-wide objects, created on first use
+		IDWriteFontCollection* customFontCollection; // NULL until fonts are added and first needed
+		IDWriteGdiInterop* gdiInterop;
+		IDWriteRenderingParams* renderingParams;
+
+		static const int MaxCachedTextFormats = 16;
+		CSimpleArray<TextServiceTextFormatCacheEntry*> textFormats; // most recently used first
 
 	public:
 		TextServiceDirectWriteGlobals();
@@ -48,7 +80,32 @@ namespace TextEditor
 
 		void _Dispose();
 
-		void AddFont(BYTE* data, int length);
+		void AddFont(const BYTE* data, int length);
+
+		HRESULT AddFontFile(const wchar_t* path);
+
+		HRESULT GetFontFile(int index, IDWriteFontFile** fontFileOut);
+
+		HRESULT EnsureShared();
+
+		HRESULT GetCustomFontCollection(IDWriteFontCollection** collectionOut);
+
+		IDWriteTextFormat* FindTextFormat(
+			const LOGFONTW* logFont,
+			float fontSize,
+			float rdpiY,
+			const wchar_t* locale,
+			float* baselineOut);
+
+		void AddTextFormat(
+			const LOGFONTW* logFont,
+			float fontSize,
+			float rdpiY,
+			const wchar_t* locale,
+			IDWriteTextFormat* textFormat,
+			float baseline);
+
+		void ClearTextFormats();
 	};
 
 	public ref class TextServiceDirectWriteGlobalsHandle
@@ -61,6 +118,8 @@ namespace TextEditor
 
 		void AddFont(INT64 data, int length);
 
+		HRESULT AddFontFile(String^ path);
+
 		void _Dispose();
 	};
 
@@ -161,6 +220,38 @@ namespace TextEditor
 			int x,
 			[Out] int %offset,
 			[Out] bool %trailing);
+
+		HRESULT SetColor(
+			int start,
+			int length,
+			Color color);
+	};
+
+
+	//
+
+	// Drawing effect attached to ranges of a text layout to draw them in a color other than the foreground color
+	// (syntax highlighting). Recognized by TextServiceLineDirectWriteInterop2::DrawGlyphRun.
+	class __declspec(uuid("c89f8c5b-82ca-443b-a7e3-108fb56ec3f4")) TextServiceColorEffect : public IUnknown
+	{
+	private:
+		long refCount;
+
+	public:
+		COLORREF color;
+
+	public:
+
+		TextServiceColorEffect(
+			COLORREF color);
+
+		unsigned long STDMETHODCALLTYPE AddRef();
+
+		unsigned long STDMETHODCALLTYPE Release();
+
+		STDMETHOD(QueryInterface)(
+			IID const& riid,
+			void** ppvObject);
 	};
 
 
@@ -331,14 +422,12 @@ namespace TextEditor
 	{
 	private:
 		long refCount;
-		BYTE* data;
-		long length;
+		const TextServiceFontData* font; // owned by globals
 
 	public:
 
 		TextServiceFontFileStream(
-			BYTE* data,
-			long length);
+			const TextServiceFontData* font);
 
 		unsigned long STDMETHODCALLTYPE AddRef();
 
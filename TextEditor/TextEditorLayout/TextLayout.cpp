@@ -0,0 +1,567 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "TextLayout.h"
+
+namespace TextEditor
+{
+	namespace LayoutCore
+	{
+		//
+
+		ClusterMap::ClusterMap()
+		{
+			Reset(std::vector<Cluster>());
+		}
+
+		void ClusterMap::Reset(
+			const std::vector<Cluster>& clusters)
+		{
+			this->clusters = clusters;
+
+			clusterOfPosition.clear();
+			clusterStarts.clear();
+			lefts.clear();
+			int position = 0;
+			float left = 0;
+			for (size_t i = 0; i < clusters.size(); i++)
+			{
+				assert(clusters[i].length > 0);
+				clusterStarts.push_back(position);
+				lefts.push_back(left);
+				clusterOfPosition.insert(clusterOfPosition.end(), clusters[i].length, (int)i);
+				position += clusters[i].length;
+				left += clusters[i].width;
+			}
+			clusterStarts.push_back(position);
+			lefts.push_back(left);
+		}
+
+		int ClusterMap::GetLength() const
+		{
+			return (int)clusterOfPosition.size();
+		}
+
+		int ClusterMap::GetClusterCount() const
+		{
+			return (int)clusters.size();
+		}
+
+		const std::vector<Cluster>& ClusterMap::GetClusters() const
+		{
+			return clusters;
+		}
+
+		float ClusterMap::GetWidth() const
+		{
+			return lefts.back();
+		}
+
+		// position may be the end of the text, which is the (empty) cluster after the last
+		int ClusterMap::GetClusterOfPosition(
+			int position) const
+		{
+			assert((position >= 0) && (position <= GetLength()));
+			return position < GetLength() ? clusterOfPosition[position] : GetClusterCount();
+		}
+
+		int ClusterMap::GetClusterStart(
+			int cluster) const
+		{
+			return clusterStarts[cluster];
+		}
+
+		float ClusterMap::GetClusterLeft(
+			int cluster) const
+		{
+			return lefts[cluster];
+		}
+
+		Status ClusterMap::HitTestTextPosition(
+			int position,
+			bool trailing,
+			float* x) const
+		{
+			if ((position < 0) || (position > GetLength()))
+			{
+				return StatusInvalidArgument;
+			}
+
+			int cluster = GetClusterOfPosition(position);
+			*x = trailing && (cluster < GetClusterCount()) ? lefts[cluster + 1] : lefts[cluster];
+			return StatusOk;
+		}
+
+		Status ClusterMap::HitTestPoint(
+			float x,
+			bool* trailing,
+			HitTestMetrics* metrics) const
+		{
+			if (clusters.empty())
+			{
+				*trailing = false;
+				metrics->textPosition = 0;
+				metrics->length = 0;
+				metrics->left = 0;
+				metrics->width = 0;
+				return StatusOk;
+			}
+
+			int cluster;
+			if (x < 0)
+			{
+				cluster = 0;
+				*trailing = false;
+			}
+			else if (x >= GetWidth())
+			{
+				cluster = GetClusterCount() - 1;
+				*trailing = true;
+			}
+			else
+			{
+				// last cluster whose left edge is at or before x
+				cluster = (int)(std::upper_bound(lefts.begin(), lefts.end() - 1, x) - lefts.begin()) - 1;
+				*trailing = x >= lefts[cluster] + clusters[cluster].width / 2;
+			}
+			metrics->textPosition = clusterStarts[cluster];
+			metrics->length = clusters[cluster].length;
+			metrics->left = lefts[cluster];
+			metrics->width = clusters[cluster].width;
+			return StatusOk;
+		}
+
+		Status ClusterMap::HitTestTextRange(
+			int position,
+			int length,
+			float originX,
+			std::vector<HitTestMetrics>& metrics) const
+		{
+			metrics.clear();
+			if ((position < 0) || (length < 0) || (position > GetLength()))
+			{
+				return StatusInvalidArgument;
+			}
+
+			int first = GetClusterOfPosition(position);
+			int endPlusOne = (length == 0) || (position == GetLength())
+				? first
+				: GetClusterOfPosition(std::min(position + length, GetLength()) - 1) + 1;
+			HitTestMetrics metric;
+			metric.textPosition = clusterStarts[first];
+			metric.length = clusterStarts[endPlusOne] - clusterStarts[first];
+			metric.left = originX + lefts[first];
+			metric.width = lefts[endPlusOne] - lefts[first];
+			metrics.push_back(metric);
+			return StatusOk;
+		}
+
+
+		//
+
+		int LineMetrics::Round(
+			float value)
+		{
+			double v = value;
+			double floor = std::floor(v);
+			double fraction = v - floor;
+			if ((fraction > .5) || ((fraction == .5) && (std::fmod(floor, 2) != 0)))
+			{
+				floor += 1;
+			}
+			return (int)floor;
+		}
+
+		Status LineMetrics::CharPosToX(
+			const ITextLayout& layout,
+			float pixelsPerDip,
+			int offset,
+			bool trailing,
+			int* x)
+		{
+			float x1;
+			Status status = layout.HitTestTextPosition(offset, trailing, &x1);
+			if (Failed(status))
+			{
+				return status;
+			}
+
+			*x = Round(x1 * pixelsPerDip); // rounding must match BuildRegion()
+			return StatusOk;
+		}
+
+		Status LineMetrics::XToCharPos(
+			const ITextLayout& layout,
+			float pixelsPerDip,
+			int x,
+			int* offset,
+			bool* trailing)
+		{
+			HitTestMetrics metrics;
+			Status status = layout.HitTestPoint((float)(x / pixelsPerDip), trailing, &metrics);
+			if (Failed(status))
+			{
+				return status;
+			}
+
+			*offset = metrics.textPosition;
+			if (*trailing)
+			{
+				*offset += metrics.length;
+			}
+			return StatusOk;
+		}
+
+		Status LineMetrics::BuildRegion(
+			const ITextLayout& layout,
+			float pixelsPerDip,
+			float originX,
+			int startPos,
+			int endPosPlusOne,
+			std::vector<PixelSpan>& spans)
+		{
+			spans.clear();
+
+			std::vector<HitTestMetrics> metrics;
+			Status status = layout.HitTestTextRange(startPos, endPosPlusOne - startPos, originX, metrics);
+			if (Failed(status))
+			{
+				return status;
+			}
+
+			for (size_t i = 0; i < metrics.size(); i++)
+			{
+				PixelSpan span;
+				span.x = Round(metrics[i].left * pixelsPerDip); // rounding must match CharPosToX()
+				// the right edge is rounded on its own, not as a width from the rounded left edge, which with rounding half to
+				// even would put it a pixel away from CharPosToX() at odd left edges
+				span.width = Round((metrics[i].width + metrics[i].left) * pixelsPerDip) - span.x; // rounding must match CharPosToX()
+				if (span.width > 0)
+				{
+					spans.push_back(span);
+				}
+			}
+
+			// union: runs of a bidirectional line come in visual pieces that may touch or, after rounding, overlap
+			std::sort(
+				spans.begin(),
+				spans.end(),
+				[](const PixelSpan& a, const PixelSpan& b) { return a.x < b.x; });
+			size_t count = 0;
+			for (size_t i = 0; i < spans.size(); i++)
+			{
+				if ((count != 0) && (spans[i].x <= spans[count - 1].x + spans[count - 1].width))
+				{
+					int end = std::max(spans[count - 1].x + spans[count - 1].width, spans[i].x + spans[i].width);
+					spans[count - 1].width = end - spans[count - 1].x;
+				}
+				else
+				{
+					spans[count++] = spans[i];
+				}
+			}
+			spans.resize(count);
+
+			return StatusOk;
+		}
+
+		Status LineMetrics::GetExtent(
+			const ITextLayout& layout,
+			float pixelsPerDip,
+			int* width)
+		{
+			float width1;
+			Status status = layout.GetWidth(&width1);
+			if (Failed(status))
+			{
+				return status;
+			}
+
+			*width = Round(width1 * pixelsPerDip); // rounding must match CharPosToX(), BuildRegion()
+			return StatusOk;
+		}
+
+
+		//
+
+		TextLayoutCache::TextLayoutCache(
+			ITextLayoutFactory* factory,
+			size_t maxEntries,
+			size_t maxUnits)
+			: factory(factory), maxEntries(std::max(maxEntries, (size_t)1)), maxUnits(maxUnits), units(0), hits(0), misses(0)
+		{
+		}
+
+		Status TextLayoutCache::Get(
+			const char16_t* text,
+			int length,
+			std::shared_ptr<const ITextLayout>& layout)
+		{
+			std::u16string key(text, length);
+
+			std::unordered_map<std::u16string, std::list<Entry>::iterator>::iterator found = index.find(key);
+			if (found != index.end())
+			{
+				hits++;
+				entries.splice(entries.begin(), entries, found->second);
+				layout = found->second->layout;
+				return StatusOk;
+			}
+
+			misses++;
+			std::unique_ptr<ITextLayout> created;
+			Status status = factory->CreateTextLayout(text, length, created);
+			if (Failed(status))
+			{
+				return status;
+			}
+			layout = std::shared_ptr<const ITextLayout>(created.release());
+
+			Entry entry;
+			entry.text = nullptr;
+			entry.layout = layout;
+			entries.push_front(entry);
+			std::pair<std::unordered_map<std::u16string, std::list<Entry>::iterator>::iterator, bool> inserted
+				= index.insert(std::make_pair(key, entries.begin()));
+			entries.front().text = &inserted.first->first; // keys don't move when the table is rehashed
+			units += length;
+
+			// the entry just added stays even if it alone exceeds the limits
+			while ((entries.size() > 1) && ((entries.size() > maxEntries) || (units > maxUnits)))
+			{
+				const Entry& last = entries.back();
+				units -= last.text->length();
+				index.erase(index.find(*last.text));
+				entries.pop_back();
+			}
+
+			return StatusOk;
+		}
+
+		void TextLayoutCache::Clear()
+		{
+			entries.clear();
+			index.clear();
+			units = 0;
+		}
+
+		size_t TextLayoutCache::GetCount() const
+		{
+			return entries.size();
+		}
+
+		int64_t TextLayoutCache::GetHits() const
+		{
+			return hits;
+		}
+
+		int64_t TextLayoutCache::GetMisses() const
+		{
+			return misses;
+		}
+
+
+		//
+
+		Strip::Strip(
+			int width,
+			int height)
+			: width(0), height(0)
+		{
+			Resize(width, height);
+		}
+
+		void Strip::Resize(
+			int width,
+			int height)
+		{
+			this->width = std::max(width, 1);
+			this->height = std::max(height, 1);
+			pixels.assign((size_t)this->width * this->height, 0);
+		}
+
+		int Strip::GetWidth() const
+		{
+			return width;
+		}
+
+		int Strip::GetHeight() const
+		{
+			return height;
+		}
+
+		Color Strip::GetPixel(
+			int x,
+			int y) const
+		{
+			assert((x >= 0) && (x < width) && (y >= 0) && (y < height));
+			return pixels[(size_t)y * width + x];
+		}
+
+		const Color* Strip::GetPixels() const
+		{
+			return &pixels[0];
+		}
+
+		void Strip::Fill(
+			int x,
+			int y,
+			int width,
+			int height,
+			Color color)
+		{
+			int left = std::max(x, 0);
+			int right = std::min(x + width, this->width);
+			int top = std::max(y, 0);
+			int bottom = std::min(y + height, this->height);
+			if ((left >= right) || (top >= bottom))
+			{
+				return;
+			}
+			for (int row = top; row < bottom; row++)
+			{
+				Color* start = &pixels[(size_t)row * this->width];
+				std::fill(start + left, start + right, color);
+			}
+		}
+
+		uint64_t Strip::Hash() const
+		{
+			uint64_t hash = 14695981039346656037ULL;
+			for (size_t i = 0; i < pixels.size(); i++)
+			{
+				for (int shift = 0; shift < 32; shift += 8)
+				{
+					hash = (hash ^ ((pixels[i] >> shift) & 0xFF)) * 1099511628211ULL;
+				}
+			}
+			return hash;
+		}
+
+
+		//
+
+		static void AddColorRun(
+			std::vector<ColorRun>& runs,
+			int start,
+			int length,
+			Color color)
+		{
+			if (length <= 0)
+			{
+				return;
+			}
+			if (!runs.empty() && (runs.back().color == color) && (runs.back().start + runs.back().length == start))
+			{
+				runs.back().length += length;
+				return;
+			}
+			ColorRun run = { start, length, color };
+			runs.push_back(run);
+		}
+
+		void StripComposer::GetEffectiveColorRuns(
+			int length,
+			const std::vector<ColorRun>& colorRuns,
+			Color fore,
+			int selectStart,
+			int selectEndPlusOne,
+			Color selectedFore,
+			std::vector<ColorRun>& effectiveRuns)
+		{
+			// fill gaps between the given runs with the foreground color
+			std::vector<ColorRun> runs;
+			int position = 0;
+			for (size_t i = 0; i < colorRuns.size(); i++)
+			{
+				int start = std::max(colorRuns[i].start, position);
+				int end = std::min(colorRuns[i].start + colorRuns[i].length, length);
+				if (start >= end)
+				{
+					continue;
+				}
+				AddColorRun(runs, position, start - position, fore);
+				AddColorRun(runs, start, end - start, colorRuns[i].color);
+				position = end;
+			}
+			AddColorRun(runs, position, length - position, fore);
+
+			// the selection overrides
+			selectStart = std::max(std::min(selectStart, length), 0);
+			selectEndPlusOne = std::max(std::min(selectEndPlusOne, length), selectStart);
+			effectiveRuns.clear();
+			for (size_t i = 0; i < runs.size(); i++)
+			{
+				int start = runs[i].start;
+				int end = start + runs[i].length;
+				int insideStart = std::min(std::max(selectStart, start), end);
+				int insideEnd = std::max(std::min(selectEndPlusOne, end), insideStart);
+				AddColorRun(effectiveRuns, start, insideStart - start, runs[i].color);
+				AddColorRun(effectiveRuns, insideStart, insideEnd - insideStart, selectedFore);
+				AddColorRun(effectiveRuns, insideEnd, end - insideEnd, runs[i].color);
+			}
+		}
+
+		Status StripComposer::Compose(
+			Strip& strip,
+			const ITextLayout& layout,
+			IGlyphRenderer& renderer,
+			float pixelsPerDip,
+			int originX,
+			const StripColors& colors,
+			int selectStart,
+			int selectEndPlusOne,
+			const std::vector<ColorRun>& colorRuns)
+		{
+			strip.Fill(0, 0, strip.GetWidth(), strip.GetHeight(), colors.back);
+
+			if (selectStart < selectEndPlusOne)
+			{
+				std::vector<PixelSpan> spans;
+				Status status = LineMetrics::BuildRegion(layout, pixelsPerDip, 0, selectStart, selectEndPlusOne, spans);
+				if (Failed(status))
+				{
+					return status;
+				}
+				for (size_t i = 0; i < spans.size(); i++)
+				{
+					strip.Fill(originX + spans[i].x, 0, spans[i].width, strip.GetHeight(), colors.selectedBack);
+				}
+			}
+
+			std::vector<ColorRun> runs;
+			GetEffectiveColorRuns(
+				layout.GetLength(),
+				colorRuns,
+				colors.fore,
+				selectStart,
+				selectEndPlusOne,
+				colors.selectedFore,
+				runs);
+			return renderer.DrawLayout(strip, layout, pixelsPerDip, originX, runs);
+		}
+	}
+}
@@ -0,0 +1,380 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#pragma once
+
+// Platform-independent core of line layout: cluster maps and advances, the hit-testing rules that convert layout
+// positions (device-independent pixels, DIPs) to device pixels, a cache of layouts, and composition of the offscreen
+// strip a line is drawn into. Shaping and rasterization are left to implementations of ITextLayoutFactory and
+// IGlyphRenderer - DirectWrite (TextLayoutDirectWrite.h) in the product, and a deterministic stub
+// (TextLayoutStub.h) for measuring and regression testing without a display.
+//
+// The product's DirectWrite interop uses only LineMetrics, over its own per-line IDWriteTextLayout, for CharPosToX,
+// XToCharPos, BuildRegion and GetExtent. It still creates, caches and draws its layouts itself, so TextLayoutCache and
+// StripComposer are used only by TextLayoutBenchmark and TextLayoutTest for now.
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace TextEditor
+{
+	namespace LayoutCore
+	{
+		//
+
+		// Status codes share the values of HRESULT so that the DirectWrite implementation can pass its own through.
+		typedef int32_t Status;
+		const Status StatusOk = 0;
+		const Status StatusOutOfMemory = (Status)0x8007000EL; // E_OUTOFMEMORY
+		const Status StatusInvalidArgument = (Status)0x80070057L; // E_INVALIDARG
+
+		inline bool Failed(Status status)
+		{
+			return status < 0;
+		}
+
+		// 0xAARRGGBB
+		typedef uint32_t Color;
+
+
+		//
+
+		// A cluster is the smallest unit of text that is drawn and hit-tested: a character with any combining marks, a
+		// surrogate pair, or a ligature.
+		struct Cluster
+		{
+			float width; // advance in DIPs
+			uint16_t length; // UTF-16 code units
+			bool isWhitespace;
+			bool isRightToLeft;
+		};
+
+		struct HitTestMetrics
+		{
+			int textPosition;
+			int length;
+			float left; // DIPs
+			float width;
+		};
+
+		// Layout of one line of text (no wrapping). All positions are in DIPs and text positions in UTF-16 code units.
+		// Hit-testing methods follow the semantics of the corresponding methods of IDWriteTextLayout.
+		class ITextLayout
+		{
+		public:
+			virtual ~ITextLayout() {}
+
+			virtual int GetLength() const = 0;
+
+			// in logical order
+			virtual Status GetClusters(
+				std::vector<Cluster>& clusters) const = 0;
+
+			// including trailing whitespace
+			virtual Status GetWidth(
+				float* width) const = 0;
+
+			// leading (or trailing) edge of the cluster containing position
+			virtual Status HitTestTextPosition(
+				int position,
+				bool trailing,
+				float* x) const = 0;
+
+			// cluster nearest x, and which half of it x is in
+			virtual Status HitTestPoint(
+				float x,
+				bool* trailing,
+				HitTestMetrics* metrics) const = 0;
+
+			// one entry per visually contiguous run of clusters covering [position, position + length), offset by originX
+			virtual Status HitTestTextRange(
+				int position,
+				int length,
+				float originX,
+				std::vector<HitTestMetrics>& metrics) const = 0;
+		};
+
+		class ITextLayoutFactory
+		{
+		public:
+			virtual ~ITextLayoutFactory() {}
+
+			virtual Status CreateTextLayout(
+				const char16_t* text,
+				int length,
+				std::unique_ptr<ITextLayout>& layout) = 0;
+		};
+
+
+		//
+
+		// Cluster map and advances of a left-to-right line: the cluster of each code unit and the left edge of each
+		// cluster, from which the hit tests of ITextLayout are answered by lookup and binary search. Layouts that only
+		// know their clusters (e.g. the stub) delegate to this.
+		class ClusterMap
+		{
+		private:
+			std::vector<Cluster> clusters;
+			std::vector<int> clusterOfPosition; // one entry per code unit
+			std::vector<int> clusterStarts; // first code unit of each cluster, plus total length
+			std::vector<float> lefts; // left edge of each cluster, plus total width
+
+		public:
+			ClusterMap();
+
+			void Reset(
+				const std::vector<Cluster>& clusters);
+
+			int GetLength() const;
+
+			int GetClusterCount() const;
+
+			const std::vector<Cluster>& GetClusters() const;
+
+			float GetWidth() const;
+
+			int GetClusterOfPosition(
+				int position) const;
+
+			int GetClusterStart(
+				int cluster) const;
+
+			float GetClusterLeft(
+				int cluster) const;
+
+			Status HitTestTextPosition(
+				int position,
+				bool trailing,
+				float* x) const;
+
+			Status HitTestPoint(
+				float x,
+				bool* trailing,
+				HitTestMetrics* metrics) const;
+
+			Status HitTestTextRange(
+				int position,
+				int length,
+				float originX,
+				std::vector<HitTestMetrics>& metrics) const;
+		};
+
+
+		//
+
+		// horizontal extent in device pixels
+		struct PixelSpan
+		{
+			int x;
+			int width;
+		};
+
+		// Conversion of layout positions to device pixels. The rounding here is what keeps caret placement, selection
+		// highlighting and line extents consistent with each other, so every implementation goes through it.
+		class LineMetrics
+		{
+		public:
+			// round half to even, as Math.Round() does
+			static int Round(
+				float value);
+
+			static Status CharPosToX(
+				const ITextLayout& layout,
+				float pixelsPerDip,
+				int offset,
+				bool trailing,
+				int* x);
+
+			static Status XToCharPos(
+				const ITextLayout& layout,
+				float pixelsPerDip,
+				int x,
+				int* offset,
+				bool* trailing);
+
+			// spans covering [startPos, endPosPlusOne), sorted and merged (the union of the hit-test rectangles)
+			static Status BuildRegion(
+				const ITextLayout& layout,
+				float pixelsPerDip,
+				float originX,
+				int startPos,
+				int endPosPlusOne,
+				std::vector<PixelSpan>& spans);
+
+			static Status GetExtent(
+				const ITextLayout& layout,
+				float pixelsPerDip,
+				int* width);
+		};
+
+
+		//
+
+		// Layouts of recently drawn lines, keyed by text, least recently used discarded first once either limit is
+		// reached. Layouts are shared and immutable - colors are applied when a strip is composed, not to the layout.
+		class TextLayoutCache
+		{
+		private:
+			struct Entry
+			{
+				const std::u16string* text; // the key in index
+				std::shared_ptr<const ITextLayout> layout;
+			};
+
+			ITextLayoutFactory* factory; // not owned
+			size_t maxEntries;
+			size_t maxUnits;
+			size_t units;
+			std::list<Entry> entries; // most recently used first
+			std::unordered_map<std::u16string, std::list<Entry>::iterator> index;
+
+			int64_t hits;
+			int64_t misses;
+
+		public:
+			static const size_t DefaultMaxEntries = 256;
+			static const size_t DefaultMaxUnits = 256 * 1024;
+
+			TextLayoutCache(
+				ITextLayoutFactory* factory,
+				size_t maxEntries = DefaultMaxEntries,
+				size_t maxUnits = DefaultMaxUnits);
+
+			Status Get(
+				const char16_t* text,
+				int length,
+				std::shared_ptr<const ITextLayout>& layout);
+
+			void Clear();
+
+			size_t GetCount() const;
+
+			int64_t GetHits() const;
+
+			int64_t GetMisses() const;
+		};
+
+
+		//
+
+		// 32 bits per pixel offscreen strip holding one line, composed and then copied to the screen in one operation.
+		class Strip
+		{
+		private:
+			int width;
+			int height;
+			std::vector<Color> pixels;
+
+		public:
+			Strip(
+				int width,
+				int height);
+
+			void Resize(
+				int width,
+				int height);
+
+			int GetWidth() const;
+
+			int GetHeight() const;
+
+			Color GetPixel(
+				int x,
+				int y) const;
+
+			const Color* GetPixels() const;
+
+			// clipped to the strip
+			void Fill(
+				int x,
+				int y,
+				int width,
+				int height,
+				Color color);
+
+			// FNV-1a over the pixels, for comparing output across runs
+			uint64_t Hash() const;
+		};
+
+		struct ColorRun
+		{
+			int start;
+			int length;
+			Color color;
+		};
+
+		// draws the glyphs of a layout into a strip, each cluster in the color of the run covering it
+		class IGlyphRenderer
+		{
+		public:
+			virtual ~IGlyphRenderer() {}
+
+			virtual Status DrawLayout(
+				Strip& strip,
+				const ITextLayout& layout,
+				float pixelsPerDip,
+				int originX,
+				const std::vector<ColorRun>& colorRuns) = 0;
+		};
+
+		struct StripColors
+		{
+			Color fore;
+			Color back;
+			Color selectedFore;
+			Color selectedBack;
+		};
+
+		// Composition of a line strip in the order the text view draws it: background, selection highlight (the region
+		// of BuildRegion), then the text, with syntax colors overridden by the selected foreground color inside the
+		// selection.
+		class StripComposer
+		{
+		public:
+			// runs covering [0, length) in order: colorRuns (gaps in fore) with [selectStart, selectEndPlusOne) replaced
+			static void GetEffectiveColorRuns(
+				int length,
+				const std::vector<ColorRun>& colorRuns,
+				Color fore,
+				int selectStart,
+				int selectEndPlusOne,
+				Color selectedFore,
+				std::vector<ColorRun>& effectiveRuns);
+
+			// an empty selection (selectStart == selectEndPlusOne) draws no highlight
+			static Status Compose(
+				Strip& strip,
+				const ITextLayout& layout,
+				IGlyphRenderer& renderer,
+				float pixelsPerDip,
+				int originX,
+				const StripColors& colors,
+				int selectStart,
+				int selectEndPlusOne,
+				const std::vector<ColorRun>& colorRuns);
+		};
+	}
+}
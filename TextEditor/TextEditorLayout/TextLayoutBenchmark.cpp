@@ -0,0 +1,445 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+// Headless benchmark of line layout: layout creation with and without the cache, the hit-testing rules, and strip
+// composition, over the same pseudo-random lines on every run. Prints timings, and checksums of the results and a
+// hash of the composed strips which don't change unless the output does.
+//
+//     TextLayoutBenchmark [--quick] [--lines N] [--directwrite]
+//
+// --directwrite (Windows only) lays out with DirectWrite instead of the stub. Strips are still drawn by the stub
+// renderer, over DirectWrite positions, so the hash is not comparable with that of a stub run.
+//
+// A --quick run with the stub (as ctest runs it) also checks the checksums and hash against those of a known good
+// build, and fails if any differ.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "TextLayout.h"
+#include "TextLayoutStub.h"
+#ifdef _WIN32
+#include "TextLayoutDirectWrite.h"
+#pragma comment(lib, "Dwrite")
+#endif
+
+using namespace TextEditor::LayoutCore;
+
+// the word domain of StorageBenchmark, with occasional text that forms multi-unit or wide clusters
+static const char16_t* const Domain = u"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+static const char16_t* const Extras[] = { u"\u00E9", u"\u4E00", u"\U00020000", u"\U0001F468\u200D\U0001F469" };
+
+class Random
+{
+private:
+	uint64_t state;
+
+public:
+	Random(
+		uint64_t seed)
+		: state(seed)
+	{
+	}
+
+	int Next(
+		int limit)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (int)((state >> 33) % (uint64_t)limit);
+	}
+};
+
+static std::vector<std::u16string> MakeLines(
+	int count)
+{
+	Random random(1);
+	int domainLength = (int)std::char_traits<char16_t>::length(Domain);
+	std::vector<std::u16string> lines;
+	for (int i = 0; i < count; i++)
+	{
+		std::u16string line;
+		for (int j = random.Next(16); j >= 0; j--)
+		{
+			for (int k = random.Next(10); k >= 0; k--)
+			{
+				if (random.Next(50) == 0)
+				{
+					line += Extras[random.Next(sizeof(Extras) / sizeof(Extras[0]))];
+				}
+				else
+				{
+					line += Domain[random.Next(domainLength)];
+				}
+			}
+			if (j > 0)
+			{
+				line += u' ';
+			}
+		}
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+class Timer
+{
+private:
+	std::chrono::steady_clock::time_point start;
+
+public:
+	Timer()
+		: start(std::chrono::steady_clock::now())
+	{
+	}
+
+	double Milliseconds() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+};
+
+static void Report(
+	const char* name,
+	double milliseconds,
+	int64_t operations)
+{
+	printf(
+		"  %-28s%10.1f ms%12.1f ns/op\n",
+		name,
+		milliseconds,
+		operations != 0 ? milliseconds * 1e6 / operations : 0.0);
+}
+
+static bool Check(
+	Status status,
+	const char* what)
+{
+	if (Failed(status))
+	{
+		fprintf(stderr, "%s failed: 0x%08x\n", what, (unsigned int)status);
+		return false;
+	}
+	return true;
+}
+
+struct Results
+{
+	int64_t cacheMisses;
+	int64_t charPosToXChecksum;
+	int64_t xToCharPosChecksum;
+	int64_t buildRegionChecksum;
+	uint64_t stripHash;
+};
+
+// stub layout, --quick
+static const Results QuickExpected = { 2000, 33429880, 7726134, 622237, 0xba74bd03c6fc16edULL };
+
+static bool Verify(
+	const char* what,
+	uint64_t actual,
+	uint64_t expected)
+{
+	if (actual != expected)
+	{
+		fprintf(stderr, "%s is %llu, expected %llu\n", what, (unsigned long long)actual, (unsigned long long)expected);
+		return false;
+	}
+	return true;
+}
+
+int main(
+	int argc,
+	char* argv[])
+{
+	int lineCount = 20000;
+	int passes = 10;
+	bool quick = false;
+	bool directWrite = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+		{
+			lineCount = 1000;
+			passes = 2;
+			quick = true;
+		}
+		else if ((strcmp(argv[i], "--lines") == 0) && (i + 1 < argc))
+		{
+			lineCount = atoi(argv[++i]);
+			quick = false;
+		}
+		else if (strcmp(argv[i], "--directwrite") == 0)
+		{
+			directWrite = true;
+		}
+		else
+		{
+			fprintf(stderr, "usage: TextLayoutBenchmark [--quick] [--lines N] [--directwrite]\n");
+			return 2;
+		}
+	}
+	if (lineCount < 1)
+	{
+		fprintf(stderr, "--lines must be positive\n");
+		return 2;
+	}
+
+	Results results = {};
+
+	const float pixelsPerDip = 1.25f; // 120 dpi
+	const int lineHeight = 16;
+	const int visibleLines = 60;
+
+	std::unique_ptr<ITextLayoutFactory> factory;
+#ifdef _WIN32
+	if (directWrite)
+	{
+		IDWriteFactory* dwriteFactory = NULL;
+		IDWriteTextFormat* textFormat = NULL;
+		if (!Check(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), reinterpret_cast<IUnknown**>(&dwriteFactory)), "DWriteCreateFactory")
+			|| !Check(dwriteFactory->CreateTextFormat(L"Consolas", NULL, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 13.0f, L"en-us", &textFormat), "CreateTextFormat")
+			|| !Check(textFormat->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP), "SetWordWrapping"))
+		{
+			return 1;
+		}
+		factory.reset(new DirectWriteTextLayoutFactory(dwriteFactory, textFormat, (float)lineHeight));
+		textFormat->Release();
+		dwriteFactory->Release();
+	}
+#else
+	if (directWrite)
+	{
+		fprintf(stderr, "DirectWrite is only available on Windows\n");
+		return 2;
+	}
+#endif
+	if (!factory)
+	{
+		factory.reset(new StubTextLayoutFactory(6.5f));
+	}
+
+	std::vector<std::u16string> lines = MakeLines(lineCount);
+	int64_t units = 0;
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		units += lines[i].length();
+	}
+	printf(
+		"Text layout benchmark (%s): %d lines, %lld code units, %d passes\n",
+		directWrite ? "DirectWrite" : "stub",
+		lineCount,
+		(long long)units,
+		passes);
+
+	// every line, as when the document is first measured
+	std::vector<std::unique_ptr<ITextLayout>> layouts(lines.size());
+	{
+		Timer timer;
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			if (!Check(factory->CreateTextLayout(lines[i].c_str(), (int)lines[i].length(), layouts[i]), "CreateTextLayout"))
+			{
+				return 1;
+			}
+		}
+		Report("CreateTextLayout", timer.Milliseconds(), (int64_t)lines.size());
+	}
+
+	// a screenful redrawn while scrolling through the document a few lines at a time
+	{
+		TextLayoutCache cache(factory.get());
+		std::shared_ptr<const ITextLayout> layout;
+		int64_t operations = 0;
+		Timer timer;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (int top = 0; top < lineCount; top += 7)
+			{
+				int end = top + visibleLines < lineCount ? top + visibleLines : lineCount;
+				for (int i = top; i < end; i++)
+				{
+					if (!Check(cache.Get(lines[i].c_str(), (int)lines[i].length(), layout), "TextLayoutCache::Get"))
+					{
+						return 1;
+					}
+					operations++;
+				}
+			}
+		}
+		Report("TextLayoutCache::Get", timer.Milliseconds(), operations);
+		printf(
+			"    hits %lld, misses %lld\n",
+			(long long)cache.GetHits(),
+			(long long)cache.GetMisses());
+		results.cacheMisses = cache.GetMisses();
+	}
+
+	// caret placed at every position
+	{
+		int64_t operations = 0;
+		int64_t sum = 0;
+		Timer timer;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (size_t i = 0; i < layouts.size(); i++)
+			{
+				for (int position = 0; position <= layouts[i]->GetLength(); position++)
+				{
+					int x;
+					if (!Check(LineMetrics::CharPosToX(*layouts[i], pixelsPerDip, position, false, &x), "CharPosToX"))
+					{
+						return 1;
+					}
+					sum += x;
+					operations++;
+				}
+			}
+		}
+		Report("CharPosToX", timer.Milliseconds(), operations);
+		printf("    checksum %lld\n", (long long)sum);
+		results.charPosToXChecksum = sum;
+	}
+
+	// mouse at every pixel of every fourth line
+	{
+		int64_t operations = 0;
+		int64_t sum = 0;
+		Timer timer;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (size_t i = 0; i < layouts.size(); i += 4)
+			{
+				int width;
+				if (!Check(LineMetrics::GetExtent(*layouts[i], pixelsPerDip, &width), "GetExtent"))
+				{
+					return 1;
+				}
+				for (int x = 0; x <= width; x++)
+				{
+					int offset;
+					bool trailing;
+					if (!Check(LineMetrics::XToCharPos(*layouts[i], pixelsPerDip, x, &offset, &trailing), "XToCharPos"))
+					{
+						return 1;
+					}
+					sum += offset;
+					operations++;
+				}
+			}
+		}
+		Report("XToCharPos", timer.Milliseconds(), operations);
+		printf("    checksum %lld\n", (long long)sum);
+		results.xToCharPosChecksum = sum;
+	}
+
+	// selection of a random range of each line
+	{
+		Random random(2);
+		std::vector<PixelSpan> spans;
+		int64_t operations = 0;
+		int64_t sum = 0;
+		Timer timer;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (size_t i = 0; i < layouts.size(); i++)
+			{
+				int length = layouts[i]->GetLength();
+				int start = random.Next(length + 1);
+				int end = start + random.Next(length - start + 1);
+				if (!Check(LineMetrics::BuildRegion(*layouts[i], pixelsPerDip, 0, start, end, spans), "BuildRegion"))
+				{
+					return 1;
+				}
+				for (size_t j = 0; j < spans.size(); j++)
+				{
+					sum += spans[j].x + spans[j].width;
+				}
+				operations++;
+			}
+		}
+		Report("BuildRegion", timer.Milliseconds(), operations);
+		printf("    checksum %lld\n", (long long)sum);
+		results.buildRegionChecksum = sum;
+	}
+
+	// the strip of every line, with syntax colors, and a selection on some
+	{
+		Random random(3);
+		StubGlyphRenderer renderer;
+		StripColors colors = { 0xFF000000, 0xFFFFFFFF, 0xFFFFFFFF, 0xFF3399FF };
+		Strip strip(1280, lineHeight);
+		std::vector<ColorRun> runs;
+		uint64_t hash = 14695981039346656037ULL;
+		int64_t operations = 0;
+		Timer timer;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (size_t i = 0; i < layouts.size(); i++)
+			{
+				int length = layouts[i]->GetLength();
+				runs.clear();
+				for (int position = random.Next(8); position < length; position += 4 + random.Next(8))
+				{
+					ColorRun run = { position, 1 + random.Next(4), 0xFF000080u + (uint32_t)random.Next(128) };
+					runs.push_back(run);
+				}
+				int selectStart = 0;
+				int selectEndPlusOne = 0;
+				if (random.Next(4) == 0)
+				{
+					selectStart = random.Next(length + 1);
+					selectEndPlusOne = selectStart + random.Next(length - selectStart + 1);
+				}
+				if (!Check(StripComposer::Compose(strip, *layouts[i], renderer, pixelsPerDip, 2, colors, selectStart, selectEndPlusOne, runs), "Compose"))
+				{
+					return 1;
+				}
+				if (pass == 0)
+				{
+					hash = (hash ^ strip.Hash()) * 1099511628211ULL;
+				}
+				operations++;
+			}
+		}
+		Report("StripComposer::Compose", timer.Milliseconds(), operations);
+		printf("    strip hash %016llx\n", (unsigned long long)hash);
+		results.stripHash = hash;
+	}
+
+	if (quick && !directWrite)
+	{
+		bool ok = Verify("cache misses", results.cacheMisses, QuickExpected.cacheMisses);
+		ok = Verify("CharPosToX checksum", results.charPosToXChecksum, QuickExpected.charPosToXChecksum) && ok;
+		ok = Verify("XToCharPos checksum", results.xToCharPosChecksum, QuickExpected.xToCharPosChecksum) && ok;
+		ok = Verify("BuildRegion checksum", results.buildRegionChecksum, QuickExpected.buildRegionChecksum) && ok;
+		ok = Verify("strip hash", results.stripHash, QuickExpected.stripHash) && ok;
+		if (!ok)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include "TextLayoutDirectWrite.h"
+
+namespace TextEditor
+{
+	namespace LayoutCore
+	{
+		static_assert(sizeof(char16_t) == sizeof(WCHAR), "UTF-16 text is passed to DirectWrite as WCHAR");
+
+
+		//
+
+		DirectWriteTextLayout::DirectWriteTextLayout(
+			IDWriteTextLayout* textLayout,
+			int length)
+			: textLayout(textLayout), length(length)
+		{
+			textLayout->AddRef();
+		}
+
+		DirectWriteTextLayout::~DirectWriteTextLayout()
+		{
+			textLayout->Release();
+		}
+
+		IDWriteTextLayout* DirectWriteTextLayout::GetTextLayout() const
+		{
+			return textLayout;
+		}
+
+		int DirectWriteTextLayout::GetLength() const
+		{
+			return length;
+		}
+
+		Status DirectWriteTextLayout::GetClusters(
+			std::vector<Cluster>& clusters) const
+		{
+			HRESULT hr;
+
+			clusters.clear();
+
+			UINT32 count = 0;
+			hr = textLayout->GetClusterMetrics(NULL, 0, &count);
+			if ((hr != E_NOT_SUFFICIENT_BUFFER) && FAILED(hr))
+			{
+				return hr;
+			}
+			if (count == 0)
+			{
+				return S_OK;
+			}
+
+			std::vector<DWRITE_CLUSTER_METRICS> metrics(count);
+			hr = textLayout->GetClusterMetrics(&metrics[0], count, &count);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+
+			clusters.resize(count);
+			for (UINT32 i = 0; i < count; i++)
+			{
+				clusters[i].width = metrics[i].width;
+				clusters[i].length = metrics[i].length;
+				clusters[i].isWhitespace = metrics[i].isWhitespace != 0;
+				clusters[i].isRightToLeft = metrics[i].isRightToLeft != 0;
+			}
+			return S_OK;
+		}
+
+		Status DirectWriteTextLayout::GetWidth(
+			float* width) const
+		{
+			HRESULT hr;
+
+			DWRITE_TEXT_METRICS metrics;
+			hr = textLayout->GetMetrics(&metrics);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+
+			*width = metrics.widthIncludingTrailingWhitespace;
+			return S_OK;
+		}
+
+		Status DirectWriteTextLayout::HitTestTextPosition(
+			int position,
+			bool trailing,
+			float* x) const
+		{
+			HRESULT hr;
+
+			FLOAT x1, y1;
+			DWRITE_HIT_TEST_METRICS metrics;
+			hr = textLayout->HitTestTextPosition(
+				position,
+				trailing,
+				&x1,
+				&y1,
+				&metrics);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+
+			*x = x1;
+			return S_OK;
+		}
+
+		Status DirectWriteTextLayout::HitTestPoint(
+			float x,
+			bool* trailing,
+			HitTestMetrics* metrics) const
+		{
+			HRESULT hr;
+
+			BOOL inside, trailing1;
+			DWRITE_HIT_TEST_METRICS metric;
+			hr = textLayout->HitTestPoint(
+				x,
+				(float)0,
+				&trailing1,
+				&inside,
+				&metric);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+
+			*trailing = trailing1 != 0;
+			metrics->textPosition = (int)metric.textPosition;
+			metrics->length = (int)metric.length;
+			metrics->left = metric.left;
+			metrics->width = metric.width;
+			return S_OK;
+		}
+
+		Status DirectWriteTextLayout::HitTestTextRange(
+			int position,
+			int length,
+			float originX,
+			std::vector<HitTestMetrics>& metrics) const
+		{
+			HRESULT hr;
+
+			metrics.clear();
+
+			std::vector<DWRITE_HIT_TEST_METRICS> metrics1(8);
+			UINT32 count;
+			while (true)
+			{
+				hr = textLayout->HitTestTextRange(
+					position,
+					length,
+					originX,
+					(float)0,
+					&metrics1[0],
+					(UINT32)metrics1.size(),
+					&count);
+				if (hr == E_NOT_SUFFICIENT_BUFFER)
+				{
+					metrics1.resize(metrics1.size() * 2);
+					continue;
+				}
+				if (FAILED(hr))
+				{
+					return hr;
+				}
+				break;
+			}
+
+			metrics.resize(count);
+			for (UINT32 i = 0; i < count; i++)
+			{
+				metrics[i].textPosition = (int)metrics1[i].textPosition;
+				metrics[i].length = (int)metrics1[i].length;
+				metrics[i].left = metrics1[i].left;
+				metrics[i].width = metrics1[i].width;
+			}
+			return S_OK;
+		}
+
+
+		//
+
+		DirectWriteTextLayoutFactory::DirectWriteTextLayoutFactory(
+			IDWriteFactory* factory,
+			IDWriteTextFormat* textFormat,
+			float lineHeight)
+			: factory(factory), textFormat(textFormat), lineHeight(lineHeight)
+		{
+			factory->AddRef();
+			textFormat->AddRef();
+		}
+
+		DirectWriteTextLayoutFactory::~DirectWriteTextLayoutFactory()
+		{
+			textFormat->Release();
+			factory->Release();
+		}
+
+		Status DirectWriteTextLayoutFactory::CreateTextLayout(
+			const char16_t* text,
+			int length,
+			std::unique_ptr<ITextLayout>& layout)
+		{
+			HRESULT hr;
+
+			IDWriteTextLayout* textLayout = NULL;
+			hr = factory->CreateTextLayout(
+				reinterpret_cast<const WCHAR*>(text),
+				length,
+				textFormat,
+				(float)50, // layout width - shouldn't matter with DWRITE_WORD_WRAPPING_NO_WRAP specified
+				lineHeight,
+				&textLayout);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+
+			layout.reset(new DirectWriteTextLayout(textLayout, length));
+			textLayout->Release(); // DirectWriteTextLayout holds its own reference
+			return S_OK;
+		}
+	}
+}
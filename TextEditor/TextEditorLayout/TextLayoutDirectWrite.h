@@ -0,0 +1,107 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#pragma once
+
+#include <windows.h>
+#include <dwrite.h>
+
+#include "TextLayout.h"
+
+namespace TextEditor
+{
+	namespace LayoutCore
+	{
+		//
+
+		// ITextLayout over a DirectWrite text layout. Holds its own reference to the layout, so can be constructed
+		// around one owned by someone else (e.g. TextServiceLineDirectWriteInterop) for the duration of a call.
+		class DirectWriteTextLayout : public ITextLayout
+		{
+		private:
+			IDWriteTextLayout* textLayout;
+			int length;
+
+		public:
+			DirectWriteTextLayout(
+				IDWriteTextLayout* textLayout,
+				int length);
+
+			~DirectWriteTextLayout();
+
+			DirectWriteTextLayout(const DirectWriteTextLayout&) = delete;
+			DirectWriteTextLayout& operator=(const DirectWriteTextLayout&) = delete;
+
+			IDWriteTextLayout* GetTextLayout() const;
+
+			int GetLength() const override;
+
+			Status GetClusters(
+				std::vector<Cluster>& clusters) const override;
+
+			Status GetWidth(
+				float* width) const override;
+
+			Status HitTestTextPosition(
+				int position,
+				bool trailing,
+				float* x) const override;
+
+			Status HitTestPoint(
+				float x,
+				bool* trailing,
+				HitTestMetrics* metrics) const override;
+
+			Status HitTestTextRange(
+				int position,
+				int length,
+				float originX,
+				std::vector<HitTestMetrics>& metrics) const override;
+		};
+
+		// Creates single-line layouts in a text format prepared as TextServiceDirectWriteInterop::Reset() does (no word
+		// wrapping, uniform line spacing). Used by TextLayoutBenchmark --directwrite - the interop creates its own.
+		class DirectWriteTextLayoutFactory : public ITextLayoutFactory
+		{
+		private:
+			IDWriteFactory* factory;
+			IDWriteTextFormat* textFormat;
+			float lineHeight;
+
+		public:
+			DirectWriteTextLayoutFactory(
+				IDWriteFactory* factory,
+				IDWriteTextFormat* textFormat,
+				float lineHeight);
+
+			~DirectWriteTextLayoutFactory();
+
+			DirectWriteTextLayoutFactory(const DirectWriteTextLayoutFactory&) = delete;
+			DirectWriteTextLayoutFactory& operator=(const DirectWriteTextLayoutFactory&) = delete;
+
+			Status CreateTextLayout(
+				const char16_t* text,
+				int length,
+				std::unique_ptr<ITextLayout>& layout) override;
+		};
+	}
+}
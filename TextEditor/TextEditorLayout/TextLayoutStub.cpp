@@ -0,0 +1,243 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include "TextLayoutStub.h"
+
+namespace TextEditor
+{
+	namespace LayoutCore
+	{
+		//
+
+		StubTextLayout::StubTextLayout(
+			const std::vector<Cluster>& clusters)
+		{
+			map.Reset(clusters);
+		}
+
+		int StubTextLayout::GetLength() const
+		{
+			return map.GetLength();
+		}
+
+		Status StubTextLayout::GetClusters(
+			std::vector<Cluster>& clusters) const
+		{
+			clusters = map.GetClusters();
+			return StatusOk;
+		}
+
+		Status StubTextLayout::GetWidth(
+			float* width) const
+		{
+			*width = map.GetWidth();
+			return StatusOk;
+		}
+
+		Status StubTextLayout::HitTestTextPosition(
+			int position,
+			bool trailing,
+			float* x) const
+		{
+			return map.HitTestTextPosition(position, trailing, x);
+		}
+
+		Status StubTextLayout::HitTestPoint(
+			float x,
+			bool* trailing,
+			HitTestMetrics* metrics) const
+		{
+			return map.HitTestPoint(x, trailing, metrics);
+		}
+
+		Status StubTextLayout::HitTestTextRange(
+			int position,
+			int length,
+			float originX,
+			std::vector<HitTestMetrics>& metrics) const
+		{
+			return map.HitTestTextRange(position, length, originX, metrics);
+		}
+
+
+		//
+
+		StubTextLayoutFactory::StubTextLayoutFactory(
+			float advance)
+			: advance(advance)
+		{
+		}
+
+		Status StubTextLayoutFactory::CreateTextLayout(
+			const char16_t* text,
+			int length,
+			std::unique_ptr<ITextLayout>& layout)
+		{
+			if (length < 0)
+			{
+				return StatusInvalidArgument;
+			}
+
+			std::vector<Cluster> clusters;
+			GetClusters(text, length, advance, clusters);
+			layout.reset(new StubTextLayout(clusters));
+			return StatusOk;
+		}
+
+		// code point at i, advancing i past it - an unpaired surrogate stands for itself
+		static uint32_t NextCodePoint(
+			const char16_t* text,
+			int length,
+			int& i)
+		{
+			uint32_t c = text[i++];
+			if ((c >= 0xD800) && (c <= 0xDBFF) && (i < length) && (text[i] >= 0xDC00) && (text[i] <= 0xDFFF))
+			{
+				c = 0x10000 + ((c - 0xD800) << 10) + (text[i++] - 0xDC00);
+			}
+			return c;
+		}
+
+		static bool IsCombiningMark(
+			uint32_t c)
+		{
+			return ((c >= 0x0300) && (c <= 0x036F))
+				|| ((c >= 0x1AB0) && (c <= 0x1AFF))
+				|| ((c >= 0x1DC0) && (c <= 0x1DFF))
+				|| ((c >= 0x20D0) && (c <= 0x20FF))
+				|| ((c >= 0xFE00) && (c <= 0xFE0F)) // variation selectors
+				|| ((c >= 0xFE20) && (c <= 0xFE2F));
+		}
+
+		static bool IsWide(
+			uint32_t c)
+		{
+			return ((c >= 0x1100) && (c <= 0x115F))
+				|| ((c >= 0x2E80) && (c <= 0xA4CF))
+				|| ((c >= 0xAC00) && (c <= 0xD7A3))
+				|| ((c >= 0xF900) && (c <= 0xFAFF))
+				|| ((c >= 0xFF00) && (c <= 0xFF60))
+				|| ((c >= 0xFFE0) && (c <= 0xFFE6))
+				|| ((c >= 0x1F300) && (c <= 0x1F64F))
+				|| ((c >= 0x20000) && (c <= 0x3FFFD));
+		}
+
+		static bool IsWhitespace(
+			uint32_t c)
+		{
+			return (c == ' ') || (c == '\t') || (c == 0x00A0) || (c == 0x3000);
+		}
+
+		void StubTextLayoutFactory::GetClusters(
+			const char16_t* text,
+			int length,
+			float advance,
+			std::vector<Cluster>& clusters)
+		{
+			const int ZeroWidthJoiner = 0x200D;
+			const int MaxClusterLength = 0xFFFF - 3; // room for a joiner and a surrogate pair
+
+			clusters.clear();
+			int i = 0;
+			while (i < length)
+			{
+				int start = i;
+				uint32_t c = NextCodePoint(text, length, i);
+				Cluster cluster;
+				cluster.width = IsWide(c) ? 2 * advance : advance;
+				cluster.isWhitespace = IsWhitespace(c);
+				cluster.isRightToLeft = false;
+
+				while ((i < length) && (i - start <= MaxClusterLength))
+				{
+					int j = i;
+					uint32_t next = NextCodePoint(text, length, j);
+					if (IsCombiningMark(next))
+					{
+						i = j;
+					}
+					else if (next == ZeroWidthJoiner)
+					{
+						i = j;
+						if (i < length)
+						{
+							NextCodePoint(text, length, i);
+						}
+						cluster.isWhitespace = false;
+					}
+					else
+					{
+						break;
+					}
+				}
+
+				cluster.length = (uint16_t)(i - start);
+				clusters.push_back(cluster);
+			}
+		}
+
+
+		//
+
+		Status StubGlyphRenderer::DrawLayout(
+			Strip& strip,
+			const ITextLayout& layout,
+			float pixelsPerDip,
+			int originX,
+			const std::vector<ColorRun>& colorRuns)
+		{
+			std::vector<Cluster> clusters;
+			Status status = layout.GetClusters(clusters);
+			if (Failed(status))
+			{
+				return status;
+			}
+
+			int inset = strip.GetHeight() / 4;
+			size_t run = 0;
+			int position = 0;
+			float left = 0;
+			for (size_t i = 0; i < clusters.size(); i++)
+			{
+				float right = left + clusters[i].width;
+				if (!clusters[i].isWhitespace)
+				{
+					// a cluster takes the color of the run containing its first code unit
+					while ((run < colorRuns.size()) && (colorRuns[run].start + colorRuns[run].length <= position))
+					{
+						run++;
+					}
+					if ((run < colorRuns.size()) && (colorRuns[run].start <= position))
+					{
+						// rounding must match LineMetrics::BuildRegion()
+						int x = LineMetrics::Round(left * pixelsPerDip);
+						int width = LineMetrics::Round(right * pixelsPerDip) - x;
+						strip.Fill(originX + x + 1, inset, width - 2, strip.GetHeight() - 2 * inset, colorRuns[run].color);
+					}
+				}
+				position += clusters[i].length;
+				left = right;
+			}
+			return StatusOk;
+		}
+	}
+}
@@ -0,0 +1,104 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#pragma once
+
+#include "TextLayout.h"
+
+namespace TextEditor
+{
+	namespace LayoutCore
+	{
+		//
+
+		// Deterministic stand-in for a shaping engine, for benchmarks and regression tests: every cluster is one
+		// advance wide (two for East Asian wide characters), combining marks and zero-width-joiner sequences join the
+		// preceding cluster, surrogate pairs form one cluster, and text is laid out left to right.
+		class StubTextLayout : public ITextLayout
+		{
+		private:
+			ClusterMap map;
+
+		public:
+			StubTextLayout(
+				const std::vector<Cluster>& clusters);
+
+			int GetLength() const override;
+
+			Status GetClusters(
+				std::vector<Cluster>& clusters) const override;
+
+			Status GetWidth(
+				float* width) const override;
+
+			Status HitTestTextPosition(
+				int position,
+				bool trailing,
+				float* x) const override;
+
+			Status HitTestPoint(
+				float x,
+				bool* trailing,
+				HitTestMetrics* metrics) const override;
+
+			Status HitTestTextRange(
+				int position,
+				int length,
+				float originX,
+				std::vector<HitTestMetrics>& metrics) const override;
+		};
+
+		class StubTextLayoutFactory : public ITextLayoutFactory
+		{
+		private:
+			float advance; // DIPs
+
+		public:
+			StubTextLayoutFactory(
+				float advance);
+
+			Status CreateTextLayout(
+				const char16_t* text,
+				int length,
+				std::unique_ptr<ITextLayout>& layout) override;
+
+			static void GetClusters(
+				const char16_t* text,
+				int length,
+				float advance,
+				std::vector<Cluster>& clusters);
+		};
+
+		// draws each cluster other than whitespace as a solid box, inset by a pixel at the sides and a quarter of the
+		// strip height at the top and bottom
+		class StubGlyphRenderer : public IGlyphRenderer
+		{
+		public:
+			Status DrawLayout(
+				Strip& strip,
+				const ITextLayout& layout,
+				float pixelsPerDip,
+				int originX,
+				const std::vector<ColorRun>& colorRuns) override;
+		};
+	}
+}
@@ -0,0 +1,248 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+// Regression test of the platform-independent layout rules, run against the stub implementation.
+
+#include <cstdio>
+#include <string>
+
+#include "TextLayout.h"
+#include "TextLayoutStub.h"
+
+using namespace TextEditor::LayoutCore;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (false)
+
+static std::unique_ptr<ITextLayout> MakeLayout(
+	const std::u16string& text,
+	float advance)
+{
+	StubTextLayoutFactory factory(advance);
+	std::unique_ptr<ITextLayout> layout;
+	Status status = factory.CreateTextLayout(text.c_str(), (int)text.length(), layout);
+	CHECK(!Failed(status));
+	return layout;
+}
+
+static void TestClusters()
+{
+	// e with combining acute, supplementary ideograph (wide), CJK (wide), two emoji joined by ZWJ, space
+	std::u16string text = u"ae\u0301\U00020000\u4E00\U0001F468\u200D\U0001F469 ";
+	std::vector<Cluster> clusters;
+	StubTextLayoutFactory::GetClusters(text.c_str(), (int)text.length(), 7, clusters);
+	CHECK(clusters.size() == 6);
+	CHECK((clusters[0].length == 1) && (clusters[0].width == 7));
+	CHECK((clusters[1].length == 2) && (clusters[1].width == 7));
+	CHECK((clusters[2].length == 2) && (clusters[2].width == 14));
+	CHECK((clusters[3].length == 1) && (clusters[3].width == 14));
+	CHECK((clusters[4].length == 5) && (clusters[4].width == 14) && !clusters[4].isWhitespace);
+	CHECK((clusters[5].length == 1) && clusters[5].isWhitespace);
+
+	ClusterMap map;
+	map.Reset(clusters);
+	CHECK(map.GetLength() == (int)text.length());
+	CHECK(map.GetWidth() == 7 + 7 + 14 + 14 + 14 + 7);
+	CHECK(map.GetClusterOfPosition(2) == 1);
+	CHECK(map.GetClusterOfPosition(4) == 2);
+	CHECK(map.GetClusterOfPosition((int)text.length()) == 6);
+	CHECK(map.GetClusterStart(4) == 6);
+	CHECK(map.GetClusterLeft(4) == 42);
+
+	// unpaired surrogates are clusters of their own
+	std::u16string unpaired = u"a";
+	unpaired += (char16_t)0xD800;
+	unpaired += u"b";
+	StubTextLayoutFactory::GetClusters(unpaired.c_str(), (int)unpaired.length(), 7, clusters);
+	CHECK((clusters.size() == 3) && (clusters[1].length == 1));
+}
+
+static void TestRound()
+{
+	// half to even, as Math.Round()
+	CHECK(LineMetrics::Round(0.5f) == 0);
+	CHECK(LineMetrics::Round(1.5f) == 2);
+	CHECK(LineMetrics::Round(2.5f) == 2);
+	CHECK(LineMetrics::Round(2.5001f) == 3);
+	CHECK(LineMetrics::Round(-0.5f) == 0);
+	CHECK(LineMetrics::Round(-1.5f) == -2);
+	CHECK(LineMetrics::Round(-1.6f) == -2);
+	CHECK(LineMetrics::Round(3.49f) == 3);
+}
+
+static void TestHitTesting()
+{
+	// at 1.25 pixels per DIP (120 dpi), advances of 6 DIPs put cluster edges on 7.5 pixel steps, where the rounding
+	// rule decides
+	std::unique_ptr<ITextLayout> layout = MakeLayout(u"abcde\u0301f", 6);
+	const float pixelsPerDip = 1.25f;
+
+	int x;
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 0, false, &x)) && (x == 0));
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 1, false, &x)) && (x == 8)); // 7.5
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 0, true, &x)) && (x == 8));
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 3, false, &x)) && (x == 22)); // 22.5
+	// inside a cluster is its leading edge, or trailing edge if trailing
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 5, false, &x)) && (x == 30));
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 5, true, &x)) && (x == 38)); // 37.5
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 6, false, &x)) && (x == 38));
+	CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 7, false, &x)) && (x == 45));
+	CHECK(Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, 8, false, &x)));
+
+	int width;
+	CHECK(!Failed(LineMetrics::GetExtent(*layout, pixelsPerDip, &width)) && (width == 45));
+
+	int offset;
+	bool trailing;
+	CHECK(!Failed(LineMetrics::XToCharPos(*layout, pixelsPerDip, -5, &offset, &trailing)) && (offset == 0) && !trailing);
+	CHECK(!Failed(LineMetrics::XToCharPos(*layout, pixelsPerDip, 3, &offset, &trailing)) && (offset == 0) && !trailing);
+	CHECK(!Failed(LineMetrics::XToCharPos(*layout, pixelsPerDip, 4, &offset, &trailing)) && (offset == 1) && trailing);
+	CHECK(!Failed(LineMetrics::XToCharPos(*layout, pixelsPerDip, 31, &offset, &trailing)) && (offset == 4) && !trailing);
+	CHECK(!Failed(LineMetrics::XToCharPos(*layout, pixelsPerDip, 35, &offset, &trailing)) && (offset == 6) && trailing);
+	CHECK(!Failed(LineMetrics::XToCharPos(*layout, pixelsPerDip, 100, &offset, &trailing)) && (offset == 7) && trailing);
+
+	std::vector<PixelSpan> spans;
+	CHECK(!Failed(LineMetrics::BuildRegion(*layout, pixelsPerDip, 0, 1, 3, spans)));
+	CHECK((spans.size() == 1) && (spans[0].x == 8) && (spans[0].width == 14)); // [7.5, 22.5) - edges as CharPosToX()
+	CHECK(!Failed(LineMetrics::BuildRegion(*layout, pixelsPerDip, 0, 5, 6, spans)));
+	CHECK((spans.size() == 1) && (spans[0].x == 30) && (spans[0].width == 8)); // part of a cluster selects all of it
+	CHECK(!Failed(LineMetrics::BuildRegion(*layout, pixelsPerDip, 0, 2, 2, spans)));
+	CHECK(spans.empty());
+
+	// region edges agree with caret positions everywhere
+	for (int start = 0; start < layout->GetLength(); start++)
+	{
+		for (int end = start + 1; end <= layout->GetLength(); end++)
+		{
+			int left, right;
+			CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, start, false, &left)));
+			CHECK(!Failed(LineMetrics::CharPosToX(*layout, pixelsPerDip, end - 1, true, &right)));
+			CHECK(!Failed(LineMetrics::BuildRegion(*layout, pixelsPerDip, 0, start, end, spans)));
+			CHECK((spans.size() == 1) && (spans[0].x == left) && (spans[0].x + spans[0].width == right));
+		}
+	}
+
+	std::unique_ptr<ITextLayout> empty = MakeLayout(u"", 6);
+	CHECK(!Failed(LineMetrics::CharPosToX(*empty, pixelsPerDip, 0, false, &x)) && (x == 0));
+	CHECK(!Failed(LineMetrics::XToCharPos(*empty, pixelsPerDip, 10, &offset, &trailing)) && (offset == 0));
+	CHECK(!Failed(LineMetrics::GetExtent(*empty, pixelsPerDip, &width)) && (width == 0));
+}
+
+static void TestCache()
+{
+	StubTextLayoutFactory factory(7);
+	TextLayoutCache cache(&factory, 2, 1000);
+	std::shared_ptr<const ITextLayout> a1, a2, b, c;
+	CHECK(!Failed(cache.Get(u"alpha", 5, a1)));
+	CHECK(!Failed(cache.Get(u"beta", 4, b)));
+	CHECK(!Failed(cache.Get(u"alpha", 5, a2)));
+	CHECK((a1 == a2) && (cache.GetHits() == 1) && (cache.GetMisses() == 2));
+	CHECK(!Failed(cache.Get(u"gamma", 5, c))); // evicts beta, the least recently used
+	CHECK(cache.GetCount() == 2);
+	CHECK(!Failed(cache.Get(u"alpha", 5, a2)) && (a1 == a2));
+	std::shared_ptr<const ITextLayout> b2;
+	CHECK(!Failed(cache.Get(u"beta", 4, b2)) && (b2 != b) && (cache.GetMisses() == 4));
+	CHECK(b->GetLength() == 4); // an evicted layout remains usable by its holders
+
+	TextLayoutCache small(&factory, 100, 8);
+	CHECK(!Failed(small.Get(u"abcdef", 6, a1)));
+	CHECK(!Failed(small.Get(u"ghijkl", 6, b)));
+	CHECK(small.GetCount() == 1); // unit budget
+	CHECK(!Failed(small.Get(u"0123456789", 10, c)));
+	CHECK(small.GetCount() == 1); // larger than the budget, but kept
+
+	cache.Clear();
+	CHECK(cache.GetCount() == 0);
+}
+
+static void TestColorRuns()
+{
+	const Color fore = 1, selectedFore = 2, red = 3, blue = 4;
+	std::vector<ColorRun> runs;
+	runs.push_back(ColorRun { 2, 3, red });
+	runs.push_back(ColorRun { 8, 4, blue }); // extends past the end
+	std::vector<ColorRun> effective;
+	StripComposer::GetEffectiveColorRuns(10, runs, fore, 4, 9, selectedFore, effective);
+	CHECK(effective.size() == 4);
+	CHECK((effective[0].start == 0) && (effective[0].length == 2) && (effective[0].color == fore));
+	CHECK((effective[1].start == 2) && (effective[1].length == 2) && (effective[1].color == red));
+	CHECK((effective[2].start == 4) && (effective[2].length == 5) && (effective[2].color == selectedFore));
+	CHECK((effective[3].start == 9) && (effective[3].length == 1) && (effective[3].color == blue));
+
+	StripComposer::GetEffectiveColorRuns(6, std::vector<ColorRun>(), fore, 3, 3, selectedFore, effective);
+	CHECK((effective.size() == 1) && (effective[0].length == 6) && (effective[0].color == fore));
+}
+
+static void TestCompose()
+{
+	StripColors colors = { 0xFF000000, 0xFFFFFFFF, 0xFFFFFFFF, 0xFF3399FF };
+	std::unique_ptr<ITextLayout> layout = MakeLayout(u"ab cd", 8);
+	StubGlyphRenderer renderer;
+	Strip strip(60, 16);
+	std::vector<ColorRun> runs;
+	runs.push_back(ColorRun { 3, 1, 0xFFFF0000 });
+	CHECK(!Failed(StripComposer::Compose(strip, *layout, renderer, 1, 4, colors, 1, 2, runs)));
+
+	CHECK(strip.GetPixel(0, 0) == colors.back);
+	CHECK(strip.GetPixel(4 + 4, 8) == colors.fore); // 'a'
+	CHECK(strip.GetPixel(4 + 8, 0) == colors.selectedBack); // the highlight is the height of the strip
+	CHECK(strip.GetPixel(4 + 12, 8) == colors.selectedFore); // 'b'
+	CHECK(strip.GetPixel(4 + 20, 8) == colors.back); // space
+	CHECK(strip.GetPixel(4 + 28, 8) == 0xFFFF0000); // 'c'
+	CHECK(strip.GetPixel(4 + 28, 2) == colors.back); // above the glyph box
+	CHECK(strip.GetPixel(4 + 36, 8) == colors.fore); // 'd'
+	CHECK(strip.GetPixel(59, 8) == colors.back);
+
+	uint64_t hash = strip.Hash();
+	Strip strip2(60, 16);
+	CHECK(!Failed(StripComposer::Compose(strip2, *layout, renderer, 1, 4, colors, 1, 2, runs)));
+	CHECK(strip2.Hash() == hash);
+	CHECK(!Failed(StripComposer::Compose(strip2, *layout, renderer, 1, 4, colors, 1, 3, runs)));
+	CHECK(strip2.Hash() != hash);
+}
+
+int main()
+{
+	TestClusters();
+	TestRound();
+	TestHitTesting();
+	TestCache();
+	TestColorRuns();
+	TestCompose();
+
+	if (failures != 0)
+	{
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
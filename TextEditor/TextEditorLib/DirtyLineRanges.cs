@@ -0,0 +1,82 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+
+namespace TextEditor
+{
+    // Set of lines awaiting redraw, kept as sorted, disjoint, non-adjacent inclusive ranges. Invalidations accumulate
+    // here between frames, so a line invalidated repeatedly in the meantime is drawn only once.
+    public class DirtyLineRanges
+    {
+        private readonly List<int> starts = new List<int>();
+        private readonly List<int> ends = new List<int>();
+
+        public int Count { get { return starts.Count; } }
+
+        public void Get(int index, out int startLine, out int endLine)
+        {
+            startLine = starts[index];
+            endLine = ends[index];
+        }
+
+        // add [startLine, endLine], merging with any ranges it overlaps or abuts - empty ranges are ignored
+        public void Add(int startLine, int endLine)
+        {
+            if (startLine > endLine)
+            {
+                return;
+            }
+
+            int i = 0;
+            while ((i < starts.Count) && (ends[i] < startLine - 1))
+            {
+                i++;
+            }
+            int j = i;
+            while ((j < starts.Count) && (starts[j] <= endLine + 1))
+            {
+                startLine = Math.Min(startLine, starts[j]);
+                endLine = Math.Max(endLine, ends[j]);
+                j++;
+            }
+            starts.RemoveRange(i, j - i);
+            ends.RemoveRange(i, j - i);
+            starts.Insert(i, startLine);
+            ends.Insert(i, endLine);
+
+#if DEBUG
+            for (int k = 1; k < starts.Count; k++)
+            {
+                Debug.Assert(ends[k - 1] + 1 < starts[k]);
+            }
+#endif
+        }
+
+        public void Clear()
+        {
+            starts.Clear();
+            ends.Clear();
+        }
+    }
+}
@@ -0,0 +1,332 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+
+namespace TextEditor
+{
+    public struct SniffResult
+    {
+        public Utf8Transcoding.Form form;
+        public int bomLength;
+        public bool validUtf8; // no invalid UTF-8 seen in samples (only meaningful for byte forms)
+        public bool ascii; // no bytes above 0x7F seen in samples
+        public bool binary; // samples contain NUL or a high proportion of control characters
+        public LineEndingInfo lineEndingInfo; // counts within samples only
+        public long sampledUnits; // bytes, or code units for UTF-16
+        public long estimatedLineCount; // extrapolated from samples
+    }
+
+    // Bounded-cost content inspection of a file before loading: examines the head, the tail and a few random interior
+    // blocks to determine encoding (BOM, BOM-less UTF-16 from the distribution of NUL bytes, UTF-8 validity), the mix of
+    // line endings, and whether the content looks like binary data.
+    public static class EncodingSniffer
+    {
+#if DEBUG
+        private const int EndSampleSize = 4096;
+        private const int InteriorSampleSize = 1024;
+#else
+        private const int EndSampleSize = 65536;
+        private const int InteriorSampleSize = 16384;
+#endif
+        private const int InteriorSampleCount = 6;
+
+        private struct Sample
+        {
+            public readonly long offset;
+            public readonly byte[] bytes;
+            public readonly int count;
+
+            public Sample(long offset, byte[] bytes, int count)
+            {
+                this.offset = offset;
+                this.bytes = bytes;
+                this.count = count;
+            }
+        }
+
+        // guess the encoding and analyze content accordingly
+        public static SniffResult Sniff(Stream stream)
+        {
+            byte[] bom = new byte[3];
+            stream.Seek(0, SeekOrigin.Begin);
+            int c = stream.Read(bom, 0, bom.Length);
+
+            if ((c >= 2) && (bom[0] == 0xFF) && (bom[1] == 0xFE))
+            {
+                return Sniff(stream, Utf8Transcoding.Form.Utf16LittleEndian, 2);
+            }
+            else if ((c >= 2) && (bom[0] == 0xFE) && (bom[1] == 0xFF))
+            {
+                return Sniff(stream, Utf8Transcoding.Form.Utf16BigEndian, 2);
+            }
+            else if ((c >= 3) && (bom[0] == 0xEF) && (bom[1] == 0xBB) && (bom[2] == 0xBF))
+            {
+                return Sniff(stream, Utf8Transcoding.Form.Utf8, 3);
+            }
+
+            List<Sample> samples = ReadSamples(stream, 0);
+
+            // UTF-16 text that is mostly ASCII has a NUL in every other byte - the high byte of each code unit
+            long total = 0;
+            long evenNuls = 0;
+            long oddNuls = 0;
+            foreach (Sample sample in samples)
+            {
+                total += sample.count;
+                for (int i = 0; i < sample.count; i++)
+                {
+                    if (sample.bytes[i] == 0)
+                    {
+                        if (((sample.offset + i) & 1) == 0)
+                        {
+                            evenNuls++;
+                        }
+                        else
+                        {
+                            oddNuls++;
+                        }
+                    }
+                }
+            }
+            if ((evenNuls + oddNuls != 0) && (evenNuls + oddNuls >= total / 8))
+            {
+                if (oddNuls >= 9 * (evenNuls + oddNuls) / 10)
+                {
+                    return Analyze(samples, Utf8Transcoding.Form.Utf16LittleEndian, 0, stream.Length);
+                }
+                if (evenNuls >= 9 * (evenNuls + oddNuls) / 10)
+                {
+                    return Analyze(samples, Utf8Transcoding.Form.Utf16BigEndian, 0, stream.Length);
+                }
+            }
+
+            // UTF-8 if it validates and isn't plain ASCII, else raw 8-bit
+            SniffResult result = Analyze(samples, Utf8Transcoding.Form.Ansi, 0, stream.Length);
+            if (result.validUtf8 && !result.ascii)
+            {
+                result.form = Utf8Transcoding.Form.Utf8;
+            }
+            return result;
+        }
+
+        // analyze content assuming the specified encoding form
+        public static SniffResult Sniff(Stream stream, Utf8Transcoding.Form form, int bomLength)
+        {
+            return Analyze(ReadSamples(stream, bomLength), form, bomLength, stream.Length);
+        }
+
+        private static List<Sample> ReadSamples(Stream stream, int start)
+        {
+            List<Sample> samples = new List<Sample>();
+            long length = stream.Length;
+
+            if (length - start <= 2 * EndSampleSize + InteriorSampleCount * InteriorSampleSize)
+            {
+                samples.Add(ReadSample(stream, start, (int)(length - start)));
+                return samples;
+            }
+
+            samples.Add(ReadSample(stream, start, EndSampleSize));
+
+            // interior blocks at random (but repeatable) even offsets between head and tail
+            Random random = new Random(unchecked((int)length));
+            long interiorStart = start + EndSampleSize;
+            long interiorLength = length - EndSampleSize - InteriorSampleSize - interiorStart;
+            long[] offsets = new long[InteriorSampleCount];
+            for (int i = 0; i < InteriorSampleCount; i++)
+            {
+                offsets[i] = (interiorStart + (long)(random.NextDouble() * interiorLength)) & ~1L;
+            }
+            Array.Sort(offsets);
+            foreach (long offset in offsets)
+            {
+                samples.Add(ReadSample(stream, offset, InteriorSampleSize));
+            }
+
+            samples.Add(ReadSample(stream, (length - EndSampleSize) & ~1L, EndSampleSize));
+
+            return samples;
+        }
+
+        private static Sample ReadSample(Stream stream, long offset, int count)
+        {
+            byte[] bytes = new byte[count];
+            stream.Seek(offset, SeekOrigin.Begin);
+            int c = 0;
+            int read;
+            while ((c < count) && ((read = stream.Read(bytes, c, count - c)) > 0))
+            {
+                c += read;
+            }
+            return new Sample(offset, bytes, c);
+        }
+
+        private static SniffResult Analyze(List<Sample> samples, Utf8Transcoding.Form form, int bomLength, long length)
+        {
+            SniffResult result = new SniffResult();
+            result.form = form;
+            result.bomLength = bomLength;
+            result.validUtf8 = true;
+            result.ascii = true;
+
+            bool utf16 = (form == Utf8Transcoding.Form.Utf16LittleEndian) || (form == Utf8Transcoding.Form.Utf16BigEndian);
+            bool bigEndian = form == Utf8Transcoding.Form.Utf16BigEndian;
+            long controls = 0;
+            long lineBreaks = 0;
+            foreach (Sample sample in samples)
+            {
+                // samples other than the first may begin in the middle of a line ending or multi-byte sequence
+                bool first = sample.offset <= bomLength;
+                int start = 0;
+                if (!first && !utf16)
+                {
+                    while ((start < sample.count) && (start < 3) && ((sample.bytes[start] & 0xC0) == 0x80))
+                    {
+                        start++;
+                    }
+                }
+
+                if (!utf16)
+                {
+                    result.validUtf8 = result.validUtf8 && ValidateUtf8(sample.bytes, start, sample.count);
+                    result.ascii = result.ascii
+                        && (Utf8Transcoding.AsciiRunLength(sample.bytes, start, sample.count) == sample.count - start);
+                }
+
+                int units = utf16 ? sample.count / 2 : sample.count;
+                int previous = first ? -1 : GetUnit(sample.bytes, 0, utf16, bigEndian);
+                for (int i = first ? 0 : 1; i < units; i++)
+                {
+                    int unit = GetUnit(sample.bytes, i, utf16, bigEndian);
+                    if (unit == '\n')
+                    {
+                        lineBreaks++;
+                        if (previous == '\r')
+                        {
+                            result.lineEndingInfo.windowsLFCount++;
+                        }
+                        else
+                        {
+                            result.lineEndingInfo.unixLFCount++;
+                        }
+                    }
+                    else if (previous == '\r')
+                    {
+                        lineBreaks++;
+                        result.lineEndingInfo.macintoshLFCount++;
+                    }
+                    if ((unit < 0x20) && (unit != '\t') && (unit != '\n') && (unit != '\r') && (unit != '\f') && (unit != 0x1B))
+                    {
+                        controls++;
+                    }
+                    previous = unit;
+                }
+                result.sampledUnits += units;
+            }
+
+            result.binary = controls * 50 > result.sampledUnits; // more than 2%
+            long totalUnits = (length - bomLength) / (utf16 ? 2 : 1);
+            result.estimatedLineCount = 1 + (result.sampledUnits != 0 ? (long)((double)totalUnits * lineBreaks / result.sampledUnits) : 0);
+            return result;
+        }
+
+        private static int GetUnit(byte[] bytes, int index, bool utf16, bool bigEndian)
+        {
+            if (!utf16)
+            {
+                return bytes[index];
+            }
+            return bigEndian
+                ? (bytes[2 * index] << 8) | bytes[2 * index + 1]
+                : bytes[2 * index] | (bytes[2 * index + 1] << 8);
+        }
+
+        // Validate UTF-8 (rejecting overlong forms, surrogates and code points above U+10FFFF). A sequence cut off by the
+        // end of the sample is accepted. ASCII runs are skipped eight bytes at a time.
+        public static bool ValidateUtf8(byte[] bytes, int start, int end)
+        {
+            int i = start;
+            while (i < end)
+            {
+                i += Utf8Transcoding.AsciiRunLength(bytes, i, end);
+                if (i == end)
+                {
+                    break;
+                }
+
+                byte b = bytes[i];
+                int n;
+                byte min = 0x80, max = 0xBF; // permitted range of second byte
+                if ((b >= 0xC2) && (b <= 0xDF))
+                {
+                    n = 1;
+                }
+                else if ((b >= 0xE0) && (b <= 0xEF))
+                {
+                    n = 2;
+                    if (b == 0xE0)
+                    {
+                        min = 0xA0;
+                    }
+                    else if (b == 0xED)
+                    {
+                        max = 0x9F;
+                    }
+                }
+                else if ((b >= 0xF0) && (b <= 0xF4))
+                {
+                    n = 3;
+                    if (b == 0xF0)
+                    {
+                        min = 0x90;
+                    }
+                    else if (b == 0xF4)
+                    {
+                        max = 0x8F;
+                    }
+                }
+                else
+                {
+                    return false;
+                }
+
+                for (int k = 1; k <= n; k++)
+                {
+                    if (i + k == end)
+                    {
+                        return true;
+                    }
+                    byte t = bytes[i + k];
+                    if ((k == 1) ? ((t < min) || (t > max)) : ((t & 0xC0) != 0x80))
+                    {
+                        return false;
+                    }
+                }
+                i += n + 1;
+            }
+            return true;
+        }
+    }
+}
@@ -38,7 +38,6 @@ namespace TextEditor
             this.dataGridViewTextBoxColumn1 = new System.Windows.Forms.DataGridViewTextBoxColumn();
             this.dataGridViewTextBoxColumn2 = new System.Windows.Forms.DataGridViewTextBoxColumn();
             this.dataGridViewTextBoxColumn3 = new System.Windows.Forms.DataGridViewTextBoxColumn();
-            this.findInFilesEntryBindingSource = new System.Windows.Forms.BindingSource(this.components);
             this.labelExtensions = new System.Windows.Forms.Label();
             this.comboBoxSearchExtensions = new System.Windows.Forms.ComboBox();
             this.tableLayoutPanel1 = new System.Windows.Forms.TableLayoutPanel();
@@ -52,7 +51,6 @@ namespace TextEditor
             this.dpiChangeHelper = new TextEditor.DpiChangeHelper(this.components);
             this.tableLayoutPanel2.SuspendLayout();
             ((System.ComponentModel.ISupportInitialize)(this.dataGridViewFindResults)).BeginInit();
-            ((System.ComponentModel.ISupportInitialize)(this.findInFilesEntryBindingSource)).BeginInit();
             this.tableLayoutPanel1.SuspendLayout();
             this.flowLayoutPanel1.SuspendLayout();
             this.SuspendLayout();
@@ -136,17 +134,16 @@ namespace TextEditor
             this.dataGridViewTextBoxColumn2,
             this.dataGridViewTextBoxColumn3});
             this.tableLayoutPanel2.SetColumnSpan(this.dataGridViewFindResults, 5);
-            this.dataGridViewFindResults.DataSource = this.findInFilesEntryBindingSource;
             this.dataGridViewFindResults.Dock = System.Windows.Forms.DockStyle.Fill;
             this.dataGridViewFindResults.Location = new System.Drawing.Point(3, 96);
             this.dataGridViewFindResults.Name = "dataGridViewFindResults";
             this.dataGridViewFindResults.ReadOnly = true;
             this.dataGridViewFindResults.Size = new System.Drawing.Size(861, 188);
             this.dataGridViewFindResults.TabIndex = 7;
+            this.dataGridViewFindResults.VirtualMode = true;
             // 
             // dataGridViewTextBoxColumn1
             // 
-            this.dataGridViewTextBoxColumn1.DataPropertyName = "DisplayPath";
             this.dataGridViewTextBoxColumn1.HeaderText = "File";
             this.dataGridViewTextBoxColumn1.Name = "dataGridViewTextBoxColumn1";
             this.dataGridViewTextBoxColumn1.ReadOnly = true;
@@ -154,23 +151,17 @@ namespace TextEditor
             // 
             // dataGridViewTextBoxColumn2
             // 
-            this.dataGridViewTextBoxColumn2.DataPropertyName = "LineNumber";
             this.dataGridViewTextBoxColumn2.HeaderText = "Line";
             this.dataGridViewTextBoxColumn2.Name = "dataGridViewTextBoxColumn2";
             this.dataGridViewTextBoxColumn2.ReadOnly = true;
             // 
             // dataGridViewTextBoxColumn3
             // 
-            this.dataGridViewTextBoxColumn3.DataPropertyName = "FormattedLine";
             this.dataGridViewTextBoxColumn3.HeaderText = "Text";
             this.dataGridViewTextBoxColumn3.Name = "dataGridViewTextBoxColumn3";
             this.dataGridViewTextBoxColumn3.ReadOnly = true;
             this.dataGridViewTextBoxColumn3.Width = 400;
             // 
-            // findInFilesEntryBindingSource
-            // 
-            this.findInFilesEntryBindingSource.DataSource = typeof(TextEditor.FindInFilesEntry);
-            // 
             // labelExtensions
             // 
             this.labelExtensions.Anchor = ((System.Windows.Forms.AnchorStyles)((System.Windows.Forms.AnchorStyles.Left | System.Windows.Forms.AnchorStyles.Right)));
@@ -299,7 +290,6 @@ namespace TextEditor
             this.tableLayoutPanel2.ResumeLayout(false);
             this.tableLayoutPanel2.PerformLayout();
             ((System.ComponentModel.ISupportInitialize)(this.dataGridViewFindResults)).EndInit();
-            ((System.ComponentModel.ISupportInitialize)(this.findInFilesEntryBindingSource)).EndInit();
             this.tableLayoutPanel1.ResumeLayout(false);
             this.flowLayoutPanel1.ResumeLayout(false);
             this.flowLayoutPanel1.PerformLayout();
@@ -318,7 +308,6 @@ namespace TextEditor
         private System.Windows.Forms.Label labelSearchRoot;
         private System.Windows.Forms.ComboBox comboBoxSearchPath;
         private MyDataGridView dataGridViewFindResults;
-        private System.Windows.Forms.BindingSource findInFilesEntryBindingSource;
         private System.Windows.Forms.DataGridViewTextBoxColumn dataGridViewTextBoxColumn1;
         private System.Windows.Forms.DataGridViewTextBoxColumn dataGridViewTextBoxColumn2;
         private System.Windows.Forms.DataGridViewTextBoxColumn dataGridViewTextBoxColumn3;
@@ -35,7 +35,7 @@ namespace TextEditor
     public partial class FindInFiles : Form
     {
         private readonly IFindInFilesApplication clientApplication;
-        private readonly BindingList<FindInFilesEntry> results = new BindingList<FindInFilesEntry>();
+        private FindInFilesResults results = new FindInFilesResults();
         private FindInFilesTask task;
         private readonly Dictionary<IFindInFilesItem, IFindInFilesWindow> windows = new Dictionary<IFindInFilesItem, IFindInFilesWindow>();
 
@@ -74,7 +74,7 @@ namespace TextEditor
                 comboBoxSearchExtensions);
             comboBoxSearchExtensions.SelectedValueChanged += new EventHandler(comboBoxSearchExtensions_SelectedValueChanged);
 
-            dataGridViewFindResults.DataSource = new BindingSource(results, null);
+            dataGridViewFindResults.CellValueNeeded += new DataGridViewCellValueEventHandler(dataGridViewFindResults_CellValueNeeded);
             dataGridViewFindResults.CellMouseDoubleClick += new DataGridViewCellMouseEventHandler(dataGridViewFindResults_CellMouseDoubleClick);
             dataGridViewFindResults.EnterKeyPressed += new EventHandler(dataGridViewFindResults_EnterKeyPressed);
 
@@ -158,9 +158,41 @@ namespace TextEditor
             }
         }
 
+        private void dataGridViewFindResults_CellValueNeeded(object sender, DataGridViewCellValueEventArgs e)
+        {
+            if (e.RowIndex >= results.Count)
+            {
+                return;
+            }
+            FindInFilesEntry entry = results[e.RowIndex];
+            if (e.ColumnIndex == dataGridViewTextBoxColumn1.Index)
+            {
+                e.Value = entry.DisplayPath;
+            }
+            else if (e.ColumnIndex == dataGridViewTextBoxColumn2.Index)
+            {
+                e.Value = entry.LineNumber;
+            }
+            else if (e.ColumnIndex == dataGridViewTextBoxColumn3.Index)
+            {
+                e.Value = entry.FormattedLine;
+            }
+        }
+
+        // Rows are never added to the grid individually - the grid runs in virtual mode and is simply told how many
+        // results have been published so far, pulling the ones it actually displays from the store on demand.
+        private void UpdateRowCount()
+        {
+            int count = results.Count;
+            if (dataGridViewFindResults.RowCount != count)
+            {
+                dataGridViewFindResults.RowCount = count;
+            }
+        }
+
         private void dataGridViewFindResults_CellMouseDoubleClick(object sender, DataGridViewCellMouseEventArgs e)
         {
-            if (dataGridViewFindResults.CurrentRow == null)
+            if ((dataGridViewFindResults.CurrentRow == null) || (dataGridViewFindResults.CurrentRow.Index >= results.Count))
             {
                 return;
             }
@@ -242,14 +274,16 @@ namespace TextEditor
                     comboBoxSearchExtensions.SelectedValue = text;
                 }
 
-                results.Clear();
+                // a fresh store for each search, since a cancelled task may still be winding down and appending to its own
+                results = new FindInFilesResults();
+                dataGridViewFindResults.RowCount = 0;
                 task = new FindInFilesTask(
+                    results,
                     this.textBoxSearchFor.Text,
                     clientApplication.GetNodeForPath(path),
                     comboBoxSearchExtensions.Text,
                     this.checkBoxCaseSensitive.Checked,
                     this.checkBoxMatchWholeWord.Checked);
-                task.ProgressChanged += new ProgressChangedEventHandler(task_ProgressChanged);
                 task.RunWorkerCompleted += new RunWorkerCompletedEventHandler(task_RunWorkerCompleted);
                 buttonFind.Text = "Stop Find";
                 task.RunWorkerAsync();
@@ -260,12 +294,12 @@ namespace TextEditor
             else
             {
                 task.CancelAsync();
-                task.ProgressChanged -= new ProgressChangedEventHandler(task_ProgressChanged);
                 task.RunWorkerCompleted -= new RunWorkerCompletedEventHandler(task_RunWorkerCompleted);
                 buttonFind.Text = "Find";
                 task = null;
                 labelStatus.Text = null;
                 timerStatusUpdate.Stop();
+                UpdateRowCount();
             }
         }
 
@@ -292,25 +326,16 @@ namespace TextEditor
             clientApplication.Config_SearchExtensions = GetCombo(searchedExtensions, lastExtensionNumber);
         }
 
-        private void task_ProgressChanged(object sender, ProgressChangedEventArgs e)
-        {
-            if (!IsDisposed)
-            {
-                FindInFilesEntry[] entries = (FindInFilesEntry[])e.UserState;
-                for (int i = 0; i < entries.Length; i++)
-                {
-                    results.Add(entries[i]);
-                }
-                task.Release();
-            }
-        }
-
         private void task_RunWorkerCompleted(object sender, RunWorkerCompletedEventArgs e)
         {
             buttonFind.Text = "Find";
             task = null;
             labelStatus.Text = null;
             timerStatusUpdate.Stop();
+            if (!IsDisposed)
+            {
+                UpdateRowCount();
+            }
         }
 
         private void timerStatusUpdate_Tick(object sender, EventArgs e)
@@ -321,6 +346,7 @@ namespace TextEditor
                 status = task.CurrentPath;
             }
             labelStatus.Text = status.Replace("&", "&&");
+            UpdateRowCount();
         }
 
         private void buttonFileDialog_Click(object sender, EventArgs e)
@@ -419,6 +445,63 @@ namespace TextEditor
         public int EndCharP1 { get { return endCharP1; } }
     }
 
+    // Append-only store of search results, written by the single search thread and read by the UI thread without
+    // locking. Entries live in fixed-size chunks that never move once allocated, so growing the store only replaces the
+    // (small) chunk directory. The writer fills slots beyond the published count and then publishes them in a batch by
+    // advancing the count; a reader that observes a count is guaranteed to observe the directory and entries it covers.
+    public class FindInFilesResults
+    {
+#if DEBUG
+        private const int ChunkShift = 4;
+#else
+        private const int ChunkShift = 10;
+#endif
+        private const int ChunkSize = 1 << ChunkShift;
+
+        private FindInFilesEntry[][] chunks = new FindInFilesEntry[4][];
+        private int count; // published
+        private int pending; // written by the search thread but not yet published
+
+        public int Count { get { return Volatile.Read(ref count); } }
+
+        public FindInFilesEntry this[int index]
+        {
+            get
+            {
+                if (unchecked((uint)index >= (uint)Count))
+                {
+                    Debug.Assert(false);
+                    throw new ArgumentOutOfRangeException();
+                }
+                return Volatile.Read(ref chunks)[index >> ChunkShift][index & (ChunkSize - 1)];
+            }
+        }
+
+        // search thread only
+        public void Add(FindInFilesEntry entry)
+        {
+            int chunk = pending >> ChunkShift;
+            if (chunk == chunks.Length)
+            {
+                FindInFilesEntry[][] newChunks = new FindInFilesEntry[2 * chunks.Length][];
+                Array.Copy(chunks, newChunks, chunks.Length);
+                Volatile.Write(ref chunks, newChunks);
+            }
+            if (chunks[chunk] == null)
+            {
+                chunks[chunk] = new FindInFilesEntry[ChunkSize];
+            }
+            chunks[chunk][pending & (ChunkSize - 1)] = entry;
+            pending++;
+        }
+
+        // search thread only
+        public void Publish()
+        {
+            Volatile.Write(ref count, pending);
+        }
+    }
+
     public class FindInFilesTask : BackgroundWorker
     {
         private readonly string pattern;
@@ -428,12 +511,10 @@ namespace TextEditor
         private readonly bool caseSensitive;
         private readonly bool matchWholeWords;
         private IFindInFilesNode currentPath;
-        private const int ChunkLength = 16;
-        private readonly List<FindInFilesEntry> results = new List<FindInFilesEntry>(ChunkLength);
-        private DateTime lastFlush;
-        private AutoResetEvent interlock;
+        private readonly FindInFilesResults results;
 
         public FindInFilesTask(
+            FindInFilesResults results,
             string pattern,
             IFindInFilesNode root,
             string extensions,
@@ -454,6 +535,7 @@ namespace TextEditor
                 throw new ArgumentException();
             }
 
+            this.results = results;
             this.pattern = pattern;
             this.root = root;
             if (!String.IsNullOrEmpty(extensions))
@@ -491,38 +573,24 @@ namespace TextEditor
             this.caseSensitive = caseSensitive;
             this.matchWholeWords = matchWholeWords;
 
-            this.WorkerReportsProgress = true;
             this.WorkerSupportsCancellation = true;
         }
 
         public string CurrentPath { get { return currentPath != null ? currentPath.GetPath() : String.Empty; } }
 
-        public void Release()
-        {
-            AutoResetEvent interlock = this.interlock;
-            if (interlock != null)
-            {
-                interlock.Set();
-            }
-        }
-
+        // Results are published to the store rather than reported through ReportProgress. The UI polls the published
+        // count and reads only the rows it displays, so the search never waits on the UI however many hits there are.
         protected override void OnDoWork(DoWorkEventArgs e)
         {
             bool cancelled = false;
             try
             {
-                this.interlock = new AutoResetEvent(false);
-
                 EnumerateRecursive(root, ".", out cancelled);
             }
             finally
             {
-                Flush();
+                results.Publish();
                 e.Cancel = cancelled;
-
-                AutoResetEvent interlock = this.interlock;
-                this.interlock = null;
-                interlock.Close();
             }
         }
 
@@ -626,45 +694,12 @@ namespace TextEditor
                 SendResult(new FindInFilesEntry(item, displayPath, String.Format("Unable to open: {0}", exception.Message), 0, 0, 0));
             }
 
-            if (lastFlush.AddMilliseconds(250) < DateTime.UtcNow)
-            {
-                Flush();
-            }
-        }
-
-        private void Flush()
-        {
-            if (results.Count > 0)
-            {
-                FindInFilesEntry[] entries = results.ToArray();
-                results.Clear();
-
-                ReportProgress(0, entries);
-
-                // Alas, BackgroundWorker is not quite the complete solution one was hoping for.
-                // It tends to swamp the message queue with events (since DataGridView for display is much
-                // slower than this is at finding items), causing the application to hang up. This
-                // event is used to interlock reporting of results so that search does not resume until
-                // the DataGridView has consumed all the changes just sent.
-                while (!CancellationPending)
-                {
-                    if (this.interlock.WaitOne(1000))
-                    {
-                        break;
-                    }
-                }
-
-                lastFlush = DateTime.UtcNow;
-            }
+            results.Publish();
         }
 
         private void SendResult(FindInFilesEntry entry)
         {
             results.Add(entry);
-            if (results.Count >= ChunkLength)
-            {
-                Flush();
-            }
         }
     }
 
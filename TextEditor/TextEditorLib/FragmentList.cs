@@ -26,7 +26,11 @@ using System.Diagnostics;
 namespace TextEditor
 {
     // A replacement for List<T> that tries to stay off the large object heap for big collections
-    // but minimizes allocations for tiny collections
+    // but minimizes allocations for tiny collections.
+    // Large collections are a tiered vector: fixed-size blocks, each a circular buffer with its own rotation, all full
+    // except the last. Inserting or removing shifts elements within one block and then rotates each following block,
+    // moving only as many elements as were inserted or removed per block, and whole blocks are inserted or removed by
+    // moving block references. Random access remains O(1).
     public struct FragmentList<T>
     {
         private const int BlockSize = 4096; // must be integer power of 2
@@ -34,6 +38,7 @@ namespace TextEditor
         private int count;
         private T[] simpleArray; // exactly one of these is not null
         private T[][] fragmentArray; // exactly one of these is not null
+        private int[] rotations; // physical index of logical element 0 of each block in fragmentArray
 
 #if DEBUG
         private const bool Validate = true;
@@ -124,8 +129,9 @@ namespace TextEditor
             }
             else
             {
-                vector = fragmentArray[index / BlockSize];
-                offset = index & (BlockSize - 1);
+                int block = index / BlockSize;
+                vector = fragmentArray[block];
+                offset = (index + rotations[block]) & (BlockSize - 1);
             }
         }
 
@@ -191,24 +197,36 @@ namespace TextEditor
             int after = this.count - index;
 
             EnsureCapacity(this.count + count);
-            this.count += count;
 
-            for (int i = after - 1; i >= 0; i--)
+            if (simpleArray != null)
             {
-                T[] vector;
-                int vectorOffset;
-                GetEffectiveAddress(i + index, out vector, out vectorOffset);
-                T t = vector[vectorOffset];
-                GetEffectiveAddress(i + index + count, out vector, out vectorOffset);
-                vector[vectorOffset] = t;
+                Array.Copy(simpleArray, index, simpleArray, index + count, after);
+                Array.Copy(collection, offset, simpleArray, index, count);
             }
-            for (int i = 0; i < count; i++)
+            else
             {
-                T[] vector;
-                int vectorOffset;
-                GetEffectiveAddress(i + index, out vector, out vectorOffset);
-                vector[vectorOffset] = collection[i + offset];
+                if (after > 0)
+                {
+                    int partial = count & (BlockSize - 1);
+                    if (partial != 0)
+                    {
+                        RotateRight(index, partial, this.count);
+                    }
+                    if (count >= BlockSize)
+                    {
+                        InsertBlocks(index, count / BlockSize, this.count + partial);
+                    }
+                }
+                for (int i = 0; i < count; )
+                {
+                    int block = (index + i) / BlockSize;
+                    int blockOffset = (index + i) & (BlockSize - 1);
+                    int n = Math.Min(count - i, BlockSize - blockOffset);
+                    CopyToBlock(collection, offset + i, fragmentArray[block], rotations[block], blockOffset, n);
+                    i += n;
+                }
             }
+            this.count += count;
 #if DEBUG
             if (Validate)
             {
@@ -239,22 +257,23 @@ namespace TextEditor
                 throw new ArgumentOutOfRangeException();
             }
             Debug.Assert(!((simpleArray != null) && (fragmentArray != null)));
-            for (int i = index; i < this.count - count; i++)
+            if (simpleArray != null)
             {
-                T[] vector;
-                int vectorOffset;
-                GetEffectiveAddress(i + count, out vector, out vectorOffset);
-                T t = vector[vectorOffset];
-                GetEffectiveAddress(i, out vector, out vectorOffset);
-                vector[vectorOffset] = t;
+                Array.Copy(simpleArray, index + count, simpleArray, index, this.count - count - index);
+                // clear dead slots for garbage collector
+                Array.Clear(simpleArray, this.count - count, count);
             }
-            for (int i = this.count - count; i < this.count; i++)
+            else if (count != 0)
             {
-                // clear dead slots for garbage collector
-                T[] vector;
-                int vectorOffset;
-                GetEffectiveAddress(i, out vector, out vectorOffset);
-                vector[vectorOffset] = default(T);
+                int partial = count & (BlockSize - 1);
+                if (partial != 0)
+                {
+                    RotateLeft(index, partial, this.count);
+                }
+                if (count >= BlockSize)
+                {
+                    RemoveBlocks(index, count / BlockSize, this.count - partial);
+                }
             }
             this.count -= count;
 #if DEBUG
@@ -270,6 +289,189 @@ namespace TextEditor
 #endif
         }
 
+
+        // Block operations. Offsets are logical (relative to each block's rotation). Invariant: slots not holding
+        // elements contain default(T), so that the garbage collector isn't kept from anything.
+
+        private static void CopyFromBlock(T[] block, int rotation, int start, T[] destination, int destinationIndex, int length)
+        {
+            int physical = (rotation + start) & (BlockSize - 1);
+            int first = Math.Min(length, BlockSize - physical);
+            Array.Copy(block, physical, destination, destinationIndex, first);
+            Array.Copy(block, 0, destination, destinationIndex + first, length - first);
+        }
+
+        private static void CopyToBlock(T[] source, int sourceIndex, T[] block, int rotation, int start, int length)
+        {
+            int physical = (rotation + start) & (BlockSize - 1);
+            int first = Math.Min(length, BlockSize - physical);
+            Array.Copy(source, sourceIndex, block, physical, first);
+            Array.Copy(source, sourceIndex + first, block, 0, length - first);
+        }
+
+        private static void ClearBlock(T[] block, int rotation, int start, int length)
+        {
+            int physical = (rotation + start) & (BlockSize - 1);
+            int first = Math.Min(length, BlockSize - physical);
+            Array.Clear(block, physical, first);
+            Array.Clear(block, 0, length - first);
+        }
+
+        // copy between blocks, or within one block with memmove semantics, in runs contiguous in both
+        private static void BlockCopy(T[] source, int sourceRotation, int sourceStart, T[] destination, int destinationRotation, int destinationStart, int length)
+        {
+            if ((source == destination) && (destinationStart > sourceStart))
+            {
+                while (length > 0)
+                {
+                    int sourceLast = (sourceRotation + sourceStart + length - 1) & (BlockSize - 1);
+                    int destinationLast = (destinationRotation + destinationStart + length - 1) & (BlockSize - 1);
+                    int c = Math.Min(length, Math.Min(sourceLast, destinationLast) + 1);
+                    Array.Copy(source, sourceLast - c + 1, destination, destinationLast - c + 1, c);
+                    length -= c;
+                }
+            }
+            else
+            {
+                while (length > 0)
+                {
+                    int sourcePhysical = (sourceRotation + sourceStart) & (BlockSize - 1);
+                    int destinationPhysical = (destinationRotation + destinationStart) & (BlockSize - 1);
+                    int c = Math.Min(length, BlockSize - Math.Max(sourcePhysical, destinationPhysical));
+                    Array.Copy(source, sourcePhysical, destination, destinationPhysical, c);
+                    sourceStart += c;
+                    destinationStart += c;
+                    length -= c;
+                }
+            }
+        }
+
+        // Open a gap of shift (< BlockSize) elements at index, given count elements: the block containing index
+        // shifts its remainder up, and each following block is rotated, taking in the elements pushed out of the
+        // end of its predecessor.
+        private void RotateRight(int index, int shift, int count)
+        {
+            int first = index / BlockSize;
+            int offset = index & (BlockSize - 1);
+            int last = (count + shift - 1) / BlockSize;
+            T[] carry = new T[shift];
+            T[] spare = new T[shift];
+
+            T[] block = fragmentArray[first];
+            int rotation = rotations[first];
+            if (offset + shift <= BlockSize)
+            {
+                CopyFromBlock(block, rotation, BlockSize - shift, carry, 0, shift);
+                BlockCopy(block, rotation, offset, block, rotation, offset + shift, BlockSize - shift - offset);
+            }
+            else
+            {
+                // gap extends into the next block
+                CopyFromBlock(block, rotation, offset, carry, offset + shift - BlockSize, BlockSize - offset);
+            }
+
+            for (int i = first + 1; i <= last; i++)
+            {
+                rotation = rotations[i] = (rotations[i] - shift) & (BlockSize - 1);
+                CopyFromBlock(fragmentArray[i], rotation, 0, spare, 0, shift);
+                CopyToBlock(carry, 0, fragmentArray[i], rotation, 0, shift);
+                T[] t = carry;
+                carry = spare;
+                spare = t;
+            }
+        }
+
+        // Close up shift (< BlockSize) elements at index, given count elements - the inverse of RotateRight.
+        private void RotateLeft(int index, int shift, int count)
+        {
+            int first = index / BlockSize;
+            int offset = index & (BlockSize - 1);
+            int last = (count - 1) / BlockSize;
+            T[] carry = new T[shift]; // the last block takes in empty slots
+            T[] spare = new T[shift];
+
+            int rotation;
+            for (int i = last; i > first; i--)
+            {
+                rotation = rotations[i] = (rotations[i] + shift) & (BlockSize - 1);
+                CopyFromBlock(fragmentArray[i], rotation, BlockSize - shift, spare, 0, shift);
+                CopyToBlock(carry, 0, fragmentArray[i], rotation, BlockSize - shift, shift);
+                T[] t = carry;
+                carry = spare;
+                spare = t;
+            }
+
+            T[] block = fragmentArray[first];
+            rotation = rotations[first];
+            if (offset + shift <= BlockSize)
+            {
+                BlockCopy(block, rotation, offset + shift, block, rotation, offset, BlockSize - shift - offset);
+                CopyToBlock(carry, 0, block, rotation, BlockSize - shift, shift);
+            }
+            else
+            {
+                // removed range extends into the next block, whose removed head comes back at the start of carry
+                CopyToBlock(carry, offset + shift - BlockSize, block, rotation, offset, BlockSize - offset);
+            }
+        }
+
+        // Open a gap of blocks * BlockSize elements at index, given count elements: unused blocks from beyond the end
+        // are moved in after the block containing index, and that block's remainder moves to the same offsets of the
+        // last of them.
+        private void InsertBlocks(int index, int blocks, int count)
+        {
+            int first = index / BlockSize;
+            int offset = index & (BlockSize - 1);
+            int used = (count + BlockSize - 1) / BlockSize;
+
+            T[][] unused = new T[blocks][];
+            Array.Copy(fragmentArray, used, unused, 0, blocks);
+            Array.Copy(fragmentArray, first + 1, fragmentArray, first + 1 + blocks, used - (first + 1));
+            Array.Copy(rotations, first + 1, rotations, first + 1 + blocks, used - (first + 1));
+            Array.Copy(unused, 0, fragmentArray, first + 1, blocks);
+            Array.Clear(rotations, first + 1, blocks);
+
+            // the vacated slots are left as they are - the caller overwrites the gap
+            CopyFromBlock(fragmentArray[first], rotations[first], offset, fragmentArray[first + blocks], offset, BlockSize - offset);
+        }
+
+        // Close up blocks * BlockSize elements at index, given count elements - the inverse of InsertBlocks. Emptied
+        // blocks are moved beyond the end for reuse.
+        private void RemoveBlocks(int index, int blocks, int count)
+        {
+            int first = index / BlockSize;
+            int offset = index & (BlockSize - 1);
+            int used = (count + BlockSize - 1) / BlockSize;
+
+            int length = 0;
+            if (first + blocks < used)
+            {
+                length = Math.Max(Math.Min(BlockSize, count - (first + blocks) * BlockSize) - offset, 0);
+                BlockCopy(
+                    fragmentArray[first + blocks],
+                    rotations[first + blocks],
+                    offset,
+                    fragmentArray[first],
+                    rotations[first],
+                    offset,
+                    length);
+            }
+            ClearBlock(fragmentArray[first], rotations[first], offset + length, BlockSize - offset - length);
+
+            int dead = Math.Min(blocks, used - (first + 1));
+            T[][] emptied = new T[dead][];
+            Array.Copy(fragmentArray, first + 1, emptied, 0, dead);
+            for (int i = 0; i < dead; i++)
+            {
+                Array.Clear(emptied[i], 0, BlockSize);
+            }
+            Array.Copy(fragmentArray, first + 1 + dead, fragmentArray, first + 1, used - (first + 1 + dead));
+            Array.Copy(rotations, first + 1 + dead, rotations, first + 1, used - (first + 1 + dead));
+            Array.Copy(emptied, 0, fragmentArray, used - dead, dead);
+            Array.Clear(rotations, used - dead, dead);
+        }
+
+
         private int Capacity
         {
             get
@@ -287,22 +489,16 @@ namespace TextEditor
             }
         }
 
+        // capacity only grows - once fragmented, the list stays fragmented
         private void SetCapacity(int capacity)
         {
             Debug.Assert(!((simpleArray != null) && (fragmentArray != null)));
+            Debug.Assert(capacity > Capacity);
             if (capacity <= BlockSize)
             {
                 if (simpleArray == null)
                 {
-                    if (fragmentArray != null)
-                    {
-                        simpleArray = fragmentArray[0];
-                    }
-                    else
-                    {
-                        simpleArray = new T[capacity];
-                    }
-                    fragmentArray = null;
+                    simpleArray = new T[capacity];
                 }
 
                 if (simpleArray.Length < capacity)
@@ -333,11 +529,13 @@ namespace TextEditor
                     fragmentArray[0] = simpleArray;
                     simpleArray = null;
                     Array.Resize(ref fragmentArray[0], BlockSize);
+                    rotations = new int[c / BlockSize];
                 }
                 else
                 {
                     Debug.Assert(simpleArray == null);
                     Array.Resize(ref fragmentArray, c / BlockSize);
+                    Array.Resize(ref rotations, c / BlockSize);
                 }
 
                 for (int i = oldEnd; i < c; i += BlockSize)
@@ -368,13 +566,18 @@ namespace TextEditor
         public void Clear()
         {
             Debug.Assert(!((simpleArray != null) && (fragmentArray != null)));
-            for (int i = 0; i < count; i++)
+            // clear dead slots for garbage collector
+            if (simpleArray != null)
             {
-                // clear dead slots for garbage collector
-                T[] vector;
-                int vectorOffset;
-                GetEffectiveAddress(i, out vector, out vectorOffset);
-                vector[vectorOffset] = default(T);
+                Array.Clear(simpleArray, 0, count);
+            }
+            else if (fragmentArray != null)
+            {
+                for (int i = 0; i * BlockSize < count; i++)
+                {
+                    Array.Clear(fragmentArray[i], 0, BlockSize);
+                }
+                Array.Clear(rotations, 0, rotations.Length);
             }
             count = 0;
 #if DEBUG
@@ -21,6 +21,7 @@
 */
 
 using System;
+using System.Collections.Generic;
 using System.Drawing;
 
 namespace TextEditor
@@ -72,6 +73,27 @@ namespace TextEditor
             out int prevOffset);
     }
 
+    public struct ColorRun
+    {
+        public readonly int start;
+        public readonly int length;
+        public readonly Color color;
+
+        public ColorRun(int start, int length, Color color)
+        {
+            this.start = start;
+            this.length = length;
+            this.color = color;
+        }
+    }
+
+    // Optionally implemented by ITextInfo: subsequent DrawText calls draw the characters covered by the runs in the
+    // run colors rather than the foreground color (used for syntax highlighting).
+    public interface ITextInfoColorRuns
+    {
+        void SetColorRuns(List<ColorRun> runs);
+    }
+
     public enum TextService // known services - mostly for designer property editor
     {
         Simple,
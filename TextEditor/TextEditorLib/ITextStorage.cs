@@ -20,6 +20,7 @@
  * 
 */
 using System;
+using System.Diagnostics;
 using System.IO;
 using System.Text;
 
@@ -153,12 +154,25 @@ namespace TextEditor
 
         ITextLine this[int index] { get; }
 
+        // Allocation-free line access: copies the characters of the line into the caller's buffer,
+        // replacing the buffer with a larger one if it is too small. Returns number of chars copied.
+        int CopyLine(
+            int index,
+            ref char[] buffer);
+        TextLineEnumerator EnumerateLines(
+            int startLine,
+            int count,
+            char[] buffer);
+
         string GetText(
             string EOLN);
 
         bool Modified { get; set; }
         bool Empty { get; }
 
+        // Approximate memory held by the text, for accounting against a memory budget.
+        long EstimateMemoryBytes();
+
         ITextStorage CloneSection(
             int startLine,
             int startChar,
@@ -174,6 +188,13 @@ namespace TextEditor
             int insertChar,
             ITextStorage insert);
 
+        // Append encoded data to the end of the text (e.g. new content of a file being followed), adding its line
+        // endings to lineEndingInfo. The data must not end within a character or between the CR and LF of a line ending.
+        void AppendStream(
+            Stream stream,
+            Encoding encoding,
+            ref LineEndingInfo lineEndingInfo);
+
         void ToTextWriter(
             TextWriter writer);
         void ToStream(
@@ -182,6 +203,51 @@ namespace TextEditor
             string EOLN);
     }
 
+    // Sequential access to a range of lines without per-line allocation. The characters of the current
+    // line are in Buffer[0..Length) and are valid only until the next call to MoveNext(). The buffer is
+    // reused for each line (grown as needed) and can be handed to a subsequent enumeration via Buffer.
+    public struct TextLineEnumerator
+    {
+        private readonly ITextStorage storage;
+        private readonly int end;
+        private int index;
+        private int length;
+        private char[] buffer;
+
+        public TextLineEnumerator(ITextStorage storage, int startLine, int count, char[] buffer)
+        {
+            if ((startLine < 0) || (count < 0) || (startLine + count > storage.Count))
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+
+            this.storage = storage;
+            this.end = startLine + count;
+            this.index = startLine - 1;
+            this.length = 0;
+            this.buffer = buffer;
+        }
+
+        public bool MoveNext()
+        {
+            if (index + 1 >= end)
+            {
+                length = 0;
+                return false;
+            }
+            index++;
+            length = storage.CopyLine(index, ref buffer);
+            return true;
+        }
+
+        public int Index { get { return index; } }
+
+        public int Length { get { return length; } }
+
+        public char[] Buffer { get { return buffer; } }
+    }
+
     public struct LineEndingInfo
     {
         public int unixLFCount;
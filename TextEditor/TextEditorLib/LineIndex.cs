@@ -0,0 +1,96 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.IO;
+
+namespace TextEditor
+{
+    // The line index of a Utf8SplayGapBuffer as loaded from a stream: skip map segments, line ending counts and the
+    // longest line. Saved alongside a file's identity, it can be supplied when the same data is loaded again so that
+    // the data is not scanned for line breaks (see Utf8SplayGapStorageFactory.FromStream).
+    public class LineIndex
+    {
+        private const int Signature = 0x58444E4C; // "LNDX"
+        private const int Version = 2; // 1 also carried UTF-16 lengths
+
+        public readonly LineEndingInfo lineEndingInfo;
+        public readonly int bomLength; // byte order mark detected by the buffer (if not skipped by the caller)
+        public readonly int longestLine; // longest line as loaded, by bytes
+        public readonly int[] segments; // (line count, byte length) pairs - see LineSkipMap.GetSegments()
+
+        public LineIndex(LineEndingInfo lineEndingInfo, int bomLength, int longestLine, int[] segments)
+        {
+            this.lineEndingInfo = lineEndingInfo;
+            this.bomLength = bomLength;
+            this.longestLine = longestLine;
+            this.segments = segments;
+        }
+
+        public void Write(BinaryWriter writer)
+        {
+            writer.Write(Signature);
+            writer.Write(Version);
+            writer.Write(LineSkipMap.Sparseness);
+            writer.Write(LineSkipMap.ByteBudget);
+            writer.Write(lineEndingInfo.unixLFCount);
+            writer.Write(lineEndingInfo.windowsLFCount);
+            writer.Write(lineEndingInfo.macintoshLFCount);
+            writer.Write(bomLength);
+            writer.Write(longestLine);
+            writer.Write(segments.Length);
+            foreach (int value in segments)
+            {
+                writer.Write(value);
+            }
+        }
+
+        // returns null if the data was written by a different version or with different skip map parameters (segments
+        // sized for another build)
+        public static LineIndex Read(BinaryReader reader)
+        {
+            if ((reader.ReadInt32() != Signature)
+                || (reader.ReadInt32() != Version)
+                || (reader.ReadInt32() != LineSkipMap.Sparseness)
+                || (reader.ReadInt32() != LineSkipMap.ByteBudget))
+            {
+                return null;
+            }
+            LineEndingInfo lineEndingInfo = new LineEndingInfo();
+            lineEndingInfo.unixLFCount = reader.ReadInt32();
+            lineEndingInfo.windowsLFCount = reader.ReadInt32();
+            lineEndingInfo.macintoshLFCount = reader.ReadInt32();
+            int bomLength = reader.ReadInt32();
+            int longestLine = reader.ReadInt32();
+            int count = reader.ReadInt32();
+            if ((count <= 0) || (count % 2 != 0) || (count > (reader.BaseStream.Length - reader.BaseStream.Position) / sizeof(int)))
+            {
+                return null;
+            }
+            int[] segments = new int[count];
+            for (int i = 0; i < count; i++)
+            {
+                segments[i] = reader.ReadInt32();
+            }
+            return new LineIndex(lineEndingInfo, bomLength, longestLine, segments);
+        }
+    }
+}
@@ -28,12 +28,17 @@ using TreeLib;
 
 namespace TextEditor
 {
+    // Segments of consecutive lines with their total byte length, used to seek to a line without walking from the
+    // start. A segment is limited both in lines (Sparseness) and in bytes (ByteBudget, so that files with long lines
+    // don't leave megabytes to scan between entries); a single line longer than the budget is a segment by itself.
     public class LineSkipMap
     {
 #if DEBUG
         public const int Sparseness = 5;
+        public const int ByteBudget = 256;
 #else
         public const int Sparseness = 4096;
+        public const int ByteBudget = 65536;
 #endif
         // index 0 is reserved for prefix placeholder, so all lines are offset by +1
         private readonly SplayTreeRange2List map = new SplayTreeRange2List();
@@ -45,6 +50,34 @@ namespace TextEditor
             map.Insert(1, Side.X, 1, suffixLength);
         }
 
+        // Segments as (line count, byte length) pairs, first line first, for saving the index of a loaded file and
+        // reinstating it with Restore() instead of rescanning.
+        public int[] GetSegments()
+        {
+            List<int> segments = new List<int>();
+            int line = 0;
+            do
+            {
+                int numLines, charIndex, charLength;
+                GetCountYExtent(line, out numLines, out charIndex, out charLength);
+                segments.Add(numLines);
+                segments.Add(charLength);
+            } while (Next(line, out line));
+            return segments.ToArray();
+        }
+
+        public void Restore(int prefixLength, int[] segments)
+        {
+            map.Clear();
+            map.Insert(0, Side.X, 1, prefixLength);
+            int line = 1;
+            for (int i = 0; i < segments.Length; i += 2)
+            {
+                map.Insert(line, Side.X, segments[i], segments[i + 1]);
+                line += segments[i];
+            }
+        }
+
         public void GetCountYExtent(int line, out int numLines, out int charIndex, out int charLength)
         {
             line++;
@@ -105,6 +138,70 @@ namespace TextEditor
             map.Insert(startLine, Side.X, numLines, charLength);
         }
 
+        // ensure a segment boundary exists at line, given the absolute char offset of the start of that line
+        public void SplitAt(int line, int charOffset)
+        {
+            line++;
+            if (line >= map.GetExtent(Side.X))
+            {
+                return;
+            }
+            int startLine, numLines, charIndex, charLength;
+            map.NearestLessOrEqual(line, Side.X, out startLine);
+            if (startLine == line)
+            {
+                return;
+            }
+            map.Get(startLine, Side.X, out charIndex, out numLines, out charLength);
+            Debug.Assert((charOffset > charIndex) && (charOffset < charIndex + charLength));
+            map.Delete(startLine, Side.X);
+            map.Insert(startLine, Side.X, line - startLine, charOffset - charIndex);
+            map.Insert(line, Side.X, startLine + numLines - line, charIndex + charLength - charOffset);
+        }
+
+        // insert a segment - line must be at a segment boundary (see SplitAt)
+        public void InsertSegment(int line, int numLines, int charLength)
+        {
+            Debug.Assert((numLines > 0) && (charLength > 0));
+            line++;
+            map.Insert(line, Side.X, numLines, charLength);
+        }
+
+        // remove segments spanning exactly [line, line + count) - boundaries must exist at both ends
+        public void RemoveSegments(int line, int count)
+        {
+            line++;
+            while (count > 0)
+            {
+                int charIndex, numLines, charLength;
+                map.Get(line, Side.X, out charIndex, out numLines, out charLength);
+                Debug.Assert(numLines <= count);
+                map.Delete(line, Side.X);
+                count -= numLines;
+            }
+        }
+
+        // merge segment containing line with its successor if the result does not exceed Sparseness or ByteBudget
+        public void Coalesce(int line)
+        {
+            line++;
+            int startLine, numLines, charIndex, charLength;
+            map.NearestLessOrEqual(line, Side.X, out startLine);
+            map.Get(startLine, Side.X, out charIndex, out numLines, out charLength);
+            int nextStartLine;
+            if (map.NearestGreater(startLine, Side.X, out nextStartLine))
+            {
+                int nextNumLines, nextCharIndex, nextCharLength;
+                map.Get(nextStartLine, Side.X, out nextCharIndex, out nextNumLines, out nextCharLength);
+                if ((numLines + nextNumLines <= Sparseness) && (charLength + nextCharLength <= ByteBudget))
+                {
+                    map.Delete(nextStartLine, Side.X);
+                    map.Delete(startLine, Side.X);
+                    map.Insert(startLine, Side.X, numLines + nextNumLines, charLength + nextCharLength);
+                }
+            }
+        }
+
         public delegate int GetOffsetOfLineMethod(int line);
 
         public void LineInserted(int lineEndOf, int charsAdded, GetOffsetOfLineMethod getOffsetOfLine)
@@ -119,7 +216,7 @@ namespace TextEditor
             charLength += charsAdded;
             map.Insert(startLine, Side.X, numLines, charLength);
 
-            if (numLines > Sparseness)
+            if ((numLines > Sparseness) || ((charLength > ByteBudget) && (numLines > 1)))
             {
                 int midpointLine = startLine + numLines / 2;
                 midpointLine--;
@@ -153,9 +250,12 @@ namespace TextEditor
                 {
                     int nextNumLines, nextCharIndex, nextCharLength;
                     map.Get(nextStartLine, Side.X, out nextCharIndex, out nextNumLines, out nextCharLength);
-                    map.Delete(nextStartLine, Side.X);
-                    map.Delete(startLine, Side.X);
-                    map.Insert(startLine, Side.X, numLines + nextNumLines, charLength + nextCharLength);
+                    if (charLength + nextCharLength <= ByteBudget)
+                    {
+                        map.Delete(nextStartLine, Side.X);
+                        map.Delete(startLine, Side.X);
+                        map.Insert(startLine, Side.X, numLines + nextNumLines, charLength + nextCharLength);
+                    }
                 }
             }
         }
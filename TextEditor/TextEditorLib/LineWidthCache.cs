@@ -28,15 +28,35 @@ namespace TextEditor
 {
     public class LineWidthCache
     {
-        private const int MaxCount = 512;
 #if DEBUG
         private static readonly bool EnableLogging = false;
 #else
         private const bool EnableLogging = false;
 #endif
 
-        private int start;
-        private readonly List<int> widths = new List<int>(MaxCount); // as 1s-complement, so default (0) can mean invalid
+        private readonly SparseLineCache<int> widths; // as 1s-complement, so default (0) can mean invalid
+
+        public LineWidthCache()
+        {
+            widths = new SparseLineCache<int>();
+        }
+
+        public LineWidthCache(int blockLines, int maxBlocks)
+        {
+            widths = new SparseLineCache<int>(blockLines, maxBlocks);
+        }
+
+        // for tuning cache size
+        public long Hits { get { return widths.Hits; } }
+        public long Misses { get { return widths.Misses; } }
+        public long Evictions { get { return widths.Evictions; } }
+        public double HitRate { get { return widths.HitRate; } }
+        public int BlockCount { get { return widths.BlockCount; } }
+
+        public void ResetStatistics()
+        {
+            widths.ResetStatistics();
+        }
 
         public void Clear()
         {
@@ -46,18 +66,9 @@ namespace TextEditor
                 Debugger.Log(0, "TextViewControl.LineWidthCache", "LineWidthCache.Clear()" + Environment.NewLine);
             }
 #endif
-            start = 0;
             widths.Clear();
         }
 
-        // Commentary on InsertRange(..., new int[count]) below:
-        // It's a pity they don't support InsertRangeDefaultValue() or something to make space and zero-init.
-        // One could write a special enumerator that returns 'count' zeroes. However, as the interface takes an IEnumerable,
-        // that involves allocating TWO objects, each of which having at least one 'int' member variable and customary
-        // heap overhead. So it turns out to be cheaper in the common case (inserting a line or two) to just do
-        // 'new int[count]'. In the worst case, the allocated array will never exceed MaxCount elements. And there is less
-        // code to have bugs in.
-
         public void Set(int index, int width)
         {
 #if DEBUG
@@ -68,32 +79,7 @@ namespace TextEditor
 #endif
 
             Debug.Assert(width >= 0);
-            if ((widths.Count != 0) && ((index - start >= MaxCount) || (start + widths.Count - index >= MaxCount)))
-            {
-                Clear();
-            }
-
-            if (widths.Count == 0)
-            {
-                start = index;
-                widths.Add(~width);
-            }
-            else
-            {
-                if (index < start)
-                {
-                    widths.InsertRange(0, new int[start - index]);
-                    start = index;
-                }
-                else if (index < start + widths.Count)
-                {
-                }
-                else
-                {
-                    widths.AddRange(new int[index + 1 - (start + widths.Count)]);
-                }
-                widths[index - start] = ~width;
-            }
+            widths.Set(index, ~width);
 #if DEBUG
             if (EnableLogging)
             {
@@ -111,16 +97,7 @@ namespace TextEditor
             }
 #endif
 
-            if (index < start)
-            {
-            }
-            else if (index < start + widths.Count)
-            {
-                widths[index - start] = 0;
-            }
-            else
-            {
-            }
+            widths.Invalidate(index);
 #if DEBUG
             if (EnableLogging)
             {
@@ -131,24 +108,14 @@ namespace TextEditor
 
         public bool TryGet(int index, out int width)
         {
-            bool result = false;
-            width = 0;
-            if (index < start)
+            int w;
+            if (widths.TryGet(index, out w))
             {
+                width = ~w;
+                return true;
             }
-            else if (index < start + widths.Count)
-            {
-                int w = widths[index - start];
-                if (~w >= 0)
-                {
-                    width = ~w;
-                    result = true;
-                }
-            }
-            else
-            {
-            }
-            return result;
+            width = 0;
+            return false;
         }
 
         public void Insert(int index, int count)
@@ -160,24 +127,7 @@ namespace TextEditor
             }
 #endif
 
-            if (widths.Count + count > MaxCount)
-            {
-                Clear();
-            }
-            else
-            {
-                if (index <= start)
-                {
-                    start += count;
-                }
-                else if (index <= start + widths.Count)
-                {
-                    widths.InsertRange(index - start, new int[count]);
-                }
-                else
-                {
-                }
-            }
+            widths.Insert(index, count);
 #if DEBUG
             if (EnableLogging)
             {
@@ -195,33 +145,7 @@ namespace TextEditor
             }
 #endif
 
-            if (index + count <= start)
-            {
-                start -= count;
-            }
-            else if (index <= start)
-            {
-                int before = start - index;
-                int after = count - before;
-                if (after > widths.Count)
-                {
-                    after = widths.Count;
-                }
-                widths.RemoveRange(0, after);
-                start -= before;
-            }
-            else if (index < start + widths.Count)
-            {
-                int within = widths.Count - (index - start);
-                if (within > count)
-                {
-                    within = count;
-                }
-                widths.RemoveRange(index - start, within);
-            }
-            else
-            {
-            }
+            widths.Delete(index, count);
 #if DEBUG
             if (EnableLogging)
             {
@@ -234,18 +158,7 @@ namespace TextEditor
         private void Dump()
         {
             Debug.Assert(EnableLogging);
-            Debugger.Log(0, "TextViewControl.LineWidthCache", String.Format("LineWidthCache: start={0}, count={1}" + Environment.NewLine, start, widths.Count));
-            StringBuilder indices = new StringBuilder();
-            StringBuilder values = new StringBuilder();
-            for (int i = 0; i < widths.Count; i++)
-            {
-                indices.AppendFormat("{0,-8}", i + start);
-                values.AppendFormat("{0,-8}", widths[i] != 0 ? (~widths[i]).ToString() : "inv");
-            }
-            indices.AppendLine();
-            values.AppendLine();
-            Debugger.Log(0, "TextViewControl.LineWidthCache", indices.ToString());
-            Debugger.Log(0, "TextViewControl.LineWidthCache", values.ToString());
+            Debugger.Log(0, "TextViewControl.LineWidthCache", "LineWidthCache: " + widths.Dump(delegate (int w) { return (~w).ToString(); }));
         }
 #endif
     }
@@ -0,0 +1,467 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Drawing;
+using System.Globalization;
+
+namespace TextEditor
+{
+    // Layout of a line too long to shape as a unit (minified code, single-line logs and data files). The tab-expanded
+    // text is split into segments at positions where shaping cannot interact across the split - preferably following
+    // whitespace - and each segment is analyzed independently, only when drawn or hit-tested. Segment widths are
+    // measured left to right on demand into a prefix-width index, so the cost of painting depends on the visible width
+    // rather than the line length, and x <-> column mapping is a binary search plus analysis of a single segment.
+    // Bidirectional reordering is confined to a segment, so the owner uses this only for left-to-right layout.
+    public class LongLineLayout
+    {
+#if DEBUG
+        public const int Threshold = 256; // columns
+        private const int SegmentLength = 64;
+        private const int BreakSearch = 16;
+        private const int NavigationWindow = 64;
+#else
+        public const int Threshold = 16384; // columns
+        private const int SegmentLength = 1024;
+        private const int BreakSearch = 128;
+        private const int NavigationWindow = 4096;
+#endif
+
+        private readonly ITextService service;
+        private readonly Font font;
+        private readonly int fontHeight;
+        private readonly string text; // tab-expanded
+        private readonly int[] starts; // first column of each segment, followed by text length
+        private readonly List<int> prefixWidths = new List<int>(); // x of each segment start, through end of last measured
+        private ColorRun[] colorRuns; // for whole line; null if not yet provided
+
+        public LongLineLayout(ITextService service, Font font, int fontHeight, string text)
+        {
+            this.service = service;
+            this.font = font;
+            this.fontHeight = fontHeight;
+            this.text = text;
+            this.starts = Split(text);
+            prefixWidths.Add(0);
+        }
+
+        public string Text { get { return text; } }
+
+        public int Length { get { return text.Length; } }
+
+        private int SegmentCount { get { return starts.Length - 1; } }
+
+        // a break before index does not split a surrogate pair or separate a character from following combining marks,
+        // and does not fall next to a joiner
+        public static bool IsSafeBreak(string text, int index)
+        {
+            if ((index <= 0) || (index >= text.Length))
+            {
+                return true;
+            }
+            char previous = text[index - 1];
+            char next = text[index];
+            if (Char.IsHighSurrogate(previous) || Char.IsLowSurrogate(next))
+            {
+                return false;
+            }
+            if ((previous == '\u200C') || (previous == '\u200D') || (next == '\u200C') || (next == '\u200D'))
+            {
+                return false;
+            }
+            switch (CharUnicodeInfo.GetUnicodeCategory(next))
+            {
+                case UnicodeCategory.NonSpacingMark:
+                case UnicodeCategory.SpacingCombiningMark:
+                case UnicodeCategory.EnclosingMark:
+                    return false;
+            }
+            return true;
+        }
+
+        // safe break at or before target and after limit (limit >= 0, target < text length), preferring one that
+        // follows whitespace
+        private static int FindBreak(string text, int target, int limit)
+        {
+            Debug.Assert((limit >= 0) && (limit < target) && (target < text.Length));
+            int lowest = Math.Max(target - BreakSearch, limit + 1);
+            for (int i = target; i >= lowest; i--)
+            {
+                if (Char.IsWhiteSpace(text[i - 1]) && IsSafeBreak(text, i))
+                {
+                    return i;
+                }
+            }
+            for (int i = target; i >= lowest; i--)
+            {
+                if (IsSafeBreak(text, i))
+                {
+                    return i;
+                }
+            }
+            return target; // pathological run of combining marks - split regardless
+        }
+
+        private static int[] Split(string text)
+        {
+            List<int> starts = new List<int>();
+            int start = 0;
+            starts.Add(start);
+            while (text.Length - start > SegmentLength)
+            {
+                start = FindBreak(text, start + SegmentLength, start);
+                starts.Add(start);
+            }
+            starts.Add(text.Length);
+            return starts.ToArray();
+        }
+
+        // Portion of a stored (not tab-expanded) line to analyze for caret and word navigation from index: the whole
+        // line ordinarily, or for a long line a window around index bounded by safe breaks. Returns the start of the
+        // window in offset.
+        public static string GetNavigationText(string line, int index, out int offset)
+        {
+            offset = 0;
+            if (line.Length < Threshold)
+            {
+                return line;
+            }
+            int start = index - NavigationWindow / 2 <= 0
+                ? 0
+                : FindBreak(line, index - NavigationWindow / 2, Math.Max(index - NavigationWindow, 0));
+            int end = index + NavigationWindow / 2 >= line.Length
+                ? line.Length
+                : FindBreak(line, index + NavigationWindow / 2, index);
+            offset = start;
+            return line.Substring(start, end - start);
+        }
+
+        private ITextInfo Analyze(Graphics graphics, int segment)
+        {
+            return service.AnalyzeText(
+                graphics,
+                font,
+                fontHeight,
+                text.Substring(starts[segment], starts[segment + 1] - starts[segment]));
+        }
+
+        // extend prefix widths through the end of segment
+        private void MeasureThrough(Graphics graphics, int segment)
+        {
+            while (prefixWidths.Count <= segment + 1)
+            {
+                int i = prefixWidths.Count - 1;
+                using (ITextInfo info = Analyze(graphics, i))
+                {
+                    prefixWidths.Add(prefixWidths[i] + info.GetExtent(graphics).Width);
+                }
+            }
+        }
+
+        // segment containing x, measuring only as far as needed; positions beyond either end map to the end segments
+        private int SegmentFromX(Graphics graphics, int x)
+        {
+            while ((prefixWidths[prefixWidths.Count - 1] <= x) && (prefixWidths.Count - 1 < SegmentCount))
+            {
+                MeasureThrough(graphics, prefixWidths.Count - 1);
+            }
+
+            // last segment starting at or before x
+            int lo = 0;
+            int hi = prefixWidths.Count;
+            while (lo < hi)
+            {
+                int mid = lo + (hi - lo) / 2;
+                if (prefixWidths[mid] <= x)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            return Math.Max(Math.Min(lo - 1, SegmentCount - 1), 0);
+        }
+
+        // segment containing column; the end of the line belongs to the last segment
+        private int SegmentFromColumn(int column)
+        {
+            int k = Array.BinarySearch(starts, column);
+            if (k < 0)
+            {
+                k = ~k - 1;
+            }
+            return Math.Max(Math.Min(k, SegmentCount - 1), 0);
+        }
+
+        // segments intersecting [0, clipWidth) when the line is positioned at x, measuring as needed
+        private IEnumerable<int> VisibleSegments(Graphics graphics, int x, int clipWidth)
+        {
+            for (int k = SegmentFromX(graphics, -x); (k < SegmentCount) && (x + prefixWidths[k] < clipWidth); k++)
+            {
+                MeasureThrough(graphics, k);
+                yield return k;
+            }
+        }
+
+        // Exact once every segment has been measured, otherwise extrapolated from those measured so far (never less
+        // than the measured prefix). The owner's canvas size is refined as more of the line comes into view.
+        public int GetWidth(Graphics graphics)
+        {
+            MeasureThrough(graphics, 0);
+            int measured = prefixWidths.Count - 1;
+            int width = prefixWidths[measured];
+            if (measured < SegmentCount)
+            {
+                width += (int)((long)width * (text.Length - starts[measured]) / starts[measured]);
+            }
+            return width;
+        }
+
+        public bool HasColorRuns { get { return colorRuns != null; } }
+
+        public void SetColorRuns(List<ColorRun> runs)
+        {
+            colorRuns = runs.ToArray();
+        }
+
+        public void InvalidateColorRuns()
+        {
+            colorRuns = null;
+        }
+
+        // color runs of a line clipped to [start, end), relative to start
+        public static List<ColorRun> ClipColorRuns(IList<ColorRun> colorRuns, int start, int end)
+        {
+            // runs are ordered and disjoint - find first one ending after start
+            int lo = 0;
+            int hi = colorRuns.Count;
+            while (lo < hi)
+            {
+                int mid = lo + (hi - lo) / 2;
+                if (colorRuns[mid].start + colorRuns[mid].length <= start)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+
+            List<ColorRun> runs = new List<ColorRun>();
+            for (int i = lo; (i < colorRuns.Count) && (colorRuns[i].start < end); i++)
+            {
+                int runStart = Math.Max(colorRuns[i].start, start);
+                int runEnd = Math.Min(colorRuns[i].start + colorRuns[i].length, end);
+                runs.Add(new ColorRun(runStart - start, runEnd - runStart, colorRuns[i].color));
+            }
+            return runs;
+        }
+
+        public void DrawText(
+            Graphics graphics,
+            Bitmap backing,
+            Point position,
+            int clipWidth,
+            Color foreColor,
+            Color backColor,
+            bool applyColorRuns)
+        {
+            foreach (int k in VisibleSegments(graphics, position.X, clipWidth))
+            {
+                using (ITextInfo info = Analyze(graphics, k))
+                {
+                    ITextInfoColorRuns infoColorRuns;
+                    if (applyColorRuns && (colorRuns != null) && ((infoColorRuns = info as ITextInfoColorRuns) != null))
+                    {
+                        infoColorRuns.SetColorRuns(ClipColorRuns(colorRuns, starts[k], starts[k + 1]));
+                    }
+                    info.DrawText(
+                        graphics,
+                        backing,
+                        new Point(position.X + prefixWidths[k], position.Y),
+                        foreColor,
+                        backColor);
+                }
+            }
+        }
+
+        // region covering the visible part of the column range
+        public Region BuildRegion(
+            Graphics graphics,
+            Point position,
+            int clipWidth,
+            int startColumn,
+            int endColumnPlusOne)
+        {
+            Region region = new Region(Rectangle.Empty);
+            foreach (int k in VisibleSegments(graphics, position.X, clipWidth))
+            {
+                int start = Math.Max(startColumn, starts[k]);
+                int end = Math.Min(endColumnPlusOne, starts[k + 1]);
+                if (start < end)
+                {
+                    using (ITextInfo info = Analyze(graphics, k))
+                    {
+                        using (Region part = info.BuildRegion(
+                            graphics,
+                            new Point(position.X + prefixWidths[k], position.Y),
+                            start - starts[k],
+                            end - starts[k]))
+                        {
+                            region.Union(part);
+                        }
+                    }
+                }
+            }
+            return region;
+        }
+
+        public int ColumnToX(Graphics graphics, int column, bool trailing)
+        {
+            int k = SegmentFromColumn(column);
+            MeasureThrough(graphics, k - 1);
+            using (ITextInfo info = Analyze(graphics, k))
+            {
+                int x;
+                info.CharPosToX(graphics, column - starts[k], trailing, out x);
+                return prefixWidths[k] + x;
+            }
+        }
+
+        public int XToColumn(Graphics graphics, int x)
+        {
+            int k = SegmentFromX(graphics, x);
+            using (ITextInfo info = Analyze(graphics, k))
+            {
+                int offset;
+                bool trailing;
+                info.XToCharPos(graphics, x - prefixWidths[k], out offset, out trailing);
+                return starts[k] + offset;
+            }
+        }
+    }
+
+    // Layouts of recently used long lines, with the same edit notification protocol as LineWidthCache. Entries depend
+    // on font, text service and tab size, so owner must Clear() when any of them changes.
+    public class LongLineLayoutCache
+    {
+        private const int Capacity = 4;
+
+        private class Entry
+        {
+            public int index;
+            public LongLineLayout layout;
+        }
+
+        private readonly List<Entry> entries = new List<Entry>(); // most recently used first
+
+        public void Clear()
+        {
+            entries.Clear();
+        }
+
+        public void Set(int index, LongLineLayout layout)
+        {
+            Invalidate(index);
+            Entry entry = new Entry();
+            entry.index = index;
+            entry.layout = layout;
+            entries.Insert(0, entry);
+            if (entries.Count > Capacity)
+            {
+                entries.RemoveAt(entries.Count - 1);
+            }
+        }
+
+        public void Invalidate(int index)
+        {
+            entries.RemoveAll(delegate (Entry entry) { return entry.index == index; });
+        }
+
+        public bool TryGet(int index, out LongLineLayout layout)
+        {
+            for (int i = 0; i < entries.Count; i++)
+            {
+                Entry entry = entries[i];
+                if (entry.index == index)
+                {
+                    entries.RemoveAt(i);
+                    entries.Insert(0, entry);
+                    layout = entry.layout;
+                    return true;
+                }
+            }
+            layout = null;
+            return false;
+        }
+
+        public void Insert(int index, int count)
+        {
+            foreach (Entry entry in entries)
+            {
+                if (entry.index >= index)
+                {
+                    entry.index += count;
+                }
+            }
+        }
+
+        public void Delete(int index, int count)
+        {
+            entries.RemoveAll(delegate (Entry entry) { return (entry.index >= index) && (entry.index < index + count); });
+            foreach (Entry entry in entries)
+            {
+                if (entry.index >= index + count)
+                {
+                    entry.index -= count;
+                }
+            }
+        }
+
+        // characters held by the cached layouts (each keeps a copy of its line)
+        public long TextLength
+        {
+            get
+            {
+                long length = 0;
+                foreach (Entry entry in entries)
+                {
+                    length += entry.layout.Length;
+                }
+                return length;
+            }
+        }
+
+        // syntax colors depend on state carried from preceding lines
+        public void InvalidateColorRuns()
+        {
+            foreach (Entry entry in entries)
+            {
+                entry.layout.InvalidateColorRuns();
+            }
+        }
+    }
+}
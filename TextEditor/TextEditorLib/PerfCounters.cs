@@ -0,0 +1,402 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Text;
+using System.Threading;
+
+namespace TextEditor
+{
+    public enum PerfCounter
+    {
+        AnalyzeText,
+        DrawText,
+        RedrawRange,
+        MoveTo,
+        GetLine,
+        InsertSection,
+        DeleteSection,
+        Load,
+        Save,
+        Append, // new data of a followed file
+    }
+
+    // Lightweight, always-compiled instrumentation of hot paths. Call sites bracket work with
+    //     long perf = PerfCounters.Begin();
+    //     ...
+    //     PerfCounters.End(PerfCounter.X, perf);
+    // When disabled, Begin() is a test of a static field returning zero and End() a test of its argument. When enabled,
+    // each thread accumulates counts, total and maximum durations, and a log2 histogram of durations into its own
+    // counters (no locking or interlocked operations), and optionally records trace events into a per-thread ring for
+    // export in Chrome trace format (chrome://tracing, Perfetto). Readers take unsynchronized snapshots, which may be
+    // momentarily inconsistent but are adequate for diagnostics. Brackets keep no state besides the caller's start
+    // timestamp (there is no nesting), so a bracket abandoned by an exception only loses that sample - call sites whose
+    // work can throw end the bracket in a finally so that failing calls are still counted.
+    public static class PerfCounters
+    {
+        public static readonly int CounterCount = Enum.GetValues(typeof(PerfCounter)).Length;
+        public const int HistogramBuckets = 32; // bucket i holds durations in [2^(i-1), 2^i) microseconds
+#if DEBUG
+        private const int TraceCapacity = 1024;
+#else
+        private const int TraceCapacity = 65536;
+#endif
+
+        private static bool enabled;
+        private static bool tracing;
+        private static long epoch = Stopwatch.GetTimestamp();
+        private static readonly double MicrosecondsPerTick = 1000000d / Stopwatch.Frequency;
+
+        private static readonly List<ThreadCounters> threads = new List<ThreadCounters>();
+        [ThreadStatic]
+        private static ThreadCounters current;
+
+        private struct TraceEvent
+        {
+            public PerfCounter counter;
+            public long start;
+            public long end;
+            public bool gc; // collection occurred during the event
+        }
+
+        private class ThreadCounters
+        {
+            public readonly int threadId;
+            public readonly string threadName;
+            public readonly long[] counts = new long[CounterCount];
+            public readonly long[] ticks = new long[CounterCount];
+            public readonly long[] maxTicks = new long[CounterCount];
+            public readonly long[] histogram = new long[CounterCount * HistogramBuckets];
+            public TraceEvent[] trace;
+            public long traceTotal; // events ever written to ring
+            public int lastGen0Count;
+
+            public ThreadCounters()
+            {
+                threadId = Thread.CurrentThread.ManagedThreadId;
+                threadName = Thread.CurrentThread.Name ?? String.Format("Thread {0}", threadId);
+                lastGen0Count = GC.CollectionCount(0);
+            }
+
+            public void Clear()
+            {
+                Array.Clear(counts, 0, counts.Length);
+                Array.Clear(ticks, 0, ticks.Length);
+                Array.Clear(maxTicks, 0, maxTicks.Length);
+                Array.Clear(histogram, 0, histogram.Length);
+                traceTotal = 0;
+            }
+        }
+
+        public static bool Enabled
+        {
+            get
+            {
+                return enabled;
+            }
+            set
+            {
+                enabled = value;
+            }
+        }
+
+        // record trace events as well as counters (only while enabled)
+        public static bool Tracing
+        {
+            get
+            {
+                return tracing;
+            }
+            set
+            {
+                tracing = value;
+            }
+        }
+
+        public static long Begin()
+        {
+            return enabled ? Stopwatch.GetTimestamp() : 0;
+        }
+
+        public static void End(PerfCounter counter, long start)
+        {
+            if (start != 0)
+            {
+                Record(counter, start, Stopwatch.GetTimestamp());
+            }
+        }
+
+        private static void Record(PerfCounter counter, long start, long end)
+        {
+            ThreadCounters counters = current;
+            if (counters == null)
+            {
+                counters = current = new ThreadCounters();
+                lock (threads)
+                {
+                    threads.Add(counters);
+                }
+            }
+
+            int index = (int)counter;
+            long elapsed = end - start;
+            counters.counts[index]++;
+            counters.ticks[index] += elapsed;
+            if (counters.maxTicks[index] < elapsed)
+            {
+                counters.maxTicks[index] = elapsed;
+            }
+            counters.histogram[index * HistogramBuckets + GetBucket(elapsed)]++;
+
+            if (tracing)
+            {
+                if (counters.trace == null)
+                {
+                    counters.trace = new TraceEvent[TraceCapacity];
+                }
+                int gen0Count = GC.CollectionCount(0);
+                TraceEvent traceEvent;
+                traceEvent.counter = counter;
+                traceEvent.start = start;
+                traceEvent.end = end;
+                traceEvent.gc = gen0Count != counters.lastGen0Count;
+                counters.lastGen0Count = gen0Count;
+                counters.trace[(int)(counters.traceTotal % TraceCapacity)] = traceEvent;
+                counters.traceTotal++;
+            }
+        }
+
+        private static int GetBucket(long elapsedTicks)
+        {
+            long microseconds = (long)(elapsedTicks * MicrosecondsPerTick);
+            int bucket = 0;
+            while ((microseconds != 0) && (bucket < HistogramBuckets - 1))
+            {
+                microseconds >>= 1;
+                bucket++;
+            }
+            return bucket;
+        }
+
+        public static void Reset()
+        {
+            lock (threads)
+            {
+                foreach (ThreadCounters counters in threads)
+                {
+                    counters.Clear();
+                }
+                epoch = Stopwatch.GetTimestamp();
+            }
+        }
+
+        public static PerfSnapshot GetSnapshot()
+        {
+            PerfSnapshot snapshot = new PerfSnapshot();
+            snapshot.timestamp = Stopwatch.GetTimestamp();
+            for (int generation = 0; generation < snapshot.collections.Length; generation++)
+            {
+                snapshot.collections[generation] = GC.CollectionCount(generation);
+            }
+            lock (threads)
+            {
+                foreach (ThreadCounters counters in threads)
+                {
+                    for (int i = 0; i < CounterCount; i++)
+                    {
+                        snapshot.counts[i] += counters.counts[i];
+                        snapshot.ticks[i] += counters.ticks[i];
+                        snapshot.maxTicks[i] = Math.Max(snapshot.maxTicks[i], counters.maxTicks[i]);
+                    }
+                    for (int i = 0; i < snapshot.histogram.Length; i++)
+                    {
+                        snapshot.histogram[i] += counters.histogram[i];
+                    }
+                }
+            }
+            return snapshot;
+        }
+
+        // Write recorded trace events (the most recent TraceCapacity per thread) in Chrome trace event format.
+        public static void WriteChromeTrace(TextWriter writer)
+        {
+            writer.WriteLine("{\"traceEvents\":[");
+            bool first = true;
+            lock (threads)
+            {
+                foreach (ThreadCounters counters in threads)
+                {
+                    WriteTraceSeparator(writer, ref first);
+                    writer.Write(String.Format(
+                        CultureInfo.InvariantCulture,
+                        "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{0},\"args\":{{\"name\":\"{1}\"}}}}",
+                        counters.threadId,
+                        counters.threadName.Replace("\\", "\\\\").Replace("\"", "\\\"")));
+
+                    if (counters.trace == null)
+                    {
+                        continue;
+                    }
+                    long total = counters.traceTotal;
+                    for (long i = Math.Max(total - TraceCapacity, 0); i < total; i++)
+                    {
+                        TraceEvent traceEvent = counters.trace[(int)(i % TraceCapacity)];
+                        if (traceEvent.start < epoch)
+                        {
+                            continue;
+                        }
+                        WriteTraceSeparator(writer, ref first);
+                        writer.Write(String.Format(
+                            CultureInfo.InvariantCulture,
+                            "{{\"name\":\"{0}\",\"cat\":\"TextEditor\",\"ph\":\"X\",\"pid\":1,\"tid\":{1},\"ts\":{2:F1},\"dur\":{3:F1}}}",
+                            traceEvent.counter,
+                            counters.threadId,
+                            (traceEvent.start - epoch) * MicrosecondsPerTick,
+                            (traceEvent.end - traceEvent.start) * MicrosecondsPerTick));
+                        if (traceEvent.gc)
+                        {
+                            WriteTraceSeparator(writer, ref first);
+                            writer.Write(String.Format(
+                                CultureInfo.InvariantCulture,
+                                "{{\"name\":\"GC\",\"cat\":\"TextEditor\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":{0},\"ts\":{1:F1}}}",
+                                counters.threadId,
+                                (traceEvent.end - epoch) * MicrosecondsPerTick));
+                        }
+                    }
+                }
+            }
+            writer.WriteLine();
+            writer.WriteLine("]}");
+        }
+
+        private static void WriteTraceSeparator(TextWriter writer, ref bool first)
+        {
+            if (!first)
+            {
+                writer.WriteLine(",");
+            }
+            first = false;
+        }
+    }
+
+    // Aggregate of all threads' counters at a point in time. The difference of two snapshots gives the activity in the
+    // interval between them, from which a rolling histogram is maintained by keeping a window of recent snapshots.
+    public class PerfSnapshot
+    {
+        public long timestamp;
+        public readonly long[] counts = new long[PerfCounters.CounterCount];
+        public readonly long[] ticks = new long[PerfCounters.CounterCount];
+        public readonly long[] maxTicks = new long[PerfCounters.CounterCount]; // over all time, not interval
+        public readonly long[] histogram = new long[PerfCounters.CounterCount * PerfCounters.HistogramBuckets];
+        public readonly int[] collections = new int[3];
+
+        public PerfSnapshot Subtract(PerfSnapshot earlier)
+        {
+            PerfSnapshot difference = new PerfSnapshot();
+            difference.timestamp = timestamp - earlier.timestamp;
+            for (int i = 0; i < counts.Length; i++)
+            {
+                difference.counts[i] = counts[i] - earlier.counts[i];
+                difference.ticks[i] = ticks[i] - earlier.ticks[i];
+                difference.maxTicks[i] = maxTicks[i];
+            }
+            for (int i = 0; i < histogram.Length; i++)
+            {
+                difference.histogram[i] = histogram[i] - earlier.histogram[i];
+            }
+            for (int i = 0; i < collections.Length; i++)
+            {
+                difference.collections[i] = collections[i] - earlier.collections[i];
+            }
+            return difference;
+        }
+
+        // upper bound (microseconds) of histogram bucket containing the percentile (0..100)
+        public long Percentile(PerfCounter counter, double percentile)
+        {
+            int index = (int)counter;
+            long target = (long)Math.Ceiling(counts[index] * percentile / 100);
+            long seen = 0;
+            for (int bucket = 0; bucket < PerfCounters.HistogramBuckets; bucket++)
+            {
+                seen += histogram[index * PerfCounters.HistogramBuckets + bucket];
+                if ((seen >= target) && (seen != 0))
+                {
+                    return 1L << bucket;
+                }
+            }
+            return 0;
+        }
+
+        public override string ToString()
+        {
+            double microsecondsPerTick = 1000000d / Stopwatch.Frequency;
+            StringBuilder sb = new StringBuilder();
+            sb.AppendLine(String.Format(
+                "{0,-14}{1,12}{2,12}{3,10}{4,10}{5,10}{6,12}",
+                "Counter",
+                "Count",
+                "Total ms",
+                "Mean us",
+                "p50 us<",
+                "p99 us<",
+                "Max us"));
+            for (int i = 0; i < counts.Length; i++)
+            {
+                sb.AppendLine(String.Format(
+                    "{0,-14}{1,12:N0}{2,12:N1}{3,10:N1}{4,10:N0}{5,10:N0}{6,12:N0}",
+                    (PerfCounter)i,
+                    counts[i],
+                    ticks[i] * microsecondsPerTick / 1000,
+                    counts[i] != 0 ? ticks[i] * microsecondsPerTick / counts[i] : 0,
+                    Percentile((PerfCounter)i, 50),
+                    Percentile((PerfCounter)i, 99),
+                    maxTicks[i] * microsecondsPerTick));
+            }
+            sb.AppendLine();
+            sb.AppendLine(String.Format("GC collections: gen0 {0:N0}, gen1 {1:N0}, gen2 {2:N0}", collections[0], collections[1], collections[2]));
+            sb.AppendLine();
+            sb.AppendLine("Histogram (us upper bound: count)");
+            for (int i = 0; i < counts.Length; i++)
+            {
+                if (counts[i] == 0)
+                {
+                    continue;
+                }
+                sb.Append(String.Format("{0,-14}", (PerfCounter)i));
+                for (int bucket = 0; bucket < PerfCounters.HistogramBuckets; bucket++)
+                {
+                    long count = histogram[i * PerfCounters.HistogramBuckets + bucket];
+                    if (count != 0)
+                    {
+                        sb.Append(String.Format(" {0}:{1}", 1L << bucket, count));
+                    }
+                }
+                sb.AppendLine();
+            }
+            return sb.ToString();
+        }
+    }
+}
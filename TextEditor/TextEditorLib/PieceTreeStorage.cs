@@ -0,0 +1,920 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Text;
+
+namespace TextEditor
+{
+    // Piece tree storage: the text is a sequence of pieces referring to append-only character chunks, with lines
+    // separated by '\n'. Pieces are kept in a randomized balanced binary tree whose nodes carry subtree UTF-16 length
+    // and line break counts, giving O(log n) insert, delete, line lookup and line/offset conversion anywhere in the
+    // document. Nodes are immutable (updates copy the path from the root) so sections can be cloned or inserted by
+    // sharing subtrees rather than copying text.
+    public class PieceTreeStorageFactory : StringStorageFactory
+    {
+        private sealed class Node
+        {
+            // piece
+            public readonly char[] chunk;
+            public readonly int start;
+            public readonly int length;
+            public readonly int lineBreaks;
+
+            public readonly Node left;
+            public readonly Node right;
+
+            // subtree aggregates
+            public readonly int count;
+            public readonly int totalLength;
+            public readonly int totalLineBreaks;
+
+            public Node(char[] chunk, int start, int length, int lineBreaks, Node left, Node right)
+            {
+                this.chunk = chunk;
+                this.start = start;
+                this.length = length;
+                this.lineBreaks = lineBreaks;
+                this.left = left;
+                this.right = right;
+
+                this.count = 1 + Count(left) + Count(right);
+                this.totalLength = length + Length(left) + Length(right);
+                this.totalLineBreaks = lineBreaks + LineBreaks(left) + LineBreaks(right);
+            }
+
+            public Node With(Node left, Node right)
+            {
+                return new Node(chunk, start, length, lineBreaks, left, right);
+            }
+
+            public static int Count(Node node)
+            {
+                return node != null ? node.count : 0;
+            }
+
+            public static int Length(Node node)
+            {
+                return node != null ? node.totalLength : 0;
+            }
+
+            public static int LineBreaks(Node node)
+            {
+                return node != null ? node.totalLineBreaks : 0;
+            }
+
+#if DEBUG
+            public override string ToString()
+            {
+                return new String(chunk, start, length);
+            }
+#endif
+        }
+
+        protected class PieceTreeStorage : TextStorage
+        {
+#if DEBUG
+            public static readonly bool EnableValidate = true;
+            private const int MaxPieceLength = 7;
+            private const int MinChunkLength = 8;
+            private const int MaxChunkLength = 64;
+#else
+            public const bool EnableValidate = false;
+            private const int MaxPieceLength = 1024;
+            private const int MinChunkLength = 256;
+            private const int MaxChunkLength = 65536;
+#endif
+            public const int ValidateCutoffPieces = 500; // cutoff for slow thorough validation
+
+            private Node root; // null == one empty line
+
+            // append chunk - characters below chunkUsed are never modified once written, so may be shared by pieces in
+            // any storage
+            private char[] chunk;
+            private int chunkUsed;
+
+            private readonly Random random = new Random(0);
+            private char[] lineChars; // scratch for line access
+
+            public PieceTreeStorage(PieceTreeStorageFactory factory)
+                : base(factory)
+            {
+            }
+
+            public static PieceTreeStorage Take(
+                PieceTreeStorage source)
+            {
+                PieceTreeStorage taker = new PieceTreeStorage((PieceTreeStorageFactory)source.factory);
+                taker.root = source.root;
+                taker.chunk = source.chunk;
+                taker.chunkUsed = source.chunkUsed;
+                source.root = null;
+                source.chunk = null;
+                source.chunkUsed = 0;
+                return taker;
+            }
+
+
+            // tree primitives
+
+            private Node Merge(Node a, Node b)
+            {
+                if (a == null)
+                {
+                    return b;
+                }
+                if (b == null)
+                {
+                    return a;
+                }
+                // choosing the root with probability proportional to subtree size keeps the tree randomly balanced
+                // without storing priorities, which would be ambiguous for subtrees shared between storages
+                if (random.Next(a.count + b.count) < a.count)
+                {
+                    return a.With(a.left, Merge(a.right, b));
+                }
+                else
+                {
+                    return b.With(Merge(a, b.left), b.right);
+                }
+            }
+
+            // split into the first offset chars and the remainder, dividing a piece if necessary
+            private static void Split(Node node, int offset, out Node left, out Node right)
+            {
+                if ((node == null) || (offset <= 0))
+                {
+                    left = null;
+                    right = node;
+                    return;
+                }
+                if (offset >= node.totalLength)
+                {
+                    left = node;
+                    right = null;
+                    return;
+                }
+
+                int leftLength = Node.Length(node.left);
+                if (offset <= leftLength)
+                {
+                    Node l, r;
+                    Split(node.left, offset, out l, out r);
+                    left = l;
+                    right = node.With(r, node.right);
+                }
+                else if (offset >= leftLength + node.length)
+                {
+                    Node l, r;
+                    Split(node.right, offset - leftLength - node.length, out l, out r);
+                    left = node.With(node.left, l);
+                    right = r;
+                }
+                else
+                {
+                    int n = offset - leftLength;
+                    int leftBreaks = CountLineBreaks(node.chunk, node.start, n);
+                    left = new Node(node.chunk, node.start, n, leftBreaks, node.left, null);
+                    right = new Node(node.chunk, node.start + n, node.length - n, node.lineBreaks - leftBreaks, null, node.right);
+                }
+            }
+
+            // replace the last piece of the tree with one extended by the adjacent piece, or return null if not contiguous
+            private static Node ExtendLast(Node node, Node piece)
+            {
+                if (node.right != null)
+                {
+                    Node right = ExtendLast(node.right, piece);
+                    return right != null ? node.With(node.left, right) : null;
+                }
+                if ((node.chunk != piece.chunk) || (node.start + node.length != piece.start)
+                    || (node.length + piece.length > MaxPieceLength))
+                {
+                    return null;
+                }
+                return new Node(node.chunk, node.start, node.length + piece.length, node.lineBreaks + piece.lineBreaks, node.left, null);
+            }
+
+            // build perfectly balanced tree over a run of pieces
+            private static Node Build(List<Node> pieces, int start, int count)
+            {
+                if (count == 0)
+                {
+                    return null;
+                }
+                int half = count / 2;
+                return pieces[start + half].With(
+                    Build(pieces, start, half),
+                    Build(pieces, start + half + 1, count - half - 1));
+            }
+
+            private static Node Build(List<Node> pieces)
+            {
+                return Build(pieces, 0, pieces.Count);
+            }
+
+            private static int CountLineBreaks(char[] chars, int offset, int count)
+            {
+                int lineBreaks = 0;
+                int end = offset + count;
+                while ((offset = Array.IndexOf(chars, '\n', offset, end - offset)) >= 0)
+                {
+                    lineBreaks++;
+                    offset++;
+                }
+                return lineBreaks;
+            }
+
+            private static void CopyTo(Node node, int offset, int count, char[] buffer, int index)
+            {
+                while ((node != null) && (count > 0))
+                {
+                    int leftLength = Node.Length(node.left);
+                    if (offset < leftLength)
+                    {
+                        int n = Math.Min(count, leftLength - offset);
+                        CopyTo(node.left, offset, n, buffer, index);
+                        index += n;
+                        count -= n;
+                        offset += n;
+                        if (count == 0)
+                        {
+                            break;
+                        }
+                    }
+                    offset -= leftLength;
+                    if (offset < node.length)
+                    {
+                        int n = Math.Min(count, node.length - offset);
+                        Array.Copy(node.chunk, node.start + offset, buffer, index, n);
+                        index += n;
+                        count -= n;
+                        offset += n;
+                    }
+                    offset -= node.length;
+                    node = node.right;
+                }
+                Debug.Assert(count == 0);
+            }
+
+            private static IEnumerable<Node> InOrder(Node node)
+            {
+                Stack<Node> stack = new Stack<Node>();
+                while ((node != null) || (stack.Count != 0))
+                {
+                    while (node != null)
+                    {
+                        stack.Push(node);
+                        node = node.left;
+                    }
+                    node = stack.Pop();
+                    yield return node;
+                    node = node.right;
+                }
+            }
+
+
+            // appending text
+
+            // make room in the append chunk and return how many of count chars can be written at chunkUsed as one piece
+            private int Reserve(int count)
+            {
+                if ((chunk == null) || (chunkUsed == chunk.Length))
+                {
+                    // start small so that the many little storages made for undo and clipboard stay little
+                    int length = chunk != null ? chunk.Length * 2 : MinChunkLength;
+                    length = Math.Min(Math.Max(length, count), MaxChunkLength);
+                    chunk = new char[length];
+                    chunkUsed = 0;
+                }
+                return Math.Min(Math.Min(count, MaxPieceLength), chunk.Length - chunkUsed);
+            }
+
+            // add piece over the n chars just written at chunkUsed, coalescing with the previous piece if contiguous
+            private void Commit(int n, List<Node> pieces)
+            {
+                int lineBreaks = CountLineBreaks(chunk, chunkUsed, n);
+                int last = pieces.Count - 1;
+                if ((last >= 0) && (pieces[last].chunk == chunk) && (pieces[last].start + pieces[last].length == chunkUsed)
+                    && (pieces[last].length + n <= MaxPieceLength))
+                {
+                    Node previous = pieces[last];
+                    pieces[last] = new Node(chunk, previous.start, previous.length + n, previous.lineBreaks + lineBreaks, null, null);
+                }
+                else
+                {
+                    pieces.Add(new Node(chunk, chunkUsed, n, lineBreaks, null, null));
+                }
+                chunkUsed += n;
+            }
+
+            private void Append(string text, int offset, int count, List<Node> pieces)
+            {
+                while (count > 0)
+                {
+                    int n = Reserve(count);
+                    text.CopyTo(offset, chunk, chunkUsed, n);
+                    Commit(n, pieces);
+                    offset += n;
+                    count -= n;
+                }
+            }
+
+            private void Append(char[] chars, int offset, int count, List<Node> pieces)
+            {
+                while (count > 0)
+                {
+                    int n = Reserve(count);
+                    Array.Copy(chars, offset, chunk, chunkUsed, n);
+                    Commit(n, pieces);
+                    offset += n;
+                    count -= n;
+                }
+            }
+
+            private void AppendLineBreak(List<Node> pieces)
+            {
+                Reserve(1);
+                chunk[chunkUsed] = '\n';
+                Commit(1, pieces);
+            }
+
+            private static string GetString(ITextLine line)
+            {
+                if (!(line is StringStorageLine))
+                {
+                    throw new ArgumentException();
+                }
+                return ((StringStorageLine)line).line;
+            }
+
+            // make tree of lines joined by line breaks, optionally with a leading or trailing line break
+            private Node MakeLines(ITextLine[] lines, bool leadingLineBreak, bool trailingLineBreak)
+            {
+                List<Node> pieces = new List<Node>();
+                for (int i = 0; i < lines.Length; i++)
+                {
+                    if ((i != 0) || leadingLineBreak)
+                    {
+                        AppendLineBreak(pieces);
+                    }
+                    string text = GetString(lines[i]);
+                    Append(text, 0, text.Length, pieces);
+                }
+                if (trailingLineBreak)
+                {
+                    AppendLineBreak(pieces);
+                }
+                Node lines2 = Build(pieces);
+
+                int expectedLineBreaks = lines.Length - 1 + (leadingLineBreak ? 1 : 0) + (trailingLineBreak ? 1 : 0);
+                if (Node.LineBreaks(lines2) != expectedLineBreaks)
+                {
+                    // line contains a line break character
+                    Debug.Assert(false);
+                    throw new ArgumentException();
+                }
+
+                return lines2;
+            }
+
+            // replace chars [offset, offset + removeCount) with insertion
+            private void Replace(int offset, int removeCount, Node insertion)
+            {
+                Node a, rest, removed, c;
+                Split(root, offset, out a, out rest);
+                Split(rest, removeCount, out removed, out c);
+                Node extended = null;
+                if ((a != null) && (insertion != null) && (insertion.count == 1))
+                {
+                    // typing appends contiguous text to the chunk - grow the preceding piece rather than adding one
+                    extended = ExtendLast(a, insertion);
+                }
+                root = extended != null ? Merge(extended, c) : Merge(Merge(a, insertion), c);
+
+                if (EnableValidate)
+                {
+                    if (Node.Count(root) < ValidateCutoffPieces)
+                    {
+                        Validate();
+                    }
+                }
+            }
+
+
+            // line/offset mapping
+
+            private int OffsetOfLine(int line)
+            {
+                if ((line < 0) || (line > Node.LineBreaks(root)))
+                {
+                    Debug.Assert(false);
+                    throw new ArgumentException();
+                }
+
+                int offset = 0;
+                int lineBreaks = line; // line breaks remaining to pass
+                Node node = root;
+                while (lineBreaks > 0)
+                {
+                    int leftLineBreaks = Node.LineBreaks(node.left);
+                    if (lineBreaks <= leftLineBreaks)
+                    {
+                        node = node.left;
+                        continue;
+                    }
+                    lineBreaks -= leftLineBreaks;
+                    offset += Node.Length(node.left);
+                    if (lineBreaks <= node.lineBreaks)
+                    {
+                        int i = node.start - 1;
+                        do
+                        {
+                            i = Array.IndexOf(node.chunk, '\n', i + 1, node.start + node.length - (i + 1));
+                            lineBreaks--;
+                        } while (lineBreaks > 0);
+                        return offset + (i - node.start) + 1;
+                    }
+                    lineBreaks -= node.lineBreaks;
+                    offset += node.length;
+                    node = node.right;
+                }
+                return offset;
+            }
+
+            private int LineOfOffset(int offset)
+            {
+                if ((offset < 0) || (offset > Node.Length(root)))
+                {
+                    Debug.Assert(false);
+                    throw new ArgumentException();
+                }
+
+                int line = 0;
+                Node node = root;
+                while (node != null)
+                {
+                    int leftLength = Node.Length(node.left);
+                    if (offset <= leftLength)
+                    {
+                        node = node.left;
+                        continue;
+                    }
+                    line += Node.LineBreaks(node.left);
+                    offset -= leftLength;
+                    if (offset <= node.length)
+                    {
+                        return line + CountLineBreaks(node.chunk, node.start, offset);
+                    }
+                    line += node.lineBreaks;
+                    offset -= node.length;
+                    node = node.right;
+                }
+                return line;
+            }
+
+            private void GetLineExtent(int index, out int start, out int length)
+            {
+                int lineBreaks = Node.LineBreaks(root);
+                if ((index < 0) || (index > lineBreaks))
+                {
+                    throw new ArgumentOutOfRangeException();
+                }
+                start = OffsetOfLine(index);
+                int end = index < lineBreaks ? OffsetOfLine(index + 1) - 1 : Node.Length(root);
+                length = end - start;
+            }
+
+
+            // TextStorage
+
+            protected override void MakeEmpty()
+            {
+                root = null;
+            }
+
+            protected override void Insert(int index, ITextLine line)
+            {
+                InsertRange(index, new ITextLine[] { line });
+            }
+
+            protected override void InsertRange(int index, ITextLine[] linesToInsert)
+            {
+                int count = GetLineCount();
+                if ((index < 0) || (index > count))
+                {
+                    throw new ArgumentOutOfRangeException();
+                }
+                if (linesToInsert.Length == 0)
+                {
+                    return;
+                }
+                if (index < count)
+                {
+                    Replace(OffsetOfLine(index), 0, MakeLines(linesToInsert, false/*leadingLineBreak*/, true/*trailingLineBreak*/));
+                }
+                else
+                {
+                    Replace(Node.Length(root), 0, MakeLines(linesToInsert, true/*leadingLineBreak*/, false/*trailingLineBreak*/));
+                }
+            }
+
+            protected override void RemoveRange(int start, int count)
+            {
+                int lineCount = GetLineCount();
+                if ((start < 0) || (count < 0) || (start + count > lineCount))
+                {
+                    throw new ArgumentOutOfRangeException();
+                }
+                if (count == 0)
+                {
+                    return;
+                }
+                if (start + count < lineCount)
+                {
+                    int offset = OffsetOfLine(start);
+                    Replace(offset, OffsetOfLine(start + count) - offset, null);
+                }
+                else if (start > 0)
+                {
+                    // removing through the last line - take the line break preceding the range instead of the one following
+                    int offset = OffsetOfLine(start) - 1;
+                    Replace(offset, Node.Length(root) - offset, null);
+                }
+                else
+                {
+                    MakeEmpty();
+                }
+            }
+
+            protected override int GetLineCount()
+            {
+                return Node.LineBreaks(root) + 1;
+            }
+
+            protected override ITextLine GetLine(int index)
+            {
+                int length = CopyLine(index, ref lineChars);
+                return new StringStorageLine(new String(lineChars, 0, length));
+            }
+
+            protected override void SetLine(int index, ITextLine line)
+            {
+                string text = GetString(line);
+
+                int start, length;
+                GetLineExtent(index, out start, out length);
+                EnsureCapacity(ref lineChars, length);
+                CopyTo(root, start, length, lineChars, 0);
+
+                // only the span that differs is replaced, so an edit costs O(log n) plus the compare regardless of
+                // line length, and the append chunk grows only by the text actually typed
+                int prefix = 0;
+                int limit = Math.Min(length, text.Length);
+                while ((prefix < limit) && (lineChars[prefix] == text[prefix]))
+                {
+                    prefix++;
+                }
+                int suffix = 0;
+                limit -= prefix;
+                while ((suffix < limit) && (lineChars[length - 1 - suffix] == text[text.Length - 1 - suffix]))
+                {
+                    suffix++;
+                }
+
+                Node insertion = null;
+                int insertCount = text.Length - prefix - suffix;
+                if (insertCount != 0)
+                {
+                    List<Node> pieces = new List<Node>();
+                    Append(text, prefix, insertCount, pieces);
+                    insertion = Build(pieces);
+                    if (Node.LineBreaks(insertion) != 0)
+                    {
+                        // line contains a line break character
+                        Debug.Assert(false);
+                        throw new ArgumentException();
+                    }
+                }
+                if ((insertCount != 0) || (length - prefix - suffix != 0))
+                {
+                    Replace(start + prefix, length - prefix - suffix, insertion);
+                }
+            }
+
+            protected override int GetLineLength(int index)
+            {
+                int start, length;
+                GetLineExtent(index, out start, out length);
+                return length;
+            }
+
+            public override int CopyLine(int index, ref char[] buffer)
+            {
+                int start, length;
+                GetLineExtent(index, out start, out length);
+                EnsureCapacity(ref buffer, length);
+                CopyTo(root, start, length, buffer, 0);
+                return length;
+            }
+
+            // the tree keeps the total length, so the text need not be walked
+            public override long EstimateMemoryBytes()
+            {
+                return 2L * Node.Length(root);
+            }
+
+            public override bool Empty
+            {
+                get
+                {
+                    return Node.Length(root) == 0;
+                }
+            }
+
+            public override ITextStorage CloneSection(int startLine, int startChar, int endLine, int endCharPlusOne)
+            {
+                CheckSectionRange(startLine, startChar, endLine, endCharPlusOne);
+
+                int start = OffsetOfLine(startLine) + startChar;
+                int end = OffsetOfLine(endLine) + endCharPlusOne;
+                Node a, rest, section, c;
+                Split(root, start, out a, out rest);
+                Split(rest, end - start, out section, out c);
+
+                PieceTreeStorage copy = new PieceTreeStorage((PieceTreeStorageFactory)factory);
+                copy.root = section;
+                return copy;
+            }
+
+            public override void DeleteSection(int startLine, int startChar, int endLine, int endCharPlusOne)
+            {
+                long perf = PerfCounters.Begin();
+                CheckSectionRange(startLine, startChar, endLine, endCharPlusOne);
+
+                int start = OffsetOfLine(startLine) + startChar;
+                int end = OffsetOfLine(endLine) + endCharPlusOne;
+                Replace(start, end - start, null);
+
+                Modified = true;
+                PerfCounters.End(PerfCounter.DeleteSection, perf);
+            }
+
+            public override void InsertSection(int insertLine, int insertChar, ITextStorage insert)
+            {
+                long perf = PerfCounters.Begin();
+                CheckPosition(insertLine, insertChar);
+
+                Node insertion;
+                PieceTreeStorage source = insert as PieceTreeStorage;
+                if (source != null)
+                {
+                    // nodes are immutable, so the source tree can be shared as is (even if source is this)
+                    insertion = source.root;
+                }
+                else
+                {
+                    List<Node> pieces = new List<Node>();
+                    TextLineEnumerator lines = insert.EnumerateLines(0, insert.Count, null);
+                    while (lines.MoveNext())
+                    {
+                        if (lines.Index != 0)
+                        {
+                            AppendLineBreak(pieces);
+                        }
+                        Append(lines.Buffer, 0, lines.Length, pieces);
+                    }
+                    insertion = Build(pieces);
+                    if (Node.LineBreaks(insertion) != insert.Count - 1)
+                    {
+                        // line contains a line break character
+                        Debug.Assert(false);
+                        throw new ArgumentException();
+                    }
+                }
+
+                Replace(OffsetOfLine(insertLine) + insertChar, 0, insertion);
+
+                Modified = true;
+                PerfCounters.End(PerfCounter.InsertSection, perf);
+            }
+
+            public override string GetText(string EOLN)
+            {
+                StringBuilder sb = new StringBuilder(Node.Length(root) + Node.LineBreaks(root) * (EOLN.Length - 1));
+                foreach (Node piece in InOrder(root))
+                {
+                    int i = piece.start;
+                    int end = piece.start + piece.length;
+                    int lineBreak;
+                    while ((lineBreak = Array.IndexOf(piece.chunk, '\n', i, end - i)) >= 0)
+                    {
+                        sb.Append(piece.chunk, i, lineBreak - i);
+                        sb.Append(EOLN);
+                        i = lineBreak + 1;
+                    }
+                    sb.Append(piece.chunk, i, end - i);
+                }
+                return sb.ToString();
+            }
+
+            public override void ToTextWriter(TextWriter writer)
+            {
+                foreach (Node piece in InOrder(root))
+                {
+                    int i = piece.start;
+                    int end = piece.start + piece.length;
+                    int lineBreak;
+                    while ((lineBreak = Array.IndexOf(piece.chunk, '\n', i, end - i)) >= 0)
+                    {
+                        writer.Write(piece.chunk, i, lineBreak - i);
+                        writer.WriteLine();
+                        i = lineBreak + 1;
+                    }
+                    writer.Write(piece.chunk, i, end - i);
+                }
+            }
+
+
+            // loading
+
+            // append chars with line endings normalized to '\n'; pendingCR carries a CR at the end of one block into the next
+            private void AppendNormalized(char[] chars, int count, ref bool pendingCR, ref LineEndingInfo lineEndingInfo, List<Node> pieces)
+            {
+                int runStart = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    char c = chars[i];
+                    if (pendingCR)
+                    {
+                        pendingCR = false;
+                        AppendLineBreak(pieces);
+                        if (c == '\n')
+                        {
+                            lineEndingInfo.windowsLFCount++;
+                            runStart = i + 1;
+                            continue;
+                        }
+                        lineEndingInfo.macintoshLFCount++;
+                    }
+                    if (c == '\r')
+                    {
+                        Append(chars, runStart, i - runStart, pieces);
+                        runStart = i + 1;
+                        pendingCR = true;
+                    }
+                    else if (c == '\n')
+                    {
+                        lineEndingInfo.unixLFCount++;
+                    }
+                }
+                Append(chars, runStart, count - runStart, pieces);
+            }
+
+            public static PieceTreeStorage Load(PieceTreeStorageFactory factory, Stream stream, Encoding encoding, out LineEndingInfo lineEndingInfo)
+            {
+                lineEndingInfo = new LineEndingInfo();
+
+                PieceTreeStorage text = new PieceTreeStorage(factory);
+                List<Node> pieces = new List<Node>();
+
+                Decoder decoder = encoding.GetDecoder();
+                byte[] bytes = new byte[4096];
+                char[] chars = new char[encoding.GetMaxCharCount(bytes.Length)];
+                bool pendingCR = false;
+                while (true)
+                {
+                    int readBytes = stream.Read(bytes, 0, bytes.Length);
+                    // if there is an incomplete multi-byte sequence at the end of the file, flushing eats it without reporting
+                    int usedChars = decoder.GetChars(bytes, 0, readBytes, chars, 0, readBytes == 0/*flush*/);
+                    text.AppendNormalized(chars, usedChars, ref pendingCR, ref lineEndingInfo, pieces);
+                    if (readBytes == 0)
+                    {
+                        break;
+                    }
+                }
+                if (pendingCR)
+                {
+                    text.AppendLineBreak(pieces);
+                    lineEndingInfo.macintoshLFCount++;
+                }
+
+                text.root = Build(pieces);
+                return text;
+            }
+
+            public static PieceTreeStorage Load(PieceTreeStorageFactory factory, string utf16, int offset, int count, string EOLN)
+            {
+                PieceTreeStorage text = new PieceTreeStorage(factory);
+                List<Node> pieces = new List<Node>();
+
+                int index = offset;
+                int end = offset + count;
+                if (EOLN.Length != 0)
+                {
+                    int lineBreak;
+                    while ((lineBreak = utf16.IndexOf(EOLN, index, end - index, StringComparison.Ordinal)) >= 0)
+                    {
+                        text.Append(utf16, index, lineBreak - index, pieces);
+                        text.AppendLineBreak(pieces);
+                        index = lineBreak + EOLN.Length;
+                    }
+                }
+                text.Append(utf16, index, end - index, pieces);
+
+                text.root = Build(pieces);
+                return text;
+            }
+
+
+            // validation
+
+            public void Validate()
+            {
+                Debug.Assert(EnableValidate);
+
+                Validate(root);
+            }
+
+            private static void Validate(Node node)
+            {
+                if (node == null)
+                {
+                    return;
+                }
+                Validate(node.left);
+                Validate(node.right);
+
+                if ((node.length <= 0) || (node.length > MaxPieceLength)
+                    || (node.start < 0) || (node.start + node.length > node.chunk.Length))
+                {
+                    // invalid piece
+                    Debug.Assert(false);
+                    throw new InvalidOperationException();
+                }
+                if (node.lineBreaks != CountLineBreaks(node.chunk, node.start, node.length))
+                {
+                    // piece line break count is wrong
+                    Debug.Assert(false);
+                    throw new InvalidOperationException();
+                }
+                if ((node.count != 1 + Node.Count(node.left) + Node.Count(node.right))
+                    || (node.totalLength != node.length + Node.Length(node.left) + Node.Length(node.right))
+                    || (node.totalLineBreaks != node.lineBreaks + Node.LineBreaks(node.left) + Node.LineBreaks(node.right)))
+                {
+                    // aggregates are wrong
+                    Debug.Assert(false);
+                    throw new InvalidOperationException();
+                }
+            }
+        }
+
+
+        public override TextStorage NewStorage()
+        {
+            return new PieceTreeStorage(this);
+        }
+
+        public override ITextStorage Take(
+            ITextStorage source)
+        {
+            if (!(source is PieceTreeStorage))
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+            return PieceTreeStorage.Take((PieceTreeStorage)source);
+        }
+
+        public override ITextStorage FromUtf16Buffer(string utf16, int offset, int count, string EOLN)
+        {
+            return PieceTreeStorage.Load(this, utf16, offset, count, EOLN);
+        }
+
+        public override ITextStorage FromStream(Stream stream, Encoding encoding, out LineEndingInfo lineEndingInfo)
+        {
+            return PieceTreeStorage.Load(this, stream, encoding, out lineEndingInfo);
+        }
+    }
+}
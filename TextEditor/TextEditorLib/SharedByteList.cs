@@ -0,0 +1,315 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Diagnostics;
+using System.IO;
+
+using TreeLib;
+
+namespace TextEditor
+{
+    // List of bytes held as pieces of shared, immutable chunks (the byte store of Utf8SplayGapBuffer). Bytes are
+    // written once, into the unused tail of the list's current chunk, and never modified afterwards - edits replace
+    // pieces, not bytes. A range can therefore be copied to another list by copying its piece descriptors, with both
+    // lists referring to the same chunks, so cloning, cutting and pasting a section cost time proportional to the
+    // pieces it spans (each O(log n) to locate) and neither copy bytes nor take more memory. The price is that a small
+    // piece kept alive (e.g. by an undo record) keeps its whole chunk alive.
+    public class SharedByteList
+    {
+#if DEBUG
+        private const int MinChunkSize = 16;
+        public const int ChunkSize = 256;
+#else
+        private const int MinChunkSize = 64;
+        public const int ChunkSize = 65536;
+#endif
+
+        private struct Piece
+        {
+            public readonly byte[] chunk;
+            public readonly int offset;
+
+            public Piece(byte[] chunk, int offset)
+            {
+                this.chunk = chunk;
+                this.offset = offset;
+            }
+        }
+
+        private readonly SplayTreeRangeMap<Piece> pieces = new SplayTreeRangeMap<Piece>();
+
+        // chunk receiving new bytes - only the part from appendUsed on is ever written, and only by this list (others
+        // may hold pieces of the part before it)
+        private byte[] append;
+        private int appendUsed;
+
+        // piece last located by the indexer (start is -1 if none)
+        private int cachedStart = -1;
+        private int cachedLength;
+        private Piece cachedPiece;
+
+        public int Count
+        {
+            get
+            {
+                return pieces.GetExtent();
+            }
+        }
+
+        public void Clear()
+        {
+            pieces.Clear();
+            append = null;
+            appendUsed = 0;
+            Invalidate();
+        }
+
+        private void Invalidate()
+        {
+            cachedStart = -1;
+            cachedLength = 0;
+        }
+
+        public byte this[int index]
+        {
+            get
+            {
+                if ((index < cachedStart) || (index >= cachedStart + cachedLength))
+                {
+                    if (unchecked((uint)index) >= unchecked((uint)Count))
+                    {
+                        Debug.Assert(false);
+                        throw new ArgumentOutOfRangeException();
+                    }
+                    pieces.NearestLessOrEqual(index, out cachedStart);
+                    pieces.Get(cachedStart, out cachedLength, out cachedPiece);
+                }
+                return cachedPiece.chunk[cachedPiece.offset + (index - cachedStart)];
+            }
+        }
+
+        private void CheckRange(int index, int count)
+        {
+            if ((index < 0) || (count < 0) || (index > Count - count))
+            {
+                Debug.Assert(false);
+                throw new ArgumentOutOfRangeException();
+            }
+        }
+
+        // ensure a piece boundary exists at index
+        private void SplitAt(int index)
+        {
+            if ((index == 0) || (index == Count))
+            {
+                return;
+            }
+            int start;
+            pieces.NearestLessOrEqual(index, out start);
+            if (start == index)
+            {
+                return;
+            }
+            int length;
+            Piece piece;
+            pieces.Get(start, out length, out piece);
+            pieces.Delete(start);
+            pieces.Insert(start, index - start, piece);
+            pieces.Insert(index, start + length - index, new Piece(piece.chunk, piece.offset + (index - start)));
+        }
+
+        // insert a piece at a piece boundary, extending the preceding piece instead if the bytes follow on from it
+        private void AddPiece(int index, byte[] chunk, int offset, int length)
+        {
+            int start;
+            if ((index > 0) && pieces.NearestLessOrEqual(index - 1, out start))
+            {
+                int previousLength;
+                Piece previous;
+                pieces.Get(start, out previousLength, out previous);
+                Debug.Assert(start + previousLength == index);
+                if ((previous.chunk == chunk) && (previous.offset + previousLength == offset))
+                {
+                    pieces.Delete(start);
+                    pieces.Insert(start, previousLength + length, previous);
+                    return;
+                }
+            }
+            pieces.Insert(index, length, new Piece(chunk, offset));
+        }
+
+        // start a new chunk when the current one is full - sizes start small (short sections get short chunks) and
+        // double up to ChunkSize
+        private void EnsureAppendSpace(int count)
+        {
+            if ((append == null) || (appendUsed == append.Length))
+            {
+                int size = append == null ? MinChunkSize : Math.Min(2 * append.Length, ChunkSize);
+                append = new byte[Math.Max(size, Math.Min(count, ChunkSize))];
+                appendUsed = 0;
+            }
+        }
+
+        public void InsertRange(int index, byte[] items)
+        {
+            InsertRange(index, items, 0, items.Length);
+        }
+
+        public void InsertRange(int index, byte[] items, int offset, int count)
+        {
+            CheckRange(index, 0);
+            if ((offset < 0) || (count < 0) || (offset > items.Length - count))
+            {
+                Debug.Assert(false);
+                throw new ArgumentOutOfRangeException();
+            }
+
+            Invalidate();
+            SplitAt(index);
+            while (count > 0)
+            {
+                EnsureAppendSpace(count);
+                int c = Math.Min(count, append.Length - appendUsed);
+                Buffer.BlockCopy(items, offset, append, appendUsed, c);
+                AddPiece(index, append, appendUsed, c);
+                appendUsed += c;
+                index += c;
+                offset += c;
+                count -= c;
+            }
+        }
+
+        // read the stream to its end onto the end of the list, straight into chunks
+        public void AppendFrom(Stream stream)
+        {
+            Invalidate();
+            while (true)
+            {
+                EnsureAppendSpace(ChunkSize);
+                int read = stream.Read(append, appendUsed, append.Length - appendUsed);
+                if (read == 0)
+                {
+                    break;
+                }
+                AddPiece(Count, append, appendUsed, read);
+                appendUsed += read;
+            }
+        }
+
+        public void RemoveRange(int index, int count)
+        {
+            CheckRange(index, count);
+
+            Invalidate();
+            SplitAt(index);
+            SplitAt(index + count);
+            while (count > 0)
+            {
+                int length;
+                Piece piece;
+                pieces.Get(index, out length, out piece);
+                pieces.Delete(index);
+                count -= length;
+            }
+            Debug.Assert(count == 0);
+        }
+
+        public void ReplaceRange(int index, int count, byte[] items)
+        {
+            RemoveRange(index, count);
+            InsertRange(index, items, 0, items.Length);
+        }
+
+        public void CopyTo(int index, byte[] array, int arrayIndex, int count)
+        {
+            CheckRange(index, count);
+            if ((arrayIndex < 0) || (arrayIndex > array.Length - count))
+            {
+                Debug.Assert(false);
+                throw new ArgumentOutOfRangeException();
+            }
+
+            int start;
+            pieces.NearestLessOrEqual(index, out start);
+            while (count > 0)
+            {
+                int length;
+                Piece piece;
+                pieces.Get(start, out length, out piece);
+                int skip = index - start;
+                int c = Math.Min(count, length - skip);
+                Buffer.BlockCopy(piece.chunk, piece.offset + skip, array, arrayIndex, c);
+                index += c;
+                arrayIndex += c;
+                count -= c;
+                start += length;
+            }
+        }
+
+        // Insert [index, index + count) of this list into target at targetIndex by sharing the pieces - no bytes are
+        // copied.
+        public void CopyRangeTo(int index, int count, SharedByteList target, int targetIndex)
+        {
+            if (target == this)
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+            CheckRange(index, count);
+            target.CheckRange(targetIndex, 0);
+
+            target.Invalidate();
+            target.SplitAt(targetIndex);
+            if (count > 0)
+            {
+                int start;
+                pieces.NearestLessOrEqual(index, out start);
+                while (count > 0)
+                {
+                    int length;
+                    Piece piece;
+                    pieces.Get(start, out length, out piece);
+                    int skip = index - start;
+                    int c = Math.Min(count, length - skip);
+                    target.AddPiece(targetIndex, piece.chunk, piece.offset + skip, c);
+                    index += c;
+                    targetIndex += c;
+                    count -= c;
+                    start += length;
+                }
+            }
+        }
+
+        public int IndexOfAny(byte[] values, int index, int count)
+        {
+            CheckRange(index, count);
+            for (int i = index; i < index + count; i++)
+            {
+                if (Array.IndexOf(values, this[i]) >= 0)
+                {
+                    return i;
+                }
+            }
+            return -1;
+        }
+    }
+}
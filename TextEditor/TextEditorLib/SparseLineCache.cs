@@ -0,0 +1,314 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Text;
+
+namespace TextEditor
+{
+    // Sparse cache of per-line values covering any number of disjoint regions of the document (e.g. the
+    // view plus a search result far away). Values live in blocks of up to blockLines consecutive lines;
+    // when maxBlocks is reached the least recently used block is discarded. Line insertion and deletion
+    // shift cached entries rather than flushing them. default(T) denotes a missing entry.
+    public class SparseLineCache<T>
+    {
+        public const int DefaultBlockLines = 64;
+        public const int DefaultMaxBlocks = 32;
+
+        private class Block
+        {
+            public int start;
+            public int count;
+            public long lastUse;
+            public readonly T[] values;
+
+            public Block(int capacity)
+            {
+                values = new T[capacity];
+            }
+        }
+
+        private static readonly EqualityComparer<T> Comparer = EqualityComparer<T>.Default;
+
+        private readonly int blockLines;
+        private readonly int maxBlocks;
+        private readonly List<Block> blocks; // ordered by start, non-overlapping
+        private int lastBlock = -1; // consecutive accesses usually hit the same block
+        private long clock;
+
+        private long hits;
+        private long misses;
+        private long evictions;
+
+        public SparseLineCache()
+            : this(DefaultBlockLines, DefaultMaxBlocks)
+        {
+        }
+
+        public SparseLineCache(int blockLines, int maxBlocks)
+        {
+            if ((blockLines < 1) || (maxBlocks < 1))
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+            this.blockLines = blockLines;
+            this.maxBlocks = maxBlocks;
+            this.blocks = new List<Block>(maxBlocks);
+        }
+
+        public long Hits { get { return hits; } }
+        public long Misses { get { return misses; } }
+        public long Evictions { get { return evictions; } }
+        public double HitRate { get { return hits + misses != 0 ? (double)hits / (hits + misses) : 0; } }
+        public int BlockCount { get { return blocks.Count; } }
+
+        public void ResetStatistics()
+        {
+            hits = 0;
+            misses = 0;
+            evictions = 0;
+        }
+
+        public void Clear()
+        {
+            blocks.Clear();
+            lastBlock = -1;
+        }
+
+        // index of last block with start <= index, or -1
+        private int FindBlock(int index)
+        {
+            if ((lastBlock >= 0) && (lastBlock < blocks.Count))
+            {
+                Block hint = blocks[lastBlock];
+                if ((index >= hint.start) && (index < hint.start + hint.count))
+                {
+                    return lastBlock;
+                }
+            }
+
+            int lo = 0;
+            int hi = blocks.Count;
+            while (lo < hi)
+            {
+                int mid = lo + (hi - lo) / 2;
+                if (blocks[mid].start <= index)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            return lo - 1;
+        }
+
+        private bool TryFindContaining(int index, out Block block)
+        {
+            int i = FindBlock(index);
+            if ((i >= 0) && (index < blocks[i].start + blocks[i].count))
+            {
+                lastBlock = i;
+                block = blocks[i];
+                block.lastUse = ++clock;
+                return true;
+            }
+            block = null;
+            return false;
+        }
+
+        public bool TryGet(int index, out T value)
+        {
+            Block block;
+            if (TryFindContaining(index, out block))
+            {
+                value = block.values[index - block.start];
+                if (!Comparer.Equals(value, default(T)))
+                {
+                    hits++;
+                    return true;
+                }
+            }
+            value = default(T);
+            misses++;
+            return false;
+        }
+
+        public void Set(int index, T value)
+        {
+            Block block;
+            if (!TryFindContaining(index, out block))
+            {
+                block = NewBlock(index);
+            }
+            block.values[index - block.start] = value;
+        }
+
+        public void Invalidate(int index)
+        {
+            Block block;
+            if (TryFindContaining(index, out block))
+            {
+                block.values[index - block.start] = default(T);
+            }
+        }
+
+        private Block NewBlock(int index)
+        {
+            Block recycled = null;
+            if (blocks.Count >= maxBlocks)
+            {
+                int lru = 0;
+                for (int i = 1; i < blocks.Count; i++)
+                {
+                    if (blocks[i].lastUse < blocks[lru].lastUse)
+                    {
+                        lru = i;
+                    }
+                }
+                recycled = blocks[lru];
+                blocks.RemoveAt(lru);
+                Array.Clear(recycled.values, 0, recycled.values.Length);
+                evictions++;
+            }
+
+            // align to block boundary where possible, but never overlap neighbors
+            int position = FindBlock(index) + 1;
+            int start = index - index % blockLines;
+            if (position > 0)
+            {
+                Block previous = blocks[position - 1];
+                start = Math.Max(start, previous.start + previous.count);
+            }
+            int count = blockLines;
+            if (position < blocks.Count)
+            {
+                count = Math.Min(count, blocks[position].start - start);
+            }
+            Debug.Assert((index >= start) && (index < start + count));
+
+            Block block = recycled != null ? recycled : new Block(blockLines);
+            block.start = start;
+            block.count = count;
+            block.lastUse = ++clock;
+            blocks.Insert(position, block);
+            lastBlock = position;
+            return block;
+        }
+
+        public void Insert(int index, int count)
+        {
+            if (count <= 0)
+            {
+                return;
+            }
+            for (int i = blocks.Count - 1; i >= 0; i--)
+            {
+                Block block = blocks[i];
+                if (block.start >= index)
+                {
+                    block.start += count;
+                }
+                else if (index < block.start + block.count)
+                {
+                    // open a hole of invalid entries; anything pushed beyond capacity is dropped
+                    int offset = index - block.start;
+                    int newCount = Math.Min(blockLines, block.count + count);
+                    int moved = Math.Min(block.count - offset, newCount - (offset + count));
+                    if (moved > 0)
+                    {
+                        Array.Copy(block.values, offset, block.values, offset + count, moved);
+                    }
+                    Array.Clear(block.values, offset, Math.Min(count, newCount - offset));
+                    block.count = newCount;
+                }
+                else
+                {
+                    break; // remaining blocks are entirely before index
+                }
+            }
+        }
+
+        public void Delete(int index, int count)
+        {
+            if (count <= 0)
+            {
+                return;
+            }
+            int end = index + count;
+            for (int i = blocks.Count - 1; i >= 0; i--)
+            {
+                Block block = blocks[i];
+                int blockEnd = block.start + block.count;
+                if (end <= block.start)
+                {
+                    block.start -= count;
+                }
+                else if (index < blockEnd)
+                {
+                    int cutStart = Math.Max(index, block.start) - block.start;
+                    int cutEnd = Math.Min(end, blockEnd) - block.start;
+                    int cut = cutEnd - cutStart;
+                    Array.Copy(block.values, cutEnd, block.values, cutStart, block.count - cutEnd);
+                    Array.Clear(block.values, block.count - cut, cut);
+                    block.count -= cut;
+                    if (block.start > index)
+                    {
+                        block.start = index;
+                    }
+                    if (block.count == 0)
+                    {
+                        blocks.RemoveAt(i);
+                    }
+                }
+                else
+                {
+                    break; // remaining blocks are entirely before index
+                }
+            }
+            lastBlock = -1;
+        }
+
+#if DEBUG
+        public string Dump(Func<T, string> format)
+        {
+            StringBuilder sb = new StringBuilder();
+            sb.AppendFormat("blocks={0} hits={1} misses={2} evictions={3}" + Environment.NewLine, blocks.Count, hits, misses, evictions);
+            for (int i = 0; i < blocks.Count; i++)
+            {
+                Block block = blocks[i];
+                sb.AppendFormat("  [{0}..{1}) lastUse={2}:", block.start, block.start + block.count, block.lastUse);
+                for (int j = 0; j < block.count; j++)
+                {
+                    sb.Append(' ');
+                    sb.Append(!Comparer.Equals(block.values[j], default(T)) ? format(block.values[j]) : "inv");
+                }
+                sb.AppendLine();
+            }
+            return sb.ToString();
+        }
+#endif
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Globalization;
+using System.Text;
+
+namespace TextEditor
+{
+    // Milestones of application startup (settings loaded, window shown, file loaded, first paint, text service ready),
+    // measured from process creation, for tracking startup regressions. Only the first occurrence of each milestone is
+    // recorded. May be called from any thread.
+    public static class StartupTiming
+    {
+        private static readonly object sync = new object();
+        private static readonly List<KeyValuePair<string, double>> milestones = new List<KeyValuePair<string, double>>();
+        private static readonly Stopwatch stopwatch = Stopwatch.StartNew();
+        private static readonly double processStartOffset = GetProcessStartOffset(); // ms from process creation to stopwatch start
+
+        private static double GetProcessStartOffset()
+        {
+            try
+            {
+                return (DateTime.Now - Process.GetCurrentProcess().StartTime).TotalMilliseconds;
+            }
+            catch (Exception)
+            {
+                return 0;
+            }
+        }
+
+        public static void Mark(string milestone)
+        {
+            double ms = processStartOffset + stopwatch.Elapsed.TotalMilliseconds;
+            lock (sync)
+            {
+                if (milestones.FindIndex(delegate (KeyValuePair<string, double> candidate) { return String.Equals(candidate.Key, milestone); }) >= 0)
+                {
+                    return;
+                }
+                milestones.Add(new KeyValuePair<string, double>(milestone, ms));
+            }
+            Debugger.Log(0, "StartupTiming", String.Format("{0,10:F1} ms  {1}{2}", ms, milestone, Environment.NewLine));
+        }
+
+        public static string Report()
+        {
+            StringBuilder sb = new StringBuilder();
+            sb.AppendLine("Startup (ms from process creation):");
+            lock (sync)
+            {
+                foreach (KeyValuePair<string, double> milestone in milestones)
+                {
+                    sb.AppendLine(String.Format(CultureInfo.InvariantCulture, "  {0,10:F1}  {1}", milestone.Value, milestone.Key));
+                }
+            }
+            return sb.ToString();
+        }
+    }
+}
@@ -84,6 +84,7 @@ namespace TextEditor
         protected class StringStorage : TextStorage
         {
             private FragmentList<string> lines;
+            private long charCount; // total length of lines, excluding line breaks
 
             public StringStorage(StringStorageFactory factory)
                 : base(factory)
@@ -96,7 +97,9 @@ namespace TextEditor
             {
                 StringStorage taker = new StringStorage((StringStorageFactory)source.factory);
                 taker.lines = source.lines;
+                taker.charCount = source.charCount;
                 source.lines = new FragmentList<string>();
+                source.charCount = 0;
                 return taker;
             }
 
@@ -104,6 +107,7 @@ namespace TextEditor
             {
                 lines.Clear();
                 lines.Add(String.Empty);
+                charCount = 0;
             }
 
             protected override void Insert(int index, ITextLine line)
@@ -112,7 +116,9 @@ namespace TextEditor
                 {
                     throw new ArgumentException();
                 }
-                lines.Insert(index, ((StringStorageLine)line).line);
+                string s = ((StringStorageLine)line).line;
+                lines.Insert(index, s);
+                charCount += s.Length;
             }
 
             protected override void InsertRange(int index, ITextLine[] linesToInsert)
@@ -125,12 +131,17 @@ namespace TextEditor
                         throw new ArgumentException();
                     }
                     linesToInsert2[i] = ((StringStorageLine)linesToInsert[i]).line;
+                    charCount += linesToInsert2[i].Length;
                 }
                 lines.InsertRange(index, linesToInsert2);
             }
 
             protected override void RemoveRange(int start, int count)
             {
+                for (int i = 0; i < count; i++)
+                {
+                    charCount -= lines[start + i].Length;
+                }
                 lines.RemoveRange(start, count);
             }
 
@@ -150,7 +161,28 @@ namespace TextEditor
                 {
                     throw new ArgumentException();
                 }
-                lines[index] = ((StringStorageLine)line).line;
+                string s = ((StringStorageLine)line).line;
+                charCount += s.Length - lines[index].Length;
+                lines[index] = s;
+            }
+
+            protected override int GetLineLength(int index)
+            {
+                return lines[index].Length;
+            }
+
+            public override int CopyLine(int index, ref char[] buffer)
+            {
+                string line = lines[index];
+                EnsureCapacity(ref buffer, line.Length);
+                line.CopyTo(0, buffer, 0, line.Length);
+                return line.Length;
+            }
+
+            // lines are UTF-16 strings - the running count of chars keeps the estimate from walking the lines
+            public override long EstimateMemoryBytes()
+            {
+                return 2L * charCount + (long)LineOverheadBytes * lines.Count;
             }
         }
 
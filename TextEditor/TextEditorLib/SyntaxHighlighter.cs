@@ -0,0 +1,306 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Drawing;
+
+using TreeLib;
+
+namespace TextEditor
+{
+    public enum SyntaxTokenKind
+    {
+        Plain,
+        Keyword,
+        Comment,
+        String,
+        Number,
+        Preprocessor,
+    }
+
+    public struct SyntaxToken
+    {
+        public readonly int start;
+        public readonly int length;
+        public readonly SyntaxTokenKind kind;
+
+        public SyntaxToken(int start, int length, SyntaxTokenKind kind)
+        {
+            this.start = start;
+            this.length = length;
+            this.kind = kind;
+        }
+    }
+
+    // A line-at-a-time lexer. The state carried from the end of one line to the start of the next (e.g. "inside a block
+    // comment") must fit in a byte less than 255. When tokens is null, only the end-of-line state is wanted.
+    public interface ISyntaxTokenizer
+    {
+        byte InitialState { get; }
+
+        byte Tokenize(string line, byte state, List<SyntaxToken> tokens);
+    }
+
+    // Tokenizer for the C family (C, C++, C#, Java, JavaScript). States: Normal, or inside a /* */ comment.
+    public class CLikeSyntaxTokenizer : ISyntaxTokenizer
+    {
+        private const byte Normal = 0;
+        private const byte BlockComment = 1;
+
+        private static readonly HashSet<string> Keywords = new HashSet<string>(
+            new string[]
+            {
+                "abstract", "as", "auto", "base", "bool", "break", "byte", "case", "catch", "char", "checked", "class",
+                "const", "continue", "decimal", "default", "delegate", "delete", "do", "double", "else", "enum", "event",
+                "explicit", "extends", "extern", "false", "final", "finally", "fixed", "float", "for", "foreach",
+                "function", "goto", "if", "implements", "implicit", "import", "in", "inline", "int", "interface",
+                "internal", "is", "let", "lock", "long", "namespace", "new", "null", "nullptr", "object", "operator",
+                "out", "override", "package", "params", "private", "protected", "public", "readonly", "ref", "return",
+                "sbyte", "sealed", "short", "signed", "sizeof", "static", "string", "struct", "switch", "template",
+                "this", "throw", "true", "try", "typedef", "typeof", "uint", "ulong", "unchecked", "union", "unsafe",
+                "unsigned", "ushort", "using", "var", "virtual", "void", "volatile", "while",
+            });
+
+        public byte InitialState { get { return Normal; } }
+
+        private static void Add(List<SyntaxToken> tokens, int start, int end, SyntaxTokenKind kind)
+        {
+            if (tokens != null)
+            {
+                tokens.Add(new SyntaxToken(start, end - start, kind));
+            }
+        }
+
+        public byte Tokenize(string line, byte state, List<SyntaxToken> tokens)
+        {
+            int n = line.Length;
+            int i = 0;
+
+            if (state == BlockComment)
+            {
+                int end = line.IndexOf("*/", StringComparison.Ordinal);
+                if (end < 0)
+                {
+                    Add(tokens, 0, n, SyntaxTokenKind.Comment);
+                    return BlockComment;
+                }
+                Add(tokens, 0, end + 2, SyntaxTokenKind.Comment);
+                i = end + 2;
+            }
+
+            bool leading = true; // only whitespace so far - for recognizing preprocessor directives
+            while (i < n)
+            {
+                char c = line[i];
+                if ((c == '/') && (i + 1 < n) && (line[i + 1] == '/'))
+                {
+                    Add(tokens, i, n, SyntaxTokenKind.Comment);
+                    return Normal;
+                }
+                else if ((c == '/') && (i + 1 < n) && (line[i + 1] == '*'))
+                {
+                    int end = line.IndexOf("*/", i + 2, StringComparison.Ordinal);
+                    if (end < 0)
+                    {
+                        Add(tokens, i, n, SyntaxTokenKind.Comment);
+                        return BlockComment;
+                    }
+                    Add(tokens, i, end + 2, SyntaxTokenKind.Comment);
+                    i = end + 2;
+                }
+                else if ((c == '"') || (c == '\''))
+                {
+                    int j = i + 1;
+                    while ((j < n) && (line[j] != c))
+                    {
+                        j += line[j] == '\\' ? 2 : 1;
+                    }
+                    j = Math.Min(j + 1, n);
+                    Add(tokens, i, j, SyntaxTokenKind.String);
+                    i = j;
+                }
+                else if (Char.IsDigit(c))
+                {
+                    int j = i + 1;
+                    while ((j < n) && (Char.IsLetterOrDigit(line[j]) || (line[j] == '.')))
+                    {
+                        j++;
+                    }
+                    Add(tokens, i, j, SyntaxTokenKind.Number);
+                    i = j;
+                }
+                else if (Char.IsLetter(c) || (c == '_'))
+                {
+                    int j = i + 1;
+                    while ((j < n) && (Char.IsLetterOrDigit(line[j]) || (line[j] == '_')))
+                    {
+                        j++;
+                    }
+                    if ((tokens != null) && Keywords.Contains(line.Substring(i, j - i)))
+                    {
+                        Add(tokens, i, j, SyntaxTokenKind.Keyword);
+                    }
+                    i = j;
+                }
+                else if ((c == '#') && leading)
+                {
+                    Add(tokens, i, n, SyntaxTokenKind.Preprocessor);
+                    return Normal;
+                }
+                else
+                {
+                    i++;
+                }
+
+                leading = leading && Char.IsWhiteSpace(c);
+            }
+
+            return Normal;
+        }
+    }
+
+    // Incremental highlighting over a tokenizer: keeps the end-of-line lexer state of every line in a compact side
+    // array kept in step with edits. Only lines actually painted are tokenized, after lexing (states only) forward from
+    // the last line known to be correct. After an edit, re-lexing stops as soon as a line beyond the edited region
+    // ends in the same state as before, at which point all previously computed states after it are valid again.
+    public class SyntaxHighlighter
+    {
+        private const int BlockSize = 4096;
+
+        private readonly ISyntaxTokenizer tokenizer;
+        private readonly HugeList<byte> states = new HugeList<byte>(typeof(SplayTreeRangeMap<>), BlockSize); // end state + 1, 0 = not computed
+        private int validThrough; // states of lines [0, validThrough) are correct
+        private int dirtyEnd; // lines before this may have changed since their states were computed
+        private int knownEnd; // states of [dirtyEnd, knownEnd) are correct if the state entering them is unchanged
+        private byte editEndState; // state (+ 1) at end of the last edited range before the edit, 0 if unknown
+
+        private readonly List<SyntaxToken> tokens = new List<SyntaxToken>();
+        private readonly List<ColorRun> runs = new List<ColorRun>();
+
+        private readonly Color[] colors = new Color[]
+        {
+            Color.Empty, // Plain: foreground color
+            Color.Blue, // Keyword
+            Color.Green, // Comment
+            Color.FromArgb(163, 21, 21), // String
+            Color.DarkCyan, // Number
+            Color.Gray, // Preprocessor
+        };
+
+        public SyntaxHighlighter(ISyntaxTokenizer tokenizer)
+        {
+            this.tokenizer = tokenizer;
+        }
+
+        public ISyntaxTokenizer Tokenizer { get { return tokenizer; } }
+
+        public void Reset(int lineCount)
+        {
+            states.Clear();
+            states.InsertRange(0, new byte[lineCount]);
+            validThrough = 0;
+            dirtyEnd = 0;
+            knownEnd = 0;
+        }
+
+        // call before lines [startLine, startLine + removedLines] are replaced by [startLine, startLine + insertedLines]
+        public void ReplacingLines(int startLine, int removedLines, int insertedLines)
+        {
+            int oldEnd = startLine + removedLines;
+            int delta = insertedLines - removedLines;
+
+            editEndState = oldEnd < validThrough ? states[oldEnd] : (byte)0;
+
+            // A pending region is only usable if re-lexing has not yet passed into it: lines re-lexed after dirtyEnd
+            // are consistent with the new text but those beyond them are not.
+            bool pending = (knownEnd > validThrough) && (validThrough <= dirtyEnd);
+            int known = pending ? knownEnd : validThrough;
+            int dirty = startLine + insertedLines + 1;
+            if (pending && (dirtyEnd > oldEnd))
+            {
+                dirty = Math.Max(dirty, dirtyEnd + delta);
+            }
+
+            states.RemoveRange(startLine, removedLines + 1);
+            states.InsertRange(startLine, new byte[insertedLines + 1]);
+
+            validThrough = Math.Min(validThrough, startLine);
+            dirtyEnd = dirty;
+            knownEnd = known > oldEnd ? known + delta : 0;
+            if (knownEnd <= dirtyEnd)
+            {
+                knownEnd = 0; // nothing salvageable
+            }
+        }
+
+        // after an edit: whether the state at the end of the edited range changed (or is unknown), in which case colors
+        // of following lines may have changed as well
+        public bool EditChangedFollowingLines(int replacedEndLine, Func<int, string> getLine)
+        {
+            return (editEndState == 0) || (GetEndState(replacedEndLine, getLine) + 1 != editEndState);
+        }
+
+        private byte GetEndState(int line, Func<int, string> getLine)
+        {
+            Debug.Assert(states.Count != 0);
+            line = Math.Min(line, states.Count - 1);
+            while (validThrough <= line)
+            {
+                int i = validThrough;
+                byte start = i == 0 ? tokenizer.InitialState : (byte)(states[i - 1] - 1);
+                byte end = tokenizer.Tokenize(getLine(i), start, null);
+                Debug.Assert(end < Byte.MaxValue);
+                byte old = states[i];
+                states[i] = (byte)(end + 1);
+                validThrough++;
+
+                if ((i >= dirtyEnd) && (i < knownEnd) && (old == end + 1))
+                {
+                    // converged - everything computed before the edit from here on is still correct
+                    validThrough = knownEnd;
+                    knownEnd = 0;
+                }
+            }
+            return (byte)(states[line] - 1);
+        }
+
+        // color runs for a line about to be painted, which may be the tab-expanded form of the stored line
+        public List<ColorRun> GetColorRuns(int line, string text, Func<int, string> getLine)
+        {
+            byte state = line == 0 ? tokenizer.InitialState : GetEndState(line - 1, getLine);
+
+            tokens.Clear();
+            tokenizer.Tokenize(text, state, tokens);
+
+            runs.Clear();
+            foreach (SyntaxToken token in tokens)
+            {
+                if ((token.kind != SyntaxTokenKind.Plain) && (token.length > 0))
+                {
+                    runs.Add(new ColorRun(token.start, token.length, colors[(int)token.kind]));
+                }
+            }
+            return runs;
+        }
+    }
+}
@@ -0,0 +1,204 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Diagnostics;
+
+namespace TextEditor
+{
+    // Tab stop map for a single line: positions of tab characters and the column immediately following each
+    // tab's expansion. Lines without tabs share an empty map so they skip tab expansion entirely.
+    public class TabStops
+    {
+        private static readonly int[] Empty = new int[0];
+
+        private readonly int length; // in chars
+        private readonly int expandedLength; // in columns
+        private readonly int[] positions; // char index of each tab
+        private readonly int[] ends; // column after expansion of each tab
+
+        private TabStops(int length, int expandedLength, int[] positions, int[] ends)
+        {
+            this.length = length;
+            this.expandedLength = expandedLength;
+            this.positions = positions;
+            this.ends = ends;
+        }
+
+        public static TabStops Build(char[] line, int lineLength, int spacesPerTab)
+        {
+            if (spacesPerTab < 1)
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+
+            int tabCount = 0;
+            for (int i = 0; i < lineLength; i++)
+            {
+                if (line[i] == '\t')
+                {
+                    tabCount++;
+                }
+            }
+            if (tabCount == 0)
+            {
+                return new TabStops(lineLength, lineLength, Empty, Empty);
+            }
+
+            int[] positions = new int[tabCount];
+            int[] ends = new int[tabCount];
+            int column = 0;
+            int j = 0;
+            for (int i = 0; i < lineLength; i++)
+            {
+                if (line[i] == '\t')
+                {
+                    column += spacesPerTab - (column % spacesPerTab);
+                    positions[j] = i;
+                    ends[j] = column;
+                    j++;
+                }
+                else
+                {
+                    column += 1;
+                }
+            }
+            return new TabStops(lineLength, column, positions, ends);
+        }
+
+        public int Length { get { return length; } }
+
+        public int ExpandedLength { get { return expandedLength; } }
+
+        public bool TabsFound { get { return positions.Length != 0; } }
+
+        // number of elements of sorted array less than value
+        private static int CountLess(int[] array, int value)
+        {
+            int lo = 0;
+            int hi = array.Length;
+            while (lo < hi)
+            {
+                int mid = lo + (hi - lo) / 2;
+                if (array[mid] < value)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
+        /* given a character index, calculate where the corresponding position is */
+        /* when tabs have been converted into spaces */
+        public int ColumnFromCharIndex(int charIndex)
+        {
+            if (charIndex > length)
+            {
+                charIndex = length;
+            }
+            Debug.Assert(charIndex >= 0);
+
+            int k = CountLess(positions, charIndex); // tabs preceding charIndex
+            if (k == 0)
+            {
+                return charIndex;
+            }
+            return ends[k - 1] + (charIndex - (positions[k - 1] + 1));
+        }
+
+        /* index of first character whose expanded extent reaches column, or line length if none */
+        public int CharIndexFromColumn(int column)
+        {
+            int k = CountLess(ends, column); // tabs ending strictly before column
+            int basePosition = k == 0 ? 0 : positions[k - 1] + 1;
+            int baseColumn = k == 0 ? 0 : ends[k - 1];
+            // within a run of non-tab chars column advances one per char; the next tab (if any) reaches column
+            int afterEnd = basePosition + (column - baseColumn);
+            if ((k < positions.Length) && (afterEnd > positions[k] + 1))
+            {
+                afterEnd = positions[k] + 1;
+            }
+            return Math.Min(Math.Max(afterEnd, 1) - 1, length);
+        }
+
+        /* nearest insertion point (char index) for a column with tabs expanded; a column within the */
+        /* expansion of a tab goes to whichever side of the tab is nearer */
+        public int CharIndexFromCaretColumn(int column)
+        {
+            int k = CountLess(ends, column + 1); // tabs ending at or before column
+            int basePosition = k == 0 ? 0 : positions[k - 1] + 1;
+            int baseColumn = k == 0 ? 0 : ends[k - 1];
+            int index = basePosition + (column - baseColumn);
+            if ((k < positions.Length) && (index > positions[k]))
+            {
+                int tabColumn = baseColumn + (positions[k] - basePosition);
+                int width = ends[k] - tabColumn;
+                index = tabColumn + width / 2 < column ? positions[k] + 1 : positions[k];
+            }
+            return Math.Min(index, length);
+        }
+    }
+
+    // Memoizes TabStops for recently used lines, with the same edit notification protocol as LineWidthCache.
+    // Entries depend on tab size, so owner must Clear() when it changes.
+    public class TabStopCache
+    {
+        private readonly SparseLineCache<TabStops> entries = new SparseLineCache<TabStops>(); // null means invalid
+
+        public int BlockCount { get { return entries.BlockCount; } }
+
+        public void Clear()
+        {
+            entries.Clear();
+        }
+
+        public void Set(int index, TabStops tabStops)
+        {
+            Debug.Assert(tabStops != null);
+            entries.Set(index, tabStops);
+        }
+
+        public void Invalidate(int index)
+        {
+            entries.Invalidate(index);
+        }
+
+        public bool TryGet(int index, out TabStops tabStops)
+        {
+            return entries.TryGet(index, out tabStops);
+        }
+
+        public void Insert(int index, int count)
+        {
+            entries.Insert(index, count);
+        }
+
+        public void Delete(int index, int count)
+        {
+            entries.Delete(index, count);
+        }
+    }
+}
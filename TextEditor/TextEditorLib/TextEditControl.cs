@@ -1036,6 +1036,26 @@ namespace TextEditor
             redo = null;
         }
 
+        // approximate memory held by undo and redo history, for session memory accounting
+        [Browsable(false)]
+        public long UndoRedoFootprint
+        {
+            get
+            {
+                return (undo != null ? undo.Footprint : 0) + (redo != null ? redo.Footprint : 0);
+            }
+        }
+
+        // discard redo and all but the most recent keepBytes (approximately) of undo history
+        public void TrimUndoRedo(long keepBytes)
+        {
+            if (undo != null)
+            {
+                undo.Trim(keepBytes);
+            }
+            redo = null;
+        }
+
         public void UndoSaveSelection()
         {
             if (ChangeListener != null)
@@ -1072,9 +1092,16 @@ namespace TextEditor
 
         private abstract class UndoRecord
         {
+            protected const int RecordOverheadBytes = 48;
+
             public UndoRecord Next;
 
             public abstract void Undo(TextViewControl textView);
+
+            public virtual long EstimateMemoryBytes()
+            {
+                return RecordOverheadBytes;
+            }
         }
 
         private class SelectionUndoRecord : UndoRecord
@@ -1164,6 +1191,11 @@ namespace TextEditor
                     Deleted,
                     1);
             }
+
+            public override long EstimateMemoryBytes()
+            {
+                return RecordOverheadBytes + Deleted.EstimateMemoryBytes();
+            }
         }
 
         private class TextUndoTracker : ITextEditorChangeTracking
@@ -1193,6 +1225,61 @@ namespace TextEditor
                 records = null;
             }
 
+            public long Footprint
+            {
+                get
+                {
+                    long bytes = 0;
+                    for (UndoRecord record = records; record != null; record = record.Next)
+                    {
+                        bytes += record.EstimateMemoryBytes();
+                    }
+                    return bytes;
+                }
+            }
+
+            // Discard the oldest records beyond keepBytes, cutting only between groups (or ungrouped records) so that
+            // each remaining group is undone whole. Nothing is discarded while a group is open.
+            public void Trim(long keepBytes)
+            {
+                if (groupStart != null)
+                {
+                    return;
+                }
+
+                long bytes = 0;
+                bool inGroup = false;
+                UndoRecord kept = null; // oldest record to keep so far
+                for (UndoRecord record = records; record != null; record = record.Next)
+                {
+                    if (record is GroupEndUndoRecord)
+                    {
+                        inGroup = true;
+                    }
+                    else if (record is GroupStartUndoRecord)
+                    {
+                        inGroup = false;
+                    }
+                    bytes += record.EstimateMemoryBytes();
+                    if (!inGroup)
+                    {
+                        if (bytes > keepBytes)
+                        {
+                            if (kept == null)
+                            {
+                                records = null;
+                            }
+                            else
+                            {
+                                kept.Next = null;
+                            }
+                            return;
+                        }
+                        kept = record;
+                    }
+                }
+            }
+
             public IDisposable OpenGroup()
             {
                 // defer this until close group - avoids clearing redo if group was empty
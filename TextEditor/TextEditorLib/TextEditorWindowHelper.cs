@@ -847,7 +847,7 @@ namespace TextEditor
 
             using (IDisposable undoGroup = textEditControl.UndoOpenGroup())
             {
-                SelPoint start, end;
+                SelPoint start, end = new SelPoint();
                 if (settings.RestrictToSelection)
                 {
                     textEditControl.UndoSaveSelection();
@@ -857,16 +857,19 @@ namespace TextEditor
                 else
                 {
                     start = new SelPoint(0, 0);
-                    end = new SelPoint(textEditControl.Count - 1, textEditControl.GetLine(textEditControl.Count - 1).Length);
                 }
 
+                // unrestricted, Find stopping at the end of the text is the only limit - the end of the range needs
+                // tracking (in O(1) SelPoint arithmetic per replacement) only when restricted to the selection
                 textEditControl.SetInsertionPoint(start);
                 while (textEditControl.Find(find, settings.CaseSensitive, settings.MatchWholeWord, false/*wrap*/, false/*up*/)
-                    && (textEditControl.SelectionStart <= end)
-                    && (textEditControl.SelectionEnd <= end))
+                    && (!settings.RestrictToSelection || (textEditControl.SelectionEnd <= end)))
                 {
-                    end = textEditControl.AdjustForRemove(end, textEditControl.Selection);
-                    end = textEditControl.AdjustForInsert(end, textEditControl.SelectionStart, replace);
+                    if (settings.RestrictToSelection)
+                    {
+                        end = textEditControl.AdjustForRemove(end, textEditControl.Selection);
+                        end = textEditControl.AdjustForInsert(end, textEditControl.SelectionStart, replace);
+                    }
                     textEditControl.SelectedTextStorage = replace;
                     textEditControl.SetInsertionPoint(textEditControl.SelectionEndLine, textEditControl.SelectionEndCharPlusOne);
                 }
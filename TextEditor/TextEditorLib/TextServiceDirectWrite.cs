@@ -37,24 +37,35 @@ namespace TextEditor
 
         private static TextServiceDirectWriteGlobalsHandle interopGlobals;
 
+        // The globals (and the caches they hold) are not thread safe, but a service may be prepared on a worker thread
+        // (see TextViewControl.SetTextServiceDeferred) while the UI thread uses another, so hold this when calling
+        // into the globals.
+        public static readonly object InteropGlobalsLock = new object();
+
         public static TextServiceDirectWriteGlobalsHandle InteropGlobals
         {
             get
             {
-                if (interopGlobals == null)
+                lock (InteropGlobalsLock)
                 {
-                    interopGlobals = new TextServiceDirectWriteGlobalsHandle();
+                    if (interopGlobals == null)
+                    {
+                        interopGlobals = new TextServiceDirectWriteGlobalsHandle();
+                    }
+                    return interopGlobals;
                 }
-                return interopGlobals;
             }
         }
 
         public static void DisposeInteropGlobals()
         {
-            if (interopGlobals != null)
+            lock (InteropGlobalsLock)
             {
-                interopGlobals._Dispose();
-                interopGlobals = null;
+                if (interopGlobals != null)
+                {
+                    interopGlobals._Dispose();
+                    interopGlobals = null;
+                }
             }
         }
 
@@ -117,7 +128,11 @@ namespace TextEditor
             Font font,
             int visibleWidth)
         {
-            int hr = interop.Reset(TextServiceDirectWrite.InteropGlobals, font, visibleWidth);
+            int hr;
+            lock (InteropGlobalsLock)
+            {
+                hr = interop.Reset(TextServiceDirectWrite.InteropGlobals, font, visibleWidth);
+            }
             if (hr < 0)
             {
                 Marshal.ThrowExceptionForHR(hr);
@@ -134,36 +149,44 @@ namespace TextEditor
             int fontHeight, // TODO: pass this through
             string line)
         {
-            int index;
-            if ((index = line.IndexOfAny(new char[] { '\r', '\n' })) >= 0)
-            {
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
+            long perf = PerfCounters.Begin();
             try
             {
-                return new TextLayout(
-                    this,
-                    line,
-                    graphics,
-                    font);
-            }
-            catch (Exception exception)
-            {
-                using (Font font2 = new Font(FontFamily.GenericSansSerif, fontHeight / 2.5f, FontStyle.Regular))
+                int index;
+                if ((index = line.IndexOfAny(new char[] { '\r', '\n' })) >= 0)
+                {
+                    Debug.Assert(false);
+                    throw new ArgumentException();
+                }
+                try
                 {
                     return new TextLayout(
                         this,
-                        exception.ToString().Replace("\r", " ").Replace("\n", " "),
+                        line,
                         graphics,
-                        font2);
+                        font);
                 }
+                catch (Exception exception)
+                {
+                    using (Font font2 = new Font(FontFamily.GenericSansSerif, fontHeight / 2.5f, FontStyle.Regular))
+                    {
+                        return new TextLayout(
+                            this,
+                            exception.ToString().Replace("\r", " ").Replace("\n", " "),
+                            graphics,
+                            font2);
+                    }
+                }
+            }
+            finally
+            {
+                PerfCounters.End(PerfCounter.AnalyzeText, perf);
             }
         }
 
 
         [ClassInterface(ClassInterfaceType.None)]
-        private class TextLayout : ITextInfo, IDisposable
+        private class TextLayout : ITextInfo, ITextInfoColorRuns, IDisposable
         {
             private readonly TextServiceLineDirectWriteInterop lineInterop;
             private readonly ITextInfo uniscribeLine;
@@ -225,6 +248,19 @@ namespace TextEditor
                 GC.SuppressFinalize(this);
             }
 
+            // applied to the layout as DirectWrite drawing effects
+            public void SetColorRuns(List<ColorRun> runs)
+            {
+                foreach (ColorRun run in runs)
+                {
+                    int hr = lineInterop.SetColor(run.start, run.length, run.color);
+                    if (hr < 0)
+                    {
+                        Marshal.ThrowExceptionForHR(hr);
+                    }
+                }
+            }
+
             public void DrawText(
                 Graphics graphics,
                 Bitmap backing,
@@ -232,6 +268,7 @@ namespace TextEditor
                 Color foreColor,
                 Color backColor)
             {
+                long perf = PerfCounters.Begin();
                 try
                 {
                     int hr = lineInterop.DrawText(
@@ -259,6 +296,10 @@ namespace TextEditor
                             TextFormatFlags.Left | TextFormatFlags.NoPrefix | TextFormatFlags.NoPadding | TextFormatFlags.PreserveGraphicsClipping | TextFormatFlags.SingleLine);
                     }
                 }
+                finally
+                {
+                    PerfCounters.End(PerfCounter.DrawText, perf);
+                }
             }
 
             public Region BuildRegion(
@@ -412,12 +453,22 @@ namespace TextEditor
     // A rather incomplete wrapper around DirectWrite that provides functions matching what TextRenderer provides.
     public static class DirectWriteTextRenderer
     {
-        private static List<KeyValuePair<Font, TextServiceDirectWriteInterop>> interops;
+        private static List<KeyValuePair<Font, TextServiceDirectWriteInterop>> interops; // most recently used first
         private static int lastWidth;
-        private const int MaxCachedInterops = 3;
+        private const int MaxCachedInterops = 8;
         private static TextServiceLineDirectWriteInterop lineInterop;
 
+        // Interops are cheap to re-Reset since text formats are shared process-wide by the interop globals, so a
+        // screen width change resizes the existing render targets and a full list evicts only the least recently used.
         private static TextServiceDirectWriteInterop EnsureInterop(Font font)
+        {
+            lock (TextServiceDirectWrite.InteropGlobalsLock)
+            {
+                return EnsureInteropLocked(font);
+            }
+        }
+
+        private static TextServiceDirectWriteInterop EnsureInteropLocked(Font font)
         {
             if (interops == null)
             {
@@ -426,9 +477,12 @@ namespace TextEditor
 
             if (lastWidth != Screen.PrimaryScreen.Bounds.Width)
             {
-                ClearCache();
+                lastWidth = Screen.PrimaryScreen.Bounds.Width;
+                for (int i = 0; i < interops.Count; i++)
+                {
+                    interops[i].Value.Reset(TextServiceDirectWrite.InteropGlobals, interops[i].Key, lastWidth);
+                }
             }
-            lastWidth = Screen.PrimaryScreen.Bounds.Width;
 
             int index = -1;
             for (int i = 0; i < interops.Count; i++)
@@ -436,18 +490,43 @@ namespace TextEditor
                 if (font.Equals(interops[i].Key))
                 {
                     index = i;
+                    break;
                 }
             }
-            if (index < 0)
+            if (index == 0)
+            {
+                return interops[0].Value;
+            }
+
+            KeyValuePair<Font, TextServiceDirectWriteInterop> entry;
+            if (index > 0)
+            {
+                entry = interops[index];
+                interops.RemoveAt(index);
+            }
+            else
             {
                 if (interops.Count >= MaxCachedInterops)
                 {
-                    ClearCache();
+                    KeyValuePair<Font, TextServiceDirectWriteInterop> evicted = interops[interops.Count - 1];
+                    interops.RemoveAt(interops.Count - 1);
+                    evicted.Value._Dispose();
+#if DEBUG
+                    Debugger.Log(
+                        1,
+                        "TextServiceDirectWrite",
+                        String.Concat(
+                            DateTime.Now.ToString(),
+                            ": Evicted DirectWrite interop for ",
+                            evicted.Key.ToString(),
+                            " ",
+                            evicted.Key.Style.ToString(),
+                            Environment.NewLine));
+#endif
                 }
-                index = interops.Count;
                 TextServiceDirectWriteInterop interop = new TextServiceDirectWriteInterop();
                 interop.Reset(TextServiceDirectWrite.InteropGlobals, font, lastWidth);
-                interops.Add(new KeyValuePair<Font, TextServiceDirectWriteInterop>(font, interop));
+                entry = new KeyValuePair<Font, TextServiceDirectWriteInterop>(font, interop);
 #if DEBUG
                 Debugger.Log(
                     1,
@@ -461,7 +540,8 @@ namespace TextEditor
                         Environment.NewLine));
 #endif
             }
-            return interops[index].Value;
+            interops.Insert(0, entry);
+            return entry.Value;
         }
 
         private static void ClearCache()
@@ -631,16 +711,31 @@ namespace TextEditor
         }
 
 
+        // pins of memory fonts - the globals serve the data in place, so it stays pinned for the life of the process
+        private static readonly List<GCHandle> pinnedFonts = new List<GCHandle>();
+
+        // font data is served to DirectWrite in place (not copied) - the array must not be modified afterwards
         public static void RegisterPrivateMemoryFont(byte[] data)
         {
             GCHandle hData = GCHandle.Alloc(data, GCHandleType.Pinned);
-            try
+            lock (TextServiceDirectWrite.InteropGlobalsLock)
             {
+                pinnedFonts.Add(hData);
                 TextServiceDirectWrite.InteropGlobals.AddFont(hData.AddrOfPinnedObject().ToInt64(), data.Length);
             }
-            finally
+        }
+
+        // font is memory mapped read-only and served to DirectWrite in place (not copied)
+        public static void RegisterPrivateFontFile(string path)
+        {
+            int hr;
+            lock (TextServiceDirectWrite.InteropGlobalsLock)
             {
-                hData.Free();
+                hr = TextServiceDirectWrite.InteropGlobals.AddFontFile(path);
+            }
+            if (hr < 0)
+            {
+                Marshal.ThrowExceptionForHR(hr);
             }
         }
     }
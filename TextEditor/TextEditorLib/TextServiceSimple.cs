@@ -21,6 +21,7 @@
 */
 
 using System;
+using System.Collections.Generic;
 using System.Diagnostics;
 using System.Drawing;
 using System.Runtime.InteropServices;
@@ -33,12 +34,13 @@ namespace TextEditor
     {
         private const TextFormatFlags textFormatFlags = TextFormatFlags.NoPrefix | TextFormatFlags.NoPadding | TextFormatFlags.SingleLine;
 
-        private class TextInfoSimple : ITextInfo, IDisposable
+        private class TextInfoSimple : ITextInfo, ITextInfoColorRuns, IDisposable
         {
             private readonly string line;
             private readonly Font font;
             private readonly int fontHeight;
             private readonly Size size;
+            private ColorRun[] colorRuns;
 
             public TextInfoSimple(string line, Font font, int fontHeight, Size size)
             {
@@ -52,6 +54,11 @@ namespace TextEditor
             {
             }
 
+            public void SetColorRuns(List<ColorRun> runs)
+            {
+                colorRuns = runs.Count != 0 ? runs.ToArray() : null;
+            }
+
 #if WINDOWS
             private class DeviceContext : IDeviceContext
             {
@@ -94,28 +101,67 @@ namespace TextEditor
                 Color foreColor,
                 Color backColor)
             {
+                long perf = PerfCounters.Begin();
+                try
+                {
+                    int[] runX = null; // measured before the HDC is taken
+                    if (colorRuns != null)
+                    {
+                        runX = new int[colorRuns.Length];
+                        for (int i = 0; i < colorRuns.Length; i++)
+                        {
+                            runX[i] = MeasureTextPrefix(graphics, font, line, colorRuns[i].start);
+                        }
+                    }
 #if WINDOWS
-                using (DeviceContext dc = new DeviceContext(graphics))
+                    using (DeviceContext dc = new DeviceContext(graphics))
 #else
 #endif
-                {
-                    TextRenderer.DrawText(
+                    {
+                        TextRenderer.DrawText(
 #if WINDOWS
-                        dc,
+                            dc,
 #else
-                        graphics, // Mono's TextRenderer reverses IDeviceContext back to Graphics, but GDI is off the table for Mono so we don't need it.
+                            graphics, // Mono's TextRenderer reverses IDeviceContext back to Graphics, but GDI is off the table for Mono so we don't need it.
 #endif
-                        line,
-                        font,
-                        position,
-                        foreColor,
-                        backColor,
+                            line,
+                            font,
+                            position,
+                            foreColor,
+                            backColor,
+#if WINDOWS
+                            textFormatFlags
+#else
+                            textFormatFlags | TextFormatFlags.PreserveGraphicsClipping
+#endif
+                            );
+
+                        // colored runs are drawn over the plain text (exact for the monospaced fonts this service is meant for)
+                        for (int i = 0; (colorRuns != null) && (i < colorRuns.Length); i++)
+                        {
+                            TextRenderer.DrawText(
 #if WINDOWS
-                        textFormatFlags
+                                dc,
 #else
-                        textFormatFlags | TextFormatFlags.PreserveGraphicsClipping
+                                graphics,
 #endif
-                        );
+                                line.Substring(colorRuns[i].start, colorRuns[i].length),
+                                font,
+                                new Point(position.X + runX[i], position.Y),
+                                colorRuns[i].color,
+                                backColor,
+#if WINDOWS
+                                textFormatFlags
+#else
+                                textFormatFlags | TextFormatFlags.PreserveGraphicsClipping
+#endif
+                                );
+                        }
+                    }
+                }
+                finally
+                {
+                    PerfCounters.End(PerfCounter.DrawText, perf);
                 }
             }
 
@@ -343,22 +389,30 @@ namespace TextEditor
             int fontHeight,
             string line)
         {
-            if (line.IndexOfAny(new char[] { '\r', '\n' }) >= 0)
+            long perf = PerfCounters.Begin();
+            try
+            {
+                if (line.IndexOfAny(new char[] { '\r', '\n' }) >= 0)
+                {
+                    Debug.Assert(false);
+                    throw new ArgumentException();
+                }
+                Size size = TextRenderer.MeasureText(
+                    graphics,
+                    line,
+                    font,
+                    new Size(Int32.MaxValue, Int32.MaxValue),
+                    textFormatFlags);
+                return new TextInfoSimple(
+                    line,
+                    font,
+                    fontHeight,
+                    size);
+            }
+            finally
             {
-                Debug.Assert(false);
-                throw new ArgumentException();
+                PerfCounters.End(PerfCounter.AnalyzeText, perf);
             }
-            Size size = TextRenderer.MeasureText(
-                graphics,
-                line,
-                font,
-                new Size(Int32.MaxValue, Int32.MaxValue),
-                textFormatFlags);
-            return new TextInfoSimple(
-                line,
-                font,
-                fontHeight,
-                size);
         }
 
         public TextService Service { get { return TextService.Simple; } }
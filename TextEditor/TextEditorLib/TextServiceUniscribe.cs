@@ -168,30 +168,38 @@ namespace TextEditor
             int fontHeight,
             string line)
         {
-            int index;
-            if ((index = line.IndexOfAny(new char[] { '\r', '\n' })) >= 0)
+            long perf = PerfCounters.Begin();
+            try
             {
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
+                int index;
+                if ((index = line.IndexOfAny(new char[] { '\r', '\n' })) >= 0)
+                {
+                    Debug.Assert(false);
+                    throw new ArgumentException();
+                }
 
-            if (offscreenStrip == null)
-            {
-                using (GraphicsHDC hdc = new GraphicsHDC(graphics))
+                if (offscreenStrip == null)
                 {
-                    offscreenStrip = new GDIBitmap(visibleWidth, fontHeight, hdc);
+                    using (GraphicsHDC hdc = new GraphicsHDC(graphics))
+                    {
+                        offscreenStrip = new GDIBitmap(visibleWidth, fontHeight, hdc);
+                    }
+                    Debug.Assert(hdcOffscreenStrip == null);
+                    hdcOffscreenStrip = GDIDC.Create(offscreenStrip);
                 }
-                Debug.Assert(hdcOffscreenStrip == null);
-                hdcOffscreenStrip = GDIDC.Create(offscreenStrip);
-            }
 
-            using (Pin<string> pinLine = new Pin<string>(line))
+                using (Pin<string> pinLine = new Pin<string>(line))
+                {
+                    return TextItems.AnalyzeText(
+                        this,
+                        hdcOffscreenStrip,
+                        pinLine.AddrOfPinnedObject(),
+                        new FontRunInfo[] { new FontRunInfo(line.Length, font, fontHeight) });
+                }
+            }
+            finally
             {
-                return TextItems.AnalyzeText(
-                    this,
-                    hdcOffscreenStrip,
-                    pinLine.AddrOfPinnedObject(),
-                    new FontRunInfo[] { new FontRunInfo(line.Length, font, fontHeight) });
+                PerfCounters.End(PerfCounter.AnalyzeText, perf);
             }
         }
 
@@ -923,84 +931,92 @@ namespace TextEditor
                 Color foreColor,
                 Color backColor)
             {
-                COLORREF foreColorRef = new COLORREF(foreColor);
-
-                int width = backing.Width;
-                int height = backing.Height;
-                Rectangle bounds = new Rectangle(0, 0, width, height);
-                Rectangle margin = new Rectangle(-height, 0, width + 2 * height, height);
-                Debug.Assert(service.offscreenStrip != null);
-                Debug.Assert(service.offscreenStrip.Width == width);
-                Debug.Assert(service.offscreenStrip.Height == height);
-
-                using (GDIBrush backBrush = new GDIBrush(backColor))
+                long perf = PerfCounters.Begin();
+                try
                 {
-                    GDI.FillRect(service.hdcOffscreenStrip, ref bounds, backBrush);
-                }
+                    COLORREF foreColorRef = new COLORREF(foreColor);
 
-                ProcessText(
-                    position,
-                    delegate (
-                        int iItem,
-                        Point where,
-                        int endX,
-                        ref SCRIPT_ITEM item,
-                        ref ItemInfo itemExtra,
-                        Font font)
+                    int width = backing.Width;
+                    int height = backing.Height;
+                    Rectangle bounds = new Rectangle(0, 0, width, height);
+                    Rectangle margin = new Rectangle(-height, 0, width + 2 * height, height);
+                    Debug.Assert(service.offscreenStrip != null);
+                    Debug.Assert(service.offscreenStrip.Width == width);
+                    Debug.Assert(service.offscreenStrip.Height == height);
+
+                    using (GDIBrush backBrush = new GDIBrush(backColor))
                     {
-                        if (!graphics.IsVisible(new Rectangle(where.X - height, 0, endX - where.X + 2 * height, height)))
+                        GDI.FillRect(service.hdcOffscreenStrip, ref bounds, backBrush);
+                    }
+
+                    ProcessText(
+                        position,
+                        delegate (
+                            int iItem,
+                            Point where,
+                            int endX,
+                            ref SCRIPT_ITEM item,
+                            ref ItemInfo itemExtra,
+                            Font font)
                         {
-                            return true;
-                        }
+                            if (!graphics.IsVisible(new Rectangle(where.X - height, 0, endX - where.X + 2 * height, height)))
+                            {
+                                return true;
+                            }
 
-                        int fontCacheIndex = service.FontCacheIndex(font);
+                            int fontCacheIndex = service.FontCacheIndex(font);
 
-                        GDI.SetTextColor(service.hdcOffscreenStrip, foreColorRef);
-                        GDI.SetBkMode(service.hdcOffscreenStrip, GDI.TRANSPARENT);
-                        GDI.SelectObject(service.hdcOffscreenStrip, service.fontToHFont[font]);
+                            GDI.SetTextColor(service.hdcOffscreenStrip, foreColorRef);
+                            GDI.SetBkMode(service.hdcOffscreenStrip, GDI.TRANSPARENT);
+                            GDI.SelectObject(service.hdcOffscreenStrip, service.fontToHFont[font]);
 
-                        int hr = ScriptTextOut(
-                            service.hdcOffscreenStrip,
-                            ref service.caches[fontCacheIndex].cache,
-                            where.X,
-                            where.Y,
-                            (ScriptTextOutOptions)0,
-                            IntPtr.Zero/*cliprect*/,
-                            ref item.a,
-                            IntPtr.Zero/*reserved*/,
-                            0/*reserved*/,
-                            itemExtra.glyphs,
-                            itemExtra.cGlyphs,
-                            itemExtra.iAdvances,
-                            null/*piJustify*/,
-                            itemExtra.goffsets);
-                        if (hr < 0)
-                        {
-                            Marshal.ThrowExceptionForHR(hr);
-                        }
+                            int hr = ScriptTextOut(
+                                service.hdcOffscreenStrip,
+                                ref service.caches[fontCacheIndex].cache,
+                                where.X,
+                                where.Y,
+                                (ScriptTextOutOptions)0,
+                                IntPtr.Zero/*cliprect*/,
+                                ref item.a,
+                                IntPtr.Zero/*reserved*/,
+                                0/*reserved*/,
+                                itemExtra.glyphs,
+                                itemExtra.cGlyphs,
+                                itemExtra.iAdvances,
+                                null/*piJustify*/,
+                                itemExtra.goffsets);
+                            if (hr < 0)
+                            {
+                                Marshal.ThrowExceptionForHR(hr);
+                            }
 
-                        return true;
-                    });
+                            return true;
+                        });
 
-                using (GDIRegion gdiRgnClip = new GDIRegion(graphics.Clip.GetHrgn(graphics)))
-                {
-                    using (GraphicsHDC gdiHdcOffscreen = new GraphicsHDC(graphics))
+                    using (GDIRegion gdiRgnClip = new GDIRegion(graphics.Clip.GetHrgn(graphics)))
                     {
-                        // Graphics/GDI+ doesn't pass clip region through so we have to reset it explicitly
-                        GDI.SelectClipRgn(gdiHdcOffscreen, gdiRgnClip);
-
-                        GDI.BitBlt(
-                            gdiHdcOffscreen,
-                            0,
-                            0,
-                            width,
-                            height,
-                            service.hdcOffscreenStrip,
-                            0,
-                            0,
-                            GDI.SRCCOPY);
+                        using (GraphicsHDC gdiHdcOffscreen = new GraphicsHDC(graphics))
+                        {
+                            // Graphics/GDI+ doesn't pass clip region through so we have to reset it explicitly
+                            GDI.SelectClipRgn(gdiHdcOffscreen, gdiRgnClip);
+
+                            GDI.BitBlt(
+                                gdiHdcOffscreen,
+                                0,
+                                0,
+                                width,
+                                height,
+                                service.hdcOffscreenStrip,
+                                0,
+                                0,
+                                GDI.SRCCOPY);
+                        }
                     }
                 }
+                finally
+                {
+                    PerfCounters.End(PerfCounter.DrawText, perf);
+                }
             }
 
             public Region BuildRegion(
@@ -103,16 +103,64 @@ namespace TextEditor
         {
             get
             {
-                return GetLine(index);
+                long perf = PerfCounters.Begin();
+                ITextLine line = GetLine(index);
+                PerfCounters.End(PerfCounter.GetLine, perf);
+                return line;
             }
         }
 
+        // grow caller's buffer (discarding contents) so that it can hold at least length elements
+        public static void EnsureCapacity<T>(ref T[] buffer, int length)
+        {
+            if ((buffer == null) || (buffer.Length < length))
+            {
+                int capacity = buffer != null ? buffer.Length : 0;
+                capacity = Math.Max(Math.Max(capacity * 2, length), 128);
+                buffer = new T[capacity];
+            }
+        }
+
+        public virtual int CopyLine(int index, ref char[] buffer)
+        {
+            IDecodedTextLine decodedLine = GetLine(index).Decode_MustDispose();
+            int length = decodedLine.Length;
+            EnsureCapacity(ref buffer, length);
+            decodedLine.Value.CopyTo(0, buffer, 0, length);
+            return length;
+        }
+
+        public TextLineEnumerator EnumerateLines(int startLine, int count, char[] buffer)
+        {
+            return new TextLineEnumerator(this, startLine, count, buffer);
+        }
+
+        // length of line in chars - overridable for storages that can compute it without materializing the line
+        protected virtual int GetLineLength(int index)
+        {
+            return GetLine(index).Length;
+        }
+
         public virtual string GetText(string EOLN)
         {
             StringBuilder sb = MakeRawBuffer(EOLN);
             return sb.ToString();
         }
 
+        // The base estimate assumes UTF-16 code units and an object per line, and walks the lines; storages that keep
+        // their total length override it.
+        protected const int LineOverheadBytes = 32;
+        public virtual long EstimateMemoryBytes()
+        {
+            int count = GetLineCount();
+            long chars = 0;
+            for (int i = 0; i < count; i++)
+            {
+                chars += GetLineLength(i);
+            }
+            return 2 * chars + (long)LineOverheadBytes * count;
+        }
+
         public bool Modified
         {
             get
@@ -133,8 +181,8 @@ namespace TextEditor
             }
         }
 
-        /* extract part of the stored data in the form of another text storage object */
-        public virtual ITextStorage CloneSection(
+        /* validate a range of text specified as start and end line/char positions */
+        protected void CheckSectionRange(
             int startLine,
             int startChar,
             int endLine,
@@ -153,13 +201,42 @@ namespace TextEditor
                 Debug.Assert(false);
                 throw new ArgumentException();
             }
-            if ((startChar < 0) || (startChar > GetLine(startLine).Length)
-                || (endCharPlusOne < 0) || (endCharPlusOne > GetLine(endLine).Length))
+            if ((startChar < 0) || (startChar > GetLineLength(startLine))
+                || (endCharPlusOne < 0) || (endCharPlusOne > GetLineLength(endLine)))
             {
                 // Character ranges for lines exceeded
                 Debug.Assert(false);
                 throw new ArgumentException();
             }
+        }
+
+        /* validate a line/char position */
+        protected void CheckPosition(
+            int line,
+            int charIndex)
+        {
+            if ((line < 0) || (line >= GetLineCount()))
+            {
+                // Line position out of range
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+            if ((charIndex < 0) || (charIndex > GetLineLength(line)))
+            {
+                // Character position out of range
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+        }
+
+        /* extract part of the stored data in the form of another text storage object */
+        public virtual ITextStorage CloneSection(
+            int startLine,
+            int startChar,
+            int endLine,
+            int endCharPlusOne)
+        {
+            CheckSectionRange(startLine, startChar, endLine, endCharPlusOne);
 
             TextStorage copy = factory.NewStorage();
 
@@ -218,26 +295,8 @@ namespace TextEditor
             int endLine,
             int endCharPlusOne)
         {
-            if ((startLine < 0) || (startLine >= GetLineCount())
-                || (endLine < 0) || (endLine >= GetLineCount()))
-            {
-                // Line index out of range
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
-            if ((startLine > endLine) || ((startLine == endLine) && (startChar > endCharPlusOne)))
-            {
-                // Inconsistent range specified
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
-            if ((startChar < 0) || (startChar > GetLine(startLine).Length)
-                || (endCharPlusOne < 0) || (endCharPlusOne > GetLine(endLine).Length))
-            {
-                // Character ranges for lines exceeded
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
+            long perf = PerfCounters.Begin();
+            CheckSectionRange(startLine, startChar, endLine, endCharPlusOne);
 
             if (startLine == endLine)
             {
@@ -275,6 +334,7 @@ namespace TextEditor
             }
 
             modified = true;
+            PerfCounters.End(PerfCounter.DeleteSection, perf);
         }
 
         /* insert a storage block at the specified position into this storage block. */
@@ -284,18 +344,8 @@ namespace TextEditor
             int insertChar,
             ITextStorage insert)
         {
-            if ((insertLine < 0) || (insertLine >= GetLineCount()))
-            {
-                // Line position out of range
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
-            if ((insertChar < 0) || (insertChar > GetLine(insertLine).Length))
-            {
-                // Character position out of range
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
+            long perf = PerfCounters.Begin();
+            CheckPosition(insertLine, insertChar);
 
             /* check for special case where inertion only has 1 line */
             int insertLines = insert.Count;
@@ -389,6 +439,23 @@ namespace TextEditor
             }
 
             modified = true;
+            PerfCounters.End(PerfCounter.InsertSection, perf);
+        }
+
+        // general implementation: decode the data into a new storage and insert it at the end (the insertion is also
+        // counted as an InsertSection)
+        public virtual void AppendStream(Stream stream, Encoding encoding, ref LineEndingInfo lineEndingInfo)
+        {
+            long perf = PerfCounters.Begin();
+            LineEndingInfo appendedLineEndingInfo;
+            ITextStorage appended = factory.FromStream(stream, encoding, out appendedLineEndingInfo);
+            int lastLine = GetLineCount() - 1;
+            InsertSection(lastLine, GetLineLength(lastLine), appended);
+
+            lineEndingInfo.unixLFCount += appendedLineEndingInfo.unixLFCount;
+            lineEndingInfo.windowsLFCount += appendedLineEndingInfo.windowsLFCount;
+            lineEndingInfo.macintoshLFCount += appendedLineEndingInfo.macintoshLFCount;
+            PerfCounters.End(PerfCounter.Append, perf);
         }
 
         /* if the end of line sequence is of the specified length, then calculate how */
@@ -400,7 +467,7 @@ namespace TextEditor
             int count = GetLineCount();
             for (int i = 0; i < count; i++)
             {
-                total += GetLine(i).Length;
+                total += GetLineLength(i);
             }
 
             /* all but last line have an eoln marker, so add that in too */
@@ -416,18 +483,14 @@ namespace TextEditor
 
             StringBuilder text = new StringBuilder(totalNumChars);
 
-            int count = GetLineCount();
-            int i = 0;
-            while (true)
+            TextLineEnumerator lines = EnumerateLines(0, GetLineCount(), null);
+            while (lines.MoveNext())
             {
-                IDecodedTextLine decodedLine = GetLine(i).Decode_MustDispose();
-                text.Append(decodedLine.Value);
-                if (i == count - 1)
+                if (lines.Index != 0)
                 {
-                    break;
+                    text.Append(EOLN);
                 }
-                text.Append(EOLN);
-                i++;
+                text.Append(lines.Buffer, 0, lines.Length);
             }
 
             /* sanity check */
@@ -446,18 +509,14 @@ namespace TextEditor
         // use TextWriter.NewLine to configure which newline character sequence to write
         public virtual void ToTextWriter(TextWriter writer)
         {
-            int count = GetLineCount();
-            int i = 0;
-            while (true)
+            TextLineEnumerator lines = EnumerateLines(0, GetLineCount(), null);
+            while (lines.MoveNext())
             {
-                IDecodedTextLine decodedLine = GetLine(i).Decode_MustDispose();
-                writer.Write(decodedLine.Value);
-                if (i == count - 1)
+                if (lines.Index != 0)
                 {
-                    break;
+                    writer.WriteLine();
                 }
-                writer.WriteLine();
-                i++;
+                writer.Write(lines.Buffer, 0, lines.Length);
             }
         }
 
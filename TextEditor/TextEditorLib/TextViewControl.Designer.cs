@@ -30,12 +30,22 @@ namespace TextEditor
         {
             this.components = new System.ComponentModel.Container();
             this.timerCursorBlink = new System.Windows.Forms.Timer(this.components);
+            this.timerWrapRefine = new System.Windows.Forms.Timer(this.components);
+            this.timerRedraw = new System.Windows.Forms.Timer(this.components);
             this.SuspendLayout();
             // 
             // timerCursorBlink
             // 
             this.timerCursorBlink.Interval = 500;
             // 
+            // timerWrapRefine
+            // 
+            this.timerWrapRefine.Interval = 20;
+            // 
+            // timerRedraw
+            // 
+            this.timerRedraw.Interval = 15;
+            // 
             // TextViewControl
             // 
             this.AutoScroll = true;
@@ -47,5 +57,7 @@ namespace TextEditor
         #endregion
 
         private System.Windows.Forms.Timer timerCursorBlink;
+        private System.Windows.Forms.Timer timerWrapRefine;
+        private System.Windows.Forms.Timer timerRedraw;
     }
 }
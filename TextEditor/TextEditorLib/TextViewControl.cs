@@ -20,11 +20,15 @@
  * 
 */
 using System;
+using System.Collections.Generic;
 using System.ComponentModel;
 using System.Diagnostics;
 using System.Drawing;
 using System.Drawing.Drawing2D;
+using System.IO;
 using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading;
 using System.Windows.Forms;
 
 namespace TextEditor
@@ -62,6 +66,8 @@ namespace TextEditor
         private char? deferredHighSurrogate; // for handling non-zero plane unicode character entry
 
         private int spacesPerTab = 8;
+        private char[] lineBuffer; // scratch for allocation-free line access
+        private char[] spacedLineBuffer;
 
         private bool selectAllOnEnable;
         private bool hideSelectionOnFocusLost;
@@ -72,11 +78,26 @@ namespace TextEditor
 
         private int fontHeight;
 
+        private bool wordWrap;
+        private bool wrapping; // wordWrap in effect - see ResetWrap()
+        private VisualRowIndex rowIndex; // null unless wrapping
+        private int wrapWidth;
+        private int refineLine; // background measurement of rows proceeds from here
+        private readonly SparseLineCache<int[]> rowStartsCache = new SparseLineCache<int[]>(); // null means invalid
+        private const int WrapRefineSliceMilliseconds = 10;
+
+        private readonly DirtyLineRanges dirtyLines = new DirtyLineRanges(); // drawn at the next tick of timerRedraw
+
 #if WINDOWS
         private ITextService textService = new TextServiceUniscribe(); // if changing, update TextService default value attribute as well
 #else
         private ITextService textService = new TextServiceSimple(); // if changing, update TextService default value attribute as well
 #endif
+        private TextService? pendingTextService; // being prepared on a worker thread - see SetTextServiceDeferred()
+
+        private SyntaxHighlighter syntaxHighlighter; // null: highlighting off
+        private readonly Func<int, string> getStoredLine;
+        private static bool firstPaintMarked;
 
         private Brush normalForeBrush;
         private Brush normalBackBrush;
@@ -97,11 +118,16 @@ namespace TextEditor
             InitializeComponent();
 
             this.textStorage = textStorageFactory.New();
+            this.getStoredLine = delegate (int index) { return textStorage[index].Decode_MustDispose().Value; };
 
             timerCursorBlink.Interval = (int)GetCaretBlinkTime();
             timerCursorBlink.Tick += new EventHandler(timerCursorBlink_Tick);
             //timerCursorBlink.Start();
 
+            timerWrapRefine.Tick += new EventHandler(timerWrapRefine_Tick);
+
+            timerRedraw.Tick += new EventHandler(timerRedraw_Tick);
+
             this.Disposed += new EventHandler(TextViewControl_Disposed);
 
             OnFontChanged(EventArgs.Empty); // ensure recalculations
@@ -149,6 +175,16 @@ namespace TextEditor
             DisposeGraphicsObjects(); // force recreate offscreen strip
             textService.Reset(Font, ClientWidth);
 
+            if (wrapping && (WrapWidth != wrapWidth))
+            {
+                // rewrap, keeping the line at the top of the view in place
+                int rowInLine;
+                int topLine = GetLineOfRow(-AutoScrollPosition.Y / fontHeight, out rowInLine);
+                ResetWrap();
+                AutoScrollPosition = new Point(0, GetRowOfLine(topLine) * fontHeight);
+                Invalidate();
+            }
+
             RecomputeCanvasSizeIncremental();
 
             //Invalidate();
@@ -156,8 +192,18 @@ namespace TextEditor
 
         protected override void OnPaint(PaintEventArgs pe)
         {
+            if (wrapping)
+            {
+                RecomputeCanvasSizeIncremental(); // measure rows of lines scrolled into view
+            }
             Redraw();
             base.OnPaint(pe);
+
+            if (!firstPaintMarked)
+            {
+                firstPaintMarked = true;
+                StartupTiming.Mark("First paint");
+            }
         }
 
         protected override void OnPaintBackground(PaintEventArgs e)
@@ -194,6 +240,14 @@ namespace TextEditor
             RedrawSelection();
         }
 
+        protected override void OnRightToLeftChanged(EventArgs e)
+        {
+            base.OnRightToLeftChanged(e);
+
+            ResetCanvasSize(); // wrapping is left to right only
+            Invalidate();
+        }
+
         protected override void OnFontChanged(EventArgs e)
         {
             // clear cache because, during dpi-change, values will be incorrect and then base.OnFontChanged calls OnSizeChanged
@@ -205,6 +259,15 @@ namespace TextEditor
             DisposeGraphicsObjects(); // reset height of offscreen strip
             textService.Reset(Font, ClientWidth);
 
+            UpdateFontHeight();
+
+            ResetCanvasSize();
+            SetStickyX();
+            Invalidate();
+        }
+
+        private void UpdateFontHeight()
+        {
             fontHeight = FontHeight;
 
             if (textService.Service != TextService.DirectWrite)
@@ -213,9 +276,6 @@ namespace TextEditor
             }
 
             VerticalScroll.SmallChange = fontHeight;
-            ResetCanvasSize();
-            SetStickyX();
-            Invalidate();
         }
 
         private void timerCursorBlink_Tick(object sender, EventArgs e)
@@ -227,6 +287,46 @@ namespace TextEditor
             }
         }
 
+        // Measure rows of lines not yet seen, a slice at a time on the UI thread (analysis needs the control's graphics),
+        // so that the scroll range converges on the height of the wrapped text. The line at the top of the view is kept
+        // in place as lines above it are found to wrap.
+        private void timerWrapRefine_Tick(object sender, EventArgs e)
+        {
+            if (!wrapping)
+            {
+                timerWrapRefine.Stop();
+                return;
+            }
+
+            int rowInLine;
+            int topLine = GetLineOfRow(-AutoScrollPosition.Y / fontHeight, out rowInLine);
+            int oldTopRow = GetRowOfLine(topLine);
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            using (Graphics graphics = CreateGraphics())
+            {
+                while (stopwatch.ElapsedMilliseconds < WrapRefineSliceMilliseconds)
+                {
+                    refineLine = rowIndex.FindUnmeasured(refineLine);
+                    if (refineLine >= rowIndex.LineCount)
+                    {
+                        timerWrapRefine.Stop();
+                        break;
+                    }
+                    // row starts are not cached here so as not to evict those of the lines in view
+                    rowIndex.SetRows(refineLine, ComputeRowStarts(graphics, refineLine).Length);
+                }
+            }
+
+            int topRow = GetRowOfLine(topLine);
+            RecomputeCanvasSizeIncremental();
+            if (topRow != oldTopRow)
+            {
+                AutoScrollPosition = new Point(0, -AutoScrollPosition.Y + (topRow - oldTopRow) * fontHeight);
+                Invalidate();
+            }
+        }
+
         private void EnsureGraphicsObjects()
         {
             if (normalForeBrush == null)
@@ -321,6 +421,10 @@ namespace TextEditor
             set
             {
                 base.AutoSize = value;
+                if (wordWrap)
+                {
+                    ResetCanvasSize(); // wrapping does not apply to auto-sized control
+                }
             }
         }
 
@@ -350,9 +454,12 @@ namespace TextEditor
                 // Exact recalc is too slow for large files. Instead, only the lines near the viewport are used to compute
                 // canvas size. This means the horizontal scroll bar may indicate less than the longest line in the file. As
                 // the user scrolls longer lines into view the scroll bar will adjust to account for discovery of longer lines.
+                // When wrapping, the same goes for the vertical scroll bar and the rows of lines.
+                int startLine, endLine;
+                GetVisibleLines(out startLine, out endLine);
                 RecomputeCanvasSizePartial(
-                    -AutoScrollPosition.Y / fontHeight,
-                    (-AutoScrollPosition.Y + ClientHeight + (fontHeight - 1)) / fontHeight,
+                    startLine,
+                    endLine,
                     true/*includeClientWidthAndOverflow*/);
 
             }
@@ -375,15 +482,39 @@ namespace TextEditor
         }
 
         private readonly LineWidthCache lineWidthCache = new LineWidthCache();
+        private readonly TabStopCache tabStopCache = new TabStopCache();
+        private readonly LongLineLayoutCache longLineLayoutCache = new LongLineLayoutCache();
+        // measured along with the lines in view, so that the horizontal scroll range covers the longest line of a newly
+        // loaded document before it is scrolled to (-1 for none)
+        private int longestLineHint = -1;
         private void ResetCanvasSizeCaches()
         {
             currentWidth = 0;
             lineWidthCache.Clear();
+            tabStopCache.Clear(); // also covers tab size change
+            longLineLayoutCache.Clear(); // also covers font and text service change
+            ResetWrap();
         }
 
         // do not call this method directly, use RecomputeCanvasSizePartial() instead
         private void RecomputeCanvasSizePartial(int startLine, int endLine, bool includeClientWidthAndOverflow)
         {
+            if (wrapping)
+            {
+                // text is wrapped to the client width; rows of the lines in range were measured by GetVisibleLines()
+                currentWidth = ClientWidth;
+                Size wrappedSize = new Size(0, rowIndex.RowCount * fontHeight);
+                if (AutoScrollMinSize != wrappedSize)
+                {
+                    AutoScrollMinSize = wrappedSize;
+                }
+                if ((offscreenStrip != null) && (ClientWidth > offscreenStrip.Width))
+                {
+                    DisposeGraphicsObjects();
+                }
+                return;
+            }
+
             using (Graphics graphics = CreateGraphics())
             {
                 // add some margin for two reasons: First, Graphics.DrawString seems to omit the last character if the bounding
@@ -395,39 +526,21 @@ namespace TextEditor
                 int widestLine = -1;
                 for (int i = Math.Max(startLine, 0); i <= Math.Min(endLine, this.Count - 1); i++)
                 {
-                    int width;
-                    if (!lineWidthCache.TryGet(i, out width))
-                    {
-                        bool tabsFound;
-                        IDecodedTextLine decodedLine = GetSpaceFromTabLineMustDispose(i, out tabsFound);
-                        using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
-                        {
-                            width = info.GetExtent(graphics).Width;
-                        }
-                        lineWidthCache.Set(i, width);
-                    }
-                    else
+                    int width = MeasureLineWidth(graphics, i) + horizontalOverflow;
+                    if (currentWidth1 < width)
                     {
-#if DEBUG
-                        bool tabsFound;
-                        int debugWidth;
-                        IDecodedTextLine decodedLine = GetSpaceFromTabLineMustDispose(i, out tabsFound);
-                        using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
-                        {
-                            debugWidth = info.GetExtent(graphics).Width;
-                        }
-                        if (width != debugWidth)
-                        {
-                            Debugger.Log(0, "TextViewControl.LineWidthCache", String.Format("LineWidthCache bad value - actual: {0} cached: {1}" + Environment.NewLine, debugWidth, width));
-                            Debug.Assert(false);
-                        }
-#endif
+                        currentWidth1 = width;
+                        widestLine = i;
                     }
-                    width += horizontalOverflow;
+                }
+                if ((longestLineHint >= 0) && (longestLineHint < this.Count)
+                    && ((longestLineHint < startLine) || (longestLineHint > endLine)))
+                {
+                    int width = MeasureLineWidth(graphics, longestLineHint) + horizontalOverflow;
                     if (currentWidth1 < width)
                     {
                         currentWidth1 = width;
-                        widestLine = i;
+                        widestLine = longestLineHint;
                     }
                 }
                 int oldCurrentWidth = currentWidth;
@@ -462,11 +575,56 @@ namespace TextEditor
             }
         }
 
+        private int MeasureLineWidth(Graphics graphics, int i)
+        {
+            int width;
+            LongLineLayout layout;
+            if (!lineWidthCache.TryGet(i, out width))
+            {
+                if ((layout = GetLongLineLayout(i)) != null)
+                {
+                    // estimated until the whole line has been measured, so not cached
+                    width = layout.GetWidth(graphics);
+                }
+                else
+                {
+                    bool tabsFound;
+                    IDecodedTextLine decodedLine = GetSpaceFromTabLineMustDispose(i, out tabsFound);
+                    using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                    {
+                        width = info.GetExtent(graphics).Width;
+                    }
+                    lineWidthCache.Set(i, width);
+                }
+            }
+            else
+            {
+#if DEBUG
+                bool tabsFound;
+                int debugWidth;
+                IDecodedTextLine decodedLine = GetSpaceFromTabLineMustDispose(i, out tabsFound);
+                using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                {
+                    debugWidth = info.GetExtent(graphics).Width;
+                }
+                if (width != debugWidth)
+                {
+                    Debugger.Log(0, "TextViewControl.LineWidthCache", String.Format("LineWidthCache bad value - actual: {0} cached: {1}" + Environment.NewLine, debugWidth, width));
+                    Debug.Assert(false);
+                }
+#endif
+            }
+            return width;
+        }
+
+        // draw all visible lines now, which satisfies any pending redraw
         private void Redraw()
         {
-            int startLine = -AutoScrollPosition.Y / fontHeight;
-            int endLine = (-AutoScrollPosition.Y + ClientHeight + (fontHeight - 1)) / fontHeight;
-            RedrawRange(startLine, endLine);
+            int startLine, endLine;
+            GetVisibleLines(out startLine, out endLine);
+            dirtyLines.Clear();
+            dirtyLines.Add(startLine, endLine);
+            FlushRedraw();
         }
 
         private void RedrawSelection()
@@ -474,29 +632,75 @@ namespace TextEditor
             RedrawRange(selectStartLine, selectEndLine);
         }
 
+        // Lines are not drawn immediately but collected and drawn together at the next tick of timerRedraw (about one
+        // frame), so that the same lines invalidated many times in between - by typing, scripted edits, caret blink or
+        // selection changes - are drawn only once.
         private void RedrawRange(int startLine, int endLine)
         {
+            dirtyLines.Add(startLine, endLine);
+            if (!timerRedraw.Enabled)
+            {
+                timerRedraw.Start();
+            }
+        }
+
+        private void RedrawLine(int line)
+        {
+            RedrawRange(line, line);
+        }
+
+        private void timerRedraw_Tick(object sender, EventArgs e)
+        {
+            FlushRedraw();
+        }
+
+        // draw the pending lines that are in view (each is drawn at its position at this time, so lines moved by
+        // scrolling since they were invalidated come out right)
+        private void FlushRedraw()
+        {
+            timerRedraw.Stop();
+            if (dirtyLines.Count == 0)
+            {
+                return;
+            }
+
+            long perf = PerfCounters.Begin();
+            int visibleStartLine, visibleEndLine;
+            GetVisibleLines(out visibleStartLine, out visibleEndLine);
             EnsureGraphicsObjects();
             using (Graphics graphics = CreateGraphics())
             {
-                for (int i = startLine; i <= endLine; i++)
+                for (int r = 0; r < dirtyLines.Count; r++)
                 {
-                    RedrawLinePrimitive(graphics, i);
+                    int startLine, endLine;
+                    dirtyLines.Get(r, out startLine, out endLine);
+                    for (int i = Math.Max(startLine, visibleStartLine); i <= Math.Min(endLine, visibleEndLine); i++)
+                    {
+                        RedrawLinePrimitive(graphics, i);
+                    }
                 }
             }
+            dirtyLines.Clear();
+            PerfCounters.End(PerfCounter.RedrawRange, perf);
         }
 
-        private void RedrawLine(int line)
+        private void ApplySyntaxColors(ITextInfo info, int index, string text)
         {
-            EnsureGraphicsObjects();
-            using (Graphics graphics = CreateGraphics())
+            ITextInfoColorRuns colorRuns;
+            if ((syntaxHighlighter != null) && ((colorRuns = info as ITextInfoColorRuns) != null))
             {
-                RedrawLinePrimitive(graphics, line);
+                colorRuns.SetColorRuns(syntaxHighlighter.GetColorRuns(index, text, getStoredLine));
             }
         }
 
         private void RedrawLinePrimitive(Graphics graphics, int index)
         {
+            if (wrapping)
+            {
+                RedrawWrappedLinePrimitive(graphics, index);
+                return;
+            }
+
             Rectangle rect = new Rectangle(
                 AutoScrollPosition.X,
                 index * fontHeight + AutoScrollPosition.Y,
@@ -520,6 +724,13 @@ namespace TextEditor
                     goto PutOnscreen;
                 }
 
+                LongLineLayout layout = GetLongLineLayout(index);
+                if (layout != null)
+                {
+                    RedrawLongLinePrimitive(graphics2, index, layout, rect2);
+                    goto PutOnscreen;
+                }
+
                 bool tabsFound;
                 IDecodedTextLine line = GetSpaceFromTabLineMustDispose(index, out tabsFound);
                 int rtlXAdjust = 0;
@@ -545,6 +756,7 @@ namespace TextEditor
                         fontHeight,
                         line.Value))
                     {
+                        ApplySyntaxColors(info, index, line.Value);
                         info.DrawText(
                             graphics2,
                             offscreenStrip,
@@ -564,6 +776,7 @@ namespace TextEditor
                             fontHeight,
                             line.Value))
                         {
+                            ApplySyntaxColors(info, index, line.Value);
                             info.DrawText(
                                 graphics2,
                                 offscreenStrip,
@@ -689,6 +902,242 @@ namespace TextEditor
             graphics.DrawImage(offscreenStrip, new Rectangle(0, rect.Y, ClientWidth, fontHeight));
         }
 
+        // counterpart of RedrawLinePrimitive when wrapping - each visible row of the line goes through the strip in turn
+        private void RedrawWrappedLinePrimitive(Graphics graphics, int index)
+        {
+            bool exists = (index >= 0) && (index < textStorage.Count);
+            int firstRow = GetRowOfLine(index);
+            Rectangle rect = new Rectangle(
+                0,
+                firstRow * fontHeight + AutoScrollPosition.Y,
+                ClientWidth,
+                (exists ? rowIndex.GetRows(index) : 1) * fontHeight);
+
+            if (!graphics.IsVisible(rect))
+            {
+                return;
+            }
+
+            int[] rowStarts = exists ? GetRowStarts(graphics, index) : new int[] { 0 };
+            string text = exists ? GetExpandedLine(index) : String.Empty;
+            List<ColorRun> colorRuns = exists && (syntaxHighlighter != null)
+                ? syntaxHighlighter.GetColorRuns(index, text, getStoredLine)
+                : null;
+            for (int row = 0; row < rowStarts.Length; row++)
+            {
+                rect = new Rectangle(0, (firstRow + row) * fontHeight + AutoScrollPosition.Y, ClientWidth, fontHeight);
+                if (!graphics.IsVisible(rect))
+                {
+                    continue;
+                }
+
+                using (Graphics graphics2 = Graphics.FromImage(offscreenStrip))
+                {
+                    Rectangle rect2 = new Rectangle(0, 0, rect.Width, rect.Height);
+                    graphics2.FillRectangle(normalBackBrush, rect2);
+                    if (exists)
+                    {
+                        RedrawWrappedRowPrimitive(graphics2, index, text, rowStarts, row, colorRuns, rect2);
+                    }
+                }
+
+                graphics.DrawImage(offscreenStrip, new Rectangle(0, rect.Y, ClientWidth, fontHeight));
+            }
+        }
+
+        private void RedrawWrappedRowPrimitive(
+            Graphics graphics2,
+            int index,
+            string text,
+            int[] rowStarts,
+            int row,
+            List<ColorRun> colorRuns,
+            Rectangle rect2)
+        {
+            Point anchor = rect2.Location;
+            int rowStart = rowStarts[row];
+            int rowEnd = row + 1 < rowStarts.Length ? rowStarts[row + 1] : text.Length;
+
+            bool selected = !((index < selectStartLine) || (index > selectEndLine) || !cursorEnabledFlag
+                || (hideSelectionOnFocusLost && !Focused));
+            bool insertionPoint = (selectStartLine == selectEndLine) && (selectStartChar == selectEndCharPlusOne);
+
+            using (ITextInfo info = textService.AnalyzeText(
+                graphics2,
+                Font,
+                fontHeight,
+                text.Substring(rowStart, rowEnd - rowStart)))
+            {
+                ITextInfoColorRuns infoColorRuns;
+                if ((colorRuns != null) && (!selected || insertionPoint)
+                    && ((infoColorRuns = info as ITextInfoColorRuns) != null))
+                {
+                    infoColorRuns.SetColorRuns(LongLineLayout.ClipColorRuns(colorRuns, rowStart, rowEnd));
+                }
+                info.DrawText(
+                    graphics2,
+                    offscreenStrip,
+                    anchor,
+                    ForeColor,
+                    BackColor);
+
+                if (!selected)
+                {
+                    return;
+                }
+
+                if (!insertionPoint)
+                {
+                    /* real live selection, in columns clipped to the row */
+                    int selectStartColumn = selectStartLine == index ? GetColumnFromCharIndex(index, selectStartChar) : 0;
+                    int selectEndColumnPlusOne = selectEndLine == index
+                        ? GetColumnFromCharIndex(index, selectEndCharPlusOne)
+                        : text.Length;
+                    int start = Math.Max(selectStartColumn, rowStart) - rowStart;
+                    int end = Math.Min(selectEndColumnPlusOne, rowEnd) - rowStart;
+
+                    using (Region highlight = start < end
+                        ? info.BuildRegion(graphics2, anchor, start, end)
+                        : new Region(Rectangle.Empty))
+                    {
+                        if ((selectEndLine != index) && (row == rowStarts.Length - 1))
+                        {
+                            Size extent = info.GetExtent(graphics2);
+                            highlight.Union(new Rectangle(extent.Width + anchor.X, 0, ClientWidth, fontHeight));
+                        }
+                        graphics2.SetClip(
+                            highlight,
+                            CombineMode.Replace);
+                        graphics2.FillRectangle(
+                            Focused ? selectedBackBrush : selectedBackBrushInactive,
+                            rect2);
+                        info.DrawText(
+                            graphics2,
+                            offscreenStrip,
+                            anchor,
+                            Focused ? selectedForeColor : selectedForeColorInactive,
+                            Focused ? selectedBackColor : selectedBackColorInactive);
+                    }
+                    graphics2.SetClip(rect2);
+                }
+            }
+
+            // show active end, if on this row
+            if (cursorDrawnFlag && Focused)
+            {
+                int activeLine = selectStartIsActive ? selectStartLine : selectEndLine;
+                int activeChar = selectStartIsActive ? selectStartChar : selectEndCharPlusOne;
+                if ((activeLine == index)
+                    && (GetRowOfColumn(rowStarts, GetColumnFromCharIndex(index, activeChar)) == row))
+                {
+                    int screenX = ScreenXFromCharIndex(graphics2, activeLine, activeChar, true/*forInsertionPoint*/);
+                    graphics2.DrawLine(
+                        normalForePen,
+                        new Point(screenX + anchor.X, 0),
+                        new Point(screenX + anchor.X, fontHeight - 1));
+                }
+            }
+        }
+
+        // counterpart of RedrawLinePrimitive for a long line - only the segments intersecting the strip are analyzed
+        private void RedrawLongLinePrimitive(Graphics graphics2, int index, LongLineLayout layout, Rectangle rect2)
+        {
+            Point anchor = rect2.Location;
+
+            if ((syntaxHighlighter != null) && !layout.HasColorRuns)
+            {
+                layout.SetColorRuns(syntaxHighlighter.GetColorRuns(index, layout.Text, getStoredLine));
+            }
+
+            if ((index < selectStartLine) || (index > selectEndLine) || !cursorEnabledFlag
+                || (hideSelectionOnFocusLost && !Focused))
+            {
+                /* normal draw -- no part of the line is selected */
+                layout.DrawText(graphics2, offscreenStrip, anchor, ClientWidth, ForeColor, BackColor, true/*applyColorRuns*/);
+            }
+            else if ((selectStartLine == selectEndLine) && (selectStartChar == selectEndCharPlusOne))
+            {
+                /* it's just an insertion point */
+                layout.DrawText(graphics2, offscreenStrip, anchor, ClientWidth, ForeColor, BackColor, true/*applyColorRuns*/);
+
+                if (cursorDrawnFlag && Focused)
+                {
+                    int screenX = ScreenXFromCharIndex(graphics2, index, selectStartChar, true/*forInsertionPoint*/);
+                    graphics2.DrawLine(
+                        normalForePen,
+                        new Point(screenX + anchor.X, 0),
+                        new Point(screenX + anchor.X, fontHeight - 1));
+                }
+            }
+            else
+            {
+                /* real live selection */
+
+                int selectStartColumn = 0;
+                if (selectStartLine == index)
+                {
+                    selectStartColumn = GetColumnFromCharIndex(selectStartLine, selectStartChar);
+                }
+                int selectEndColumnPlusOne = layout.Length;
+                if (selectEndLine == index)
+                {
+                    selectEndColumnPlusOne = GetColumnFromCharIndex(selectEndLine, selectEndCharPlusOne);
+                }
+
+                layout.DrawText(graphics2, offscreenStrip, anchor, ClientWidth, ForeColor, BackColor, false/*applyColorRuns*/);
+
+                // draw highlighted region
+                using (Region highlight = layout.BuildRegion(
+                    graphics2,
+                    anchor,
+                    ClientWidth,
+                    selectStartColumn,
+                    selectEndColumnPlusOne))
+                {
+                    if (selectEndLine != index)
+                    {
+                        // estimated width always lies beyond the strip unless the end of the line is in view
+                        Rectangle rect3 = new Rectangle(
+                            layout.GetWidth(graphics2) + anchor.X,
+                            0,
+                            Math.Max(AutoScrollMinSize.Width, ClientWidth),
+                            fontHeight);
+                        highlight.Union(rect3);
+                    }
+                    graphics2.SetClip(
+                        highlight,
+                        CombineMode.Replace);
+                    graphics2.FillRectangle(
+                        Focused ? selectedBackBrush : selectedBackBrushInactive,
+                        rect2);
+                    layout.DrawText(
+                        graphics2,
+                        offscreenStrip,
+                        anchor,
+                        ClientWidth,
+                        Focused ? selectedForeColor : selectedForeColorInactive,
+                        Focused ? selectedBackColor : selectedBackColorInactive,
+                        false/*applyColorRuns*/);
+                }
+
+                // show active end
+                graphics2.SetClip(rect2);
+                if (cursorDrawnFlag && Focused)
+                {
+                    int activeLine = selectStartIsActive ? selectStartLine : selectEndLine;
+                    int activeChar = selectStartIsActive ? selectStartChar : selectEndCharPlusOne;
+                    if (activeLine == index)
+                    {
+                        int screenX = ScreenXFromCharIndex(graphics2, activeLine, activeChar, true/*forInsertionPoint*/);
+                        graphics2.DrawLine(
+                            normalForePen,
+                            new Point(screenX + anchor.X, 0),
+                            new Point(screenX + anchor.X, fontHeight - 1));
+                    }
+                }
+            }
+        }
+
         public static void GetSpaceFromTabLineLength(string line, int spacesPerTab, out int length, out bool tabsFound)
         {
             if (spacesPerTab < 0)
@@ -737,59 +1186,391 @@ namespace TextEditor
             Debug.Assert(length == targetIndex);
         }
 
-        public static string GetSpaceFromTabLine(string line, int spacesPerTab)
+        public static void GetSpaceFromTabLine(char[] line, int lineLength, int spacesPerTab, char[] chars, int length)
+        {
+            int targetIndex = 0;
+            for (int i = 0; i < lineLength; i++)
+            {
+                if (line[i] == '\t')
+                {
+                    int index = spacesPerTab - (targetIndex % spacesPerTab);
+                    while (index > 0)
+                    {
+                        chars[targetIndex] = ' ';
+                        targetIndex++;
+                        index--;
+                    }
+                }
+                else
+                {
+                    chars[targetIndex] = line[i];
+                    targetIndex++;
+                }
+            }
+            Debug.Assert(length == targetIndex);
+        }
+
+        public static string GetSpaceFromTabLine(string line, int spacesPerTab)
+        {
+            if (spacesPerTab < 0)
+            {
+                throw new ArgumentException();
+            }
+
+            int length;
+            bool tabsFound;
+            GetSpaceFromTabLineLength(line, spacesPerTab, out length, out tabsFound);
+
+            if ((line.Length != length) || tabsFound)
+            {
+                char[] chars = new char[length];
+                GetSpaceFromTabLine(line, spacesPerTab, chars, length);
+                return new String(chars);
+            }
+            else
+            {
+                return line;
+            }
+        }
+
+        private TabStops GetTabStops(int index, char[] line, int lineLength)
+        {
+            TabStops tabStops;
+            if (!tabStopCache.TryGet(index, out tabStops))
+            {
+                tabStops = TabStops.Build(line, lineLength, spacesPerTab);
+                tabStopCache.Set(index, tabStops);
+            }
+            Debug.Assert(tabStops.Length == lineLength);
+            return tabStops;
+        }
+
+        private TabStops GetTabStops(int index)
+        {
+            TabStops tabStops;
+            if (!tabStopCache.TryGet(index, out tabStops))
+            {
+                int lineLength = textStorage.CopyLine(index, ref lineBuffer);
+                tabStops = TabStops.Build(lineBuffer, lineLength, spacesPerTab);
+                tabStopCache.Set(index, tabStops);
+            }
+            return tabStops;
+        }
+
+        protected IDecodedTextLine GetSpaceFromTabLineMustDispose(int index, out bool tabsFound)
+        {
+            int lineLength = textStorage.CopyLine(index, ref lineBuffer);
+            TabStops tabStops = GetTabStops(index, lineBuffer, lineLength);
+            tabsFound = tabStops.TabsFound;
+            if (!tabsFound)
+            {
+                return textStorageFactory.NewDecoded_MustDispose(lineBuffer, 0, lineLength);
+            }
+
+            int length = tabStops.ExpandedLength;
+            TextStorage.EnsureCapacity(ref spacedLineBuffer, length);
+            GetSpaceFromTabLine(lineBuffer, lineLength, spacesPerTab, spacedLineBuffer, length);
+            return textStorageFactory.NewDecoded_MustDispose(spacedLineBuffer, 0, length);
+        }
+
+        // Layout for a line too long to analyze as a whole, or null for an ordinary line (or any line when laid out
+        // right to left, since segments are placed left to right).
+        private LongLineLayout GetLongLineLayout(int index)
+        {
+            if (RightToLeft == RightToLeft.Yes)
+            {
+                return null;
+            }
+            LongLineLayout layout;
+            if (longLineLayoutCache.TryGet(index, out layout))
+            {
+                return layout;
+            }
+            if (GetTabStops(index).ExpandedLength < LongLineLayout.Threshold)
+            {
+                return null;
+            }
+            bool tabsFound;
+            IDecodedTextLine decodedLine = GetSpaceFromTabLineMustDispose(index, out tabsFound);
+            layout = new LongLineLayout(textService, Font, fontHeight, decodedLine.Value);
+            longLineLayoutCache.Set(index, layout);
+            return layout;
+        }
+
+        // analyze line for caret and word navigation from index - long lines only in the vicinity of index
+        private ITextInfo AnalyzeForNavigation(Graphics graphics, string line, int index, out int offset)
+        {
+            string text = LongLineLayout.GetNavigationText(line, index, out offset);
+            return !simpleNavigation
+                ? textService.AnalyzeText(graphics, Font, fontHeight, text)
+                : new TextServiceSimple().AnalyzeText(graphics, Font, fontHeight, text);
+        }
+
+        // Soft wrap geometry. When not wrapping, rows are lines and these reduce to the unwrapped computations. When
+        // wrapping, lines beyond the end of the text are taken to be one row each, as are lines not yet measured.
+
+        private void ResetWrap()
+        {
+            wrapping = wordWrap && !AutoSize && (RightToLeft != RightToLeft.Yes);
+            rowStartsCache.Clear();
+            if (wrapping)
+            {
+                wrapWidth = WrapWidth;
+                rowIndex = new VisualRowIndex();
+                rowIndex.Reset(textStorage.Count);
+                refineLine = 0;
+                timerWrapRefine.Start();
+            }
+            else
+            {
+                rowIndex = null;
+                timerWrapRefine.Stop();
+            }
+        }
+
+        // Width rows are wrapped to - the same whether or not the vertical scroll bar is showing, so that the bar
+        // appearing or disappearing does not rewrap the text. Some margin is left for the insertion point.
+        private int WrapWidth
+        {
+            get
+            {
+                int width = VerticalScroll.Visible ? ClientWidth : ClientWidth - SystemInformation.VerticalScrollBarWidth;
+                return Math.Max(width - fontHeight / 2, fontHeight);
+            }
+        }
+
+        private int RowCount { get { return wrapping ? rowIndex.RowCount : textStorage.Count; } }
+
+        private int GetRowOfLine(int line)
+        {
+            if (!wrapping || (line <= 0))
+            {
+                return line;
+            }
+            int count = rowIndex.LineCount;
+            return line < count ? rowIndex.GetRowOfLine(line) : rowIndex.RowCount + (line - count);
+        }
+
+        private int GetLineOfRow(int row, out int rowInLine)
+        {
+            rowInLine = 0;
+            if (!wrapping || (row < 0))
+            {
+                return row;
+            }
+            int rows = rowIndex.RowCount;
+            return row < rows ? rowIndex.GetLineOfRow(row, out rowInLine) : rowIndex.LineCount + (row - rows);
+        }
+
+        // lines intersecting the viewport - when wrapping, the rows of lines come into view are measured on the way
+        private void GetVisibleLines(out int startLine, out int endLine)
+        {
+            int startRow = -AutoScrollPosition.Y / fontHeight;
+            int endRow = (-AutoScrollPosition.Y + ClientHeight + (fontHeight - 1)) / fontHeight;
+            if (!wrapping)
+            {
+                startLine = startRow;
+                endLine = endRow;
+                return;
+            }
+
+            int rowInLine;
+            startLine = GetLineOfRow(startRow, out rowInLine);
+            using (Graphics graphics = CreateGraphics())
+            {
+                for (int i = startLine; (i < textStorage.Count) && (GetRowOfLine(i) <= endRow); i++)
+                {
+                    GetRowStarts(graphics, i);
+                }
+            }
+            endLine = GetLineOfRow(endRow, out rowInLine);
+        }
+
+        // measure the rows of lines within a screen of the range, so that positioning the view around it is exact
+        private void MeasureRowsAround(Graphics graphics, int startLine, int endLine)
+        {
+            int margin = ClientHeight / Math.Max(fontHeight, 1) + 1;
+            for (int i = Math.Max(startLine - margin, 0); i <= Math.Min(endLine + margin, textStorage.Count - 1); i++)
+            {
+                GetRowStarts(graphics, i);
+            }
+        }
+
+        private int[] GetRowStarts(Graphics graphics, int index)
+        {
+            int[] rowStarts;
+            if (!rowStartsCache.TryGet(index, out rowStarts))
+            {
+                rowStarts = ComputeRowStarts(graphics, index);
+                rowStartsCache.Set(index, rowStarts);
+                rowIndex.SetRows(index, rowStarts.Length);
+            }
+            return rowStarts;
+        }
+
+        // start column (tabs expanded) of each row of line when wrapped to wrapWidth
+        private int[] ComputeRowStarts(Graphics graphics, int index)
+        {
+            LongLineLayout layout = GetLongLineLayout(index);
+            if (layout != null)
+            {
+                return VisualRowIndex.GetRowStarts(
+                    layout.Text,
+                    wrapWidth,
+                    delegate (int column) { return column > 0 ? layout.ColumnToX(graphics, column - 1, true/*trailing*/) : 0; },
+                    delegate (int x) { return layout.XToColumn(graphics, x); });
+            }
+
+            bool tabsFound;
+            IDecodedTextLine decodedLine = GetSpaceFromTabLineMustDispose(index, out tabsFound);
+            string text = decodedLine.Value;
+            using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, text))
+            {
+                return VisualRowIndex.GetRowStarts(
+                    text,
+                    wrapWidth,
+                    delegate (int column)
+                    {
+                        int x = 0;
+                        if (column > 0)
+                        {
+                            info.CharPosToX(graphics, column - 1, true/*trailing*/, out x);
+                        }
+                        return x;
+                    },
+                    delegate (int x)
+                    {
+                        int column;
+                        bool trailing;
+                        info.XToCharPos(graphics, x, out column, out trailing);
+                        return column;
+                    });
+            }
+        }
+
+        // a column at the boundary of two rows belongs to the latter
+        private static int GetRowOfColumn(int[] rowStarts, int column)
+        {
+            int row = Array.BinarySearch(rowStarts, column);
+            return row >= 0 ? row : ~row - 1;
+        }
+
+        private string GetExpandedLine(int index)
         {
-            if (spacesPerTab < 0)
+            LongLineLayout layout = GetLongLineLayout(index);
+            if (layout != null)
             {
-                throw new ArgumentException();
+                return layout.Text;
             }
-
-            int length;
             bool tabsFound;
-            GetSpaceFromTabLineLength(line, spacesPerTab, out length, out tabsFound);
+            return GetSpaceFromTabLineMustDispose(index, out tabsFound).Value;
+        }
 
-            if ((line.Length != length) || tabsFound)
+        private int GetRowOfChar(Graphics graphics, int line, int charIndex)
+        {
+            if (!wrapping || (line < 0) || (line >= textStorage.Count))
             {
-                char[] chars = new char[length];
-                GetSpaceFromTabLine(line, spacesPerTab, chars, length);
-                return new String(chars);
+                return GetRowOfLine(line);
             }
-            else
+            int[] rowStarts = GetRowStarts(graphics, line);
+            return GetRowOfLine(line) + GetRowOfColumn(rowStarts, GetColumnFromCharIndex(line, charIndex));
+        }
+
+        private void GetPointFromRow(Graphics graphics, int row, int screenX, out int line, out int charIndex)
+        {
+            int rowInLine;
+            line = GetLineOfRow(row, out rowInLine);
+            charIndex = wrapping
+                ? CharIndexFromRowX(graphics, line, rowInLine, screenX)
+                : CharIndexFromScreenX(graphics, line, screenX);
+        }
+
+        // point delta rows from the active end of the selection, at stickyX
+        private void GetPointFromActiveEndRows(Graphics graphics, int delta, out int line, out int charIndex)
+        {
+            int row = GetRowOfChar(
+                graphics,
+                selectStartIsActive ? selectStartLine : selectEndLine,
+                selectStartIsActive ? selectStartChar : selectEndCharPlusOne) + delta;
+            row = Math.Min(Math.Max(row, 0), RowCount - 1);
+            GetPointFromRow(graphics, row, stickyX, out line, out charIndex);
+        }
+
+        // x of the column within its row
+        private int WrappedXFromColumn(Graphics graphics, int lineIndex, int columnIndex, bool forInsertionPoint)
+        {
+            int[] rowStarts = GetRowStarts(graphics, lineIndex);
+            int row = GetRowOfColumn(rowStarts, columnIndex);
+            string text = GetExpandedLine(lineIndex);
+            int rowStart = rowStarts[row];
+            int rowEnd = row + 1 < rowStarts.Length ? rowStarts[row + 1] : text.Length;
+            bool cursorAdvancing = forInsertionPoint && (columnIndex > rowStart) && this.cursorAdvancing;
+            using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, text.Substring(rowStart, rowEnd - rowStart)))
             {
-                return line;
+                int x;
+                info.CharPosToX(graphics, columnIndex - rowStart + (cursorAdvancing ? -1 : 0), cursorAdvancing/*trailing*/, out x);
+                return x;
             }
         }
 
-        protected IDecodedTextLine GetSpaceFromTabLineMustDispose(int index, out bool tabsFound)
+        // nearest character to x on a row of a wrapped line
+        private int CharIndexFromRowX(Graphics graphics, int lineIndex, int rowInLine, int screenX)
         {
-            IDecodedTextLine decodedLine = textStorage[index].Decode_MustDispose();
-            int length;
-            GetSpaceFromTabLineLength(decodedLine.Value, spacesPerTab, out length, out tabsFound);
-
-            using (Pin<char[]> pinChars = new Pin<char[]>(new char[length]))
+            if ((lineIndex < 0) || (lineIndex >= textStorage.Count))
+            {
+                return 0;
+            }
+            int[] rowStarts = GetRowStarts(graphics, lineIndex);
+            int row = Math.Min(rowInLine, rowStarts.Length - 1);
+            string text = GetExpandedLine(lineIndex);
+            int rowStart = rowStarts[row];
+            int rowEnd = row + 1 < rowStarts.Length ? rowStarts[row + 1] : text.Length;
+            int columnIndex;
+            using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, text.Substring(rowStart, rowEnd - rowStart)))
+            {
+                bool trailing;
+                info.XToCharPos(graphics, screenX, out columnIndex, out trailing);
+            }
+            columnIndex += rowStart;
+            if ((columnIndex == rowEnd) && (row < rowStarts.Length - 1))
             {
-                GetSpaceFromTabLine(decodedLine.Value, spacesPerTab, pinChars.Ref, length);
-                return textStorageFactory.NewDecoded_MustDispose(pinChars.Ref, 0, length);
+                // the end of an inner row is the start of the next - stay on this row, before the break
+                do
+                {
+                    columnIndex--;
+                } while ((columnIndex > rowStart) && !LongLineLayout.IsSafeBreak(text, columnIndex));
             }
+            return GetTabStops(lineIndex).CharIndexFromCaretColumn(columnIndex);
         }
 
         /* find out the pixel index of the left edge of the specified character */
         public int ScreenXFromCharIndex(Graphics graphics, int lineIndex, int charIndex, bool forInsertionPoint)
         {
+            int columnIndex = GetColumnFromCharIndex(lineIndex, charIndex);
+            if (wrapping)
+            {
+                return WrappedXFromColumn(graphics, lineIndex, columnIndex, forInsertionPoint);
+            }
+            // for cursorAdvancing, see https://msdn.microsoft.com/en-us/library/windows/desktop/dd317793%28v=vs.85%29.aspx
+            bool cursorAdvancing = false;
+            int adjust = 0;
+            if (forInsertionPoint && (columnIndex > 0))
+            {
+                cursorAdvancing = this.cursorAdvancing;
+                adjust = cursorAdvancing ? -1 : 0;
+            }
+
+            LongLineLayout layout = GetLongLineLayout(lineIndex);
+            if (layout != null)
+            {
+                return layout.ColumnToX(graphics, columnIndex + adjust, cursorAdvancing/*trailing*/);
+            }
+
             bool tabsFound;
             IDecodedTextLine decodedSpacedLine = GetSpaceFromTabLineMustDispose(lineIndex, out tabsFound);
             using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, decodedSpacedLine.Value))
             {
-                int columnIndex = GetColumnFromCharIndex(lineIndex, charIndex);
                 int indent;
-                // for cursorAdvancing, see https://msdn.microsoft.com/en-us/library/windows/desktop/dd317793%28v=vs.85%29.aspx
-                bool cursorAdvancing = false;
-                int adjust = 0;
-                if (forInsertionPoint && (columnIndex > 0))
-                {
-                    cursorAdvancing = this.cursorAdvancing;
-                    adjust = cursorAdvancing ? -1 : 0;
-                }
                 info.CharPosToX(graphics, columnIndex + adjust, cursorAdvancing/*trailing*/, out indent);
                 if (RightToLeft == RightToLeft.Yes)
                 {
@@ -813,95 +1594,40 @@ namespace TextEditor
             {
                 return 0;
             }
-            bool tabsFound;
-            IDecodedTextLine decodedSpacedLine = GetSpaceFromTabLineMustDispose(lineIndex, out tabsFound);
-            using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, decodedSpacedLine.Value))
+            LongLineLayout layout = GetLongLineLayout(lineIndex);
+            if (layout != null)
             {
-                if (RightToLeft == RightToLeft.Yes)
-                {
-                    screenX -= currentWidth - info.GetExtent(graphics).Width;
-                }
-                bool trailing;
-                info.XToCharPos(graphics, screenX, out columnIndex, out trailing);
+                columnIndex = layout.XToColumn(graphics, screenX);
             }
-            /* now we have the column index, with tabs expanded; we have to figure */
-            /* out what the character index is, with tabs left intact */
-            IDecodedTextLine decodedLine = textStorage[lineIndex].Decode_MustDispose();
-            int index = 0;
-            int column = 0;
-            while (column < columnIndex)
+            else
             {
-                Debug.Assert(index < decodedLine.Length);
-                int width = 1;
-                if (decodedLine.Value[index] == '\t')
+                bool tabsFound;
+                IDecodedTextLine decodedSpacedLine = GetSpaceFromTabLineMustDispose(lineIndex, out tabsFound);
+                using (ITextInfo info = textService.AnalyzeText(graphics, Font, fontHeight, decodedSpacedLine.Value))
                 {
-                    width = spacesPerTab - (column % spacesPerTab);
-                    if (!(column + width / 2 < columnIndex))
+                    if (RightToLeft == RightToLeft.Yes)
                     {
-                        break;
+                        screenX -= currentWidth - info.GetExtent(graphics).Width;
                     }
+                    bool trailing;
+                    info.XToCharPos(graphics, screenX, out columnIndex, out trailing);
                 }
-                index++;
-                column += width;
             }
-            return index;
+            /* now we have the column index, with tabs expanded; we have to figure */
+            /* out what the character index is, with tabs left intact */
+            return GetTabStops(lineIndex).CharIndexFromCaretColumn(columnIndex);
         }
 
         /* given a character index, calculate where the corresponding position is */
         /* when tabs have been converted into spaces */
-        private int GetColumnFromCharIndex(IDecodedTextLine decodedLine, int charIndex)
-        {
-            if (charIndex > decodedLine.Length)
-            {
-                charIndex = decodedLine.Length;
-            }
-            Debug.Assert((charIndex >= 0) || (charIndex < decodedLine.Length));
-            int column = 0;
-            for (int i = 0; i < charIndex; i++)
-            {
-                if (decodedLine[i] == '\t')
-                {
-                    column += spacesPerTab - (column % spacesPerTab);
-                }
-                else
-                {
-                    column += 1;
-                }
-            }
-            return column;
-        }
-
         public int GetColumnFromCharIndex(int lineIndex, int charIndex)
         {
-            IDecodedTextLine decodedLine = textStorage[lineIndex].Decode_MustDispose();
-            return GetColumnFromCharIndex(decodedLine, charIndex);
-        }
-
-        private int GetCharIndexFromColumn(IDecodedTextLine decodedLine, int column)
-        {
-            int columnIndex = 0;
-            for (int i = 0; i < decodedLine.Length; i++)
-            {
-                if (decodedLine[i] == '\t')
-                {
-                    columnIndex += spacesPerTab - (columnIndex % spacesPerTab);
-                }
-                else
-                {
-                    columnIndex += 1;
-                }
-                if (columnIndex >= column)
-                {
-                    return i;
-                }
-            }
-            return decodedLine.Length;
+            return GetTabStops(lineIndex).ColumnFromCharIndex(charIndex);
         }
 
         public int GetCharIndexFromColumn(int lineIndex, int column)
         {
-            IDecodedTextLine decodedLine = textStorage[lineIndex].Decode_MustDispose();
-            return GetCharIndexFromColumn(decodedLine, column);
+            return GetTabStops(lineIndex).CharIndexFromColumn(column);
         }
 
         public void SetStickyX()
@@ -919,6 +1645,46 @@ namespace TextEditor
 
         // misc
 
+        // line measured along with those in view when sizing the canvas (see longestLineHint)
+        [Browsable(false)]
+        public int LongestLineHint
+        {
+            get
+            {
+                return longestLineHint;
+            }
+            set
+            {
+                longestLineHint = value;
+                RecomputeCanvasSizeIncremental();
+            }
+        }
+
+        // Approximate memory held by the text and by the per-line layout caches, for session memory accounting.
+        // Long line layouts each hold a copy of their line.
+        private const int CacheEntryBytes = 16;
+        [Browsable(false)]
+        public long StorageFootprint { get { return textStorage.EstimateMemoryBytes(); } }
+        [Browsable(false)]
+        public long CacheFootprint
+        {
+            get
+            {
+                long blocks = lineWidthCache.BlockCount + tabStopCache.BlockCount + rowStartsCache.BlockCount;
+                return blocks * SparseLineCache<int>.DefaultBlockLines * CacheEntryBytes
+                    + 2 * longLineLayoutCache.TextLength;
+            }
+        }
+
+        // release the per-line layout caches - they are refilled on demand
+        public void TrimCaches()
+        {
+            lineWidthCache.Clear();
+            tabStopCache.Clear();
+            longLineLayoutCache.Clear();
+            rowStartsCache.Clear();
+        }
+
         public virtual void Reload(
             ITextStorageFactory factory,
             ITextStorage storage)
@@ -930,8 +1696,13 @@ namespace TextEditor
 
             this.textStorageFactory = factory;
             this.textStorage = factory.Take(storage);
+            if (syntaxHighlighter != null)
+            {
+                syntaxHighlighter.Reset(textStorage.Count);
+            }
 
             stickyX = 0;
+            longestLineHint = -1;
             SetInsertionPoint(0, 0);
             ResetCanvasSize();
         }
@@ -954,6 +1725,25 @@ namespace TextEditor
         [Category("Behavior"), DefaultValue(false)]
         public bool SimpleNavigation { get { return simpleNavigation; } set { simpleNavigation = value; } }
 
+        // Soft wrap lines at the client width (not for AutoSize or right to left layout). Rows of lines are measured as
+        // they come into view and by a background timer; until then a line counts as one row.
+        [Category("Behavior"), DefaultValue(false)]
+        public bool WordWrap
+        {
+            get
+            {
+                return wordWrap;
+            }
+            set
+            {
+                wordWrap = value;
+                ResetCanvasSize();
+                SetStickyX();
+                ScrollToSelection();
+                Invalidate();
+            }
+        }
+
 #if WINDOWS
         [Category("Appearance"), DefaultValue(TextService.Uniscribe)]
 #else
@@ -963,56 +1753,186 @@ namespace TextEditor
         {
             get
             {
-                return textService.Service;
+                return pendingTextService.HasValue ? pendingTextService.Value : textService.Service;
             }
             set
             {
+                pendingTextService = null; // supersedes any deferred preparation
+
                 if (value == textService.Service)
                 {
                     return;
                 }
 
-                ITextService newService;
-                switch (value)
-                {
-                    default:
-                        Debug.Assert(false);
-                        throw new ArgumentException();
-                    case TextService.Simple:
-                        newService = new TextServiceSimple();
-                        break;
+                InstallTextService(CreateTextService(value));
+            }
+        }
+
+        private ITextService CreateTextService(TextService value)
+        {
+            switch (value)
+            {
+                default:
+                    Debug.Assert(false);
+                    throw new ArgumentException();
+                case TextService.Simple:
+                    return new TextServiceSimple();
 #if WINDOWS
-                    case TextService.Uniscribe:
-                        newService = new TextServiceUniscribe();
-                        break;
-                    case TextService.DirectWrite:
-                        if (!String.Equals(System.Diagnostics.Process.GetCurrentProcess().ProcessName, "devenv"))
+                case TextService.Uniscribe:
+                    return new TextServiceUniscribe();
+                case TextService.DirectWrite:
+                    if (!String.Equals(System.Diagnostics.Process.GetCurrentProcess().ProcessName, "devenv"))
+                    {
+                        // attempt to load unprotected
+                        return new TextServiceDirectWrite();
+                    }
+                    else
+                    {
+                        // In design mode, VS dll isolation is causing grief with indirect dependencies.
+                        // Try to create (try here - constructor can't because method fails before invocation due to
+                        // missing dependency) and fall back to Uniscribe if not available.
+                        try
                         {
-                            // attempt to load unprotected
-                            newService = new TextServiceDirectWrite();
+                            return new TextServiceDirectWrite();
                         }
-                        else
+                        catch (Exception exception)
                         {
-                            // In design mode, VS dll isolation is causing grief with indirect dependencies.
-                            // Try to create (try here - constructor can't because method fails before invocation due to
-                            // missing dependency) and fall back to Uniscribe if not available.
-                            try
-                            {
-                                newService = new TextServiceDirectWrite();
-                            }
-                            catch (Exception exception)
-                            {
-                                MessageBox.Show(String.Format("{0}: Failed to create DirectWrite wrapper - falling back to Uniscribe ({1})", this.GetType().Name, exception.Message));
-                                newService = new TextServiceUniscribe();
-                            }
+                            MessageBox.Show(String.Format("{0}: Failed to create DirectWrite wrapper - falling back to Uniscribe ({1})", this.GetType().Name, exception.Message));
+                            return new TextServiceUniscribe();
                         }
-                        break;
+                    }
 #endif
-                }
-                textService.Dispose();
-                textService = newService;
+            }
+        }
+
+        private void InstallTextService(ITextService newService)
+        {
+            InstallTextService(newService, true/*reset*/);
+        }
+
+        // reset is false for a service already Reset with the current font and width
+        private void InstallTextService(ITextService newService, bool reset)
+        {
+            textService.Dispose();
+            textService = newService;
+            DisposeGraphicsObjects(); // reset height of offscreen strip
+            if (reset)
+            {
                 textService.Reset(Font, ClientWidth);
-                ResetCanvasSize();
+            }
+            UpdateFontHeight();
+            ResetCanvasSize();
+            Invalidate();
+        }
+
+        // Display text immediately with the Simple service and prepare the requested one (loading the DirectWrite
+        // interop assembly, creating the factory and font collections) on a worker thread, swapping it in when ready.
+        // Used at startup to keep text service initialization off the path to first paint. If preparation fails, the
+        // Simple service remains and failed (if provided) is invoked on the UI thread. Set the font and size first - the
+        // service is prepared for those, and is Reset again on the UI thread only if they have changed since.
+        public void SetTextServiceDeferred(TextService value, Action<Exception> failed)
+        {
+            SynchronizationContext context = SynchronizationContext.Current;
+            if ((value == TextService.Simple) || (value == TextService) || (context == null))
+            {
+                TextService = value;
+                return;
+            }
+
+            if (textService.Service != TextService.Simple)
+            {
+                InstallTextService(new TextServiceSimple());
+            }
+            pendingTextService = value;
+
+            Font font = (Font)Font.Clone();
+            int width = ClientWidth;
+            ThreadPool.QueueUserWorkItem(delegate (object state)
+            {
+                ITextService prepared = null;
+                Exception exception = null;
+                try
+                {
+                    prepared = CreateTextService(value);
+                    prepared.Reset(font, width);
+                    StartupTiming.Mark("Text service prepared");
+                }
+                catch (Exception caught)
+                {
+                    exception = caught;
+                    if (prepared != null)
+                    {
+                        prepared.Dispose();
+                        prepared = null;
+                    }
+                }
+
+                context.Post(
+                    delegate (object state2)
+                    {
+                        try
+                        {
+                            CompleteDeferredTextService(value, prepared, font, width, exception, failed);
+                        }
+                        finally
+                        {
+                            font.Dispose();
+                        }
+                    },
+                    null);
+            });
+        }
+
+        private void CompleteDeferredTextService(
+            TextService value,
+            ITextService prepared,
+            Font preparedFont,
+            int preparedWidth,
+            Exception exception,
+            Action<Exception> failed)
+        {
+            if (IsDisposed || (pendingTextService != value))
+            {
+                // control closed or service changed again before preparation finished
+                if (prepared != null)
+                {
+                    prepared.Dispose();
+                }
+                return;
+            }
+            pendingTextService = null;
+
+            if (exception != null)
+            {
+                if (failed != null)
+                {
+                    failed(exception);
+                }
+                return;
+            }
+
+            InstallTextService(prepared, !Font.Equals(preparedFont) || (ClientWidth != preparedWidth)/*reset*/);
+            StartupTiming.Mark("Text service ready");
+        }
+
+        // null disables highlighting
+        [Browsable(false), DesignerSerializationVisibility(DesignerSerializationVisibility.Hidden)]
+        public ISyntaxTokenizer SyntaxTokenizer
+        {
+            get
+            {
+                return syntaxHighlighter != null ? syntaxHighlighter.Tokenizer : null;
+            }
+            set
+            {
+                syntaxHighlighter = null;
+                if (value != null)
+                {
+                    syntaxHighlighter = new SyntaxHighlighter(value);
+                    syntaxHighlighter.Reset(textStorage.Count);
+                }
+                longLineLayoutCache.InvalidateColorRuns();
+                Invalidate();
             }
         }
 
@@ -1490,46 +2410,55 @@ namespace TextEditor
                 /* figure out how much space to leave at bottom and top edges */
                 int check = Math.Min(4 * fontHeight, Math.Max(ClientHeight / 2 - 4 * fontHeight, 0));
 
+                /* when wrapping, positions are rows rather than lines */
+                if (wrapping)
+                {
+                    MeasureRowsAround(graphics, startLine, endLine);
+                }
+                int startY = GetRowOfChar(graphics, startLine, startChar) * fontHeight;
+                int endY = GetRowOfChar(graphics, endLine, endCharPlusOne) * fontHeight;
+                int height = RowCount * fontHeight;
+
                 /* vertical adjustment */
-                if (((startLine * fontHeight >= -AutoScrollPosition.Y + check)
-                        && (startLine < -AutoScrollPosition.Y + (textStorage.Count * fontHeight - check)))
-                    || ((startLine * fontHeight < check)
-                        && (startLine * fontHeight >= -AutoScrollPosition.Y))
+                if (((startY >= -AutoScrollPosition.Y + check)
+                        && (startLine < -AutoScrollPosition.Y + (height - check)))
+                    || ((startY < check)
+                        && (startY >= -AutoScrollPosition.Y))
                     || (ClientHeight < fontHeight))
                 {
                     /* beginning of selection is in the box, so try to center the end */
-                    if ((endLine * fontHeight < -AutoScrollPosition.Y + check)
+                    if ((endY < -AutoScrollPosition.Y + check)
                         || (ClientHeight < fontHeight))
                     {
                         /* selection is too far up */
                         AutoScrollPosition = new Point(
                             -AutoScrollPosition.X,
-                            endLine * fontHeight - check);
+                            endY - check);
                     }
-                    else if (endLine * fontHeight >= -AutoScrollPosition.Y + (ClientHeight - fontHeight - check))
+                    else if (endY >= -AutoScrollPosition.Y + (ClientHeight - fontHeight - check))
                     {
                         /* selection is too far down */
                         AutoScrollPosition = new Point(
                             -AutoScrollPosition.X,
-                            endLine * fontHeight - (ClientHeight - fontHeight - check));
+                            endY - (ClientHeight - fontHeight - check));
                     }
                 }
                 else
                 {
                     /* center the beginning in the box */
-                    if (startLine * fontHeight < -AutoScrollPosition.Y + check)
+                    if (startY < -AutoScrollPosition.Y + check)
                     {
                         /* selection is to far up */
                         AutoScrollPosition = new Point(
                             -AutoScrollPosition.X,
-                            startLine * fontHeight - check);
+                            startY - check);
                     }
-                    else if (startLine * fontHeight >= -AutoScrollPosition.Y + (ClientHeight - check))
+                    else if (startY >= -AutoScrollPosition.Y + (ClientHeight - check))
                     {
                         /* selection is too far down */
                         AutoScrollPosition = new Point(
                             -AutoScrollPosition.X,
-                            startLine * fontHeight - (ClientHeight - check));
+                            startY - (ClientHeight - check));
                     }
                 }
 
@@ -1553,6 +2482,8 @@ namespace TextEditor
                     if (ScreenXFromCharIndex(graphics, startLine, startChar)
                         > -AutoScrollPosition.X + ClientWidth - check)
                     {
+                        // the estimated extent of a long line is refined as more of it is measured
+                        RecomputeCanvasSizeIncremental();
                         AutoScrollPosition = new Point(
                             (int)ScreenXFromCharIndex(graphics, startLine, startChar)
                                 - ClientWidth + (2 * check),
@@ -1662,8 +2593,7 @@ namespace TextEditor
                 whereX = e.X - AutoScrollPosition.X;
                 whereY = e.Y - AutoScrollPosition.Y;
 
-                currentMousePoint.Line = whereY / fontHeight;
-                currentMousePoint.Column = CharIndexFromScreenX(graphics, currentMousePoint.Line, whereX);
+                GetPointFromRow(graphics, whereY / fontHeight, whereX, out currentMousePoint.Line, out currentMousePoint.Column);
                 if ((ModifierKeys & Keys.Shift) != 0)
                 {
                     pivotPoint.Line = selectStartIsActive
@@ -1757,14 +2687,12 @@ namespace TextEditor
                 {
                     whereY = 0;
                 }
-                if (whereY > textStorage.Count * fontHeight - 1)
+                if (whereY > RowCount * fontHeight - 1)
                 {
-                    whereY = textStorage.Count * fontHeight - 1;
+                    whereY = RowCount * fontHeight - 1;
                 }
                 SelPoint currentMousePoint = new SelPoint();
-                currentMousePoint.Line = whereY / fontHeight;
-                currentMousePoint.Column = CharIndexFromScreenX(graphics,
-                    currentMousePoint.Line, whereX);
+                GetPointFromRow(graphics, whereY / fontHeight, whereX, out currentMousePoint.Line, out currentMousePoint.Column);
                 /* calculate what the extent of the current mouse selection should be */
                 extendedPivotPoint = pivotPoint;
                 if (pivotPoint.CompareTo(currentMousePoint) >= 0)
@@ -1840,25 +2768,23 @@ namespace TextEditor
                 if (startValid && (start.Line >= 0) && (start.Line < textStorage.Count))
                 {
                     IDecodedTextLine decodedLine = textStorage[start.Line].Decode_MustDispose();
-                    using (ITextInfo info = !simpleNavigation
-                        ? textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value)
-                        : new TextServiceSimple().AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                    int offset;
+                    using (ITextInfo info = AnalyzeForNavigation(graphics, decodedLine.Value, start.Column, out offset))
                     {
                         int previous;
-                        info.PreviousWordBoundary(start.Column, out previous);
-                        start.Column = previous;
+                        info.PreviousWordBoundary(start.Column - offset, out previous);
+                        start.Column = previous + offset;
                     }
                 }
                 if (endValid && (end.Line >= 0) && (end.Line < textStorage.Count))
                 {
                     IDecodedTextLine decodedLine = textStorage[end.Line].Decode_MustDispose();
-                    using (ITextInfo info = !simpleNavigation
-                        ? textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value)
-                        : new TextServiceSimple().AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                    int offset;
+                    using (ITextInfo info = AnalyzeForNavigation(graphics, decodedLine.Value, end.Column, out offset))
                     {
                         int next;
-                        info.NextWordBoundary(end.Column, out next);
-                        end.Column = next;
+                        info.NextWordBoundary(end.Column - offset, out next);
+                        end.Column = next + offset;
                     }
                 }
             }
@@ -2013,24 +2939,22 @@ namespace TextEditor
                                     }
                                     else if ((e.KeyData & Keys.Control) != 0)
                                     {
-                                        using (ITextInfo info = !simpleNavigation
-                                            ? textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value)
-                                            : new TextServiceSimple().AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                                        int offset;
+                                        using (ITextInfo info = AnalyzeForNavigation(graphics, decodedLine.Value, index, out offset))
                                         {
                                             int previous;
-                                            info.PreviousWordBoundary(index, out previous);
-                                            index = previous;
+                                            info.PreviousWordBoundary(index - offset, out previous);
+                                            index = previous + offset;
                                         }
                                     }
                                     else
                                     {
-                                        using (ITextInfo info = !simpleNavigation
-                                            ? textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value)
-                                            : new TextServiceSimple().AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                                        int offset;
+                                        using (ITextInfo info = AnalyzeForNavigation(graphics, decodedLine.Value, index, out offset))
                                         {
                                             int previous;
-                                            info.PreviousCharBoundary(index, out previous);
-                                            index = previous;
+                                            info.PreviousCharBoundary(index - offset, out previous);
+                                            index = previous + offset;
                                         }
                                     }
                                 }
@@ -2081,24 +3005,22 @@ namespace TextEditor
                                     }
                                     else if ((e.KeyData & Keys.Control) != 0)
                                     {
-                                        using (ITextInfo info = !simpleNavigation
-                                            ? textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value)
-                                            : new TextServiceSimple().AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                                        int offset;
+                                        using (ITextInfo info = AnalyzeForNavigation(graphics, decodedLine.Value, index, out offset))
                                         {
                                             int next;
-                                            info.NextWordBoundary(index, out next);
-                                            index = next;
+                                            info.NextWordBoundary(index - offset, out next);
+                                            index = next + offset;
                                         }
                                     }
                                     else
                                     {
-                                        using (ITextInfo info = !simpleNavigation
-                                            ? textService.AnalyzeText(graphics, Font, fontHeight, decodedLine.Value)
-                                            : new TextServiceSimple().AnalyzeText(graphics, Font, fontHeight, decodedLine.Value))
+                                        int offset;
+                                        using (ITextInfo info = AnalyzeForNavigation(graphics, decodedLine.Value, index, out offset))
                                         {
                                             int next;
-                                            info.NextCharBoundary(index, out next);
-                                            index = next;
+                                            info.NextCharBoundary(index - offset, out next);
+                                            index = next + offset;
                                         }
                                     }
                                 }
@@ -2120,12 +3042,7 @@ namespace TextEditor
 
                     case Keys.PageUp:
                         {
-                            int newPosition = (selectStartIsActive ? selectStartLine : selectEndLine)
-                                - ClientHeight / fontHeight;
-                            if (newPosition < 0)
-                            {
-                                newPosition = 0;
-                            }
+                            int newPosition;
 #if false
                             int newPoint = CharIndexFromScreenX(
                                 graphics,
@@ -2140,10 +3057,8 @@ namespace TextEditor
                                         : selectEndCharPlusOne));
 #else
                             int savedStickyX = stickyX;
-                            int newPoint = CharIndexFromScreenX(
-                                graphics,
-                                newPosition,
-                                stickyX);
+                            int newPoint;
+                            GetPointFromActiveEndRows(graphics, -(ClientHeight / fontHeight), out newPosition, out newPoint);
 #endif
                             MoveExtend(newPosition, newPoint, extend);
 #if true
@@ -2156,12 +3071,7 @@ namespace TextEditor
 
                     case Keys.PageDown:
                         {
-                            int newPosition = (selectStartIsActive ? selectStartLine : selectEndLine)
-                                + ClientHeight / fontHeight;
-                            if (newPosition > textStorage.Count - 1)
-                            {
-                                newPosition = textStorage.Count - 1;
-                            }
+                            int newPosition;
 #if false
                             int newPoint = CharIndexFromScreenX(
                                 graphics,
@@ -2176,10 +3086,8 @@ namespace TextEditor
                                         : selectEndCharPlusOne));
 #else
                             int savedStickyX = stickyX;
-                            int newPoint = CharIndexFromScreenX(
-                                graphics,
-                                newPosition,
-                                stickyX);
+                            int newPoint;
+                            GetPointFromActiveEndRows(graphics, ClientHeight / fontHeight, out newPosition, out newPoint);
 #endif
                             MoveExtend(newPosition, newPoint, extend);
 #if true
@@ -2200,11 +3108,7 @@ namespace TextEditor
                         }
                         else
                         {
-                            int newLineIndex = (selectStartIsActive ? selectStartLine : selectEndLine) - 1;
-                            if (newLineIndex < 0)
-                            {
-                                newLineIndex = 0;
-                            }
+                            int newLineIndex;
                             /* snap it to the closest point on the next line */
 #if false
                             int newPoint = CharIndexFromScreenX(
@@ -2220,10 +3124,8 @@ namespace TextEditor
                                         : selectEndCharPlusOne));
 #else
                             int savedStickyX = stickyX;
-                            int newPoint = CharIndexFromScreenX(
-                                graphics,
-                                newLineIndex,
-                                stickyX);
+                            int newPoint;
+                            GetPointFromActiveEndRows(graphics, -1, out newLineIndex, out newPoint);
 #endif
                             if (!extend)
                             {
@@ -2256,13 +3158,7 @@ namespace TextEditor
                         }
                         else
                         {
-                            int newLineIndex = (selectStartIsActive
-                                ? selectStartLine
-                                : selectEndLine) + 1;
-                            if (newLineIndex > textStorage.Count - 1)
-                            {
-                                newLineIndex = textStorage.Count - 1;
-                            }
+                            int newLineIndex;
                             /* snap it to the closest point on the next line */
 #if false
                             int newPoint = CharIndexFromScreenX(
@@ -2278,10 +3174,8 @@ namespace TextEditor
                                         : selectEndCharPlusOne));
 #else
                             int savedStickyX = stickyX;
-                            int newPoint = CharIndexFromScreenX(
-                                graphics,
-                                newLineIndex,
-                                stickyX);
+                            int newPoint;
+                            GetPointFromActiveEndRows(graphics, 1, out newLineIndex, out newPoint);
 #endif
                             if (!extend)
                             {
@@ -2413,6 +3307,7 @@ namespace TextEditor
             int lastRedrawLine = Math.Max(endLine, selectEndLine);
 
             bool shift = endLine - startLine != replacement.Count - 1;
+            int oldRowSpan = GetRowOfLine(endLine + 1) - GetRowOfLine(startLine);
 
             ITextStorage deleted = GetRange(
                 startLine,
@@ -2430,8 +3325,32 @@ namespace TextEditor
                     replacedEndCharPlusOne);
             }
 
+            if (syntaxHighlighter != null)
+            {
+                syntaxHighlighter.ReplacingLines(startLine, endLine - startLine, replacement.Count - 1);
+            }
+            if (wrapping)
+            {
+                rowIndex.ReplacingLines(startLine, endLine - startLine, replacement.Count - 1);
+                refineLine = Math.Min(refineLine, startLine);
+                timerWrapRefine.Start();
+            }
             lineWidthCache.Delete(startLine, endLine - startLine);
             lineWidthCache.Invalidate(startLine);
+            tabStopCache.Delete(startLine, endLine - startLine);
+            tabStopCache.Invalidate(startLine);
+            longLineLayoutCache.Delete(startLine, endLine - startLine);
+            longLineLayoutCache.Invalidate(startLine);
+            rowStartsCache.Delete(startLine, endLine - startLine);
+            rowStartsCache.Invalidate(startLine);
+            if (longestLineHint > endLine)
+            {
+                longestLineHint += (replacement.Count - 1) - (endLine - startLine);
+            }
+            else if (longestLineHint >= startLine)
+            {
+                longestLineHint = -1; // edited - no longer known to be the longest
+            }
             textStorage.DeleteSection(
                 startLine,
                 startChar,
@@ -2440,13 +3359,28 @@ namespace TextEditor
 
             lineWidthCache.Insert(startLine + 1, replacement.Count - 1);
             lineWidthCache.Invalidate(startLine);
+            tabStopCache.Insert(startLine + 1, replacement.Count - 1);
+            tabStopCache.Invalidate(startLine);
+            longLineLayoutCache.Insert(startLine + 1, replacement.Count - 1);
+            longLineLayoutCache.Invalidate(startLine);
+            rowStartsCache.Insert(startLine + 1, replacement.Count - 1);
+            rowStartsCache.Invalidate(startLine);
             textStorage.InsertSection(
                 startLine,
                 startChar,
                 replacement);
 
+            if ((syntaxHighlighter != null) && syntaxHighlighter.EditChangedFollowingLines(replacedEndLine, getStoredLine))
+            {
+                longLineLayoutCache.InvalidateColorRuns();
+                Invalidate(); // e.g. comment opened or closed - colors of following lines change
+            }
+
             RecomputeCanvasSizeIncremental();
 
+            // when wrapping, following lines also move if the edited lines now take a different number of rows
+            shift = shift || (GetRowOfLine(replacedEndLine + 1) - GetRowOfLine(startLine) != oldRowSpan);
+
             if (!select.HasValue)
             {
             }
@@ -2553,6 +3487,60 @@ namespace TextEditor
                 select);
         }
 
+        // Append data arriving at the end of a followed file. It is not recorded for undo and does not change Modified.
+        // Only the lines near the viewport are measured, and if the insertion point was at the end of the text it stays
+        // at the end and is scrolled into view.
+        public void AppendFromStream(Stream stream, Encoding encoding, ref LineEndingInfo lineEndingInfo)
+        {
+            int lastLine = textStorage.Count - 1;
+            bool follow = !SelectionNonEmpty
+                && (selectEndLine == lastLine)
+                && (selectEndCharPlusOne == textStorage[lastLine].Length);
+
+            int oldCount = textStorage.Count;
+            bool modified = textStorage.Modified;
+            textStorage.AppendStream(stream, encoding, ref lineEndingInfo);
+            textStorage.Modified = modified;
+            int insertedLines = textStorage.Count - oldCount;
+
+            // nothing follows the appended lines, so there are no following colors, cached widths or longest line hint
+            // to shift
+            if (syntaxHighlighter != null)
+            {
+                syntaxHighlighter.ReplacingLines(lastLine, 0, insertedLines);
+            }
+            lineWidthCache.Insert(lastLine + 1, insertedLines);
+            lineWidthCache.Invalidate(lastLine);
+            tabStopCache.Insert(lastLine + 1, insertedLines);
+            tabStopCache.Invalidate(lastLine);
+            longLineLayoutCache.Insert(lastLine + 1, insertedLines);
+            longLineLayoutCache.Invalidate(lastLine);
+            rowStartsCache.Insert(lastLine + 1, insertedLines);
+            rowStartsCache.Invalidate(lastLine);
+            if (wrapping)
+            {
+                rowIndex.ReplacingLines(lastLine, 0, insertedLines);
+                refineLine = Math.Min(refineLine, lastLine);
+                timerWrapRefine.Start();
+            }
+
+            RecomputeCanvasSizeIncremental();
+
+            if (follow)
+            {
+                lastLine = textStorage.Count - 1;
+                SetInsertionPoint(lastLine, textStorage[lastLine].Length);
+                ScrollToSelection();
+            }
+            int startLine, endLine;
+            GetVisibleLines(out startLine, out endLine);
+            RedrawRange(
+                Math.Max(oldCount - 1, startLine),
+                Math.Min(textStorage.Count - 1, endLine));
+
+            OnTextChanged(EventArgs.Empty);
+        }
+
         public ITextLine GetLine(int index)
         {
             return textStorage[index];
@@ -25,8 +25,6 @@ using System.Diagnostics;
 using System.IO;
 using System.Text;
 
-using TreeLib;
-
 namespace TextEditor
 {
     public abstract class Utf8GapBuffer
@@ -62,8 +60,9 @@ namespace TextEditor
         private static readonly byte[] LineEndingChars = WindowsLF; // just both
 
         private byte[] defaultLineEnding = WindowsLF; // TODO: code for changing default line ending
-        private HugeList<byte> vector = new HugeList<byte>(typeof(SplayTreeRangeMap<>), BlockSize);
+        private SharedByteList vector = new SharedByteList(); // chunks may be shared with sections copied to or from this
         private LineSkipMap lineSkipMap = new LineSkipMap();
+        private byte[] scanBuffer; // for line break search
 
         private int totalLines;
         private int currentLine;
@@ -207,6 +206,7 @@ namespace TextEditor
 
         public override void MoveTo(int targetLine)
         {
+            long perf = PerfCounters.Begin();
             if (unchecked((uint)targetLine) > unchecked((uint)totalLines))
             {
                 Debug.Assert(false);
@@ -242,6 +242,13 @@ namespace TextEditor
 
             MoveTo(targetLine, ref currentLine, ref currentOffset);
 
+            // a segment spanning more bytes than the budget (long lines, or lines that grew after the segment was
+            // formed) is split at the line just located, so the skip map becomes denser where it is being used
+            if ((charLength > LineSkipMap.ByteBudget) && (targetLine > startLine) && (targetLine < startLine + numLines))
+            {
+                lineSkipMap.SplitAt(targetLine, currentOffset);
+            }
+
             if (EnableValidate)
             {
                 if (totalLines < ValidateCutoffLines2)
@@ -249,6 +256,7 @@ namespace TextEditor
                     Validate();
                 }
             }
+            PerfCounters.End(PerfCounter.MoveTo, perf);
         }
 
         private void MoveTo(int targetLine, ref int currentLine, ref int currentOffset)
@@ -329,15 +337,102 @@ namespace TextEditor
             }
         }
 
+        // Line break search: bytes are copied out of the gap buffer in chunks (starting small so that short lines stay
+        // cheap, doubling up to the block size) and tested eight at a time, rather than compared one element at a time
+        // through the list's generic search.
+        private const int InitialScanChunk = 64;
+        private const ulong Ones = 0x0101010101010101UL;
+        private const ulong Highs = 0x8080808080808080UL;
+
+        // first line break in [start, end), or -1
+        private int IndexOfLineBreak(int start, int end)
+        {
+            int chunk = InitialScanChunk;
+            while (start < end)
+            {
+                int count = Math.Min(chunk, end - start);
+                TextStorage.EnsureCapacity(ref scanBuffer, count);
+                vector.CopyTo(start, scanBuffer, 0, count);
+                int i = IndexOfLineBreak(scanBuffer, 0, count);
+                if (i >= 0)
+                {
+                    return start + i;
+                }
+                start += count;
+                chunk = Math.Min(2 * chunk, BlockSize);
+            }
+            return -1;
+        }
+
+        // last line break in [start, end), or -1
+        private int LastIndexOfLineBreak(int start, int end)
+        {
+            int chunk = InitialScanChunk;
+            while (start < end)
+            {
+                int count = Math.Min(chunk, end - start);
+                TextStorage.EnsureCapacity(ref scanBuffer, count);
+                vector.CopyTo(end - count, scanBuffer, 0, count);
+                int i = LastIndexOfLineBreak(scanBuffer, 0, count);
+                if (i >= 0)
+                {
+                    return end - count + i;
+                }
+                end -= count;
+                chunk = Math.Min(2 * chunk, BlockSize);
+            }
+            return -1;
+        }
+
+        private static bool HasLineBreak(ulong word)
+        {
+            // a byte of x is zero iff the corresponding byte of (x - 0x01..) & ~x & 0x80.. is set (exact as a whole,
+            // though borrows can mark bytes above a true zero)
+            ulong cr = word ^ (Ones * (byte)'\r');
+            ulong lf = word ^ (Ones * (byte)'\n');
+            return ((((cr - Ones) & ~cr) | ((lf - Ones) & ~lf)) & Highs) != 0;
+        }
+
+        public static int IndexOfLineBreak(byte[] bytes, int start, int end)
+        {
+            int i = start;
+            while ((i + 8 <= end) && !HasLineBreak(BitConverter.ToUInt64(bytes, i)))
+            {
+                i += 8;
+            }
+            for (; i < end; i++)
+            {
+                if ((bytes[i] == (byte)'\r') || (bytes[i] == (byte)'\n'))
+                {
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        public static int LastIndexOfLineBreak(byte[] bytes, int start, int end)
+        {
+            int i = end;
+            while ((i - 8 >= start) && !HasLineBreak(BitConverter.ToUInt64(bytes, i - 8)))
+            {
+                i -= 8;
+            }
+            for (i--; i >= start; i--)
+            {
+                if ((bytes[i] == (byte)'\r') || (bytes[i] == (byte)'\n'))
+                {
+                    return i;
+                }
+            }
+            return -1;
+        }
+
         private void GetPreviousLineExtent(int offset, out int start, out int lineBodyLength, out int lineEndingLength)
         {
             Debug.Assert(IsAtLineEnding(offset - 1));
             Debug.Assert(offset - 1 >= prefixLength);
             int lineBreakStart = FindStartOfLineBreak(offset - 1);
-            int precedingLineBreakLast = vector.LastIndexOfAny(
-                LineEndingChars,
-                lineBreakStart - 1,
-                lineBreakStart);
+            int precedingLineBreakLast = LastIndexOfLineBreak(0, lineBreakStart);
             Debug.Assert(IsAtLineEnding(precedingLineBreakLast));
             Debug.Assert(precedingLineBreakLast >= prefixLength - 1);
             start = precedingLineBreakLast + 1;
@@ -349,10 +444,7 @@ namespace TextEditor
         {
             Debug.Assert(IsAtLineEnding(offset - 1));
             Debug.Assert(offset <= vector.Count - suffixLength);
-            int lineBreakStart = vector.IndexOfAny(
-                LineEndingChars,
-                offset,
-                vector.Count - offset);
+            int lineBreakStart = IndexOfLineBreak(offset, vector.Count);
             Debug.Assert(lineBreakStart <= vector.Count - suffixLength);
             int afterLineBreak = FindAfterOfLineBreak(lineBreakStart);
             lineEndingLength = afterLineBreak - lineBreakStart;
@@ -369,6 +461,17 @@ namespace TextEditor
             return bytes;
         }
 
+        // copy line body into caller's buffer (grown if too small) without allocating - returns byte count
+        public int CopyLine(int index, ref byte[] buffer)
+        {
+            MoveTo(index);
+            int lineBodyLength, lineEndingLength;
+            GetCurrentLineExtent(currentOffset, out lineBodyLength, out lineEndingLength);
+            TextStorage.EnsureCapacity(ref buffer, lineBodyLength);
+            vector.CopyTo(currentOffset, buffer, 0, lineBodyLength);
+            return lineBodyLength;
+        }
+
         public override void SetLine(int index, byte[] buffer)
         {
             if ((Array.IndexOf(buffer, (byte)'\r') >= 0) || (Array.IndexOf(buffer, (byte)'\n') >= 0))
@@ -468,36 +571,129 @@ namespace TextEditor
             }
         }
 
+        // stream must supply UTF-8 - see Utf8TranscodingReadStream for other encodings
         public Utf8SplayGapBuffer(
             Stream stream,
             bool detectBom,
-            Encoding encoding,
             out LineEndingInfo lineEndingInfo)
         {
-            byte[] buffer = new byte[vector.MaxBlockSize];
-            while (true)
+            int longestLine;
+            ReadAll(stream);
+            ScanLines(out lineEndingInfo, out longestLine);
+        }
+
+        // as above, also producing the line index for saving
+        public Utf8SplayGapBuffer(
+            Stream stream,
+            bool detectBom,
+            out LineEndingInfo lineEndingInfo,
+            out LineIndex index)
+        {
+            int longestLine;
+            ReadAll(stream);
+            ScanLines(out lineEndingInfo, out longestLine);
+            index = new LineIndex(lineEndingInfo, bomLength, longestLine, lineSkipMap.GetSegments());
+        }
+
+        // Construct from UTF-16 text (such as a large paste). The text is transcoded a block at a time straight onto the
+        // end of the vector, without an intermediate copy of the whole, and the line index is then built in bulk by
+        // ScanLines(). An initial U+FEFF is kept as text rather than taken for a BOM.
+        public Utf8SplayGapBuffer(
+            string utf16,
+            int offset,
+            int count,
+            out LineEndingInfo lineEndingInfo)
+        {
+            byte[] buffer = new byte[SharedByteList.ChunkSize];
+            int index = offset;
+            int end = offset + count;
+            while (index < end)
+            {
+                int c = Utf8Transcoding.Utf16ToUtf8(utf16, ref index, end, buffer);
+                vector.InsertRange(vector.Count, buffer, 0, c);
+            }
+
+            AddSeparators();
+
+            int longestLine;
+            ScanLines(out lineEndingInfo, out longestLine);
+        }
+
+        // Load with the line index saved from an earlier load of the same data instead of scanning for line breaks. The
+        // index is checked against the data only cheaply (total length and the line break at each segment boundary);
+        // InvalidDataException is thrown if it doesn't fit.
+        public Utf8SplayGapBuffer(
+            Stream stream,
+            bool detectBom,
+            LineIndex index)
+        {
+            ReadAll(stream);
+
+            if (index.bomLength != bomLength)
+            {
+                throw new InvalidDataException();
+            }
+            int[] segments = index.segments;
+            int lines = 0;
+            int offset = prefixLength;
+            for (int i = 0; i < segments.Length; i += 2)
             {
-                int read = stream.Read(buffer, 0, buffer.Length);
-                if (read == 0)
+                if ((segments[i] <= 0) || (segments[i + 1] <= 0) || (segments[i + 1] > vector.Count - offset))
+                {
+                    throw new InvalidDataException();
+                }
+                lines += segments[i];
+                offset += segments[i + 1];
+                if ((offset < vector.Count)
+                    && !((vector[offset - 1] == (byte)'\n') || ((vector[offset - 1] == (byte)'\r') && (vector[offset] != (byte)'\n'))))
                 {
-                    break;
+                    throw new InvalidDataException();
                 }
-                vector.InsertRange(vector.Count, buffer, 0, read);
             }
+            if (offset != vector.Count)
+            {
+                throw new InvalidDataException();
+            }
+
+            lineSkipMap.Restore(prefixLength, segments);
+            totalLines = lines;
+            currentLine = 0;
+            currentOffset = prefixLength;
+
+            if (EnableValidate)
+            {
+                Validate();
+            }
+        }
+
+        private void ReadAll(Stream stream)
+        {
+            vector.AppendFrom(stream);
 
             if ((vector.Count >= 3) && ((vector[0] == 0xEF) && (vector[1] == 0xBB) && (vector[2] == 0xBF)))
             {
                 bomLength = 3;
             }
 
-            lineEndingInfo = new LineEndingInfo();
+            AddSeparators();
+        }
 
+        private void AddSeparators()
+        {
             // invariant: require separators at ends
             Debug.Assert(WindowsLF.Length == 2);
             prefixLength = (byte)(bomLength + 2);
             vector.InsertRange(bomLength, WindowsLF);
             suffixLength = 2;
             vector.InsertRange(vector.Count, WindowsLF);
+        }
+
+        // longestLine is the line with the most bytes - an estimate of the widest line that needs no decoding
+        private void ScanLines(out LineEndingInfo lineEndingInfo, out int longestLine)
+        {
+            lineEndingInfo = new LineEndingInfo();
+            longestLine = 0;
+            int longestLineBytes = 0;
 
             totalLines = 0;
             currentLine = 0;
@@ -505,8 +701,6 @@ namespace TextEditor
 
             lineSkipMap.Reset(prefixLength, suffixLength);
 
-            bool ignoreEncoding = (encoding == null) || (encoding is UTF8Encoding);
-
             int lineEndingCount = 0;
             int endOfData = vector.Count - suffixLength/*avoid our artifical addition*/;
             //
@@ -517,26 +711,11 @@ namespace TextEditor
             //          
             while (currentOffset < endOfData)
             {
-                int textEnd = vector.IndexOfAny(LineEndingChars, currentOffset, endOfData - currentOffset);
+                int textEnd = IndexOfLineBreak(currentOffset, endOfData);
                 if (textEnd < 0)
                 {
                     textEnd = endOfData;
                 }
-                int textLength = textEnd - currentOffset;
-
-                // TODO: can extend to also handle line terminators
-                if (!ignoreEncoding)
-                {
-                    byte[] bytes = new byte[textLength];
-                    string s = encoding.GetString(bytes);
-                    int c = Encoding.UTF8.GetByteCount(s);
-                    if (c != bytes.Length)
-                    {
-                        byte[] bytes2 = Encoding.UTF8.GetBytes(s);
-                        vector.ReplaceRange(currentOffset, bytes.Length, bytes2);
-                        currentSkipCharLength += bytes2.Length - bytes.Length;
-                    }
-                }
 
                 Debug.Assert(IsAtLineEnding(textEnd));
                 int nextStart = textEnd;
@@ -563,9 +742,15 @@ namespace TextEditor
                     nextStart++;
                 }
 
+                if (longestLineBytes < textEnd - currentOffset)
+                {
+                    longestLineBytes = textEnd - currentOffset;
+                    longestLine = currentLine;
+                }
+
                 currentSkipNumLines++;
                 currentSkipCharLength += nextStart - currentOffset;
-                if (currentSkipNumLines > LineSkipMap.Sparseness)
+                if ((currentSkipNumLines > LineSkipMap.Sparseness) || (currentSkipCharLength > LineSkipMap.ByteBudget))
                 {
                     lineSkipMap.BulkLinesInserted(currentSkipStartLine, currentSkipNumLines, currentSkipCharOffset, currentSkipCharLength);
                     currentSkipStartLine += currentSkipNumLines;
@@ -603,111 +788,333 @@ namespace TextEditor
             }
         }
 
-        public Utf8SplayGapBuffer(Utf8SplayGapBuffer source, int startLine, int countLines, Encoding encoding, out LineEndingInfo lineEndingInfo)
-            : this(
-                new VectorReadStream(
-                    source.vector,
-                    source.GetStartIndexOfLineRelative(startLine, source.prefixLength),
-                    source.GetStartIndexOfLineRelative(startLine + countLines, source.prefixLength)
-                        - source.GetStartIndexOfLineRelative(startLine, source.prefixLength)),
-                false/*detectBom*/,
-                encoding,
-                out lineEndingInfo)
+        // absolute offset in vector of the start of line (index == Count permitted, yielding end of data)
+        private int GetLineOffset(int index)
         {
+            MoveTo(index);
+            return currentOffset;
         }
 
-        private class VectorReadStream : Stream
+        // bytes of text, excluding the separators and any byte order mark
+        public int ByteCount { get { return vector.Count - prefixLength - suffixLength; } }
+
+        // Copy the section [startLine:startByte, endLine:endByte) of source (byte indices relative to start of line).
+        // The bytes are shared with source rather than copied, and the line index is derived from the source's skip map
+        // rather than by rescanning.
+        public Utf8SplayGapBuffer(Utf8SplayGapBuffer source, int startLine, int startByte, int endLine, int endByte)
         {
-            private HugeList<byte> vector;
-            private int start;
-            private int length;
-            private int position;
+            if ((startLine > endLine) || ((startLine == endLine) && (startByte > endByte)))
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
+
+            int start = source.GetLineOffset(startLine) + startByte;
+            int firstLineEnd = startLine < endLine ? source.GetLineOffset(startLine + 1) : 0;
+            int lastLineStart = source.GetLineOffset(endLine);
+            int end = lastLineStart + endByte;
+
+            // invariant: require separators at ends
+            Debug.Assert(WindowsLF.Length == 2);
+            bomLength = 0;
+            prefixLength = 2;
+            suffixLength = 2;
+            vector.InsertRange(0, WindowsLF);
+            source.vector.CopyRangeTo(start, end - start, vector, vector.Count);
+            vector.InsertRange(vector.Count, WindowsLF);
+
+            totalLines = endLine - startLine + 1;
+            currentLine = 0;
+            currentOffset = prefixLength;
+
+            lineSkipMap.Reset(prefixLength, suffixLength);
 
-            public VectorReadStream(HugeList<byte> vector, int start, int length)
+            int line = 0;
+            if (startLine < endLine)
             {
-                if (unchecked((uint)start > (uint)vector.Count) || unchecked((uint)start + (uint)length > (uint)vector.Count))
+                // first line is remainder of source start line, including its line ending
+                lineSkipMap.BulkLinesInserted(
+                    line,
+                    1,
+                    prefixLength,
+                    firstLineEnd - start);
+                line++;
+
+                // interior lines taken from source skip segments, clipped to [startLine + 1, endLine)
+                int sourceLine = startLine + 1;
+                int sourceOffset = firstLineEnd;
+                while (sourceLine < endLine)
                 {
-                    Debug.Assert(false);
-                    throw new ArgumentOutOfRangeException();
+                    int segmentStartLine, segmentNumLines, segmentCharOffset, segmentCharLength;
+                    source.lineSkipMap.NearestLessOrEqualCountYExtent(sourceLine, out segmentStartLine, out segmentNumLines, out segmentCharOffset, out segmentCharLength);
+                    int numLines = Math.Min(segmentStartLine + segmentNumLines, endLine) - sourceLine;
+                    bool whole = segmentStartLine + segmentNumLines <= endLine;
+                    int segmentEnd = whole ? segmentCharOffset + segmentCharLength : lastLineStart;
+                    lineSkipMap.BulkLinesInserted(
+                        line,
+                        numLines,
+                        prefixLength + (sourceOffset - start),
+                        segmentEnd - sourceOffset);
+                    line += numLines;
+                    sourceLine += numLines;
+                    sourceOffset = segmentEnd;
                 }
-                this.vector = vector;
-                this.start = start;
-                this.length = length;
+                Debug.Assert(sourceOffset == lastLineStart);
             }
+            // last line is head of source end line, terminated by the suffix
+            int lastLineHead = Math.Max(lastLineStart, start);
+            lineSkipMap.LineLengthChanged(line, end - lastLineHead);
 
-            public override bool CanRead { get { return true; } }
-
-            public override bool CanSeek { get { return true; } }
+            if (EnableValidate)
+            {
+                if (totalLines < ValidateCutoffLines2)
+                {
+                    Validate();
+                }
+            }
+        }
 
-            public override bool CanWrite { get { return false; } }
+        // Splice all of insert at [line:byteIndex] (byte index relative to start of line), preserving insert's line
+        // endings. Insert's bytes are shared rather than copied and its skip segments are transplanted, instead of line by
+        // line.
+        public void InsertSection(int line, int byteIndex, Utf8SplayGapBuffer insert)
+        {
+            if (insert == this)
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
+            }
 
-            public override void Flush()
+            int lineStart = GetLineOffset(line);
+            int position = lineStart + byteIndex;
+            int nextLineStart = GetLineOffset(line + 1);
+            int tailLength = nextLineStart - position; // remainder of line including line ending (or suffix)
+            if (tailLength < (line + 1 < totalLines ? 1 : suffixLength))
             {
+                Debug.Assert(false);
+                throw new ArgumentException();
             }
 
-            public override long Length { get { return length; } }
+            int insertLines = insert.totalLines;
+            int insertFirstLineEnd = insert.GetLineOffset(Math.Min(1, insertLines));
+            int insertStart = insert.prefixLength;
+            int insertLength = insert.vector.Count - insert.prefixLength - insert.suffixLength;
 
-            public override long Position
+            if (insertLines == 1)
             {
-                get
-                {
-                    return position;
-                }
-                set
+                insert.vector.CopyRangeTo(insertStart, insertLength, vector, position);
+                lineSkipMap.LineLengthChanged(line, insertLength);
+            }
+            else
+            {
+                lineSkipMap.SplitAt(line + 1, nextLineStart);
+                insert.vector.CopyRangeTo(insertStart, insertLength, vector, position);
+
+                // lines 1.. of insert follow line; the last of them picks up the tail of the original line
+                int targetLine = line + 1;
+                int sourceLine = 1;
+                int sourceOffset = insertFirstLineEnd;
+                while (sourceLine < insertLines)
                 {
-                    if (unchecked((ulong)value > (ulong)length))
+                    int segmentStartLine, segmentNumLines, segmentCharOffset, segmentCharLength;
+                    insert.lineSkipMap.NearestLessOrEqualCountYExtent(sourceLine, out segmentStartLine, out segmentNumLines, out segmentCharOffset, out segmentCharLength);
+                    int numLines = segmentStartLine + segmentNumLines - sourceLine;
+                    int segmentEnd = segmentCharOffset + segmentCharLength;
+                    int charLength = segmentEnd - sourceOffset;
+                    if (sourceLine + numLines == insertLines)
                     {
-                        Debug.Assert(false);
-                        throw new ArgumentException();
+                        charLength += tailLength - insert.suffixLength;
                     }
-                    position = (int)value;
+                    lineSkipMap.InsertSegment(targetLine, numLines, charLength);
+                    targetLine += numLines;
+                    sourceLine += numLines;
+                    sourceOffset = segmentEnd;
                 }
+
+                // line keeps its head and gains first line of insert (with its line ending) in place of its tail
+                lineSkipMap.LineLengthChanged(line, (insertFirstLineEnd - insertStart) - tailLength);
+
+                totalLines += insertLines - 1;
+
+                lineSkipMap.Coalesce(line + insertLines - 1);
+                lineSkipMap.Coalesce(line);
             }
 
-            public override int Read(byte[] buffer, int offset, int count)
+            // start of line is unaffected
+            currentLine = line;
+            currentOffset = lineStart;
+
+            if (EnableValidate)
             {
-                int read = 0;
-                int c;
-                do
+                if (totalLines < ValidateCutoffLines2)
                 {
-                    c = Math.Min(count, length - position);
-                    vector.CopyTo(start + position, buffer, offset, c);
-                    read += c;
-                    count -= c;
-                    offset += c;
-                    position += c;
-                } while (c != 0);
-                return read;
+                    Validate();
+                }
+            }
+        }
+
+        // Remove [startLine:startByte, endLine:endByte) (byte indices relative to start of line) with one range removal
+        // and skip map surgery, instead of line by line.
+        public void DeleteSection(int startLine, int startByte, int endLine, int endByte)
+        {
+            if ((startLine > endLine) || ((startLine == endLine) && (startByte > endByte)))
+            {
+                Debug.Assert(false);
+                throw new ArgumentException();
             }
 
-            public override long Seek(long offset, SeekOrigin origin)
+            int startLineStart = GetLineOffset(startLine);
+            int start = startLineStart + startByte;
+
+            if (startLine == endLine)
+            {
+                int end = startLineStart + endByte;
+                vector.RemoveRange(start, end - start);
+                lineSkipMap.LineLengthChanged(startLine, -(end - start));
+            }
+            else
             {
-                switch (origin)
+                int afterStartLine = GetLineOffset(startLine + 1);
+                int end = GetLineOffset(endLine) + endByte;
+                int afterEndLine = GetLineOffset(endLine + 1);
+
+                lineSkipMap.SplitAt(startLine + 1, afterStartLine);
+                lineSkipMap.SplitAt(endLine + 1, afterEndLine);
+                lineSkipMap.RemoveSegments(startLine + 1, endLine - startLine);
+                // start line keeps its head and acquires tail of end line, including that line's ending (or suffix)
+                lineSkipMap.LineLengthChanged(startLine, (afterEndLine - end) - (afterStartLine - start));
+
+                vector.RemoveRange(start, end - start);
+                totalLines -= endLine - startLine;
+
+                lineSkipMap.Coalesce(startLine);
+            }
+
+            // start of line is unaffected
+            currentLine = startLine;
+            currentOffset = startLineStart;
+
+            if (EnableValidate)
+            {
+                if (totalLines < ValidateCutoffLines2)
                 {
-                    default:
-                        Debug.Assert(false);
-                        throw new ArgumentException();
-                    case SeekOrigin.Begin:
-                        this.Position = offset;
-                        break;
-                    case SeekOrigin.Current:
-                        this.Position = offset + position;
-                        break;
-                    case SeekOrigin.End:
-                        this.Position = start + length + offset;
-                        break;
+                    Validate();
                 }
-                return position - start;
             }
+        }
 
-            public override void SetLength(long value)
+        // Append the stream's UTF-8 data to the end (e.g. new content of a file being followed), extending the line
+        // index from the previous end of data so that cost is proportional to the data appended. An unterminated last
+        // line simply grows when a later append completes it. The data must not end within a multi-byte sequence or
+        // between the CR and LF of a line ending, since the next append would not rejoin them.
+        public void Append(Stream stream, ref LineEndingInfo lineEndingInfo)
+        {
+            int start = vector.Count - suffixLength;
+            int endOfData = start;
+            byte[] buffer = new byte[SharedByteList.ChunkSize];
+            int read;
+            while ((read = stream.Read(buffer, 0, buffer.Length)) > 0)
             {
-                throw new NotSupportedException();
+                vector.InsertRange(endOfData, buffer, 0, read);
+                endOfData += read;
+            }
+            if (endOfData == start)
+            {
+                return;
             }
 
-            public override void Write(byte[] buffer, int offset, int count)
+            int line = totalLines - 1;
+            int offset = start;
+            int textEnd = IndexOfLineBreak(offset, endOfData);
+            if (textEnd < 0)
+            {
+                // all of it extends the last line
+                lineSkipMap.LineLengthChanged(line, endOfData - start);
+            }
+            else
             {
-                throw new NotSupportedException();
+                int currentSkipStartLine = line + 1;
+                int currentSkipNumLines = 0;
+                int currentSkipCharLength = 0;
+                while (true)
+                {
+                    int nextStart = textEnd;
+                    if (nextStart < endOfData)
+                    {
+                        if (vector[nextStart] == (byte)'\r')
+                        {
+                            if (vector[nextStart + 1] == (byte)'\n')
+                            {
+                                nextStart++;
+                                lineEndingInfo.windowsLFCount++;
+                            }
+                            else
+                            {
+                                lineEndingInfo.macintoshLFCount++;
+                            }
+                        }
+                        else
+                        {
+                            Debug.Assert(vector[nextStart] == (byte)'\n');
+                            lineEndingInfo.unixLFCount++;
+                        }
+                        nextStart++;
+                    }
+                    else
+                    {
+                        // final line is terminated by the suffix
+                        nextStart += suffixLength;
+                    }
+
+                    if (offset == start)
+                    {
+                        // previous last line acquires a line ending in place of the suffix, which moves to the new last line
+                        lineSkipMap.LineLengthChanged(line, (nextStart - start) - suffixLength);
+                    }
+                    else
+                    {
+                        currentSkipNumLines++;
+                        currentSkipCharLength += nextStart - offset;
+                        if ((currentSkipNumLines > LineSkipMap.Sparseness) || (currentSkipCharLength > LineSkipMap.ByteBudget))
+                        {
+                            lineSkipMap.InsertSegment(currentSkipStartLine, currentSkipNumLines, currentSkipCharLength);
+                            currentSkipStartLine += currentSkipNumLines;
+                            currentSkipNumLines = 0;
+                            currentSkipCharLength = 0;
+                        }
+                    }
+
+                    if (textEnd == endOfData)
+                    {
+                        break;
+                    }
+                    line++;
+                    offset = nextStart;
+                    textEnd = IndexOfLineBreak(offset, endOfData);
+                    if (textEnd < 0)
+                    {
+                        textEnd = endOfData;
+                    }
+                }
+                if (currentSkipNumLines != 0)
+                {
+                    lineSkipMap.InsertSegment(currentSkipStartLine, currentSkipNumLines, currentSkipCharLength);
+                }
+
+                lineSkipMap.Coalesce(totalLines - 1);
+                totalLines = line + 1;
+            }
+
+            // cached position may have been the end of data
+            currentLine = 0;
+            currentOffset = prefixLength;
+
+            if (EnableValidate)
+            {
+                if (totalLines < ValidateCutoffLines2)
+                {
+                    Validate();
+                }
             }
         }
     }
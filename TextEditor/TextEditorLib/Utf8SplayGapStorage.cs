@@ -65,6 +65,8 @@ namespace TextEditor
         protected class Utf8GapStorage : TextStorage
         {
             private Utf8SplayGapBuffer buffer;
+            private byte[] lineBytes; // scratch for allocation-free line access
+            private char[] lineChars;
 
             public Utf8GapStorage(Utf8SplayGapStorageFactory factory, Utf8SplayGapBuffer buffer)
                 : base(factory)
@@ -146,33 +148,100 @@ namespace TextEditor
                 buffer.SetLine(index, bytes);
             }
 
+            protected override int GetLineLength(int index)
+            {
+                int byteCount = buffer.CopyLine(index, ref lineBytes);
+                return Utf8Transcoding.Utf16Length(lineBytes, 0, byteCount);
+            }
+
+            // one byte per UTF-8 code unit - the skip map is small by comparison
+            public override long EstimateMemoryBytes()
+            {
+                return buffer.ByteCount;
+            }
+
+            public override int CopyLine(int index, ref char[] chars)
+            {
+                int byteCount = buffer.CopyLine(index, ref lineBytes);
+                // UTF-8 never decodes to more UTF-16 code units than it has bytes
+                EnsureCapacity(ref chars, byteCount);
+                return Encoding.UTF8.GetChars(lineBytes, 0, byteCount, chars, 0);
+            }
+
+            // Map char index within line to byte index. Fails if the line contains invalid UTF-8 (so that the caller can
+            // fall back to the decoding path, which normalizes it), if index would split a surrogate pair, or if out of range.
+            private bool TryGetLineByteIndex(int line, int charIndex, out int byteIndex)
+            {
+                byteIndex = -1;
+                if ((line < 0) || (line >= buffer.Count) || (charIndex < 0))
+                {
+                    return false;
+                }
+                int byteCount = buffer.CopyLine(line, ref lineBytes);
+                if (Utf8Transcoding.AsciiRunLength(lineBytes, 0, byteCount) == byteCount)
+                {
+                    // all ASCII - chars and bytes correspond
+                    if (charIndex > byteCount)
+                    {
+                        return false;
+                    }
+                    byteIndex = charIndex;
+                    return true;
+                }
+                EnsureCapacity(ref lineChars, byteCount);
+                int charCount = Encoding.UTF8.GetChars(lineBytes, 0, byteCount, lineChars, 0);
+                if ((charIndex > charCount) || ((charIndex > 0) && Char.IsHighSurrogate(lineChars[charIndex - 1])))
+                {
+                    return false;
+                }
+                if (Encoding.UTF8.GetByteCount(lineChars, 0, charCount) != byteCount)
+                {
+                    return false;
+                }
+                byteIndex = Encoding.UTF8.GetByteCount(lineChars, 0, charIndex);
+                return true;
+            }
+
             public override ITextStorage CloneSection(int startLine, int startChar, int endLine, int endCharPlusOne)
             {
-                if (startLine == endLine)
+                int startByte, endByte;
+                if ((startLine > endLine) || ((startLine == endLine) && (startChar > endCharPlusOne))
+                    || !TryGetLineByteIndex(startLine, startChar, out startByte)
+                    || !TryGetLineByteIndex(endLine, endCharPlusOne, out endByte))
                 {
                     return base.CloneSection(startLine, startChar, endLine, endCharPlusOne);
                 }
-                else
+
+                Utf8SplayGapBuffer bufferCopy = new Utf8SplayGapBuffer(buffer, startLine, startByte, endLine, endByte);
+                return new Utf8GapStorage((Utf8SplayGapStorageFactory)factory, bufferCopy);
+            }
+
+            public override void InsertSection(int insertLine, int insertChar, ITextStorage insert)
+            {
+                Utf8GapStorage source = insert as Utf8GapStorage;
+                int insertByte;
+                if ((source == null) || (source == this)
+                    || !TryGetLineByteIndex(insertLine, insertChar, out insertByte))
                 {
-                    LineEndingInfo lineEndingInfo;
-                    Utf8SplayGapBuffer bufferCopy = new Utf8SplayGapBuffer(
-                        buffer,
-                        startLine + 1,
-                        endLine - (startLine + 1),
-                        null,
-                        out lineEndingInfo);
-                    string start = Encoding.UTF8.GetString(buffer.GetLine(startLine));
-                    string end = Encoding.UTF8.GetString(buffer.GetLine(endLine));
-                    bufferCopy.InsertLine(0, Encoding.UTF8.GetBytes(start.Substring(startChar)));
-                    bufferCopy.SetLine(endLine - startLine, Encoding.UTF8.GetBytes(end.Substring(0, endCharPlusOne)));
-                    return new Utf8GapStorage((Utf8SplayGapStorageFactory)factory, bufferCopy);
+                    base.InsertSection(insertLine, insertChar, insert);
+                    return;
                 }
+
+                long perf = PerfCounters.Begin();
+                buffer.InsertSection(insertLine, insertByte, source.buffer);
+                Modified = true;
+                PerfCounters.End(PerfCounter.InsertSection, perf);
             }
 
-            public override void InsertSection(int insertLine, int insertChar, ITextStorage insert)
+            // appended bytes extend the buffer's line index in place
+            public override void AppendStream(Stream stream, Encoding encoding, ref LineEndingInfo lineEndingInfo)
             {
-                // TODO: optimize for copy/paste
-                base.InsertSection(insertLine, insertChar, insert);
+                long perf = PerfCounters.Begin();
+                buffer.Append(
+                    encoding is UTF8Encoding ? stream : new Utf8TranscodingReadStream(stream, encoding),
+                    ref lineEndingInfo);
+                Modified = true;
+                PerfCounters.End(PerfCounter.Append, perf);
             }
 
             public override string GetText(string EOLN)
@@ -183,22 +252,46 @@ namespace TextEditor
 
             public override void DeleteSection(int startLine, int startChar, int endLine, int endCharPlusOne)
             {
-                // TODO: optimize for cut/delete
-                base.DeleteSection(startLine, startChar, endLine, endCharPlusOne);
+                int startByte, endByte;
+                if ((startLine > endLine) || ((startLine == endLine) && (startChar > endCharPlusOne))
+                    || !TryGetLineByteIndex(startLine, startChar, out startByte)
+                    || !TryGetLineByteIndex(endLine, endCharPlusOne, out endByte))
+                {
+                    base.DeleteSection(startLine, startChar, endLine, endCharPlusOne);
+                    return;
+                }
+
+                long perf = PerfCounters.Begin();
+                buffer.DeleteSection(startLine, startByte, endLine, endByte);
+                Modified = true;
+                PerfCounters.End(PerfCounter.DeleteSection, perf);
             }
 
+            // Line endings are normalized to EOLN on purpose, even though the buffer keeps the original ones: lines inserted
+            // by editing get CRLF and pasted sections keep their own, so writing the stored breaks would mix forms. EOLN is
+            // the window's line ending, taken from the file when it was loaded or chosen from the menu.
             public override void ToStream(Stream stream, Encoding encoding, string EOLN)
             {
-                // TODO: save for preserving line breaks
-                base.ToStream(stream, encoding, EOLN);
+                byte[] eoln = Encoding.UTF8.GetBytes(EOLN);
+                using (Utf8TranscodingWriteStream output = new Utf8TranscodingWriteStream(stream, encoding))
+                {
+                    int count = buffer.Count;
+                    for (int i = 0; i < count; i++)
+                    {
+                        if (i != 0)
+                        {
+                            output.Write(eoln, 0, eoln.Length);
+                        }
+                        int byteCount = buffer.CopyLine(i, ref lineBytes);
+                        output.Write(lineBytes, 0, byteCount);
+                    }
+                }
             }
         }
 
 
         public override bool PreservesLineEndings { get { return true; } }
 
-        public override Type[] PermittedEncodings { get { return new Type[] { typeof(UTF8Encoding), typeof(ANSIEncoding), }; } }
-
         public override TextStorage NewStorage()
         {
             return new Utf8GapStorage(this, new Utf8SplayGapBuffer());
@@ -217,30 +310,55 @@ namespace TextEditor
 
         public override ITextStorage FromUtf16Buffer(string utf16, int offset, int count, string EOLN)
         {
-            char[] utf16array = utf16.ToCharArray();
             // ignores EOLN because it preserves original line breaks
-            byte[] bytes = Encoding.UTF8.GetBytes(utf16array, 0, count); // TODO: make stream for this
             LineEndingInfo lineEndingInfo;
-            return FromStream(new MemoryStream(bytes), Encoding.UTF8, out lineEndingInfo);
+            return new Utf8GapStorage(this, new Utf8SplayGapBuffer(utf16, offset, count, out lineEndingInfo));
         }
 
         public override ITextStorage FromStream(Stream stream, Encoding encoding, out LineEndingInfo lineEndingInfo)
         {
             bool utf8 = encoding is UTF8Encoding;
-            if (!utf8 && !(encoding is ANSIEncoding))
-            {
-                Debug.Assert(false);
-                throw new ArgumentException();
-            }
             return new Utf8GapStorage(
                 this,
                 new Utf8SplayGapBuffer(
-                    stream,
+                    utf8 ? stream : new Utf8TranscodingReadStream(stream, encoding),
                     utf8/*detectBom*/,
-                    encoding,
                     out lineEndingInfo));
         }
 
+        // as FromStream(), also producing the line index of the data for saving (see LineIndex)
+        public ITextStorage FromStream(Stream stream, Encoding encoding, out LineEndingInfo lineEndingInfo, out LineIndex index)
+        {
+            bool utf8 = encoding is UTF8Encoding;
+            return new Utf8GapStorage(
+                this,
+                new Utf8SplayGapBuffer(
+                    utf8 ? stream : new Utf8TranscodingReadStream(stream, encoding),
+                    utf8/*detectBom*/,
+                    out lineEndingInfo,
+                    out index));
+        }
+
+        // as FromStream(), using the line index saved from an earlier load of the same data instead of scanning it -
+        // returns null if the index does not fit the data (the stream will have been consumed)
+        public ITextStorage FromStream(Stream stream, Encoding encoding, LineIndex index)
+        {
+            bool utf8 = encoding is UTF8Encoding;
+            try
+            {
+                return new Utf8GapStorage(
+                    this,
+                    new Utf8SplayGapBuffer(
+                        utf8 ? stream : new Utf8TranscodingReadStream(stream, encoding),
+                        utf8/*detectBom*/,
+                        index));
+            }
+            catch (InvalidDataException)
+            {
+                return null;
+            }
+        }
+
         public override ITextLine Encode(string line)
         {
             return new Utf8GapStorageLine(Encoding.UTF8.GetBytes(line));
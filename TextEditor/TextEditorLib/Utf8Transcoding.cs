@@ -0,0 +1,558 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Diagnostics;
+using System.IO;
+using System.Text;
+
+namespace TextEditor
+{
+    // Block-streaming transcoding between UTF-8 and the encodings files are loaded and saved in, so that the UTF-8
+    // storage can be fed from (and written to) a file in any encoding without per-line decode/encode round trips.
+    // Raw 8-bit (ANSIEncoding) and UTF-16 are converted directly, with runs of ASCII found eight bytes at a time;
+    // other encodings go through their Decoder/Encoder a block at a time.
+    public static class Utf8Transcoding
+    {
+#if DEBUG
+        public const int BlockSize = 17; // odd size for testing continuations
+#else
+        public const int BlockSize = 65536;
+#endif
+
+        private const ulong AsciiMask = 0x8080808080808080UL;
+        private const ulong Utf16LittleEndianAsciiMask = 0xFF80FF80FF80FF80UL;
+        private const ulong Utf16BigEndianAsciiMask = 0x80FF80FF80FF80FFUL;
+
+        public enum Form
+        {
+            Utf8,
+            Ansi,
+            Utf16LittleEndian,
+            Utf16BigEndian,
+            Other,
+        }
+
+        public static Form GetForm(Encoding encoding)
+        {
+            if (encoding is UTF8Encoding)
+            {
+                return Form.Utf8;
+            }
+            if (encoding is ANSIEncoding)
+            {
+                return Form.Ansi;
+            }
+            if (encoding is UnicodeEncoding)
+            {
+                return encoding.CodePage == 1201 ? Form.Utf16BigEndian : Form.Utf16LittleEndian;
+            }
+            return Form.Other;
+        }
+
+        // number of consecutive ASCII bytes starting at index
+        public static int AsciiRunLength(byte[] bytes, int index, int end)
+        {
+            int i = index;
+            while ((i + 8 <= end) && ((BitConverter.ToUInt64(bytes, i) & AsciiMask) == 0))
+            {
+                i += 8;
+            }
+            while ((i < end) && (bytes[i] < 0x80))
+            {
+                i++;
+            }
+            return i - index;
+        }
+
+        // number of UTF-16 code units that the UTF-8 bytes [index, end) decode to
+        public static int Utf16Length(byte[] bytes, int index, int end)
+        {
+            int ascii = AsciiRunLength(bytes, index, end);
+            return ascii + (index + ascii < end ? Encoding.UTF8.GetCharCount(bytes, index + ascii, end - index - ascii) : 0);
+        }
+
+        // number of consecutive ASCII UTF-16 code units starting at index
+        public static int Utf16AsciiRunLength(byte[] bytes, int index, int end, bool bigEndian)
+        {
+            int i = index;
+            if (BitConverter.IsLittleEndian)
+            {
+                ulong mask = bigEndian ? Utf16BigEndianAsciiMask : Utf16LittleEndianAsciiMask;
+                while ((i + 8 <= end) && ((BitConverter.ToUInt64(bytes, i) & mask) == 0))
+                {
+                    i += 8;
+                }
+            }
+            int high = bigEndian ? 0 : 1;
+            while ((i + 2 <= end) && (bytes[i + high] == 0) && (bytes[i + (1 - high)] < 0x80))
+            {
+                i += 2;
+            }
+            return (i - index) / 2;
+        }
+
+        private static int PutReplacementChar(byte[] output, int o)
+        {
+            // U+FFFD
+            output[o++] = 0xEF;
+            output[o++] = 0xBF;
+            output[o++] = 0xBD;
+            return o;
+        }
+
+        // raw 8-bit to UTF-8; output must have room for 2 * count bytes
+        public static int AnsiToUtf8(byte[] input, int count, byte[] output)
+        {
+            int i = 0;
+            int o = 0;
+            while (i < count)
+            {
+                int run = AsciiRunLength(input, i, count);
+                Buffer.BlockCopy(input, i, output, o, run);
+                i += run;
+                o += run;
+                while ((i < count) && (input[i] >= 0x80))
+                {
+                    byte b = input[i++];
+                    output[o++] = (byte)(0xC0 | (b >> 6));
+                    output[o++] = (byte)(0x80 | (b & 0x3F));
+                }
+            }
+            return o;
+        }
+
+        // UTF-16 (count must be even) to UTF-8; output must have room for 3 * (count / 2) + 3 bytes. highSurrogate carries
+        // a high surrogate at the end of one block to the next (-1 if none). Unpaired surrogates become U+FFFD.
+        public static int Utf16ToUtf8(byte[] input, int count, bool bigEndian, byte[] output, ref int highSurrogate)
+        {
+            Debug.Assert(count % 2 == 0);
+            int i = 0;
+            int o = 0;
+            while (i < count)
+            {
+                if (highSurrogate < 0)
+                {
+                    int run = Utf16AsciiRunLength(input, i, count, bigEndian);
+                    int low = i + (bigEndian ? 1 : 0);
+                    for (int k = 0; k < run; k++)
+                    {
+                        output[o + k] = input[low + 2 * k];
+                    }
+                    o += run;
+                    i += 2 * run;
+                    if (i == count)
+                    {
+                        break;
+                    }
+                }
+
+                int c = bigEndian ? ((input[i] << 8) | input[i + 1]) : (input[i] | (input[i + 1] << 8));
+                i += 2;
+
+                if (highSurrogate >= 0)
+                {
+                    if ((c >= 0xDC00) && (c <= 0xDFFF))
+                    {
+                        int codePoint = 0x10000 + ((highSurrogate - 0xD800) << 10) + (c - 0xDC00);
+                        output[o++] = (byte)(0xF0 | (codePoint >> 18));
+                        output[o++] = (byte)(0x80 | ((codePoint >> 12) & 0x3F));
+                        output[o++] = (byte)(0x80 | ((codePoint >> 6) & 0x3F));
+                        output[o++] = (byte)(0x80 | (codePoint & 0x3F));
+                        highSurrogate = -1;
+                        continue;
+                    }
+                    o = PutReplacementChar(output, o);
+                    highSurrogate = -1;
+                }
+
+                if (c < 0x80)
+                {
+                    output[o++] = (byte)c;
+                }
+                else if (c < 0x800)
+                {
+                    output[o++] = (byte)(0xC0 | (c >> 6));
+                    output[o++] = (byte)(0x80 | (c & 0x3F));
+                }
+                else if ((c >= 0xD800) && (c <= 0xDBFF))
+                {
+                    highSurrogate = c;
+                }
+                else if ((c >= 0xDC00) && (c <= 0xDFFF))
+                {
+                    o = PutReplacementChar(output, o);
+                }
+                else
+                {
+                    output[o++] = (byte)(0xE0 | (c >> 12));
+                    output[o++] = (byte)(0x80 | ((c >> 6) & 0x3F));
+                    output[o++] = (byte)(0x80 | (c & 0x3F));
+                }
+            }
+            return o;
+        }
+
+        // finish a UTF-16 conversion: unpaired high surrogate or odd trailing byte becomes U+FFFD
+        public static int Utf16ToUtf8Flush(byte[] output, int o, ref int highSurrogate, bool oddByte)
+        {
+            if (highSurrogate >= 0)
+            {
+                o = PutReplacementChar(output, o);
+                highSurrogate = -1;
+            }
+            if (oddByte)
+            {
+                o = PutReplacementChar(output, o);
+            }
+            return o;
+        }
+
+        // UTF-16 string section [index, end) to UTF-8, filling output (at least 4 bytes long) as far as whole characters
+        // fit - returns the byte count and advances index past the characters consumed. A surrogate pair is never split
+        // between calls; unpaired surrogates become U+FFFD.
+        public static int Utf16ToUtf8(string input, ref int index, int end, byte[] output)
+        {
+            Debug.Assert(output.Length >= 4);
+            int i = index;
+            int o = 0;
+            while ((i < end) && (o + 4 <= output.Length))
+            {
+                int c = input[i];
+                if (c < 0x80)
+                {
+                    int run = Math.Min(end - i, output.Length - o);
+                    int k = 0;
+                    while ((k < run) && ((c = input[i + k]) < 0x80))
+                    {
+                        output[o + k] = (byte)c;
+                        k++;
+                    }
+                    i += k;
+                    o += k;
+                    continue;
+                }
+
+                i++;
+                if (c < 0x800)
+                {
+                    output[o++] = (byte)(0xC0 | (c >> 6));
+                    output[o++] = (byte)(0x80 | (c & 0x3F));
+                }
+                else if ((c >= 0xD800) && (c <= 0xDBFF) && (i < end) && (input[i] >= 0xDC00) && (input[i] <= 0xDFFF))
+                {
+                    int codePoint = 0x10000 + ((c - 0xD800) << 10) + (input[i++] - 0xDC00);
+                    output[o++] = (byte)(0xF0 | (codePoint >> 18));
+                    output[o++] = (byte)(0x80 | ((codePoint >> 12) & 0x3F));
+                    output[o++] = (byte)(0x80 | ((codePoint >> 6) & 0x3F));
+                    output[o++] = (byte)(0x80 | (codePoint & 0x3F));
+                }
+                else if ((c >= 0xD800) && (c <= 0xDFFF))
+                {
+                    o = PutReplacementChar(output, o);
+                }
+                else
+                {
+                    output[o++] = (byte)(0xE0 | (c >> 12));
+                    output[o++] = (byte)(0x80 | ((c >> 6) & 0x3F));
+                    output[o++] = (byte)(0x80 | (c & 0x3F));
+                }
+            }
+            index = i;
+            return o;
+        }
+    }
+
+    // Read-only stream presenting the contents of a source stream in the specified encoding as UTF-8
+    public class Utf8TranscodingReadStream : Stream
+    {
+        private readonly Stream source;
+        private readonly Utf8Transcoding.Form form;
+        private readonly Decoder decoder; // Form.Other only
+        private readonly Encoder encoder; // Form.Other only
+
+        private readonly byte[] input = new byte[Utf8Transcoding.BlockSize];
+        private int carried; // bytes of an incomplete UTF-16 code unit kept at the start of input
+        private int highSurrogate = -1;
+        private readonly char[] chars;
+        private readonly byte[] output;
+        private int outputStart;
+        private int outputEnd;
+        private bool endOfSource;
+
+        public Utf8TranscodingReadStream(Stream source, Encoding encoding)
+        {
+            this.source = source;
+            this.form = Utf8Transcoding.GetForm(encoding);
+            if (form == Utf8Transcoding.Form.Other)
+            {
+                decoder = encoding.GetDecoder();
+                encoder = new UTF8Encoding(false/*encoderShouldEmitUTF8Identifier*/).GetEncoder();
+                chars = new char[encoding.GetMaxCharCount(input.Length)];
+                output = new byte[Encoding.UTF8.GetMaxByteCount(chars.Length)];
+            }
+            else
+            {
+                // 2 bytes per ANSI byte, at most 3 bytes per UTF-16 code unit, plus flushing
+                output = new byte[2 * input.Length + 6];
+            }
+        }
+
+        private void Fill()
+        {
+            outputStart = 0;
+            outputEnd = 0;
+
+            int read = source.Read(input, carried, input.Length - carried);
+            int count = carried + read;
+            carried = 0;
+            endOfSource = read == 0;
+
+            switch (form)
+            {
+                default:
+                    Debug.Assert(false);
+                    throw new InvalidOperationException();
+
+                case Utf8Transcoding.Form.Utf8:
+                    Buffer.BlockCopy(input, 0, output, 0, count);
+                    outputEnd = count;
+                    break;
+
+                case Utf8Transcoding.Form.Ansi:
+                    outputEnd = Utf8Transcoding.AnsiToUtf8(input, count, output);
+                    break;
+
+                case Utf8Transcoding.Form.Utf16LittleEndian:
+                case Utf8Transcoding.Form.Utf16BigEndian:
+                    {
+                        bool oddByte = (count % 2) != 0;
+                        outputEnd = Utf8Transcoding.Utf16ToUtf8(
+                            input,
+                            count - (oddByte ? 1 : 0),
+                            form == Utf8Transcoding.Form.Utf16BigEndian,
+                            output,
+                            ref highSurrogate);
+                        if (endOfSource)
+                        {
+                            outputEnd = Utf8Transcoding.Utf16ToUtf8Flush(output, outputEnd, ref highSurrogate, oddByte);
+                        }
+                        else if (oddByte)
+                        {
+                            input[0] = input[count - 1];
+                            carried = 1;
+                        }
+                    }
+                    break;
+
+                case Utf8Transcoding.Form.Other:
+                    {
+                        int charCount = decoder.GetChars(input, 0, count, chars, 0, endOfSource/*flush*/);
+                        outputEnd = encoder.GetBytes(chars, 0, charCount, output, 0, endOfSource/*flush*/);
+                    }
+                    break;
+            }
+        }
+
+        public override int Read(byte[] buffer, int offset, int count)
+        {
+            while ((outputStart == outputEnd) && !endOfSource)
+            {
+                Fill();
+            }
+            int c = Math.Min(count, outputEnd - outputStart);
+            Buffer.BlockCopy(output, outputStart, buffer, offset, c);
+            outputStart += c;
+            return c;
+        }
+
+        public override bool CanRead { get { return true; } }
+        public override bool CanSeek { get { return false; } }
+        public override bool CanWrite { get { return false; } }
+        public override long Length { get { throw new NotSupportedException(); } }
+        public override long Position { get { throw new NotSupportedException(); } set { throw new NotSupportedException(); } }
+
+        public override void Flush()
+        {
+        }
+
+        public override long Seek(long offset, SeekOrigin origin)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override void SetLength(long value)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override void Write(byte[] buffer, int offset, int count)
+        {
+            throw new NotSupportedException();
+        }
+    }
+
+    // Write-only stream accepting UTF-8 and writing it to a target stream in the specified encoding. Like StreamWriter,
+    // disposing closes the target stream.
+    public class Utf8TranscodingWriteStream : Stream
+    {
+        private readonly Stream target;
+        private readonly Utf8Transcoding.Form form;
+        private readonly Decoder decoder;
+        private readonly Encoder encoder;
+        private readonly char[] chars;
+        private readonly byte[] output;
+        private bool pending; // decoder or encoder may hold part of a sequence
+
+        public Utf8TranscodingWriteStream(Stream target, Encoding encoding)
+        {
+            this.target = target;
+            this.form = Utf8Transcoding.GetForm(encoding);
+            if (form != Utf8Transcoding.Form.Utf8)
+            {
+                decoder = new UTF8Encoding(false/*encoderShouldEmitUTF8Identifier*/).GetDecoder();
+                encoder = encoding.GetEncoder();
+                chars = new char[Encoding.UTF8.GetMaxCharCount(Utf8Transcoding.BlockSize)];
+                output = new byte[Math.Max(encoding.GetMaxByteCount(chars.Length), 2 * Utf8Transcoding.BlockSize)];
+            }
+        }
+
+        private void Convert(byte[] buffer, int offset, int count, bool flush)
+        {
+            do
+            {
+                int c = Math.Min(count, Utf8Transcoding.BlockSize);
+                bool last = flush && (c == count);
+                int charCount = decoder.GetChars(buffer, offset, c, chars, 0, last);
+                int byteCount = encoder.GetBytes(chars, 0, charCount, output, 0, last);
+                target.Write(output, 0, byteCount);
+                offset += c;
+                count -= c;
+            } while (count > 0);
+            pending = !flush;
+        }
+
+        private void WriteAscii(byte[] buffer, int offset, int count)
+        {
+            if (form == Utf8Transcoding.Form.Ansi)
+            {
+                target.Write(buffer, offset, count);
+                return;
+            }
+
+            // widen to UTF-16
+            int low = form == Utf8Transcoding.Form.Utf16BigEndian ? 1 : 0;
+            while (count > 0)
+            {
+                int c = Math.Min(count, Utf8Transcoding.BlockSize);
+                for (int i = 0; i < c; i++)
+                {
+                    output[2 * i + low] = buffer[offset + i];
+                    output[2 * i + (1 - low)] = 0;
+                }
+                target.Write(output, 0, 2 * c);
+                offset += c;
+                count -= c;
+            }
+        }
+
+        public override void Write(byte[] buffer, int offset, int count)
+        {
+            if (form == Utf8Transcoding.Form.Utf8)
+            {
+                target.Write(buffer, offset, count);
+                return;
+            }
+            if (form == Utf8Transcoding.Form.Other)
+            {
+                // encoding may not be ASCII-compatible
+                Convert(buffer, offset, count, false/*flush*/);
+                return;
+            }
+
+            int end = offset + count;
+            int i = offset;
+            while (i < end)
+            {
+                int run = Utf8Transcoding.AsciiRunLength(buffer, i, end);
+                if (run != 0)
+                {
+                    if (pending)
+                    {
+                        // an incomplete sequence followed by ASCII is invalid - finish it before taking the fast path
+                        Convert(buffer, i, 0, true/*flush*/);
+                    }
+                    WriteAscii(buffer, i, run);
+                    i += run;
+                }
+                else
+                {
+                    int j = i;
+                    while ((j < end) && (buffer[j] >= 0x80))
+                    {
+                        j++;
+                    }
+                    Convert(buffer, i, j - i, false/*flush*/);
+                    i = j;
+                }
+            }
+        }
+
+        public override void Flush()
+        {
+            target.Flush();
+        }
+
+        protected override void Dispose(bool disposing)
+        {
+            if (disposing)
+            {
+                if (pending)
+                {
+                    Convert(output, 0, 0, true/*flush*/);
+                }
+                target.Dispose();
+            }
+            base.Dispose(disposing);
+        }
+
+        public override bool CanRead { get { return false; } }
+        public override bool CanSeek { get { return false; } }
+        public override bool CanWrite { get { return true; } }
+        public override long Length { get { throw new NotSupportedException(); } }
+        public override long Position { get { throw new NotSupportedException(); } set { throw new NotSupportedException(); } }
+
+        public override int Read(byte[] buffer, int offset, int count)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override long Seek(long offset, SeekOrigin origin)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override void SetLength(long value)
+        {
+            throw new NotSupportedException();
+        }
+    }
+}
@@ -0,0 +1,422 @@
+/*
+ *  Copyright  1992-2002, 2015 Thomas R. Lawrence
+ * 
+ *  GNU General Public License
+ * 
+ *  This file is part of "Text Editor"
+ * 
+ *  "Text Editor" is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+
+using TreeLib;
+
+namespace TextEditor
+{
+    // Number of visual rows each line occupies when soft wrapped, as a tree of line ranges (X) against row ranges (Y),
+    // so that line -> row and row -> line are O(log n). Every range is either a run of lines of one row each or a
+    // single line of several rows; since one-row lines are interchangeable, runs of them are kept coalesced and the
+    // tree size is proportional to the number of lines that actually wrap. Lines that have not been measured yet
+    // count as one row each; measured status is kept as coalesced runs of measured and unmeasured lines, so that the
+    // next line to measure is found in O(log n) however much of the file has been measured.
+    public class VisualRowIndex
+    {
+#if DEBUG
+        public static readonly bool EnableValidate = true;
+#else
+        public const bool EnableValidate = false;
+#endif
+
+        private readonly SplayTreeRange2List map = new SplayTreeRange2List();
+        private readonly SplayTreeRangeMap<bool> measured = new SplayTreeRangeMap<bool>(); // runs alternate true/false
+
+        public void Reset(int lineCount)
+        {
+            map.Clear();
+            map.Insert(0, Side.X, lineCount, lineCount);
+            measured.Clear();
+            measured.Insert(0, lineCount, false);
+        }
+
+        public int LineCount { get { return map.GetExtent(Side.X); } }
+
+        public int RowCount { get { return map.GetExtent(Side.Y); } }
+
+        public bool IsMeasured(int line)
+        {
+            int start, count;
+            bool value;
+            measured.NearestLessOrEqual(line, out start);
+            measured.Get(start, out count, out value);
+            return value;
+        }
+
+        public int GetRowOfLine(int line)
+        {
+            int start, row, lines, rows;
+            map.NearestLessOrEqual(line, Side.X, out start);
+            map.Get(start, Side.X, out row, out lines, out rows);
+            return lines == rows ? row + (line - start) : row;
+        }
+
+        public int GetRows(int line)
+        {
+            int start, row, lines, rows;
+            map.NearestLessOrEqual(line, Side.X, out start);
+            map.Get(start, Side.X, out row, out lines, out rows);
+            return lines == rows ? 1 : rows;
+        }
+
+        public int GetLineOfRow(int row, out int rowInLine)
+        {
+            int start, line, lines, rows;
+            map.NearestLessOrEqual(row, Side.Y, out start);
+            map.Get(start, Side.Y, out line, out lines, out rows);
+            if (lines == rows)
+            {
+                rowInLine = 0;
+                return line + (row - start);
+            }
+            rowInLine = row - start;
+            return line;
+        }
+
+        // first line at or after line whose rows are not yet known, or LineCount if none
+        public int FindUnmeasured(int line)
+        {
+            if (line >= measured.GetExtent())
+            {
+                return measured.GetExtent();
+            }
+
+            int start, count;
+            bool value;
+            measured.NearestLessOrEqual(line, out start);
+            measured.Get(start, out count, out value);
+            if (!value)
+            {
+                return line;
+            }
+            // runs are coalesced, so the next one (if any) is unmeasured
+            int next;
+            return measured.NearestGreater(start, out next) ? next : measured.GetExtent();
+        }
+
+        // split line out of its run of unmeasured lines and merge it with measured neighbors
+        private void MarkMeasured(int line)
+        {
+            int start, count;
+            bool value;
+            measured.NearestLessOrEqual(line, out start);
+            measured.Get(start, out count, out value);
+            if (value)
+            {
+                return;
+            }
+
+            measured.Delete(start);
+            if (line > start)
+            {
+                measured.Insert(start, line - start, false);
+            }
+            measured.Insert(line, 1, true);
+            if (start + count > line + 1)
+            {
+                measured.Insert(line + 1, start + count - (line + 1), false);
+            }
+            CoalesceMeasured(line);
+        }
+
+        // merge run starting at start with neighbors of the same status
+        private void CoalesceMeasured(int start)
+        {
+            int count;
+            bool value;
+            measured.Get(start, out count, out value);
+
+            int next, nextCount;
+            bool nextValue;
+            if (measured.NearestGreater(start, out next))
+            {
+                measured.Get(next, out nextCount, out nextValue);
+                if (nextValue == value)
+                {
+                    measured.Delete(next);
+                    measured.Delete(start);
+                    count += nextCount;
+                    measured.Insert(start, count, value);
+                }
+            }
+
+            int previous, previousCount;
+            bool previousValue;
+            if ((start > 0) && measured.NearestLessOrEqual(start - 1, out previous))
+            {
+                measured.Get(previous, out previousCount, out previousValue);
+                if (previousValue == value)
+                {
+                    measured.Delete(start);
+                    measured.Delete(previous);
+                    measured.Insert(previous, previousCount + count, value);
+                }
+            }
+        }
+
+        public void SetRows(int line, int rows)
+        {
+            Debug.Assert(rows >= 1);
+            MarkMeasured(line);
+
+            int start, row, count, oldRows;
+            map.NearestLessOrEqual(line, Side.X, out start);
+            map.Get(start, Side.X, out row, out count, out oldRows);
+            if (count == oldRows)
+            {
+                if (rows == 1)
+                {
+                    return;
+                }
+                // split line out of run of one-row lines
+                map.Delete(start, Side.X);
+                if (line > start)
+                {
+                    map.Insert(start, Side.X, line - start, line - start);
+                }
+                map.Insert(line, Side.X, 1, rows);
+                if (start + count > line + 1)
+                {
+                    map.Insert(line + 1, Side.X, start + count - (line + 1), start + count - (line + 1));
+                }
+            }
+            else
+            {
+                Debug.Assert((count == 1) && (start == line));
+                if (rows == oldRows)
+                {
+                    return;
+                }
+                map.Delete(line, Side.X);
+                map.Insert(line, Side.X, 1, rows);
+                if (rows == 1)
+                {
+                    Coalesce(line);
+                }
+            }
+
+            if (EnableValidate)
+            {
+                Validate();
+            }
+        }
+
+        // merge one-row range starting at start with one-row neighbors
+        private void Coalesce(int start)
+        {
+            int row, count, rows;
+            map.Get(start, Side.X, out row, out count, out rows);
+            Debug.Assert(count == rows);
+
+            int next, nextRow, nextCount, nextRows;
+            if (map.NearestGreater(start, Side.X, out next))
+            {
+                map.Get(next, Side.X, out nextRow, out nextCount, out nextRows);
+                if (nextCount == nextRows)
+                {
+                    map.Delete(next, Side.X);
+                    map.Delete(start, Side.X);
+                    count += nextCount;
+                    map.Insert(start, Side.X, count, count);
+                }
+            }
+
+            int previous, previousRow, previousCount, previousRows;
+            if ((start > 0) && map.NearestLessOrEqual(start - 1, Side.X, out previous))
+            {
+                map.Get(previous, Side.X, out previousRow, out previousCount, out previousRows);
+                if (previousCount == previousRows)
+                {
+                    map.Delete(start, Side.X);
+                    map.Delete(previous, Side.X);
+                    map.Insert(previous, Side.X, previousCount + count, previousCount + count);
+                }
+            }
+        }
+
+        // call before lines [startLine, startLine + removedLines] are replaced by [startLine, startLine + insertedLines]
+        public void ReplacingLines(int startLine, int removedLines, int insertedLines)
+        {
+            // remove old lines range by range
+            int remaining = removedLines + 1;
+            while (remaining > 0)
+            {
+                int start, row, count, rows;
+                map.NearestLessOrEqual(startLine, Side.X, out start);
+                map.Get(start, Side.X, out row, out count, out rows);
+                map.Delete(start, Side.X);
+                if (count == rows)
+                {
+                    int removed = Math.Min(start + count - startLine, remaining);
+                    remaining -= removed;
+                    if (count > removed)
+                    {
+                        map.Insert(start, Side.X, count - removed, count - removed);
+                    }
+                }
+                else
+                {
+                    Debug.Assert(start == startLine);
+                    remaining--;
+                }
+            }
+
+            // new lines are unmeasured, one row each - joining the run of one-row lines before them, if any
+            int inserted = insertedLines + 1;
+            int at = startLine;
+            int merged = 0;
+            if (startLine > 0)
+            {
+                int previous, row, count, rows;
+                map.NearestLessOrEqual(startLine - 1, Side.X, out previous);
+                map.Get(previous, Side.X, out row, out count, out rows);
+                if (count == rows)
+                {
+                    map.Delete(previous, Side.X);
+                    at = previous;
+                    merged = count;
+                }
+            }
+            map.Insert(at, Side.X, merged + inserted, merged + inserted);
+            Coalesce(at);
+
+            // likewise for measured status - new lines form (or join) a run of unmeasured lines
+            remaining = removedLines + 1;
+            while (remaining > 0)
+            {
+                int start, count;
+                bool value;
+                measured.NearestLessOrEqual(startLine, out start);
+                measured.Get(start, out count, out value);
+                measured.Delete(start);
+                int removed = Math.Min(start + count - startLine, remaining);
+                remaining -= removed;
+                if (count > removed)
+                {
+                    measured.Insert(start, count - removed, value);
+                }
+            }
+            measured.Insert(startLine, insertedLines + 1, false);
+            CoalesceMeasured(startLine);
+
+            if (EnableValidate)
+            {
+                Validate();
+            }
+        }
+
+        public void Validate()
+        {
+            Debug.Assert(EnableValidate);
+
+            Debug.Assert(map.GetExtent(Side.X) == measured.GetExtent());
+            int run = 0;
+            bool previousMeasured = false;
+            while (run < measured.GetExtent())
+            {
+                int runCount;
+                bool runMeasured;
+                measured.Get(run, out runCount, out runMeasured);
+                Debug.Assert((run == 0) || (runMeasured != previousMeasured)); // coalesced
+                previousMeasured = runMeasured;
+                run += runCount;
+            }
+
+            int line = 0;
+            int previousCount = 0, previousRows = 0;
+            while (line < map.GetExtent(Side.X))
+            {
+                int row, count, rows;
+                map.Get(line, Side.X, out row, out count, out rows);
+                Debug.Assert((count == rows) || ((count == 1) && (rows > 1)));
+                Debug.Assert(!((count == rows) && (previousCount == previousRows) && (line > 0))); // coalesced
+                previousCount = count;
+                previousRows = rows;
+                line += count;
+            }
+        }
+
+        // Row start columns for soft wrapping text at width: rows break after whitespace when possible, otherwise at
+        // the last position that keeps characters together, and always hold at least one character. Spaces reaching
+        // the edge hang past it rather than starting the next row. Positions are supplied by the caller's layout.
+        public static int[] GetRowStarts(string text, int width, Func<int, int> columnToX, Func<int, int> xToColumn)
+        {
+            List<int> starts = new List<int>();
+            starts.Add(0);
+            int start = 0;
+            int startX = 0;
+            while (columnToX(text.Length) - startX > width)
+            {
+                int end = Math.Min(Math.Max(xToColumn(startX + width), start), text.Length);
+                while ((end > start) && (columnToX(end) - startX > width))
+                {
+                    end--;
+                }
+
+                int next = end;
+                while ((next < text.Length) && (text[next] == ' '))
+                {
+                    next++;
+                }
+                if (next == end)
+                {
+                    next = start;
+                    for (int i = end; i > start; i--)
+                    {
+                        if (Char.IsWhiteSpace(text[i - 1]) && LongLineLayout.IsSafeBreak(text, i))
+                        {
+                            next = i;
+                            break;
+                        }
+                    }
+                    for (int i = end; (next == start) && (i > start); i--)
+                    {
+                        if (LongLineLayout.IsSafeBreak(text, i))
+                        {
+                            next = i;
+                        }
+                    }
+                    if (next == start)
+                    {
+                        next = start + 1;
+                        while ((next < text.Length) && !LongLineLayout.IsSafeBreak(text, next))
+                        {
+                            next++;
+                        }
+                    }
+                }
+                if (next >= text.Length)
+                {
+                    break;
+                }
+
+                starts.Add(next);
+                start = next;
+                startX = columnToX(start);
+            }
+            return starts.ToArray();
+        }
+    }
+}